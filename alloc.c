@@ -0,0 +1,240 @@
+#include "alloc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ArenaSpill is a block of an arena allocated when its base ran out */
+struct ArenaSpill {
+	ArenaSpill *next;
+	size_t len, cap;
+	uint8_t pad[ALLOC_ALIGN - (2 * sizeof(size_t) + sizeof(void *)) %
+				      ALLOC_ALIGN];
+	uint8_t data[];
+};
+
+/* PoolChunk heads each chunk of a pool */
+typedef union PoolChunk {
+	union PoolChunk *next;
+	uint8_t pad[ALLOC_ALIGN];
+} PoolChunk;
+
+static Arena frame;
+
+#ifdef DEBUG
+/* stats counts the heap allocations of the current and past frames */
+static struct {
+	uint32_t count; /* in the current frame */
+	uint32_t last;  /* in the last frame */
+	uint32_t max;   /* in any frame */
+	uint32_t dirty; /* frames that allocated */
+	uint32_t frames;
+} stats;
+#define COUNT() (stats.count++)
+#else
+#define COUNT() ((void)0)
+#endif
+
+/* alignUp rounds sz up to a multiple of ALLOC_ALIGN */
+static size_t alignUp(size_t sz) {
+	return (sz + ALLOC_ALIGN - 1) & ~(size_t)(ALLOC_ALIGN - 1);
+}
+
+/* alloc_Heap mallocs sz bytes, counting the allocation in DEBUG builds */
+void *alloc_Heap(size_t sz) {
+	COUNT();
+	return malloc(sz);
+}
+
+/* alloc_Realloc reallocs p to sz bytes, counting the allocation in DEBUG
+ * builds */
+void *alloc_Realloc(void *p, size_t sz) {
+	COUNT();
+	return realloc(p, sz);
+}
+
+/* init_Arena initializes a with cap bytes */
+bool init_Arena(Arena *a, size_t cap) {
+	memset(a, 0, sizeof(Arena));
+	cap = alignUp(cap);
+	if ((a->base = alloc_Heap(cap)) == NULL) {
+		puts("error: failed to allocate arena");
+		return false;
+	}
+	a->cap = cap;
+	return true;
+}
+
+/* freeSpill frees the spill blocks of a */
+static void freeSpill(Arena *a) {
+	ArenaSpill *s, *next;
+
+	for (s = a->spill; s != NULL; s = next) {
+		next = s->next;
+		free(s);
+	}
+	a->spill = NULL;
+}
+
+void deinit_Arena(Arena *a) {
+	freeSpill(a);
+	free(a->base);
+	memset(a, 0, sizeof(Arena));
+}
+
+/* arena_Alloc returns sz bytes from a that stay valid until its reset (NULL
+ * on failure) */
+void *arena_Alloc(Arena *a, size_t sz) {
+	ArenaSpill *s;
+	size_t cap;
+	void *p;
+
+	sz = alignUp(sz);
+	if (sz <= a->cap - a->len) {
+		p = a->base + a->len;
+		a->len += sz;
+		return p;
+	}
+
+	/* spill into a block of its own until the next reset */
+	a->spilled += sz;
+	s = a->spill;
+	if (s == NULL || sz > s->cap - s->len) {
+		cap = sz > a->cap ? sz : a->cap;
+		if ((s = alloc_Heap(sizeof(ArenaSpill) + cap)) == NULL) {
+			puts("error: failed to grow arena");
+			return NULL;
+		}
+		s->next = a->spill;
+		s->len = 0;
+		s->cap = cap;
+		a->spill = s;
+	}
+	p = s->data + s->len;
+	s->len += sz;
+	return p;
+}
+
+/* arena_Reset frees everything allocated from a. If a spilled since the
+ * last reset, its base grows to hold all of it. */
+void arena_Reset(Arena *a) {
+	size_t cap;
+	void *p;
+
+	a->len = 0;
+	if (a->spill == NULL) {
+		return;
+	}
+	freeSpill(a);
+	cap = alignUp(a->cap + a->spilled);
+	a->spilled = 0;
+	free(a->base);
+	if ((p = alloc_Heap(cap)) == NULL) {
+		puts("error: failed to grow arena");
+		a->base = NULL;
+		a->cap = 0;
+		return;
+	}
+	a->base = p;
+	a->cap = cap;
+}
+
+/* init_Pool initializes p to hand out objects of size sz, perChunk objects
+ * at a time */
+void init_Pool(Pool *p, size_t sz, uint32_t perChunk) {
+	memset(p, 0, sizeof(Pool));
+	p->size = alignUp(sz < sizeof(void *) ? sizeof(void *) : sz);
+	p->perChunk = perChunk ? perChunk : 1;
+}
+
+/* deinit_Pool frees every chunk of p (and every object handed out) */
+void deinit_Pool(Pool *p) {
+	PoolChunk *c, *next;
+
+	for (c = p->chunks; c != NULL; c = next) {
+		next = c->next;
+		free(c);
+	}
+	p->chunks = p->free = NULL;
+	p->used = 0;
+}
+
+/* pool_Alloc returns an object from p (NULL on failure) */
+void *pool_Alloc(Pool *p) {
+	PoolChunk *c;
+	uint8_t *obj;
+	uint32_t i;
+
+	if (p->free == NULL) {
+		c = alloc_Heap(sizeof(PoolChunk) + p->size * p->perChunk);
+		if (c == NULL) {
+			puts("error: failed to grow pool");
+			return NULL;
+		}
+		c->next = p->chunks;
+		p->chunks = c;
+
+		/* thread the chunk's objects onto the free list in order */
+		obj = (uint8_t *)(c + 1);
+		for (i = 0; i < p->perChunk; ++i) {
+			*(void **)(obj + i * p->size) =
+			    i + 1 < p->perChunk ? obj + (i + 1) * p->size
+						: NULL;
+		}
+		p->free = obj;
+	}
+	obj = p->free;
+	p->free = *(void **)obj;
+	p->used++;
+	return obj;
+}
+
+/* pool_Free returns obj (from pool_Alloc(p)) to p */
+void pool_Free(Pool *p, void *obj) {
+	if (obj == NULL) {
+		return;
+	}
+	*(void **)obj = p->free;
+	p->free = obj;
+	p->used--;
+}
+
+/* frame_Alloc returns sz bytes that stay valid until the frame is presented
+ * (NULL on failure) */
+void *frame_Alloc(size_t sz) {
+	if (frame.base == NULL && !init_Arena(&frame, FRAME_ARENA_SIZE)) {
+		return NULL;
+	}
+	return arena_Alloc(&frame, sz);
+}
+
+/* frame_Reset frees the frame's transient data; it is called once the
+ * frame has been presented */
+void frame_Reset() {
+	arena_Reset(&frame);
+#ifdef DEBUG
+	stats.last = stats.count;
+	stats.max = stats.count > stats.max ? stats.count : stats.max;
+	stats.dirty += stats.count != 0;
+	stats.frames++;
+	stats.count = 0;
+#endif
+}
+
+/* alloc_FrameCount returns the number of heap allocations made in the last
+ * frame (always 0 outside DEBUG builds) */
+uint32_t alloc_FrameCount() {
+#ifdef DEBUG
+	return stats.last;
+#else
+	return 0;
+#endif
+}
+
+/* alloc_Report prints the heap allocations per frame */
+void alloc_Report() {
+#ifdef DEBUG
+	printf("alloc: %u/%u frames allocated, last %u, max %u; frame arena "
+	       "%zu bytes\n",
+	       stats.dirty, stats.frames, stats.last, stats.max, frame.cap);
+#endif
+}
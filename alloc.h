@@ -0,0 +1,60 @@
+/*
+ * alloc.h
+ * Allocators that keep the heap out of the frame loop.
+ * An Arena hands out memory linearly and is reset all at once. The frame
+ * arena (frame_Alloc()) holds the transient data of one frame and is reset
+ * after the frame is presented; if a frame outgrows it, it grows at the
+ * reset so that later frames fit without touching the heap.
+ * A Pool hands out objects of one size from chunks, reusing freed objects.
+ * In DEBUG builds, the heap allocations made by the allocators (and through
+ * alloc_Heap()) are counted per frame.
+ */
+#ifndef ALLOC_H
+#define ALLOC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* the alignment of every arena and pool allocation */
+enum { ALLOC_ALIGN = 16 };
+
+/* the initial size of the frame arena */
+enum { FRAME_ARENA_SIZE = 256 * 1024 };
+
+typedef struct ArenaSpill ArenaSpill;
+
+typedef struct {
+	uint8_t *base;
+	size_t len, cap;
+	ArenaSpill *spill; /* blocks allocated once base ran out */
+	size_t spilled;    /* bytes allocated from spill since the reset */
+} Arena;
+
+typedef struct {
+	size_t size;       /* of an object, rounded up to ALLOC_ALIGN */
+	uint32_t perChunk; /* objects per chunk */
+	void *free;        /* free objects, linked through their first word */
+	void *chunks;      /* chunks, linked through their header */
+	uint32_t used;     /* objects handed out */
+} Pool;
+
+bool init_Arena(Arena *, size_t);
+void deinit_Arena(Arena *);
+void *arena_Alloc(Arena *, size_t);
+void arena_Reset(Arena *);
+
+void init_Pool(Pool *, size_t, uint32_t);
+void deinit_Pool(Pool *);
+void *pool_Alloc(Pool *);
+void pool_Free(Pool *, void *);
+
+void *frame_Alloc(size_t);
+void frame_Reset();
+
+void *alloc_Heap(size_t);
+void *alloc_Realloc(void *, size_t);
+uint32_t alloc_FrameCount();
+void alloc_Report();
+
+#endif
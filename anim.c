@@ -0,0 +1,296 @@
+#include "anim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include "alloc.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* the values of a new instance (no change to the rune's draw) */
+static const AnimInstance identity = {
+    {0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f}};
+
+/* tracks holds every active track, structure-of-arrays. cap is a multiple of
+ * 4 so that the last batch can always be loaded whole. */
+static struct {
+	float *phase;  /* progress, in durations */
+	float *rate;   /* 1 / duration (s) */
+	float *period; /* phase wraps at 1 (loop), 2 (ping-pong) or never (0) */
+	float *ease;   /* 1 to ease in and out, else 0 */
+	float *from, *to;
+	uint32_t *target; /* instance * ANIM_NUM_PROPS + property */
+	uint32_t len, cap;
+} tracks;
+
+/* instances holds the per-instance data; instance 0 is never used. Copies
+ * of a rune share its instance, so live marks the instances not yet freed
+ * and a repeated stop is ignored. */
+static struct {
+	AnimInstance *inst;
+	uint32_t *free;
+	bool *live;
+	uint32_t len, cap, numFree;
+} instances;
+
+/* growTracks doubles the capacity of tracks */
+static bool growTracks() {
+	float **arrays[] = {&tracks.phase, &tracks.rate, &tracks.period,
+			    &tracks.ease,  &tracks.from, &tracks.to};
+	uint32_t i, cap;
+	void *p;
+
+	cap = tracks.cap ? tracks.cap * 2 : 64;
+	for (i = 0; i < sizeof(arrays) / sizeof(arrays[0]); ++i) {
+		p = alloc_Realloc(*arrays[i], cap * sizeof(float));
+		if (p == NULL) {
+			goto fail;
+		}
+		*arrays[i] = p;
+	}
+	p = alloc_Realloc(tracks.target, cap * sizeof(uint32_t));
+	if (p == NULL) {
+		goto fail;
+	}
+	tracks.target = p;
+	tracks.cap = cap;
+	return true;
+fail:
+	puts("error: failed to grow animation tracks");
+	return false;
+}
+
+/* newInstance returns a new instance with identity values (0 on failure) */
+static uint32_t newInstance() {
+	uint32_t id, cap;
+	void *p, *q, *l;
+
+	if (instances.numFree > 0) {
+		id = instances.free[--instances.numFree];
+		instances.inst[id] = identity;
+		instances.live[id] = true;
+		return id;
+	}
+	if (instances.len == 0) {
+		instances.len = 1;
+	}
+	if (instances.len >= instances.cap) {
+		cap = instances.cap ? instances.cap * 2 : 64;
+		p = alloc_Realloc(instances.inst, cap * sizeof(AnimInstance));
+		if (p != NULL) {
+			instances.inst = p;
+		}
+		q = alloc_Realloc(instances.free, cap * sizeof(uint32_t));
+		if (q != NULL) {
+			instances.free = q;
+		}
+		l = alloc_Realloc(instances.live, cap * sizeof(bool));
+		if (l != NULL) {
+			instances.live = l;
+		}
+		if (p == NULL || q == NULL || l == NULL) {
+			puts("error: failed to grow animation instances");
+			return 0;
+		}
+		instances.cap = cap;
+	}
+	id = instances.len++;
+	instances.inst[id] = identity;
+	instances.live[id] = true;
+	return id;
+}
+
+/* removeTrack removes track i by moving the last track into its place */
+static void removeTrack(uint32_t i) {
+	uint32_t last = --tracks.len;
+
+	tracks.phase[i] = tracks.phase[last];
+	tracks.rate[i] = tracks.rate[last];
+	tracks.period[i] = tracks.period[last];
+	tracks.ease[i] = tracks.ease[last];
+	tracks.from[i] = tracks.from[last];
+	tracks.to[i] = tracks.to[last];
+	tracks.target[i] = tracks.target[last];
+}
+
+/* anim_Add animates property prop of instance inst from from to to over
+ * duration seconds (with ANIM_* flags). If inst is 0 a new instance is
+ * created; a track already driving the property is replaced. Returns the
+ * instance or 0 on failure. */
+uint32_t anim_Add(uint32_t inst, uint32_t prop, float from, float to,
+		  float duration, uint32_t flags) {
+	uint32_t i, target;
+
+	if (prop >= ANIM_NUM_PROPS) {
+		return 0;
+	}
+	if (inst == 0 && (inst = newInstance()) == 0) {
+		return 0;
+	}
+	if (inst >= instances.len || !instances.live[inst]) {
+		return 0;
+	}
+	if (duration <= 0.0f) {
+		instances.inst[inst].v[prop] = to;
+		return inst;
+	}
+
+	target = inst * ANIM_NUM_PROPS + prop;
+	for (i = 0; i < tracks.len && tracks.target[i] != target; ++i)
+		;
+	if (i == tracks.len) {
+		if (tracks.len == tracks.cap && !growTracks()) {
+			return inst;
+		}
+		tracks.len++;
+	}
+	tracks.phase[i] = 0.0f;
+	tracks.rate[i] = 1.0f / duration;
+	tracks.period[i] = flags & ANIM_PINGPONG ? 2.0f
+			   : flags & ANIM_LOOP    ? 1.0f
+						  : 0.0f;
+	tracks.ease[i] = flags & ANIM_EASE ? 1.0f : 0.0f;
+	tracks.from[i] = from;
+	tracks.to[i] = to;
+	tracks.target[i] = target;
+	instances.inst[inst].v[prop] = from;
+	return inst;
+}
+
+/* anim_Stop removes the tracks of inst and frees it; stopping an instance
+ * that is already free does nothing */
+void anim_Stop(uint32_t inst) {
+	uint32_t i;
+
+	if (inst == 0 || inst >= instances.len || !instances.live[inst]) {
+		return;
+	}
+	instances.live[inst] = false;
+	for (i = 0; i < tracks.len;) {
+		if (tracks.target[i] / ANIM_NUM_PROPS == inst) {
+			removeTrack(i);
+		} else {
+			++i;
+		}
+	}
+	instances.free[instances.numFree++] = inst;
+}
+
+/* anim_Tick advances every track by dt seconds and writes the new values to
+ * their instances. Finished tracks leave their end value in place. */
+void anim_Tick(float dt) {
+	float *out;
+	uint32_t i;
+
+	out = (float *)instances.inst;
+	i = 0;
+#ifdef __SSE2__
+	{
+		const __m128 vdt = _mm_set1_ps(dt);
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 two = _mm_set1_ps(2.0f);
+		const __m128 three = _mm_set1_ps(3.0f);
+		const __m128 tiny = _mm_set1_ps(1e-30f);
+		float vals[4];
+		uint32_t j, n;
+
+		for (; i < tracks.len; i += 4) {
+			__m128 phase, period, wraps, wrapped, once, t, e, smooth;
+			__m128 from, to, v;
+
+			phase = _mm_loadu_ps(&tracks.phase[i]);
+			phase = _mm_add_ps(
+			    phase, _mm_mul_ps(_mm_loadu_ps(&tracks.rate[i]), vdt));
+
+			/* the phase is never negative, so truncation floors */
+			period = _mm_loadu_ps(&tracks.period[i]);
+			wraps = _mm_cvtepi32_ps(_mm_cvttps_epi32(
+			    _mm_div_ps(phase, _mm_max_ps(period, tiny))));
+			once = _mm_cmpeq_ps(period, _mm_setzero_ps());
+			wrapped = _mm_sub_ps(phase, _mm_mul_ps(period, wraps));
+			phase = _mm_or_ps(_mm_and_ps(once, _mm_min_ps(phase, one)),
+					  _mm_andnot_ps(once, wrapped));
+			_mm_storeu_ps(&tracks.phase[i], phase);
+
+			/* fold the second half of a ping-pong back */
+			t = _mm_min_ps(phase, _mm_sub_ps(two, phase));
+
+			/* t += ease * (smoothstep(t) - t) */
+			e = _mm_loadu_ps(&tracks.ease[i]);
+			smooth = _mm_mul_ps(_mm_mul_ps(t, t),
+					    _mm_sub_ps(three, _mm_mul_ps(two, t)));
+			t = _mm_add_ps(t, _mm_mul_ps(e, _mm_sub_ps(smooth, t)));
+
+			from = _mm_loadu_ps(&tracks.from[i]);
+			to = _mm_loadu_ps(&tracks.to[i]);
+			v = _mm_add_ps(from, _mm_mul_ps(_mm_sub_ps(to, from), t));
+			_mm_storeu_ps(vals, v);
+
+			n = tracks.len - i < 4 ? tracks.len - i : 4;
+			for (j = 0; j < n; ++j) {
+				out[tracks.target[i + j]] = vals[j];
+			}
+		}
+	}
+#else
+	for (; i < tracks.len; ++i) {
+		float phase, period, t;
+
+		phase = tracks.phase[i] + tracks.rate[i] * dt;
+		period = tracks.period[i];
+		if (period == 0.0f) {
+			phase = phase < 1.0f ? phase : 1.0f;
+		} else {
+			phase -= period * (float)(int32_t)(phase / period);
+		}
+		tracks.phase[i] = phase;
+
+		t = phase < 2.0f - phase ? phase : 2.0f - phase;
+		t += tracks.ease[i] * (t * t * (3.0f - 2.0f * t) - t);
+		out[tracks.target[i]] =
+		    tracks.from[i] + (tracks.to[i] - tracks.from[i]) * t;
+	}
+#endif
+
+	/* drop finished tracks */
+	for (i = 0; i < tracks.len;) {
+		if (tracks.period[i] == 0.0f && tracks.phase[i] >= 1.0f) {
+			removeTrack(i);
+		} else {
+			++i;
+		}
+	}
+}
+
+/* anim_Instance returns the values of inst or NULL if it doesn't exist */
+const AnimInstance *anim_Instance(uint32_t inst) {
+	if (inst == 0 || inst >= instances.len || !instances.live[inst]) {
+		return NULL;
+	}
+	return &instances.inst[inst];
+}
+
+/* anim_Apply transforms and tints res by the values of inst. The rune is
+ * scaled and rotated about its center. */
+void anim_Apply(uint32_t inst, RuneDrawResult *res) {
+	const AnimInstance *a;
+	float cx, cy, s;
+
+	if ((a = anim_Instance(inst)) == NULL) {
+		return;
+	}
+	s = a->v[ANIM_SCALE];
+	cx = res->pos.x + res->pos.w / 2.0f + a->v[ANIM_OFFSET_X];
+	cy = res->pos.y + res->pos.h / 2.0f + a->v[ANIM_OFFSET_Y];
+	res->pos.w *= s;
+	res->pos.h *= s;
+	res->pos.x = cx - res->pos.w / 2.0f;
+	res->pos.y = cy - res->pos.h / 2.0f;
+	res->rotation += a->v[ANIM_ROTATION];
+	res->tint[0] *= a->v[ANIM_RED];
+	res->tint[1] *= a->v[ANIM_GREEN];
+	res->tint[2] *= a->v[ANIM_BLUE];
+	res->tint[3] *= a->v[ANIM_OPACITY];
+}
+
+/* anim_NumTracks returns the number of active tracks */
+uint32_t anim_NumTracks() { return tracks.len; }
@@ -0,0 +1,45 @@
+/*
+ * anim.h
+ * anim evaluates per-character animations. Each animated rune owns an
+ * instance (the per-instance values the renderer applies to its draw) and
+ * registers tracks that drive one property of the instance. Tracks are
+ * stored structure-of-arrays and advanced together by anim_Tick(), 4 at a
+ * time with SSE.
+ */
+#ifndef ANIM_H
+#define ANIM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "rune.h"
+
+/* The animatable properties of an instance */
+enum { ANIM_OFFSET_X = 0, /* cells */
+       ANIM_OFFSET_Y,
+       ANIM_SCALE,
+       ANIM_ROTATION, /* radians, about the rune's center */
+       ANIM_RED,
+       ANIM_GREEN,
+       ANIM_BLUE,
+       ANIM_OPACITY,
+       ANIM_NUM_PROPS };
+
+/* Track flags */
+enum { ANIM_ONCE = 0,     /* stop at the end value */
+       ANIM_LOOP = 1,     /* restart from the start value */
+       ANIM_PINGPONG = 2, /* run back and forth */
+       ANIM_EASE = 4 };   /* ease in and out (smoothstep) */
+
+/* AnimInstance is the per-instance data the renderer applies */
+typedef struct {
+	float v[ANIM_NUM_PROPS];
+} AnimInstance;
+
+uint32_t anim_Add(uint32_t, uint32_t, float, float, float, uint32_t);
+void anim_Stop(uint32_t);
+void anim_Tick(float);
+const AnimInstance *anim_Instance(uint32_t);
+void anim_Apply(uint32_t, RuneDrawResult *);
+uint32_t anim_NumTracks();
+
+#endif
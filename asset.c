@@ -0,0 +1,480 @@
+#define _DEFAULT_SOURCE
+#include "asset.h"
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "glstate.h"
+#include "image.h"
+#include "sched.h"
+#include "texcomp.h"
+
+#ifdef __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#define HAVE_INOTIFY 1
+#endif
+
+/* Asset is a loaded file. The fields below the lock are shared with the
+ * asset thread; the rest belong to the main thread. */
+typedef struct {
+	char path[ASSET_MAX_PATH];
+	const char *name; /* the file name within path */
+	uint32_t kind;    /* ASSET_* */
+	int wd;           /* the inotify watch of its directory (-1 if none) */
+
+	uint32_t gen;  /* bumped by each reload */
+	bool loaded;   /* loading was attempted */
+	GLuint tex;    /* ASSET_IMAGE */
+	MeshData mesh; /* ASSET_MESH */
+	bool haveMesh;
+
+	/* under assets.lock */
+	double due; /* when to reload (sched_Now()), 0 if unchanged */
+	bool ready; /* a reload is waiting for asset_Poll() */
+	TexCompImage newImage;
+	MeshData newMesh;
+} Asset;
+
+static struct {
+	Asset assets[ASSET_MAX];
+	uint32_t len;
+
+	SDL_mutex *lock;
+	SDL_Thread *thread; /* NULL if files are not watched */
+	SDL_atomic_t numReady;
+	bool quit;
+	int inotify;
+	int wake[2];    /* a pipe that wakes the asset thread */
+	uint32_t event; /* the SDL event that wakes the main thread */
+} assets;
+
+/* importImage reads the image at path into img, ready to upload */
+static bool importImage(const char *path, TexCompImage *img) {
+	uint64_t key;
+	Image pixels;
+	bool ok;
+
+	key = texcomp_FileKey(path);
+	if (texcomp_ReadCached(key, img)) {
+		return true;
+	}
+	if (!image_Load(path, &pixels)) {
+		printf("error: failed to load texture %s\n", path);
+		return false;
+	}
+	ok = texcomp_Encode(key, pixels.pixels, pixels.w, pixels.h, img);
+	image_Free(&pixels);
+	return ok;
+}
+
+#ifdef HAVE_INOTIFY
+/* nextDue returns the milliseconds until the next change is due to be
+ * reloaded (-1 if none). The lock must be held. */
+static int nextDue(double now) {
+	double due = 0.0;
+	uint32_t i;
+
+	for (i = 0; i < assets.len; ++i) {
+		const Asset *a = &assets.assets[i];
+
+		if (a->due != 0.0 && !a->ready &&
+		    (due == 0.0 || a->due < due)) {
+			due = a->due;
+		}
+	}
+	if (due == 0.0) {
+		return -1;
+	}
+	return due <= now ? 0 : (int)((due - now) * 1000.0) + 1;
+}
+
+/* readEvents (re)starts the debounce of the assets that changed */
+static void readEvents() {
+	union {
+		struct inotify_event e;
+		char buf[4096];
+	} ev;
+	const struct inotify_event *e;
+	double due;
+	ssize_t len;
+	uint32_t i;
+	char *p;
+
+	due = sched_Now() + ASSET_DEBOUNCE_MS / 1000.0;
+	while ((len = read(assets.inotify, ev.buf, sizeof(ev.buf))) > 0) {
+		SDL_LockMutex(assets.lock);
+		for (p = ev.buf; p < ev.buf + len;
+		     p += sizeof(struct inotify_event) + e->len) {
+			e = (const struct inotify_event *)p;
+			for (i = 0; i < assets.len && e->len > 0; ++i) {
+				Asset *a = &assets.assets[i];
+
+				if (a->wd == e->wd &&
+				    strcmp(a->name, e->name) == 0) {
+					a->due = due;
+				}
+			}
+		}
+		SDL_UnlockMutex(assets.lock);
+	}
+}
+
+/* reloadDue re-imports the assets whose changes are due, then wakes the
+ * main thread to apply them */
+static void reloadDue() {
+	char path[ASSET_MAX_PATH];
+	TexCompImage img;
+	MeshData mesh;
+	SDL_Event evt;
+	uint32_t i, kind;
+	Asset *a;
+	bool ok;
+
+	for (;;) {
+		double now = sched_Now();
+
+		SDL_LockMutex(assets.lock);
+		for (i = 0; i < assets.len; ++i) {
+			a = &assets.assets[i];
+			if (a->due != 0.0 && a->due <= now && !a->ready) {
+				break;
+			}
+		}
+		if (i == assets.len) {
+			SDL_UnlockMutex(assets.lock);
+			return;
+		}
+		a->due = 0.0;
+		memcpy(path, a->path, sizeof(path));
+		kind = a->kind;
+		SDL_UnlockMutex(assets.lock);
+
+		if (kind == ASSET_IMAGE) {
+			ok = importImage(path, &img);
+		} else {
+			ok = mesh_Import(path, &mesh);
+		}
+		if (!ok) {
+			/* keep the old version until the file changes again */
+			continue;
+		}
+
+		SDL_LockMutex(assets.lock);
+		if (kind == ASSET_IMAGE) {
+			a->newImage = img;
+		} else {
+			a->newMesh = mesh;
+		}
+		a->ready = true;
+		SDL_AtomicAdd(&assets.numReady, 1);
+		SDL_UnlockMutex(assets.lock);
+
+		memset(&evt, 0, sizeof(evt));
+		evt.type = assets.event;
+		SDL_PushEvent(&evt);
+	}
+}
+
+/* assetThread waits for changes to the watched files and reloads them
+ * once they settle */
+static int assetThread(void *data) {
+	struct pollfd fds[2];
+	char drain[64];
+	int timeout;
+	bool quit;
+
+	(void)data;
+	fds[0].fd = assets.inotify;
+	fds[0].events = POLLIN;
+	fds[1].fd = assets.wake[0];
+	fds[1].events = POLLIN;
+	for (;;) {
+		SDL_LockMutex(assets.lock);
+		quit = assets.quit;
+		timeout = nextDue(sched_Now());
+		SDL_UnlockMutex(assets.lock);
+		if (quit) {
+			return 0;
+		}
+		if (poll(fds, 2, timeout) < 0 && errno != EINTR) {
+			puts("error: failed to wait for asset changes");
+			return 1;
+		}
+		if (fds[0].revents & POLLIN) {
+			readEvents();
+		}
+		if (fds[1].revents & POLLIN) {
+			while (read(assets.wake[0], drain, sizeof(drain)) >
+			       0) {
+			}
+		}
+		reloadDue();
+	}
+}
+
+/* stopWatching closes the descriptors used to watch files */
+static void stopWatching() {
+	if (assets.inotify >= 0) {
+		close(assets.inotify);
+	}
+	if (assets.wake[0] >= 0) {
+		close(assets.wake[0]);
+		close(assets.wake[1]);
+	}
+	assets.inotify = assets.wake[0] = assets.wake[1] = -1;
+}
+#endif
+
+/* init_Assets prepares to load assets and starts watching them. Assets can
+ * still be loaded (but not reloaded) if files cannot be watched. */
+bool init_Assets() {
+	memset(&assets, 0, sizeof(assets));
+	assets.inotify = assets.wake[0] = assets.wake[1] = -1;
+	if ((assets.event = SDL_RegisterEvents(1)) == (uint32_t)-1) {
+		assets.event = SDL_USEREVENT;
+	}
+	if ((assets.lock = SDL_CreateMutex()) == NULL) {
+		puts("error: failed to create the asset lock");
+		return false;
+	}
+#ifdef HAVE_INOTIFY
+	assets.inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (assets.inotify < 0 || pipe(assets.wake) != 0) {
+		puts("error: failed to watch assets; they will not reload");
+		stopWatching();
+		return true;
+	}
+	fcntl(assets.wake[0], F_SETFL, O_NONBLOCK);
+	assets.thread = SDL_CreateThread(assetThread, "assets", NULL);
+	if (assets.thread == NULL) {
+		puts("error: failed to start the asset thread");
+		stopWatching();
+	}
+#endif
+	return true;
+}
+
+/* deinit_Assets stops watching assets and frees them */
+void deinit_Assets() {
+	uint32_t i;
+	Asset *a;
+
+#ifdef HAVE_INOTIFY
+	if (assets.thread != NULL) {
+		SDL_LockMutex(assets.lock);
+		assets.quit = true;
+		SDL_UnlockMutex(assets.lock);
+		if (write(assets.wake[1], "q", 1) == 1) {
+			SDL_WaitThread(assets.thread, NULL);
+		}
+	}
+	stopWatching();
+#endif
+	for (i = 0; i < assets.len; ++i) {
+		a = &assets.assets[i];
+		if (a->tex != 0) {
+			glstate_DeleteTexture(a->tex);
+		}
+		mesh_FreeData(&a->mesh);
+		if (a->ready) {
+			texcomp_FreeImage(&a->newImage);
+			mesh_FreeData(&a->newMesh);
+		}
+	}
+	if (assets.lock != NULL) {
+		SDL_DestroyMutex(assets.lock);
+	}
+	memset(&assets, 0, sizeof(assets));
+}
+
+/* asset_Open returns the id of the asset of kind at path, adding (and
+ * watching) it if it is new. Returns 0 if it cannot be added. */
+uint32_t asset_Open(const char *path, uint32_t kind) {
+	const char *slash;
+	uint32_t i;
+	Asset *a;
+
+	for (i = 0; i < assets.len; ++i) {
+		a = &assets.assets[i];
+		if (a->kind == kind && strcmp(a->path, path) == 0) {
+			return i + 1;
+		}
+	}
+	if (assets.len == ASSET_MAX || strlen(path) >= ASSET_MAX_PATH) {
+		printf("error: cannot track asset %s\n", path);
+		return 0;
+	}
+
+	a = &assets.assets[assets.len];
+	memset(a, 0, sizeof(Asset));
+	strcpy(a->path, path);
+	a->kind = kind;
+	a->gen = 1;
+	a->wd = -1;
+	a->mesh.node = a->newMesh.node = XFORM_NONE;
+	slash = strrchr(a->path, '/');
+	a->name = slash != NULL ? slash + 1 : a->path;
+#ifdef HAVE_INOTIFY
+	if (assets.thread != NULL) {
+		char dir[ASSET_MAX_PATH];
+
+		/* watch the directory: exporters often replace files rather
+		 * than writing them in place */
+		if (slash == NULL) {
+			strcpy(dir, ".");
+		} else if (slash == a->path) {
+			strcpy(dir, "/");
+		} else {
+			memcpy(dir, a->path, slash - a->path);
+			dir[slash - a->path] = '\0';
+		}
+		a->wd = inotify_add_watch(assets.inotify, dir,
+					  IN_CLOSE_WRITE | IN_MOVED_TO);
+	}
+#endif
+
+	/* publish the asset to the asset thread */
+	SDL_LockMutex(assets.lock);
+	assets.len++;
+	SDL_UnlockMutex(assets.lock);
+	return assets.len;
+}
+
+/* get returns the asset id if it is of kind */
+static Asset *get(uint32_t id, uint32_t kind) {
+	if (id == 0 || id > assets.len || assets.assets[id - 1].kind != kind) {
+		return NULL;
+	}
+	return &assets.assets[id - 1];
+}
+
+/* asset_Texture returns the texture of image asset id, loading it on first
+ * use (0 if it failed to load). The texture stays the same across reloads. */
+GLuint asset_Texture(uint32_t id) {
+	TexCompImage img;
+	Asset *a;
+
+	if ((a = get(id, ASSET_IMAGE)) == NULL) {
+		return 0;
+	}
+	if (!a->loaded) {
+		a->loaded = true;
+		if (importImage(a->path, &img)) {
+			a->tex = texcomp_Apply(0, &img);
+			texcomp_FreeImage(&img);
+		}
+	}
+	return a->tex;
+}
+
+/* asset_Mesh returns the data of mesh asset id, importing it on first use
+ * (NULL if it failed to import) */
+const MeshData *asset_Mesh(uint32_t id) {
+	Asset *a;
+
+	if ((a = get(id, ASSET_MESH)) == NULL) {
+		return NULL;
+	}
+	if (!a->loaded) {
+		a->loaded = true;
+		a->haveMesh = mesh_Import(a->path, &a->mesh);
+	}
+	return a->haveMesh ? &a->mesh : NULL;
+}
+
+/* asset_Prefetch starts importing asset id on the asset thread, so that its
+ * first use does not wait for it. Until asset_Poll() applies it, the asset
+ * has no texture or mesh. Without the thread, it loads on first use. */
+void asset_Prefetch(uint32_t id) {
+	Asset *a;
+
+	if (id == 0 || id > assets.len || assets.thread == NULL) {
+		return;
+	}
+	a = &assets.assets[id - 1];
+	if (a->loaded) {
+		return;
+	}
+	a->loaded = true;
+	SDL_LockMutex(assets.lock);
+	a->due = sched_Now();
+	SDL_UnlockMutex(assets.lock);
+#ifdef HAVE_INOTIFY
+	if (write(assets.wake[1], "p", 1) != 1) {
+		puts("error: failed to wake the asset thread");
+	}
+#endif
+}
+
+/* asset_Resident returns true if image asset id holds a texture */
+bool asset_Resident(uint32_t id) {
+	Asset *a = get(id, ASSET_IMAGE);
+
+	return a != NULL && a->tex != 0;
+}
+
+/* asset_Evict deletes the texture of image asset id. The next
+ * asset_Texture() loads it again, from the texture cache, under a new name.
+ * A pending reload still applies. */
+void asset_Evict(uint32_t id) {
+	Asset *a;
+
+	if ((a = get(id, ASSET_IMAGE)) == NULL || a->tex == 0) {
+		return;
+	}
+	glstate_DeleteTexture(a->tex);
+	a->tex = 0;
+	a->loaded = false;
+}
+
+/* asset_Path returns the path of asset id (NULL if there is none). It stays
+ * valid until deinit_Assets(). */
+const char *asset_Path(uint32_t id) {
+	return id != 0 && id <= assets.len ? assets.assets[id - 1].path : NULL;
+}
+
+/* asset_Generation returns the number of times asset id was loaded (0 if
+ * there is no such asset) */
+uint32_t asset_Generation(uint32_t id) {
+	return id != 0 && id <= assets.len ? assets.assets[id - 1].gen : 0;
+}
+
+/* asset_Ready returns true if reloads are waiting for asset_Poll() */
+bool asset_Ready() { return SDL_AtomicGet(&assets.numReady) > 0; }
+
+/* asset_Poll swaps the reloaded assets into place, writing the ids of (at
+ * most max of) them to changed. Returns their number. */
+uint32_t asset_Poll(uint32_t *changed, uint32_t max) {
+	uint32_t i, n;
+	Asset *a;
+
+	if (!asset_Ready()) {
+		return 0;
+	}
+	SDL_LockMutex(assets.lock);
+	for (i = n = 0; i < assets.len && n < max; ++i) {
+		a = &assets.assets[i];
+		if (!a->ready) {
+			continue;
+		}
+		if (a->kind == ASSET_IMAGE) {
+			a->tex = texcomp_Apply(a->tex, &a->newImage);
+			texcomp_FreeImage(&a->newImage);
+		} else {
+			mesh_FreeData(&a->mesh);
+			a->mesh = a->newMesh;
+			a->haveMesh = true;
+		}
+		a->loaded = true;
+		a->ready = false;
+		a->gen++;
+		SDL_AtomicAdd(&assets.numReady, -1);
+		changed[n++] = i + 1;
+	}
+	SDL_UnlockMutex(assets.lock);
+	return n;
+}
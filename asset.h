@@ -0,0 +1,42 @@
+/*
+ * asset.h
+ * Assets are the image and mesh files that runes show. Each file is loaded
+ * once, on first use, and shared by every rune showing it.
+ * Loaded files are watched (with inotify, on Linux) and reloaded when they
+ * change on disk. Changes are debounced for ASSET_DEBOUNCE_MS, since
+ * exporters write files in several steps. The file is then re-imported on
+ * the asset thread. asset_Poll() swaps the result into the asset's GPU
+ * resources in place and bumps the asset's generation, so that the runes
+ * showing it can tell that they are out of date.
+ * An image's texture may be evicted to stay within the GPU budget of images
+ * (see mem.h); it is loaded again on its next use.
+ */
+#ifndef ASSET_H
+#define ASSET_H
+
+#include <GL/glew.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "mesh.h"
+
+enum { ASSET_MAX = 256, ASSET_MAX_PATH = 256, ASSET_DEBOUNCE_MS = 150 };
+
+/* The kinds of assets */
+enum { ASSET_IMAGE = 1, ASSET_MESH = 2 };
+
+bool init_Assets();
+void deinit_Assets();
+
+uint32_t asset_Open(const char *, uint32_t);
+GLuint asset_Texture(uint32_t);
+const MeshData *asset_Mesh(uint32_t);
+uint32_t asset_Generation(uint32_t);
+void asset_Prefetch(uint32_t);
+const char *asset_Path(uint32_t);
+bool asset_Resident(uint32_t);
+void asset_Evict(uint32_t);
+
+bool asset_Ready();
+uint32_t asset_Poll(uint32_t *, uint32_t);
+
+#endif
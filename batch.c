@@ -0,0 +1,570 @@
+#include "batch.h"
+#include <float.h>
+#include <math.h>
+
+/* the SIMD kernels are built with target attributes so that the rest of the
+ * program doesn't need to be compiled for AVX */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BATCH_X86 1
+#include <immintrin.h>
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX __attribute__((target("avx")))
+#endif
+
+/* Kernels is one implementation of every batch function */
+typedef struct {
+	void (*transformPoints)(const Mat4x4 *, const Vector3 *, Vector3 *,
+				size_t);
+	void (*transformVec4)(const Mat4x4 *, const Vector4 *, Vector4 *,
+			      size_t);
+	void (*lerp)(const float *, const float *, const float *, float *,
+		     size_t);
+	void (*normalize3)(float *, float *, float *, size_t);
+	void (*dot3)(const float *, const float *, const float *,
+		     const float *, const float *, const float *, float *,
+		     size_t);
+	void (*bounds)(const float *, size_t, float *, float *);
+} Kernels;
+
+/******************************************************************************
+ * scalar kernels (also used for the remainder of the SIMD ones)
+******************************************************************************/
+static void scalarTransformPoints(const Mat4x4 *m, const Vector3 *in,
+				  Vector3 *out, size_t n) {
+	float x, y, z;
+	size_t i;
+
+	for (i = 0; i < n; ++i) {
+		x = in[i].x;
+		y = in[i].y;
+		z = in[i].z;
+		out[i].x = m->a0 * x + m->a1 * y + m->a2 * z + m->a3;
+		out[i].y = m->b0 * x + m->b1 * y + m->b2 * z + m->b3;
+		out[i].z = m->c0 * x + m->c1 * y + m->c2 * z + m->c3;
+	}
+}
+
+static void scalarTransformVec4(const Mat4x4 *m, const Vector4 *in,
+				Vector4 *out, size_t n) {
+	Vector4 v;
+	size_t i;
+
+	for (i = 0; i < n; ++i) {
+		v = in[i];
+		mat4x4_multiply_vec4_to(&out[i], m, &v);
+	}
+}
+
+static void scalarLerp(const float *a, const float *b, const float *t,
+		       float *out, size_t n) {
+	size_t i;
+
+	for (i = 0; i < n; ++i) {
+		out[i] = a[i] + (b[i] - a[i]) * t[i];
+	}
+}
+
+static void scalarNormalize3(float *x, float *y, float *z, size_t n) {
+	float len;
+	size_t i;
+
+	for (i = 0; i < n; ++i) {
+		len = x[i] * x[i] + y[i] * y[i] + z[i] * z[i];
+		if (len > 0.0f) {
+			len = 1.0f / sqrtf(len);
+			x[i] *= len;
+			y[i] *= len;
+			z[i] *= len;
+		}
+	}
+}
+
+static void scalarDot3(const float *ax, const float *ay, const float *az,
+		       const float *bx, const float *by, const float *bz,
+		       float *out, size_t n) {
+	size_t i;
+
+	for (i = 0; i < n; ++i) {
+		out[i] = ax[i] * bx[i] + ay[i] * by[i] + az[i] * bz[i];
+	}
+}
+
+/* scalarBounds widens min and max (xyz) by the n points at p */
+static void scalarBounds(const float *p, size_t n, float *min, float *max) {
+	size_t i;
+	int c;
+
+	for (i = 0; i < n * 3; i += 3) {
+		for (c = 0; c < 3; ++c) {
+			min[c] = p[i + c] < min[c] ? p[i + c] : min[c];
+			max[c] = p[i + c] > max[c] ? p[i + c] : max[c];
+		}
+	}
+}
+
+/* reduceBounds folds accumulated bounds into min and max. Position k of the
+ * accumulators holds component k % 3. */
+static void reduceBounds(const float *lo, const float *hi, int len,
+			 float *min, float *max) {
+	int k;
+
+	for (k = 0; k < len; ++k) {
+		min[k % 3] = lo[k] < min[k % 3] ? lo[k] : min[k % 3];
+		max[k % 3] = hi[k] > max[k % 3] ? hi[k] : max[k % 3];
+	}
+}
+
+static const Kernels scalarKernels = {
+    scalarTransformPoints, scalarTransformVec4, scalarLerp,
+    scalarNormalize3,      scalarDot3,		scalarBounds};
+
+#ifdef BATCH_X86
+/******************************************************************************
+ * SSE2 kernels
+******************************************************************************/
+/* Points are transformed 4 at a time: the 12 floats of 4 packed points are
+ * shuffled into x, y and z vectors and back. */
+TARGET_SSE2 static void sse2TransformPoints(const Mat4x4 *m,
+					    const Vector3 *in, Vector3 *out,
+					    size_t n) {
+	__m128 m03, m14, m25, xy, yz, x, y, z, rx, ry, rz;
+	const float *p;
+	float *q;
+	size_t i;
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		p = &in[i].x;
+		m03 = _mm_loadu_ps(p);
+		m14 = _mm_loadu_ps(p + 4);
+		m25 = _mm_loadu_ps(p + 8);
+		xy = _mm_shuffle_ps(m14, m25, _MM_SHUFFLE(2, 1, 3, 2));
+		yz = _mm_shuffle_ps(m03, m14, _MM_SHUFFLE(1, 0, 2, 1));
+		x = _mm_shuffle_ps(m03, xy, _MM_SHUFFLE(2, 0, 3, 0));
+		y = _mm_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0));
+		z = _mm_shuffle_ps(yz, m25, _MM_SHUFFLE(3, 0, 3, 1));
+
+		rx = _mm_add_ps(
+		    _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(m->a0)),
+			       _mm_mul_ps(y, _mm_set1_ps(m->a1))),
+		    _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(m->a2)),
+			       _mm_set1_ps(m->a3)));
+		ry = _mm_add_ps(
+		    _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(m->b0)),
+			       _mm_mul_ps(y, _mm_set1_ps(m->b1))),
+		    _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(m->b2)),
+			       _mm_set1_ps(m->b3)));
+		rz = _mm_add_ps(
+		    _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(m->c0)),
+			       _mm_mul_ps(y, _mm_set1_ps(m->c1))),
+		    _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(m->c2)),
+			       _mm_set1_ps(m->c3)));
+
+		xy = _mm_shuffle_ps(rx, ry, _MM_SHUFFLE(2, 0, 2, 0));
+		yz = _mm_shuffle_ps(ry, rz, _MM_SHUFFLE(3, 1, 3, 1));
+		x = _mm_shuffle_ps(rz, rx, _MM_SHUFFLE(3, 1, 2, 0));
+		q = &out[i].x;
+		_mm_storeu_ps(q, _mm_shuffle_ps(xy, x, _MM_SHUFFLE(2, 0, 2, 0)));
+		_mm_storeu_ps(q + 4,
+			      _mm_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0)));
+		_mm_storeu_ps(q + 8,
+			      _mm_shuffle_ps(x, yz, _MM_SHUFFLE(3, 1, 3, 1)));
+	}
+	scalarTransformPoints(m, in + i, out + i, n - i);
+}
+
+TARGET_SSE2 static void sse2TransformVec4(const Mat4x4 *m,
+					  const Vector4 *in, Vector4 *out,
+					  size_t n) {
+	const float *f = (const float *)m;
+	__m128 c0, c1, c2, c3, v, r;
+	size_t i;
+
+	c0 = _mm_loadu_ps(&f[0]);
+	c1 = _mm_loadu_ps(&f[4]);
+	c2 = _mm_loadu_ps(&f[8]);
+	c3 = _mm_loadu_ps(&f[12]);
+	for (i = 0; i < n; ++i) {
+		v = _mm_loadu_ps(&in[i].x);
+		r = _mm_mul_ps(c0, _mm_shuffle_ps(v, v, 0x00));
+		r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_shuffle_ps(v, v, 0x55)));
+		r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_shuffle_ps(v, v, 0xaa)));
+		r = _mm_add_ps(r, _mm_mul_ps(c3, _mm_shuffle_ps(v, v, 0xff)));
+		_mm_storeu_ps(&out[i].x, r);
+	}
+}
+
+TARGET_SSE2 static void sse2Lerp(const float *a, const float *b,
+				 const float *t, float *out, size_t n) {
+	__m128 va;
+	size_t i;
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		va = _mm_loadu_ps(&a[i]);
+		_mm_storeu_ps(
+		    &out[i],
+		    _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&b[i]), va),
+					      _mm_loadu_ps(&t[i]))));
+	}
+	scalarLerp(a + i, b + i, t + i, out + i, n - i);
+}
+
+TARGET_SSE2 static void sse2Normalize3(float *x, float *y, float *z,
+				       size_t n) {
+	__m128 vx, vy, vz, len, inv, mask;
+	size_t i;
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		vx = _mm_loadu_ps(&x[i]);
+		vy = _mm_loadu_ps(&y[i]);
+		vz = _mm_loadu_ps(&z[i]);
+		len = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)),
+				 _mm_mul_ps(vz, vz));
+		mask = _mm_cmpgt_ps(len, _mm_setzero_ps());
+		inv = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(len));
+		inv = _mm_or_ps(_mm_and_ps(mask, inv),
+				_mm_andnot_ps(mask, _mm_set1_ps(1.0f)));
+		_mm_storeu_ps(&x[i], _mm_mul_ps(vx, inv));
+		_mm_storeu_ps(&y[i], _mm_mul_ps(vy, inv));
+		_mm_storeu_ps(&z[i], _mm_mul_ps(vz, inv));
+	}
+	scalarNormalize3(x + i, y + i, z + i, n - i);
+}
+
+TARGET_SSE2 static void sse2Dot3(const float *ax, const float *ay,
+				 const float *az, const float *bx,
+				 const float *by, const float *bz, float *out,
+				 size_t n) {
+	__m128 r;
+	size_t i;
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		r = _mm_mul_ps(_mm_loadu_ps(&ax[i]), _mm_loadu_ps(&bx[i]));
+		r = _mm_add_ps(
+		    r, _mm_mul_ps(_mm_loadu_ps(&ay[i]), _mm_loadu_ps(&by[i])));
+		r = _mm_add_ps(
+		    r, _mm_mul_ps(_mm_loadu_ps(&az[i]), _mm_loadu_ps(&bz[i])));
+		_mm_storeu_ps(&out[i], r);
+	}
+	scalarDot3(ax + i, ay + i, az + i, bx + i, by + i, bz + i, out + i,
+		   n - i);
+}
+
+/* The points are read as a flat stream of floats, 12 (4 points) at a time,
+ * so that every accumulator position always holds the same component. */
+TARGET_SSE2 static void sse2Bounds(const float *p, size_t n, float *min,
+				   float *max) {
+	__m128 lo[3], hi[3], v;
+	float l[12], h[12];
+	size_t i;
+	int k;
+
+	if (n < 4) {
+		scalarBounds(p, n, min, max);
+		return;
+	}
+	for (k = 0; k < 3; ++k) {
+		lo[k] = hi[k] = _mm_loadu_ps(&p[k * 4]);
+	}
+	for (i = 4; i + 4 <= n; i += 4) {
+		for (k = 0; k < 3; ++k) {
+			v = _mm_loadu_ps(&p[i * 3 + k * 4]);
+			lo[k] = _mm_min_ps(lo[k], v);
+			hi[k] = _mm_max_ps(hi[k], v);
+		}
+	}
+	for (k = 0; k < 3; ++k) {
+		_mm_storeu_ps(&l[k * 4], lo[k]);
+		_mm_storeu_ps(&h[k * 4], hi[k]);
+	}
+	reduceBounds(l, h, 12, min, max);
+	scalarBounds(p + i * 3, n - i, min, max);
+}
+
+static const Kernels sse2Kernels = {sse2TransformPoints, sse2TransformVec4,
+				    sse2Lerp,		 sse2Normalize3,
+				    sse2Dot3,		 sse2Bounds};
+
+/******************************************************************************
+ * AVX kernels
+******************************************************************************/
+/* As sse2TransformPoints, 8 points at a time (4 in each 128-bit lane) */
+TARGET_AVX static void avxTransformPoints(const Mat4x4 *m, const Vector3 *in,
+					  Vector3 *out, size_t n) {
+	__m256 m03, m14, m25, xy, yz, x, y, z, rx, ry, rz;
+	const float *p;
+	float *q;
+	size_t i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		p = &in[i].x;
+		m03 = _mm256_insertf128_ps(
+		    _mm256_castps128_ps256(_mm_loadu_ps(p)), _mm_loadu_ps(p + 12),
+		    1);
+		m14 = _mm256_insertf128_ps(
+		    _mm256_castps128_ps256(_mm_loadu_ps(p + 4)),
+		    _mm_loadu_ps(p + 16), 1);
+		m25 = _mm256_insertf128_ps(
+		    _mm256_castps128_ps256(_mm_loadu_ps(p + 8)),
+		    _mm_loadu_ps(p + 20), 1);
+		xy = _mm256_shuffle_ps(m14, m25, _MM_SHUFFLE(2, 1, 3, 2));
+		yz = _mm256_shuffle_ps(m03, m14, _MM_SHUFFLE(1, 0, 2, 1));
+		x = _mm256_shuffle_ps(m03, xy, _MM_SHUFFLE(2, 0, 3, 0));
+		y = _mm256_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0));
+		z = _mm256_shuffle_ps(yz, m25, _MM_SHUFFLE(3, 0, 3, 1));
+
+		rx = _mm256_add_ps(
+		    _mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(m->a0)),
+				  _mm256_mul_ps(y, _mm256_set1_ps(m->a1))),
+		    _mm256_add_ps(_mm256_mul_ps(z, _mm256_set1_ps(m->a2)),
+				  _mm256_set1_ps(m->a3)));
+		ry = _mm256_add_ps(
+		    _mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(m->b0)),
+				  _mm256_mul_ps(y, _mm256_set1_ps(m->b1))),
+		    _mm256_add_ps(_mm256_mul_ps(z, _mm256_set1_ps(m->b2)),
+				  _mm256_set1_ps(m->b3)));
+		rz = _mm256_add_ps(
+		    _mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(m->c0)),
+				  _mm256_mul_ps(y, _mm256_set1_ps(m->c1))),
+		    _mm256_add_ps(_mm256_mul_ps(z, _mm256_set1_ps(m->c2)),
+				  _mm256_set1_ps(m->c3)));
+
+		xy = _mm256_shuffle_ps(rx, ry, _MM_SHUFFLE(2, 0, 2, 0));
+		yz = _mm256_shuffle_ps(ry, rz, _MM_SHUFFLE(3, 1, 3, 1));
+		x = _mm256_shuffle_ps(rz, rx, _MM_SHUFFLE(3, 1, 2, 0));
+		m03 = _mm256_shuffle_ps(xy, x, _MM_SHUFFLE(2, 0, 2, 0));
+		m14 = _mm256_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0));
+		m25 = _mm256_shuffle_ps(x, yz, _MM_SHUFFLE(3, 1, 3, 1));
+		q = &out[i].x;
+		_mm_storeu_ps(q, _mm256_castps256_ps128(m03));
+		_mm_storeu_ps(q + 4, _mm256_castps256_ps128(m14));
+		_mm_storeu_ps(q + 8, _mm256_castps256_ps128(m25));
+		_mm_storeu_ps(q + 12, _mm256_extractf128_ps(m03, 1));
+		_mm_storeu_ps(q + 16, _mm256_extractf128_ps(m14, 1));
+		_mm_storeu_ps(q + 20, _mm256_extractf128_ps(m25, 1));
+	}
+	sse2TransformPoints(m, in + i, out + i, n - i);
+}
+
+/* Vectors are transformed 2 at a time, one in each 128-bit lane */
+TARGET_AVX static void avxTransformVec4(const Mat4x4 *m, const Vector4 *in,
+					Vector4 *out, size_t n) {
+	const float *f = (const float *)m;
+	__m256 c0, c1, c2, c3, v, r;
+	size_t i;
+
+	c0 = _mm256_broadcast_ps((const __m128 *)&f[0]);
+	c1 = _mm256_broadcast_ps((const __m128 *)&f[4]);
+	c2 = _mm256_broadcast_ps((const __m128 *)&f[8]);
+	c3 = _mm256_broadcast_ps((const __m128 *)&f[12]);
+	for (i = 0; i + 2 <= n; i += 2) {
+		v = _mm256_loadu_ps(&in[i].x);
+		r = _mm256_mul_ps(c0, _mm256_permute_ps(v, 0x00));
+		r = _mm256_add_ps(r, _mm256_mul_ps(c1, _mm256_permute_ps(v, 0x55)));
+		r = _mm256_add_ps(r, _mm256_mul_ps(c2, _mm256_permute_ps(v, 0xaa)));
+		r = _mm256_add_ps(r, _mm256_mul_ps(c3, _mm256_permute_ps(v, 0xff)));
+		_mm256_storeu_ps(&out[i].x, r);
+	}
+	sse2TransformVec4(m, in + i, out + i, n - i);
+}
+
+TARGET_AVX static void avxLerp(const float *a, const float *b, const float *t,
+			       float *out, size_t n) {
+	__m256 va;
+	size_t i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		va = _mm256_loadu_ps(&a[i]);
+		_mm256_storeu_ps(
+		    &out[i],
+		    _mm256_add_ps(va, _mm256_mul_ps(
+					  _mm256_sub_ps(_mm256_loadu_ps(&b[i]), va),
+					  _mm256_loadu_ps(&t[i]))));
+	}
+	scalarLerp(a + i, b + i, t + i, out + i, n - i);
+}
+
+TARGET_AVX static void avxNormalize3(float *x, float *y, float *z, size_t n) {
+	__m256 vx, vy, vz, len, inv, mask;
+	size_t i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		vx = _mm256_loadu_ps(&x[i]);
+		vy = _mm256_loadu_ps(&y[i]);
+		vz = _mm256_loadu_ps(&z[i]);
+		len = _mm256_add_ps(
+		    _mm256_add_ps(_mm256_mul_ps(vx, vx), _mm256_mul_ps(vy, vy)),
+		    _mm256_mul_ps(vz, vz));
+		mask = _mm256_cmp_ps(len, _mm256_setzero_ps(), _CMP_GT_OQ);
+		inv = _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(len));
+		inv = _mm256_blendv_ps(_mm256_set1_ps(1.0f), inv, mask);
+		_mm256_storeu_ps(&x[i], _mm256_mul_ps(vx, inv));
+		_mm256_storeu_ps(&y[i], _mm256_mul_ps(vy, inv));
+		_mm256_storeu_ps(&z[i], _mm256_mul_ps(vz, inv));
+	}
+	scalarNormalize3(x + i, y + i, z + i, n - i);
+}
+
+TARGET_AVX static void avxDot3(const float *ax, const float *ay,
+			       const float *az, const float *bx,
+			       const float *by, const float *bz, float *out,
+			       size_t n) {
+	__m256 r;
+	size_t i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		r = _mm256_mul_ps(_mm256_loadu_ps(&ax[i]), _mm256_loadu_ps(&bx[i]));
+		r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_loadu_ps(&ay[i]),
+						   _mm256_loadu_ps(&by[i])));
+		r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_loadu_ps(&az[i]),
+						   _mm256_loadu_ps(&bz[i])));
+		_mm256_storeu_ps(&out[i], r);
+	}
+	scalarDot3(ax + i, ay + i, az + i, bx + i, by + i, bz + i, out + i,
+		   n - i);
+}
+
+/* As sse2Bounds, 24 floats (8 points) at a time */
+TARGET_AVX static void avxBounds(const float *p, size_t n, float *min,
+				 float *max) {
+	__m256 lo[3], hi[3], v;
+	float l[24], h[24];
+	size_t i;
+	int k;
+
+	if (n < 8) {
+		sse2Bounds(p, n, min, max);
+		return;
+	}
+	for (k = 0; k < 3; ++k) {
+		lo[k] = hi[k] = _mm256_loadu_ps(&p[k * 8]);
+	}
+	for (i = 8; i + 8 <= n; i += 8) {
+		for (k = 0; k < 3; ++k) {
+			v = _mm256_loadu_ps(&p[i * 3 + k * 8]);
+			lo[k] = _mm256_min_ps(lo[k], v);
+			hi[k] = _mm256_max_ps(hi[k], v);
+		}
+	}
+	for (k = 0; k < 3; ++k) {
+		_mm256_storeu_ps(&l[k * 8], lo[k]);
+		_mm256_storeu_ps(&h[k * 8], hi[k]);
+	}
+	reduceBounds(l, h, 24, min, max);
+	scalarBounds(p + i * 3, n - i, min, max);
+}
+
+static const Kernels avxKernels = {avxTransformPoints, avxTransformVec4,
+				   avxLerp,		avxNormalize3,
+				   avxDot3,		avxBounds};
+#endif
+
+/******************************************************************************
+ * dispatch
+******************************************************************************/
+static const Kernels *kernels;
+static uint32_t level, maxLevel;
+
+/* detect returns the widest kernels the CPU (and OS) support */
+static uint32_t detect() {
+#ifdef BATCH_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx")) {
+		return BATCH_AVX;
+	}
+	if (__builtin_cpu_supports("sse2")) {
+		return BATCH_SSE2;
+	}
+#endif
+	return BATCH_SCALAR;
+}
+
+/* batch_SetLevel selects the kernels of BATCH_* level l, or the widest
+ * supported below it. Returns the level selected. */
+uint32_t batch_SetLevel(uint32_t l) {
+	if (kernels == NULL) {
+		maxLevel = detect();
+	}
+	level = l < maxLevel ? l : maxLevel;
+	switch (level) {
+#ifdef BATCH_X86
+	case BATCH_AVX:
+		kernels = &avxKernels;
+		break;
+	case BATCH_SSE2:
+		kernels = &sse2Kernels;
+		break;
+#endif
+	default:
+		kernels = &scalarKernels;
+		break;
+	}
+	return level;
+}
+
+/* batch_Level returns the level of the kernels in use */
+uint32_t batch_Level() {
+	if (kernels == NULL) {
+		batch_SetLevel(BATCH_AVX);
+	}
+	return level;
+}
+
+/* batch_TransformPoints stores m * (p, 1) of the n points of in to out (which
+ * may be in) */
+void batch_TransformPoints(const Mat4x4 *m, const Vector3 *in, Vector3 *out,
+			   size_t n) {
+	if (kernels == NULL) {
+		batch_SetLevel(BATCH_AVX);
+	}
+	kernels->transformPoints(m, in, out, n);
+}
+
+/* batch_TransformVec4 stores m * v of the n vectors of in to out (which may
+ * be in) */
+void batch_TransformVec4(const Mat4x4 *m, const Vector4 *in, Vector4 *out,
+			 size_t n) {
+	if (kernels == NULL) {
+		batch_SetLevel(BATCH_AVX);
+	}
+	kernels->transformVec4(m, in, out, n);
+}
+
+/* batch_Lerp stores a + (b - a) * t of n elements to out */
+void batch_Lerp(const float *a, const float *b, const float *t, float *out,
+		size_t n) {
+	if (kernels == NULL) {
+		batch_SetLevel(BATCH_AVX);
+	}
+	kernels->lerp(a, b, t, out, n);
+}
+
+/* batch_Normalize3 normalizes n vectors in place. Zero vectors are left
+ * unchanged. */
+void batch_Normalize3(float *x, float *y, float *z, size_t n) {
+	if (kernels == NULL) {
+		batch_SetLevel(BATCH_AVX);
+	}
+	kernels->normalize3(x, y, z, n);
+}
+
+/* batch_Dot3 stores the dot products of n pairs of vectors to out */
+void batch_Dot3(const float *ax, const float *ay, const float *az,
+		const float *bx, const float *by, const float *bz, float *out,
+		size_t n) {
+	if (kernels == NULL) {
+		batch_SetLevel(BATCH_AVX);
+	}
+	kernels->dot3(ax, ay, az, bx, by, bz, out, n);
+}
+
+/* batch_Bounds returns the bounds of n points (empty, with min > max, if n
+ * is 0) */
+Aabb batch_Bounds(const Vector3 *p, size_t n) {
+	Aabb box = {{FLT_MAX, FLT_MAX, FLT_MAX}, {-FLT_MAX, -FLT_MAX, -FLT_MAX}};
+
+	if (kernels == NULL) {
+		batch_SetLevel(BATCH_AVX);
+	}
+	kernels->bounds(&p->x, n, &box.min.x, &box.max.x);
+	return box;
+}
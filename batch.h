@@ -0,0 +1,37 @@
+/*
+ * batch.h
+ * batch transforms arrays of vectors at once: points by a matrix, lerps,
+ * normalizes and dot products over structure-of-arrays streams, and the
+ * bounds of a point array. Each kernel has scalar, SSE2 and AVX versions;
+ * the widest one the CPU supports is picked at runtime on first use.
+ */
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "matrix.h"
+#include "vector.h"
+
+/* The instruction sets of the kernels */
+enum { BATCH_SCALAR = 0, BATCH_SSE2 = 1, BATCH_AVX = 2 };
+
+/* Aabb is an axis-aligned bounding box */
+typedef struct {
+	Vector3 min, max;
+} Aabb;
+
+uint32_t batch_Level();
+uint32_t batch_SetLevel(uint32_t);
+
+void batch_TransformPoints(const Mat4x4 *, const Vector3 *, Vector3 *,
+			   size_t);
+void batch_TransformVec4(const Mat4x4 *, const Vector4 *, Vector4 *, size_t);
+void batch_Lerp(const float *, const float *, const float *, float *,
+		size_t);
+void batch_Normalize3(float *, float *, float *, size_t);
+void batch_Dot3(const float *, const float *, const float *, const float *,
+		const float *, const float *, float *, size_t);
+Aabb batch_Bounds(const Vector3 *, size_t);
+
+#endif
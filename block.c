@@ -0,0 +1,288 @@
+#include "block.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "alloc.h"
+#include "rune.h"
+
+enum { NO_BLOCK = 0xffffffff };
+
+/* grow reallocs *p to hold at least n elements of size sz (doubling) */
+static bool grow(void **p, uint32_t *cap, uint32_t n, size_t sz) {
+	uint32_t newCap;
+	void *mem;
+
+	if (n <= *cap) {
+		return true;
+	}
+	for (newCap = *cap ? *cap : 16; newCap < n; newCap *= 2)
+		;
+	if ((mem = alloc_Realloc(*p, newCap * sz)) == NULL) {
+		puts("error: failed to grow block index");
+		return false;
+	}
+	*p = mem;
+	*cap = newCap;
+	return true;
+}
+
+/* row_insert inserts run at position i of row */
+static void row_insert(BlockRow *row, uint32_t i, BlockRun run) {
+	if (!grow((void **)&row->runs, &row->capRuns, row->numRuns + 1,
+		  sizeof(BlockRun))) {
+		return;
+	}
+	memmove(&row->runs[i + 1], &row->runs[i],
+		(row->numRuns - i) * sizeof(BlockRun));
+	row->runs[i] = run;
+	row->numRuns++;
+}
+
+/* row_remove removes the run at position i of row */
+static void row_remove(BlockRow *row, uint32_t i) {
+	memmove(&row->runs[i], &row->runs[i + 1],
+		(row->numRuns - i - 1) * sizeof(BlockRun));
+	row->numRuns--;
+}
+
+/* init_BlockIndex initializes idx to cover numCols x numRows cells */
+void init_BlockIndex(BlockIndex *idx, uint32_t numCols, uint32_t numRows) {
+	memset(idx, 0, sizeof(BlockIndex));
+	idx->bucketsW = (numCols + BLOCK_BUCKET - 1) / BLOCK_BUCKET;
+	idx->bucketsH = (numRows + BLOCK_BUCKET - 1) / BLOCK_BUCKET;
+	idx->rows = calloc(numRows, sizeof(BlockRow));
+	idx->bucketStart =
+	    calloc(idx->bucketsW * idx->bucketsH + 1, sizeof(uint32_t));
+	if (idx->rows == NULL || idx->bucketStart == NULL) {
+		puts("error: failed to allocate block index");
+		free(idx->rows);
+		free(idx->bucketStart);
+		memset(idx, 0, sizeof(BlockIndex));
+		return;
+	}
+	idx->numRows = numRows;
+	idx->numCols = numCols;
+}
+
+/* deinit_BlockIndex frees the storage owned by idx */
+void deinit_BlockIndex(BlockIndex *idx) {
+	uint32_t i;
+
+	for (i = 0; i < idx->numRows; ++i) {
+		free(idx->rows[i].runs);
+	}
+	free(idx->rows);
+	free(idx->blockOf);
+	free(idx->blocks);
+	free(idx->bucketStart);
+	free(idx->bucketItems);
+	memset(idx, 0, sizeof(BlockIndex));
+}
+
+/* blockindex_Set records that the cell at (x, y) now holds codepoint code.
+ * Only the runs of row y are touched; blocks are rebuilt on the next update */
+void blockindex_Set(BlockIndex *idx, uint32_t x, uint32_t y, uint32_t code) {
+	BlockRow *row;
+	BlockRun *run;
+	bool prev, next;
+	uint32_t i;
+
+	if (y >= idx->numRows) {
+		return;
+	}
+	row = &idx->rows[y];
+
+	/* cut x out of the run that currently contains it (if any) */
+	for (i = 0; i < row->numRuns && row->runs[i].x1 <= x; ++i)
+		;
+	if (i < row->numRuns && row->runs[i].x0 <= x) {
+		run = &row->runs[i];
+		if (run->code == code) {
+			return;
+		}
+		/* leave i at the first run beginning after x */
+		if (run->x0 == x && run->x1 == x + 1) {
+			row_remove(row, i);
+		} else if (run->x0 == x) {
+			run->x0++;
+		} else if (run->x1 == x + 1) {
+			run->x1--;
+			++i;
+		} else {
+			BlockRun tail = {.x0 = x + 1, .x1 = run->x1, .code = run->code};
+			run->x1 = x;
+			row_insert(row, i + 1, tail);
+			++i;
+		}
+		idx->dirty = true;
+	}
+	if (!rune_IsResource(code)) {
+		return;
+	}
+
+	/* i is now the first run beginning after x: merge with its neighbors */
+	prev = i > 0 && row->runs[i - 1].x1 == x && row->runs[i - 1].code == code;
+	next = i < row->numRuns && row->runs[i].x0 == x + 1 &&
+	       row->runs[i].code == code;
+	if (prev && next) {
+		row->runs[i - 1].x1 = row->runs[i].x1;
+		row_remove(row, i);
+	} else if (prev) {
+		row->runs[i - 1].x1++;
+	} else if (next) {
+		row->runs[i].x0--;
+	} else {
+		BlockRun cell = {.x0 = x, .x1 = x + 1, .code = code};
+		row_insert(row, i, cell);
+	}
+	idx->dirty = true;
+}
+
+/* bucketRange writes the range of buckets [*x0, *x1) x [*y0, *y1) that
+ * block b overlaps */
+static void bucketRange(const BlockIndex *idx, const Block *b, uint32_t *x0,
+			uint32_t *y0, uint32_t *x1, uint32_t *y1) {
+	*x0 = b->x / BLOCK_BUCKET;
+	*y0 = b->y / BLOCK_BUCKET;
+	*x1 = (b->x + b->w - 1) / BLOCK_BUCKET + 1;
+	*y1 = (b->y + b->h - 1) / BLOCK_BUCKET + 1;
+	*x1 = *x1 < idx->bucketsW ? *x1 : idx->bucketsW;
+	*y1 = *y1 < idx->bucketsH ? *y1 : idx->bucketsH;
+}
+
+/* bin sorts the blocks into the buckets they overlap (a counting sort) */
+static bool bin(BlockIndex *idx) {
+	uint32_t i, x, y, x0, y0, x1, y1, n, numBuckets, *start;
+
+	numBuckets = idx->bucketsW * idx->bucketsH;
+	start = idx->bucketStart;
+	if (start == NULL) {
+		return false;
+	}
+	memset(start, 0, (numBuckets + 1) * sizeof(uint32_t));
+
+	/* count the blocks of each bucket in start[bucket + 1] */
+	for (i = 0; i < idx->numBlocks; ++i) {
+		bucketRange(idx, &idx->blocks[i], &x0, &y0, &x1, &y1);
+		for (y = y0; y < y1; ++y) {
+			for (x = x0; x < x1; ++x) {
+				start[y * idx->bucketsW + x + 1]++;
+			}
+		}
+	}
+	for (i = 0; i < numBuckets; ++i) {
+		start[i + 1] += start[i];
+	}
+	if (!grow((void **)&idx->bucketItems, &idx->capItems,
+		  start[numBuckets], sizeof(uint32_t))) {
+		memset(start, 0, (numBuckets + 1) * sizeof(uint32_t));
+		return false;
+	}
+
+	/* fill each bucket, using start[bucket] as its cursor */
+	for (i = 0; i < idx->numBlocks; ++i) {
+		bucketRange(idx, &idx->blocks[i], &x0, &y0, &x1, &y1);
+		for (y = y0; y < y1; ++y) {
+			for (x = x0; x < x1; ++x) {
+				n = y * idx->bucketsW + x;
+				idx->bucketItems[start[n]++] = i;
+			}
+		}
+	}
+
+	/* the cursors now hold each bucket's end: shift them back */
+	memmove(&start[1], &start[0], numBuckets * sizeof(uint32_t));
+	start[0] = 0;
+	return true;
+}
+
+/* blockindex_Update rebuilds the blocks of idx from its runs if any have
+ * changed. Each block is a rectangle: a run and the identical runs (same
+ * span and code) directly below it. A set of matching cells that is not a
+ * rectangle is thus split into several blocks, each anchored at a cell of
+ * its own. The rebuild is a single pass over the runs of every row.
+ * Returns true if the blocks were rebuilt. */
+bool blockindex_Update(BlockIndex *idx) {
+	uint32_t y, a, b, n, first, prevFirst, numRuns;
+	BlockRow *above, *row;
+	BlockRun *ra, *rb;
+	Block *blk;
+
+	if (!idx->dirty) {
+		return false;
+	}
+	idx->dirty = false;
+
+	numRuns = 0;
+	for (y = 0; y < idx->numRows; ++y) {
+		numRuns += idx->rows[y].numRuns;
+	}
+	if (!grow((void **)&idx->blockOf, &idx->capBlockOf, numRuns,
+		  sizeof(uint32_t))) {
+		return false;
+	}
+
+	idx->numBlocks = 0;
+	above = NULL;
+	prevFirst = first = 0;
+	for (y = 0; y < idx->numRows; ++y) {
+		row = &idx->rows[y];
+		for (a = b = 0; b < row->numRuns; ++b) {
+			rb = &row->runs[b];
+
+			/* a run identical to the one above it extends its
+			 * block; the runs of both rows are sorted by x0 */
+			while (above != NULL && a < above->numRuns &&
+			       above->runs[a].x0 < rb->x0) {
+				++a;
+			}
+			ra = above != NULL && a < above->numRuns
+				 ? &above->runs[a]
+				 : NULL;
+			if (ra != NULL && ra->x0 == rb->x0 &&
+			    ra->x1 == rb->x1 && ra->code == rb->code) {
+				n = idx->blockOf[prevFirst + a];
+				idx->blockOf[first + b] = n;
+				idx->blocks[n].h++;
+				continue;
+			}
+
+			if (!grow((void **)&idx->blocks, &idx->capBlocks,
+				  idx->numBlocks + 1, sizeof(Block))) {
+				return false;
+			}
+			idx->blockOf[first + b] = idx->numBlocks;
+			blk = &idx->blocks[idx->numBlocks++];
+			blk->x = rb->x0;
+			blk->y = y;
+			blk->w = rb->x1 - rb->x0;
+			blk->h = 1;
+			blk->code = rb->code;
+		}
+		above = row;
+		prevFirst = first;
+		first += row->numRuns;
+	}
+	return bin(idx);
+}
+
+/* blockindex_Find returns the block containing the cell (x, y) or NULL.
+ * Blocks are rectangles of matching cells, so every cell a block covers is
+ * part of it. */
+Block *blockindex_Find(BlockIndex *idx, uint32_t x, uint32_t y) {
+	uint32_t bucket, i;
+
+	if (x >= idx->numCols || y >= idx->numRows) {
+		return NULL;
+	}
+	bucket = (y / BLOCK_BUCKET) * idx->bucketsW + x / BLOCK_BUCKET;
+	for (i = idx->bucketStart[bucket]; i < idx->bucketStart[bucket + 1];
+	     ++i) {
+		Block *b = &idx->blocks[idx->bucketItems[i]];
+		if (x >= b->x && y >= b->y && x < b->x + b->w &&
+		    y < b->y + b->h) {
+			return b;
+		}
+	}
+	return NULL;
+}
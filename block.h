@@ -0,0 +1,68 @@
+/*
+ * block.h
+ * The BlockIndex tracks blocks of adjacent cells that share a resource
+ * codepoint (U+E008..U+F8FF). Each block is a rectangle of such cells and is
+ * rendered once from its anchor (upper-left corner); a group of matching
+ * cells that is not a rectangle is split into several blocks.
+ * blockindex_Set() updates the runs of matching cells in a single row, and
+ * blockindex_Update() rebuilds the blocks from the runs, stacking identical
+ * runs of adjacent rows.
+ * Blocks are also binned into a uniform grid of buckets, so that
+ * blockindex_Find() only tests the few blocks overlapping one bucket.
+ */
+#ifndef BLOCK_H
+#define BLOCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* the size (in cells) of a bucket; a block of RUNE_MAX_W x RUNE_MAX_H cells
+ * overlaps at most 6x6 buckets */
+enum { BLOCK_BUCKET = 16 };
+
+/* Block is a rectangle (in cells) of matching cells */
+typedef struct {
+	uint32_t x, y; /* the anchor of the block */
+	uint32_t w, h; /* the extent of the block */
+	uint32_t code; /* the resource codepoint shared by the block */
+} Block;
+
+/* BlockRun is a horizontal span [x0, x1) of cells with the same codepoint */
+typedef struct {
+	uint32_t x0, x1;
+	uint32_t code;
+} BlockRun;
+
+typedef struct {
+	BlockRun *runs;
+	uint32_t numRuns, capRuns;
+} BlockRow;
+
+typedef struct {
+	BlockRow *rows;
+	uint32_t numRows, numCols;
+
+	/* the block of each run (in row-major order) */
+	uint32_t *blockOf;
+	uint32_t capBlockOf;
+
+	Block *blocks;
+	uint32_t numBlocks, capBlocks;
+
+	/* the blocks overlapping bucket i are bucketItems[bucketStart[i]] to
+	 * bucketItems[bucketStart[i + 1]] */
+	uint32_t *bucketStart;
+	uint32_t *bucketItems;
+	uint32_t bucketsW, bucketsH, capItems;
+
+	bool dirty; /* true if the runs have changed since the last update */
+} BlockIndex;
+
+void init_BlockIndex(BlockIndex *, uint32_t, uint32_t);
+void deinit_BlockIndex(BlockIndex *);
+
+void blockindex_Set(BlockIndex *, uint32_t, uint32_t, uint32_t);
+bool blockindex_Update(BlockIndex *);
+Block *blockindex_Find(BlockIndex *, uint32_t, uint32_t);
+
+#endif
@@ -1,11 +1,26 @@
 #include "gled.h"
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_ttf.h>
+#include "alloc.h"
+#include "anim.h"
+#include "asset.h"
+#include "hud.h"
+#include "latency.h"
+#include "mem.h"
+#include "post.h"
+#include "rsrcdb.h"
+#include "sched.h"
+#include "snapshot.h"
+#include "texcomp.h"
 #include "window.h"
 
 static Window* main_win;
+static FrameSched sched;
+static RsrcDb rsrc;
 
 int gled_init() {
+	SDL_DisplayMode mode;
+
 	if (SDL_Init(SDL_INIT_EVERYTHING) != 0) {
 		printf("SDL init failed.\n");
 		return -1;
@@ -15,34 +30,162 @@ int gled_init() {
 		return -2;
 	}
 
+	if (!init_Assets()) {
+		return -3;
+	}
 	main_win = new_Window(40, 25);
 	if (main_win == NULL) {
 		return -3;
 	}
+	if (SDL_GetWindowDisplayMode(main_win->win, &mode) != 0) {
+		mode.refresh_rate = 0;
+	}
+	init_FrameSched(&sched, mode.refresh_rate);
 	window_redraw(main_win);
 	return 0;
 }
 
 void gled_quit() {
+#ifdef DEBUG
+	texcomp_Report();
+	post_Report();
+	alloc_Report();
+	mem_Report();
+#endif
+	deinit_Assets();
 	del_Window(main_win);
+	deinit_RsrcDb(&rsrc);
 	SDL_Quit();
 }
 
-void gled_redraw() { window_redraw(main_win); }
+/* gled_redraw presents a new frame even if nothing changed */
+void gled_redraw() {
+	window_damage(main_win);
+	gled_update();
+}
 
-void gled_update() {
+/* gled_damage makes the next gled_update() present a frame */
+void gled_damage() { window_damage(main_win); }
+
+/* gled_update advances the window and presents a frame if anything changed.
+ * Returns true if a frame was presented. */
+bool gled_update() {
+	uint32_t changed[ASSET_MAX], i, n;
+	double start = sched_Now();
+
+	/* swap in reloaded assets and redraw what shows them */
+	n = asset_Poll(changed, ASSET_MAX);
+	for (i = 0; i < n; ++i) {
+		window_reloaded(main_win, changed[i]);
+	}
+	hud_Update(main_win);
 	window_update(main_win);
-	window_redraw(main_win);
+	if (!window_redraw(main_win)) {
+		/* no frame will show the input read since the last one */
+		if (!window_damaged(main_win)) {
+			latency_Discard();
+		}
+		return false;
+	}
+	sched_Presented(&sched, start, main_win->submitted);
+	return true;
+}
+
+/* gled_timeout returns the milliseconds until gled_update() should next run
+ * (0 if now, -1 if it need not until something changes) */
+int32_t gled_timeout() {
+	return sched_Timeout(&sched, window_damaged(main_win) ||
+					 anim_NumTracks() > 0 || asset_Ready());
 }
 
 void gled_clear() {}
 
+/* gled_open_resources opens the compiled resource database at path. Runes
+ * set from it refer to its paths, so it stays open until gled_quit(). */
+bool gled_open_resources(const char *path) {
+	if (rsrc.map != NULL) {
+		puts("error: resources are already open");
+		return false;
+	}
+	return init_RsrcDb(&rsrc, path);
+}
+
+/* gled_set_resource shows the resource of code with its upper-left corner
+ * at cell (x, y). Returns false if code has no resource. */
+bool gled_set_resource(uint64_t x, uint64_t y, uint32_t code) {
+	const RsrcEntry *e;
+	Rune_ r;
+
+	if ((e = rsrcdb_Find(&rsrc, code)) == NULL ||
+	    !rsrcdb_Rune(&rsrc, code, &r)) {
+		return false;
+	}
+	if (e->kind == RSRC_MESH) {
+		window_setMesh(main_win, x, y, &r.mesh);
+	} else {
+		window_setImg(main_win, x, y, &r.img);
+	}
+	return true;
+}
+
+/* gled_save_snapshot saves the state of the window (without the HUD) to
+ * path */
+bool gled_save_snapshot(const char *path) {
+	bool hud, ok;
+
+	hud = hud_Shown(main_win);
+	hud_Show(main_win, false);
+	ok = snapshot_Save(main_win, path);
+	hud_Show(main_win, hud);
+	return ok;
+}
+
+/* gled_restore_snapshot restores the window saved at path. The editor then
+ * redraws over it as usual, so the snapshot need not be current. */
+bool gled_restore_snapshot(const char *path) {
+	if (!snapshot_Restore(main_win, path)) {
+		return false;
+	}
+	gled_update();
+	return true;
+}
+
+/* gled_show_hud shows or hides the memory HUD */
+void gled_show_hud(bool shown) { hud_Show(main_win, shown); }
+
+/* gled_set_effects enables the POST_* post-processing effects */
+void gled_set_effects(uint32_t effects) {
+	post_Enable(effects);
+	window_damage(main_win);
+}
+
 void gled_resize(uint64_t cols, uint64_t rows) {
 	window_resize(main_win, cols, rows);
 }
 
-void gled_onmousepress(uint64_t x, uint64_t y) {}
+/* gled_onresize refits the grid to a w x h pixel window and redraws it */
+void gled_onresize(uint64_t w, uint64_t h) {
+	window_fit(main_win, w, h);
+	gled_update();
+}
+
+/* gled_onmousepress delivers a press of button at pixel (x, y) */
+void gled_onmousepress(uint64_t x, uint64_t y, uint32_t button) {
+	window_pointer(main_win, RUNE_POINTER_PRESS, (float)x / main_win->cellW,
+		       (float)y / main_win->cellH, button);
+}
+
+/* gled_onmouserelease delivers a release of button at pixel (x, y) */
+void gled_onmouserelease(uint64_t x, uint64_t y, uint32_t button) {
+	window_pointer(main_win, RUNE_POINTER_RELEASE,
+		       (float)x / main_win->cellW, (float)y / main_win->cellH,
+		       button);
+}
 
-void gled_onmouserelease(uint64_t x, uint64_t y) {}
+/* gled_onmousemove delivers a pointer move to pixel (x, y) */
+void gled_onmousemove(uint64_t x, uint64_t y) {
+	window_pointer(main_win, RUNE_POINTER_MOVE, (float)x / main_win->cellW,
+		       (float)y / main_win->cellH, 0);
+}
 
 void gled_set_mainwin(Window* w) { main_win = w; }
@@ -1,6 +1,7 @@
 #ifndef INTERFACE_H
 #define INTERFACE_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include "window.h"
 
@@ -8,11 +9,22 @@ int gled_init();
 void gled_quit();
 
 void gled_redraw();
+void gled_damage();
+bool gled_update();
+int32_t gled_timeout();
 void gled_clear();
+bool gled_open_resources(const char *);
+bool gled_set_resource(uint64_t, uint64_t, uint32_t);
+bool gled_save_snapshot(const char *);
+bool gled_restore_snapshot(const char *);
+void gled_show_hud(bool);
 void gled_resize(uint64_t, uint64_t);
+void gled_onresize(uint64_t, uint64_t);
 void gled_set_mainwin(Window*);
+void gled_set_effects(uint32_t);
 
-void gled_onmousepress(uint64_t, uint64_t);
-void gled_onmouserelease(uint64_t, uint64_t);
+void gled_onmousepress(uint64_t, uint64_t, uint32_t);
+void gled_onmouserelease(uint64_t, uint64_t, uint32_t);
+void gled_onmousemove(uint64_t, uint64_t);
 
 #endif
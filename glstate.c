@@ -0,0 +1,297 @@
+#include "glstate.h"
+#include "mem.h"
+#include <string.h>
+
+/* UNKNOWN marks shadowed state that must be set unconditionally */
+#define UNKNOWN 0xffffffff
+
+/* GLState is the shadow copy of the GL state */
+typedef struct {
+	GLuint program;
+	GLenum activeUnit;
+	GLuint textures[GLSTATE_MAX_UNITS]; /* GL_TEXTURE_2D binding per unit */
+	GLuint vao;
+	GLuint arrayBuffer;
+	GLuint elementBuffer; /* belongs to the bound VAO */
+	GLuint framebuffer;
+	GLuint renderbuffer;
+
+	GLint viewport[4];
+	bool viewportKnown;
+
+	GLuint blend, depthTest; /* GL_TRUE, GL_FALSE or UNKNOWN */
+	GLenum blendSrc, blendDst;
+	GLenum depthFunc;
+} GLState;
+
+static GLState state;
+static GLStateStats stats;
+static bool initialized = false;
+
+/* changed counts a request and returns true if it must reach the driver */
+static bool changed(GLuint *shadow, GLuint val) {
+	stats.calls++;
+	if (*shadow == val) {
+		stats.avoided++;
+		return false;
+	}
+	*shadow = val;
+	return true;
+}
+
+/* glstate_Reset forgets all shadowed state (e.g. after creating a context) */
+void glstate_Reset() {
+	memset(&state, 0xff, sizeof(state));
+	state.viewportKnown = false;
+	initialized = true;
+}
+
+/* glstate_Stats returns the counters accumulated since startup */
+GLStateStats glstate_Stats() { return stats; }
+
+void glstate_UseProgram(GLuint program) {
+	if (!initialized) {
+		glstate_Reset();
+	}
+	if (changed(&state.program, program)) {
+		glUseProgram(program);
+	}
+}
+
+/* glstate_BindTexture binds tex to target on the given texture unit
+ * (0-based). Only GL_TEXTURE_2D bindings are shadowed. */
+void glstate_BindTexture(GLuint unit, GLenum target, GLuint tex) {
+	if (!initialized) {
+		glstate_Reset();
+	}
+	if (target != GL_TEXTURE_2D || unit >= GLSTATE_MAX_UNITS) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+		state.activeUnit = GL_TEXTURE0 + unit;
+		glBindTexture(target, tex);
+		stats.calls++;
+		return;
+	}
+	if (!changed(&state.textures[unit], tex)) {
+		return;
+	}
+	if (state.activeUnit != GL_TEXTURE0 + unit) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+		state.activeUnit = GL_TEXTURE0 + unit;
+	}
+	glBindTexture(target, tex);
+}
+
+void glstate_BindVertexArray(GLuint vao) {
+	if (!initialized) {
+		glstate_Reset();
+	}
+	if (changed(&state.vao, vao)) {
+		glBindVertexArray(vao);
+		/* the element buffer binding is part of the VAO */
+		state.elementBuffer = UNKNOWN;
+	}
+}
+
+void glstate_BindBuffer(GLenum target, GLuint buf) {
+	GLuint *shadow;
+
+	if (!initialized) {
+		glstate_Reset();
+	}
+	switch (target) {
+		case GL_ARRAY_BUFFER:
+			shadow = &state.arrayBuffer;
+			break;
+		case GL_ELEMENT_ARRAY_BUFFER:
+			shadow = &state.elementBuffer;
+			break;
+		default:
+			stats.calls++;
+			glBindBuffer(target, buf);
+			return;
+	}
+	if (changed(shadow, buf)) {
+		glBindBuffer(target, buf);
+	}
+}
+
+/* glstate_BindFramebuffer binds fbo as both the draw and read framebuffer */
+void glstate_BindFramebuffer(GLuint fbo) {
+	if (!initialized) {
+		glstate_Reset();
+	}
+	if (changed(&state.framebuffer, fbo)) {
+		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	}
+}
+
+/* glstate_GetFramebuffer returns the bound framebuffer, querying the driver
+ * only if it has not been bound through glstate */
+GLuint glstate_GetFramebuffer() {
+	GLint fbo;
+
+	if (!initialized) {
+		glstate_Reset();
+	}
+	if (state.framebuffer == UNKNOWN) {
+		glGetIntegerv(GL_FRAMEBUFFER_BINDING, &fbo);
+		state.framebuffer = fbo;
+	} else {
+		stats.queries++;
+	}
+	return state.framebuffer;
+}
+
+void glstate_BindRenderbuffer(GLuint rbo) {
+	if (!initialized) {
+		glstate_Reset();
+	}
+	if (changed(&state.renderbuffer, rbo)) {
+		glBindRenderbuffer(GL_RENDERBUFFER, rbo);
+	}
+}
+
+void glstate_Viewport(GLint x, GLint y, GLsizei w, GLsizei h) {
+	if (!initialized) {
+		glstate_Reset();
+	}
+	stats.calls++;
+	if (state.viewportKnown && state.viewport[0] == x &&
+	    state.viewport[1] == y && state.viewport[2] == w &&
+	    state.viewport[3] == h) {
+		stats.avoided++;
+		return;
+	}
+	state.viewport[0] = x;
+	state.viewport[1] = y;
+	state.viewport[2] = w;
+	state.viewport[3] = h;
+	state.viewportKnown = true;
+	glViewport(x, y, w, h);
+}
+
+/* glstate_GetViewport writes the current viewport (x, y, w, h) to vp. The
+ * driver is only queried if the viewport has not been set through glstate */
+void glstate_GetViewport(GLint *vp) {
+	if (!initialized) {
+		glstate_Reset();
+	}
+	if (!state.viewportKnown) {
+		glGetIntegerv(GL_VIEWPORT, state.viewport);
+		state.viewportKnown = true;
+	} else {
+		stats.queries++;
+	}
+	memcpy(vp, state.viewport, sizeof(state.viewport));
+}
+
+/* glstate_Enable enables or disables cap. Only GL_BLEND and GL_DEPTH_TEST
+ * are shadowed. */
+void glstate_Enable(GLenum cap, bool on) {
+	GLuint *shadow;
+
+	if (!initialized) {
+		glstate_Reset();
+	}
+	switch (cap) {
+		case GL_BLEND:
+			shadow = &state.blend;
+			break;
+		case GL_DEPTH_TEST:
+			shadow = &state.depthTest;
+			break;
+		default:
+			stats.calls++;
+			if (on) {
+				glEnable(cap);
+			} else {
+				glDisable(cap);
+			}
+			return;
+	}
+	if (!changed(shadow, on ? GL_TRUE : GL_FALSE)) {
+		return;
+	}
+	if (on) {
+		glEnable(cap);
+	} else {
+		glDisable(cap);
+	}
+}
+
+void glstate_BlendFunc(GLenum src, GLenum dst) {
+	if (!initialized) {
+		glstate_Reset();
+	}
+	stats.calls++;
+	if (state.blendSrc == src && state.blendDst == dst) {
+		stats.avoided++;
+		return;
+	}
+	state.blendSrc = src;
+	state.blendDst = dst;
+	glBlendFunc(src, dst);
+}
+
+void glstate_DepthFunc(GLenum func) {
+	if (!initialized) {
+		glstate_Reset();
+	}
+	if (changed(&state.depthFunc, func)) {
+		glDepthFunc(func);
+	}
+}
+
+/* the glstate_Delete* functions delete an object and drop any binding of it
+ * from the shadow copy (GL unbinds deleted objects itself) */
+
+void glstate_DeleteTexture(GLuint tex) {
+	int i;
+
+	for (i = 0; i < GLSTATE_MAX_UNITS; ++i) {
+		if (state.textures[i] == tex) {
+			state.textures[i] = 0;
+		}
+	}
+	mem_Untrack(MEM_TEXTURE, tex);
+	glDeleteTextures(1, &tex);
+}
+
+void glstate_DeleteBuffer(GLuint buf) {
+	if (state.arrayBuffer == buf) {
+		state.arrayBuffer = 0;
+	}
+	if (state.elementBuffer == buf) {
+		state.elementBuffer = 0;
+	}
+	mem_Untrack(MEM_BUFFER, buf);
+	glDeleteBuffers(1, &buf);
+}
+
+void glstate_DeleteVertexArray(GLuint vao) {
+	if (state.vao == vao) {
+		state.vao = 0;
+		state.elementBuffer = UNKNOWN;
+	}
+	glDeleteVertexArrays(1, &vao);
+}
+
+void glstate_DeleteRenderbuffer(GLuint rbo) {
+	if (state.renderbuffer == rbo) {
+		state.renderbuffer = 0;
+	}
+	mem_Untrack(MEM_RENDERBUFFER, rbo);
+	glDeleteRenderbuffers(1, &rbo);
+}
+
+void glstate_DeleteFramebuffer(GLuint fbo) {
+	if (state.framebuffer == fbo) {
+		state.framebuffer = 0;
+	}
+	glDeleteFramebuffers(1, &fbo);
+}
+
+void glstate_DeleteProgram(GLuint program) {
+	/* a program in use is only deleted once it is no longer current */
+	glDeleteProgram(program);
+}
@@ -0,0 +1,52 @@
+/*
+ * glstate.h
+ * glstate shadows the GL state that gled changes most often (bound program,
+ * textures, vertex array, buffers, framebuffer, viewport, blend and depth
+ * state) so that redundant calls are filtered out and queries for that state
+ * are answered without a round trip to the driver.
+ * All binds of shadowed state must go through these functions; call
+ * glstate_Reset() after anything else may have changed it.
+ */
+#ifndef GLSTATE_H
+#define GLSTATE_H
+
+#include <GL/glew.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* the number of texture units that are shadowed */
+enum { GLSTATE_MAX_UNITS = 16 };
+
+/* GLStateStats counts the state changes made through glstate */
+typedef struct {
+	uint64_t calls;   /* state changes requested */
+	uint64_t avoided; /* requests dropped because nothing would change */
+	uint64_t queries; /* queries answered from the shadow copy */
+} GLStateStats;
+
+void glstate_Reset();
+GLStateStats glstate_Stats();
+
+void glstate_UseProgram(GLuint);
+void glstate_BindTexture(GLuint, GLenum, GLuint);
+void glstate_BindVertexArray(GLuint);
+void glstate_BindBuffer(GLenum, GLuint);
+void glstate_BindFramebuffer(GLuint);
+GLuint glstate_GetFramebuffer();
+void glstate_BindRenderbuffer(GLuint);
+
+void glstate_Viewport(GLint, GLint, GLsizei, GLsizei);
+void glstate_GetViewport(GLint *);
+
+void glstate_Enable(GLenum, bool);
+void glstate_BlendFunc(GLenum, GLenum);
+void glstate_DepthFunc(GLenum);
+
+void glstate_DeleteTexture(GLuint);
+void glstate_DeleteBuffer(GLuint);
+void glstate_DeleteVertexArray(GLuint);
+void glstate_DeleteRenderbuffer(GLuint);
+void glstate_DeleteFramebuffer(GLuint);
+void glstate_DeleteProgram(GLuint);
+
+#endif
@@ -0,0 +1,133 @@
+#include "glyphcache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* slot returns the home slot of key in a table of cap slots */
+static uint32_t slot(uint64_t key, uint32_t cap) {
+	/* Fibonacci hashing spreads consecutive codepoints across the table */
+	return (uint32_t)((key * 0x9e3779b97f4a7c15ULL) >> 32) & (cap - 1);
+}
+
+/* alloc gives gc an empty table of cap slots */
+static bool alloc(GlyphCache *gc, uint32_t cap) {
+	uint32_t i;
+
+	gc->keys = malloc(sizeof(uint64_t) * cap);
+	gc->glyphs = malloc(sizeof(Glyph) * cap);
+	if (gc->keys == NULL || gc->glyphs == NULL) {
+		puts("error: failed to allocate glyph cache");
+		free(gc->keys);
+		free(gc->glyphs);
+		gc->keys = NULL;
+		gc->glyphs = NULL;
+		gc->cap = 0;
+		return false;
+	}
+	for (i = 0; i < cap; ++i) {
+		gc->keys[i] = GLYPH_EMPTY;
+	}
+	gc->cap = cap;
+	gc->len = 0;
+	return true;
+}
+
+/* init_GlyphCache initializes gc with room for about cap glyphs */
+void init_GlyphCache(GlyphCache *gc, uint32_t cap) {
+	uint32_t n;
+
+	memset(gc->asciiLoaded, 0, sizeof(gc->asciiLoaded));
+	for (n = 16; n < cap * 2; n *= 2)
+		;
+	alloc(gc, n);
+}
+
+void deinit_GlyphCache(GlyphCache *gc) {
+	free(gc->keys);
+	free(gc->glyphs);
+	gc->keys = NULL;
+	gc->glyphs = NULL;
+	gc->len = gc->cap = 0;
+}
+
+/* glyphcache_Find returns the glyph cached for key or NULL */
+Glyph *glyphcache_Find(GlyphCache *gc, uint64_t key) {
+	uint32_t i;
+
+	if (key < GLYPHCACHE_ASCII) {
+		return gc->asciiLoaded[key] ? &gc->ascii[key] : NULL;
+	}
+	if (gc->cap == 0) {
+		return NULL;
+	}
+	for (i = slot(key, gc->cap); gc->keys[i] != key;
+	     i = (i + 1) & (gc->cap - 1)) {
+		if (gc->keys[i] == GLYPH_EMPTY) {
+			return NULL;
+		}
+	}
+	return &gc->glyphs[i];
+}
+
+/* grow doubles the table of gc, rehashing its glyphs */
+static bool grow(GlyphCache *gc) {
+	uint64_t *keys;
+	Glyph *glyphs;
+	uint32_t i, j, cap;
+
+	keys = gc->keys;
+	glyphs = gc->glyphs;
+	cap = gc->cap;
+	if (!alloc(gc, cap ? cap * 2 : 16)) {
+		gc->keys = keys;
+		gc->glyphs = glyphs;
+		gc->cap = cap;
+		return false;
+	}
+	for (i = 0; i < cap; ++i) {
+		if (keys[i] == GLYPH_EMPTY) {
+			continue;
+		}
+		j = slot(keys[i], gc->cap);
+		while (gc->keys[j] != GLYPH_EMPTY) {
+			j = (j + 1) & (gc->cap - 1);
+		}
+		gc->keys[j] = keys[i];
+		gc->glyphs[j] = glyphs[i];
+		gc->len++;
+	}
+	free(keys);
+	free(glyphs);
+	return true;
+}
+
+/* glyphcache_Insert returns the (zeroed) glyph for key for the caller to fill
+ * in. If key is already cached its glyph is returned as is. Returns NULL if
+ * the cache could not grow. */
+Glyph *glyphcache_Insert(GlyphCache *gc, uint64_t key) {
+	Glyph *g;
+	uint32_t i;
+
+	if (key < GLYPHCACHE_ASCII) {
+		if (!gc->asciiLoaded[key]) {
+			memset(&gc->ascii[key], 0, sizeof(Glyph));
+			gc->asciiLoaded[key] = true;
+		}
+		return &gc->ascii[key];
+	}
+	if ((g = glyphcache_Find(gc, key)) != NULL) {
+		return g;
+	}
+
+	/* keep the load factor at or below 1/2 so probes stay short */
+	if ((gc->len + 1) * 2 > gc->cap && !grow(gc)) {
+		return NULL;
+	}
+	for (i = slot(key, gc->cap); gc->keys[i] != GLYPH_EMPTY;
+	     i = (i + 1) & (gc->cap - 1))
+		;
+	gc->keys[i] = key;
+	gc->len++;
+	memset(&gc->glyphs[i], 0, sizeof(Glyph));
+	return &gc->glyphs[i];
+}
@@ -0,0 +1,54 @@
+/*
+ * glyphcache.h
+ * The GlyphCache maps (font, style, size, codepoint) keys to the texture and
+ * clip rect each glyph is drawn from. Keys are packed into 64 bits and stored
+ * in a flat open-addressing table; ASCII glyphs of the default font, style and
+ * size skip the table and are indexed directly.
+ */
+#ifndef GLYPHCACHE_H
+#define GLYPHCACHE_H
+
+#include <GL/glew.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "vector.h"
+
+/* GLYPH_KEY packs an 8-bit font, 8-bit style, 16-bit size (0 is the font's
+ * default size) and 32-bit codepoint into a key */
+#define GLYPH_KEY(font, style, size, code)                                   \
+	((uint64_t)(font) << 56 | (uint64_t)(style) << 48 |                  \
+	 (uint64_t)(size) << 32 | (uint32_t)(code))
+
+/* marks unused slots (no font has 255 styles of 65535px U+FFFFFFFF) */
+#define GLYPH_EMPTY UINT64_MAX
+
+enum { GLYPH_STYLE_BOLD = 1, GLYPH_STYLE_ITALIC = 2 };
+
+enum { GLYPHCACHE_ASCII = 128 };
+
+/* Glyph is where a glyph is drawn from. Glyphs the font lacks are cached
+ * with tex = 0. */
+typedef struct {
+	GLuint tex;
+	Rect clip;
+	uint32_t mode; /* RUNE_DRAW_* */
+} Glyph;
+
+typedef struct {
+	/* direct-indexed glyphs for keys GLYPH_KEY(0, 0, 0, 0..127) */
+	Glyph ascii[GLYPHCACHE_ASCII];
+	bool asciiLoaded[GLYPHCACHE_ASCII];
+
+	/* open-addressing table (linear probing); cap is a power of 2 */
+	uint64_t *keys;
+	Glyph *glyphs;
+	uint32_t len, cap;
+} GlyphCache;
+
+void init_GlyphCache(GlyphCache *, uint32_t);
+void deinit_GlyphCache(GlyphCache *);
+
+Glyph *glyphcache_Find(GlyphCache *, uint64_t);
+Glyph *glyphcache_Insert(GlyphCache *, uint64_t);
+
+#endif
@@ -0,0 +1,186 @@
+#include "grid.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "alloc.h"
+#include "anim.h"
+#include "glstate.h"
+#include "mem.h"
+
+/* init_Grid initializes g as grid id of w x h blank cells */
+bool init_Grid(Grid *g, uint32_t id, uint32_t w, uint32_t h) {
+	uint32_t i;
+
+	memset(g, 0, sizeof(Grid));
+	g->id = id;
+	if (w == 0 || h == 0 ||
+	    (g->cells = alloc_Heap((size_t)w * h * sizeof(Rune_))) == NULL) {
+		puts("error: failed to allocate grid");
+		return false;
+	}
+	for (i = 0; i < w * h; ++i) {
+		g->cells[i].ch = rune_blankChar;
+	}
+	g->w = w;
+	g->h = h;
+	g->dirty = true;
+	mem_Add(MEM_GRIDS, MEM_CPU, (size_t)w * h * sizeof(Rune_));
+	return true;
+}
+
+/* deinit_Grid frees the cells and target of g, stopping their animations
+ * (the copies of a rune share one, which anim_Stop frees only once) */
+void deinit_Grid(Grid *g) {
+	uint32_t i;
+
+	for (i = 0; g->cells != NULL && i < g->w * g->h; ++i) {
+		if (g->cells[i].r.anim != 0) {
+			anim_Stop(g->cells[i].r.anim);
+		}
+	}
+	if (g->cells != NULL) {
+		mem_Sub(MEM_GRIDS, MEM_CPU,
+			(size_t)g->w * g->h * sizeof(Rune_));
+	}
+	free(g->cells);
+	gridtarget_Free(&g->target);
+	memset(g, 0, sizeof(Grid));
+}
+
+/* grid_Resize resizes g to w x h cells, keeping the cells that remain
+ * inside it */
+bool grid_Resize(Grid *g, uint32_t w, uint32_t h) {
+	Rune_ *cells;
+	uint32_t x, y;
+
+	if (w == g->w && h == g->h) {
+		return true;
+	}
+	if (w == 0 || h == 0 ||
+	    (cells = alloc_Heap((size_t)w * h * sizeof(Rune_))) == NULL) {
+		puts("error: failed to resize grid");
+		return false;
+	}
+	for (y = 0; y < h; ++y) {
+		for (x = 0; x < w; ++x) {
+			if (x < g->w && y < g->h) {
+				cells[y * w + x] = g->cells[y * g->w + x];
+			} else {
+				cells[y * w + x].ch = rune_blankChar;
+			}
+		}
+	}
+
+	/* the cells cut off take their animations with them */
+	for (y = 0; y < g->h; ++y) {
+		for (x = 0; x < g->w; ++x) {
+			if ((x >= w || y >= h) &&
+			    g->cells[y * g->w + x].r.anim != 0) {
+				anim_Stop(g->cells[y * g->w + x].r.anim);
+			}
+		}
+	}
+	mem_Sub(MEM_GRIDS, MEM_CPU, (size_t)g->w * g->h * sizeof(Rune_));
+	mem_Add(MEM_GRIDS, MEM_CPU, (size_t)w * h * sizeof(Rune_));
+	free(g->cells);
+	g->cells = cells;
+	g->w = w;
+	g->h = h;
+	g->dirty = true;
+	return true;
+}
+
+/* grid_Cell returns the cell at (x, y) for the caller to change (NULL if it
+ * is out of range). The grid is redrawn on the next frame. */
+Rune_ *grid_Cell(Grid *g, uint32_t x, uint32_t y) {
+	if (x >= g->w || y >= g->h) {
+		return NULL;
+	}
+	g->dirty = true;
+	return &g->cells[y * g->w + x];
+}
+
+/* grid_Set copies r into the cell at (x, y) */
+void grid_Set(Grid *g, uint32_t x, uint32_t y, const Rune_ *r) {
+	Rune_ *cell;
+
+	if ((cell = grid_Cell(g, x, y)) == NULL) {
+		return;
+	}
+
+	/* the replaced rune's animation goes with it */
+	if (cell->r.anim != 0 && cell->r.anim != r->r.anim) {
+		anim_Stop(cell->r.anim);
+	}
+	*cell = *r;
+}
+
+/* gridtarget_Fit makes t able to hold a w x h pixel rendering and binds it
+ * with a viewport of that size. Returns false on failure. */
+bool gridtarget_Fit(GridTarget *t, uint32_t w, uint32_t h) {
+	uint32_t tw, th;
+
+	if (w == 0 || h == 0) {
+		return false;
+	}
+	if (t->fbo == 0) {
+		glGenTextures(1, &t->tex);
+		glGenFramebuffers(1, &t->fbo);
+	}
+	if (w > t->w || h > t->h) {
+		tw = (w + GRID_TARGET_STEP - 1) / GRID_TARGET_STEP *
+		     GRID_TARGET_STEP;
+		th = (h + GRID_TARGET_STEP - 1) / GRID_TARGET_STEP *
+		     GRID_TARGET_STEP;
+		glstate_BindTexture(0, GL_TEXTURE_2D, t->tex);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, tw, th, 0, GL_RGBA,
+			     GL_UNSIGNED_BYTE, NULL);
+		mem_Track(MEM_TEXTURE, t->tex, MEM_GRIDS, (size_t)tw * th * 4);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+				GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER,
+				GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S,
+				GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T,
+				GL_CLAMP_TO_EDGE);
+		glstate_BindFramebuffer(t->fbo);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+				       GL_TEXTURE_2D, t->tex, 0);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) !=
+		    GL_FRAMEBUFFER_COMPLETE) {
+			puts("error: incomplete grid target");
+			return false;
+		}
+		t->w = tw;
+		t->h = th;
+	}
+	glstate_BindFramebuffer(t->fbo);
+	glstate_Viewport(0, 0, w, h);
+	t->usedW = w;
+	t->usedH = h;
+	return true;
+}
+
+/* gridtarget_Clip returns the texture coordinates of the last rendering of
+ * t, flipped so that its first row is at the top */
+Rect gridtarget_Clip(const GridTarget *t) {
+	Rect clip = {0.0f, 0.0f, 0.0f, 0.0f};
+
+	if (t->w != 0 && t->h != 0) {
+		clip.x = 0.0f;
+		clip.y = (float)t->usedH / t->h;
+		clip.w = (float)t->usedW / t->w;
+		clip.h = -clip.y;
+	}
+	return clip;
+}
+
+/* gridtarget_Free deletes the GL objects of t */
+void gridtarget_Free(GridTarget *t) {
+	if (t->fbo != 0) {
+		glstate_DeleteFramebuffer(t->fbo);
+		glstate_DeleteTexture(t->tex);
+	}
+	memset(t, 0, sizeof(GridTarget));
+}
@@ -0,0 +1,54 @@
+/*
+ * grid.h
+ * A Grid is a rectangle of cells composited onto the window at a position
+ * and depth, such as a Neovim window or float under ext_multigrid. Each grid
+ * owns its cells and caches them in a render target that is only redrawn
+ * when a cell changes; moving or restacking a grid just recomposites the
+ * cached targets.
+ */
+#ifndef GRID_H
+#define GRID_H
+
+#include <GL/glew.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "rune.h"
+
+/* target sizes are rounded up to this many pixels so that a window drag
+ * reallocates them only now and then */
+enum { GRID_TARGET_STEP = 256 };
+
+/* GridTarget is a cached rendering of a grid */
+typedef struct {
+	GLuint fbo, tex;
+	uint32_t w, h;         /* the allocated size in pixels */
+	uint32_t usedW, usedH; /* the size last rendered into */
+} GridTarget;
+
+typedef struct {
+	uint32_t id;
+	int32_t x, y; /* the upper-left corner in window cells */
+	int32_t z;    /* grids are composited in increasing z */
+	uint32_t w, h;
+	bool hidden;
+	bool opaque; /* the grid hides what is under it (has a background) */
+	bool dirty;  /* a cell changed since the target was rendered */
+
+	Rune_ *cells; /* w x h, row-major */
+	GridTarget target;
+
+	uint32_t serial; /* the order grids of equal z are stacked in */
+} Grid;
+
+bool init_Grid(Grid *, uint32_t, uint32_t, uint32_t);
+void deinit_Grid(Grid *);
+
+bool grid_Resize(Grid *, uint32_t, uint32_t);
+Rune_ *grid_Cell(Grid *, uint32_t, uint32_t);
+void grid_Set(Grid *, uint32_t, uint32_t, const Rune_ *);
+
+bool gridtarget_Fit(GridTarget *, uint32_t, uint32_t);
+Rect gridtarget_Clip(const GridTarget *);
+void gridtarget_Free(GridTarget *);
+
+#endif
@@ -0,0 +1,95 @@
+#include "hud.h"
+#include <stdio.h>
+#include <string.h>
+#include "mem.h"
+
+/* the size of the HUD in cells: a header, each subsystem and the total */
+enum { HUD_COLS = 43, HUD_ROWS = MEM_NUM_TAGS + 2 };
+
+/* lastRefresh is SDL_GetTicks() when the HUD was last refreshed */
+static uint32_t lastRefresh;
+
+/* hud_Show shows or hides the HUD of w */
+void hud_Show(Window *w, bool shown) {
+	if (shown == hud_Shown(w)) {
+		return;
+	}
+	if (!shown) {
+		window_closeGrid(w, HUD_GRID);
+		return;
+	}
+	if (window_newGrid(w, HUD_GRID, HUD_COLS, HUD_ROWS) == NULL) {
+		return;
+	}
+	/* the HUD has a background, so the buffer under it is not drawn */
+	window_opaqueGrid(w, HUD_GRID, true);
+	lastRefresh = 0;
+	hud_Update(w);
+}
+
+/* hud_Shown returns true if the HUD of w is shown */
+bool hud_Shown(Window *w) { return window_grid(w, HUD_GRID) != NULL; }
+
+/* setLine writes text to row y of g, inverted if over */
+static void setLine(Grid *g, uint32_t y, const char *text, bool over) {
+	uint32_t x, code, len;
+	const Rune *cell;
+	Rune_ r;
+
+	len = strlen(text);
+	for (x = 0; x < g->w; ++x) {
+		code = x < len ? (unsigned char)text[x] : ' ';
+		cell = &g->cells[y * g->w + x].r;
+		/* leave unchanged cells alone, so that an unchanged HUD
+		 * never redraws the grid */
+		if (cell->code == code && cell->flags.invert == over) {
+			continue;
+		}
+		r.ch = rune_blankChar;
+		r.r.code = code;
+		r.r.flags.invert = over;
+		grid_Set(g, x, y, &r);
+	}
+}
+
+/* hud_Update refreshes the HUD of w if it is shown and due */
+void hud_Update(Window *w) {
+	char line[128]; /* room for any figures: setLine() clips to the grid */
+	MemStats cpu, gpu;
+	uint32_t i, now;
+	int32_t x;
+	Grid *g;
+
+	if ((g = window_grid(w, HUD_GRID)) == NULL) {
+		return;
+	}
+	x = (int32_t)w->w - HUD_COLS;
+	x = x > 0 ? x : 0;
+	if (g->x != x || g->y != 0 || g->z != INT32_MAX) {
+		window_placeGrid(w, HUD_GRID, x, 0, INT32_MAX);
+	}
+	now = SDL_GetTicks();
+	if (lastRefresh != 0 && now - lastRefresh < HUD_REFRESH_MS) {
+		return;
+	}
+	lastRefresh = now ? now : 1;
+
+	snprintf(line, sizeof(line), "%-7s%9s%9s%9s%9s", "KiB", "cpu", "peak",
+		 "gpu", "peak");
+	setLine(g, 0, line, false);
+	for (i = 0; i < MEM_NUM_TAGS; ++i) {
+		cpu = mem_Stats(i, MEM_CPU);
+		gpu = mem_Stats(i, MEM_GPU);
+		snprintf(line, sizeof(line), "%-7s%9zu%9zu%9zu%9zu",
+			 mem_TagName(i), cpu.live / 1024, cpu.peak / 1024,
+			 gpu.live / 1024, gpu.peak / 1024);
+		setLine(g, i + 1, line,
+			mem_OverBudget(i, MEM_CPU) ||
+			    mem_OverBudget(i, MEM_GPU));
+	}
+	cpu = mem_Total(MEM_CPU);
+	gpu = mem_Total(MEM_GPU);
+	snprintf(line, sizeof(line), "%-7s%9zu%9s%9zu%9s", "total",
+		 cpu.live / 1024, "", gpu.live / 1024, "");
+	setLine(g, HUD_ROWS - 1, line, false);
+}
@@ -0,0 +1,24 @@
+/*
+ * hud.h
+ * The HUD is a grid in the upper-right corner of the window that shows the
+ * live and peak memory of each subsystem (see mem.h), on the CPU and GPU.
+ * Subsystems over a budget are shown inverted. It is refreshed at most every
+ * HUD_REFRESH_MS, and only the cells whose text changed are redrawn.
+ */
+#ifndef HUD_H
+#define HUD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "window.h"
+
+/* the id of the HUD's grid, which the editor's grids never use */
+#define HUD_GRID UINT32_MAX
+
+enum { HUD_REFRESH_MS = 500 };
+
+void hud_Show(Window *, bool);
+bool hud_Shown(Window *);
+void hud_Update(Window *);
+
+#endif
@@ -0,0 +1,874 @@
+#include "image.h"
+#include <SDL2/SDL.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+#include "util.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+
+/* the largest width or height accepted from any image file */
+enum { IMAGE_MAX_DIM = 16384 };
+
+/* the number of released pixel buffers kept for reuse */
+enum { IMAGE_POOL_SIZE = 8 };
+
+static struct {
+	uint8_t *buf;
+	size_t cap;
+} pool[IMAGE_POOL_SIZE];
+static int poolLen;
+static SDL_SpinLock poolLock; /* images are also decoded by the asset thread */
+
+/* be32 and le32/le16 read unaligned integers */
+static uint32_t be32(const uint8_t *p) {
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+	       ((uint32_t)p[2] << 8) | p[3];
+}
+static uint32_t le32(const uint8_t *p) {
+	return ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) |
+	       ((uint32_t)p[1] << 8) | p[0];
+}
+static uint16_t le16(const uint8_t *p) { return (uint16_t)(p[1] << 8 | p[0]); }
+
+/* poolTake returns a buffer of at least sz bytes, reusing the smallest
+ * pooled buffer that is large enough, and writes its capacity to cap */
+static uint8_t *poolTake(size_t sz, size_t *cap) {
+	uint8_t *buf;
+	int i, best;
+
+	SDL_AtomicLock(&poolLock);
+	best = -1;
+	for (i = 0; i < poolLen; ++i) {
+		if (pool[i].cap >= sz &&
+		    (best < 0 || pool[i].cap < pool[best].cap)) {
+			best = i;
+		}
+	}
+	if (best >= 0) {
+		buf = pool[best].buf;
+		*cap = pool[best].cap;
+		pool[best] = pool[--poolLen];
+		SDL_AtomicUnlock(&poolLock);
+		return buf;
+	}
+	SDL_AtomicUnlock(&poolLock);
+	if ((buf = malloc(sz)) == NULL) {
+		puts("error: out of memory decoding image");
+		return NULL;
+	}
+	*cap = sz;
+	return buf;
+}
+
+/* poolGive returns the buffer buf of capacity cap to the pool */
+static void poolGive(uint8_t *buf, size_t cap) {
+	int i, smallest;
+
+	SDL_AtomicLock(&poolLock);
+	if (poolLen < IMAGE_POOL_SIZE) {
+		pool[poolLen].buf = buf;
+		pool[poolLen++].cap = cap;
+	} else {
+		/* keep the largest buffers */
+		smallest = 0;
+		for (i = 1; i < poolLen; ++i) {
+			if (pool[i].cap < pool[smallest].cap) {
+				smallest = i;
+			}
+		}
+		if (pool[smallest].cap < cap) {
+			free(pool[smallest].buf);
+			pool[smallest].buf = buf;
+			pool[smallest].cap = cap;
+		} else {
+			free(buf);
+		}
+	}
+	SDL_AtomicUnlock(&poolLock);
+}
+
+/* imageAlloc sizes img for w x h pixels, reusing a pooled buffer if one is
+ * large enough. */
+static bool imageAlloc(Image *img, uint32_t w, uint32_t h) {
+	if (w == 0 || h == 0 || w > IMAGE_MAX_DIM || h > IMAGE_MAX_DIM) {
+		puts("error: unsupported image dimensions");
+		return false;
+	}
+	img->w = w;
+	img->h = h;
+	img->pixels = poolTake((size_t)w * h * 4, &img->cap);
+	return img->pixels != NULL;
+}
+
+/* image_Free returns the pixels of img to the image pool */
+void image_Free(Image *img) {
+	if (img->pixels == NULL) {
+		return;
+	}
+	poolGive(img->pixels, img->cap);
+	img->pixels = NULL;
+	img->cap = 0;
+}
+
+/* contentHash returns a hash of the n bytes at p (8 bytes at a time) */
+static uint64_t contentHash(const uint8_t *p, size_t n) {
+	uint64_t h, w;
+	size_t i;
+
+	h = n * 0x9e3779b97f4a7c15ULL;
+	for (i = 0; i + 8 <= n; i += 8) {
+		memcpy(&w, p + i, 8);
+		h = (h ^ w) * 0xff51afd7ed558ccdULL;
+		h ^= h >> 32;
+	}
+	return hash64(p + i, n - i, h);
+}
+
+/* mapFile maps file read-only, returning its contents and length */
+static const uint8_t *mapFile(const char *file, size_t *len) {
+	struct stat st;
+	void *p;
+	int fd;
+
+	if ((fd = open(file, O_RDONLY)) < 0) {
+		return NULL;
+	}
+	if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+		close(fd);
+		return NULL;
+	}
+	p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED) {
+		return NULL;
+	}
+	*len = st.st_size;
+	return p;
+}
+
+static void unmapFile(const uint8_t *p, size_t len) {
+	munmap((void *)p, len);
+}
+
+/*****************************************************************************/
+/* QOI                                                                       */
+/*****************************************************************************/
+
+enum { QOI_OP_INDEX = 0x00,
+       QOI_OP_DIFF = 0x40,
+       QOI_OP_LUMA = 0x80,
+       QOI_OP_RUN = 0xc0,
+       QOI_OP_RGB = 0xfe,
+       QOI_OP_RGBA = 0xff,
+       QOI_MASK = 0xc0,
+       QOI_HEADER_SZ = 14,
+       QOI_PADDING_SZ = 8 };
+
+static const uint8_t qoiPadding[QOI_PADDING_SZ] = {0, 0, 0, 0, 0, 0, 0, 1};
+
+/* qoiHash returns the index of the RGBA pixel px in the QOI color table */
+static int qoiHash(const uint8_t *px) {
+	return (px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64;
+}
+
+/* image_DecodeQOI decodes the len byte QOI file at data to img */
+bool image_DecodeQOI(const uint8_t *data, size_t len, Image *img) {
+	uint8_t index[64][4], px[4], *out;
+	size_t p, i, n;
+	int run;
+
+	if (len < QOI_HEADER_SZ + QOI_PADDING_SZ ||
+	    memcmp(data, "qoif", 4) != 0) {
+		return false;
+	}
+	if (!imageAlloc(img, be32(data + 4), be32(data + 8))) {
+		return false;
+	}
+	memset(index, 0, sizeof(index));
+	px[0] = px[1] = px[2] = 0;
+	px[3] = 255;
+
+	out = img->pixels;
+	n = (size_t)img->w * img->h;
+	p = QOI_HEADER_SZ;
+	run = 0;
+	for (i = 0; i < n; ++i) {
+		if (run > 0) {
+			--run;
+		} else if (p < len - QOI_PADDING_SZ) {
+			int b1 = data[p++];
+
+			if (b1 == QOI_OP_RGB) {
+				memcpy(px, &data[p], 3);
+				p += 3;
+			} else if (b1 == QOI_OP_RGBA) {
+				memcpy(px, &data[p], 4);
+				p += 4;
+			} else if ((b1 & QOI_MASK) == QOI_OP_INDEX) {
+				memcpy(px, index[b1], 4);
+			} else if ((b1 & QOI_MASK) == QOI_OP_DIFF) {
+				px[0] += ((b1 >> 4) & 3) - 2;
+				px[1] += ((b1 >> 2) & 3) - 2;
+				px[2] += (b1 & 3) - 2;
+			} else if ((b1 & QOI_MASK) == QOI_OP_LUMA) {
+				int b2 = data[p++];
+				int vg = (b1 & 0x3f) - 32;
+				px[0] += vg - 8 + ((b2 >> 4) & 0x0f);
+				px[1] += vg;
+				px[2] += vg - 8 + (b2 & 0x0f);
+			} else {
+				run = b1 & 0x3f;
+			}
+			memcpy(index[qoiHash(px)], px, 4);
+		}
+		memcpy(&out[i * 4], px, 4);
+	}
+	return true;
+}
+
+/* image_EncodeQOI returns a malloc'd QOI encoding of img, writing its length
+ * to len. */
+uint8_t *image_EncodeQOI(const Image *img, size_t *len) {
+	uint8_t index[64][4], prev[4], *out;
+	const uint8_t *px;
+	size_t i, n, p;
+	int run, h;
+
+	n = (size_t)img->w * img->h;
+	if ((out = malloc(QOI_HEADER_SZ + n * 5 + QOI_PADDING_SZ)) == NULL) {
+		return NULL;
+	}
+	memcpy(out, "qoif", 4);
+	out[4] = img->w >> 24;
+	out[5] = img->w >> 16;
+	out[6] = img->w >> 8;
+	out[7] = img->w;
+	out[8] = img->h >> 24;
+	out[9] = img->h >> 16;
+	out[10] = img->h >> 8;
+	out[11] = img->h;
+	out[12] = 4; /* channels */
+	out[13] = 0; /* sRGB with linear alpha */
+
+	memset(index, 0, sizeof(index));
+	prev[0] = prev[1] = prev[2] = 0;
+	prev[3] = 255;
+	p = QOI_HEADER_SZ;
+	run = 0;
+	for (i = 0; i < n; ++i) {
+		px = &img->pixels[i * 4];
+		if (memcmp(px, prev, 4) == 0) {
+			if (++run == 62 || i == n - 1) {
+				out[p++] = QOI_OP_RUN | (run - 1);
+				run = 0;
+			}
+			continue;
+		}
+		if (run > 0) {
+			out[p++] = QOI_OP_RUN | (run - 1);
+			run = 0;
+		}
+		h = qoiHash(px);
+		if (memcmp(index[h], px, 4) == 0) {
+			out[p++] = QOI_OP_INDEX | h;
+		} else {
+			memcpy(index[h], px, 4);
+			if (px[3] == prev[3]) {
+				int8_t vr = px[0] - prev[0];
+				int8_t vg = px[1] - prev[1];
+				int8_t vb = px[2] - prev[2];
+				int8_t vgr = vr - vg;
+				int8_t vgb = vb - vg;
+
+				if (vr > -3 && vr < 2 && vg > -3 && vg < 2 &&
+				    vb > -3 && vb < 2) {
+					out[p++] = QOI_OP_DIFF | (vr + 2) << 4 |
+						   (vg + 2) << 2 | (vb + 2);
+				} else if (vgr > -9 && vgr < 8 && vg > -33 &&
+					   vg < 32 && vgb > -9 && vgb < 8) {
+					out[p++] = QOI_OP_LUMA | (vg + 32);
+					out[p++] = (vgr + 8) << 4 | (vgb + 8);
+				} else {
+					out[p++] = QOI_OP_RGB;
+					memcpy(&out[p], px, 3);
+					p += 3;
+				}
+			} else {
+				out[p++] = QOI_OP_RGBA;
+				memcpy(&out[p], px, 4);
+				p += 4;
+			}
+		}
+		memcpy(prev, px, 4);
+	}
+	memcpy(&out[p], qoiPadding, QOI_PADDING_SZ);
+	*len = p + QOI_PADDING_SZ;
+	return out;
+}
+
+/*****************************************************************************/
+/* PNG                                                                       */
+/*****************************************************************************/
+
+static const uint8_t pngSignature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+
+enum { PNG_GRAY = 0,
+       PNG_RGB = 2,
+       PNG_PALETTE = 3,
+       PNG_GRAY_ALPHA = 4,
+       PNG_RGBA = 6 };
+
+/* paeth returns the Paeth predictor of a (left), b (up), c (up-left) */
+static uint8_t paeth(int a, int b, int c) {
+	int p, pa, pb, pc;
+
+	p = a + b - c;
+	pa = abs(p - a);
+	pb = abs(p - b);
+	pc = abs(p - c);
+	if (pa <= pb && pa <= pc) {
+		return a;
+	}
+	return pb <= pc ? b : c;
+}
+
+/* unfilter reverses the PNG filter on the n bytes of row given the previous
+ * (already unfiltered) row prior and bpp bytes per pixel. */
+static bool unfilter(uint8_t *row, const uint8_t *prior, size_t n, size_t bpp,
+		     int type) {
+	size_t i;
+
+	i = 0;
+	switch (type) {
+		case 0: /* none */
+			break;
+		case 1: /* sub */
+#ifdef __SSE2__
+			if (bpp == 4) {
+				/* prefix-sum 4 pixels at a time */
+				__m128i last = _mm_setzero_si128();
+				for (; i + 16 <= n; i += 16) {
+					__m128i x;
+					x = _mm_loadu_si128((__m128i *)&row[i]);
+					x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+					x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+					x = _mm_add_epi8(x, last);
+					_mm_storeu_si128((__m128i *)&row[i], x);
+					last = _mm_shuffle_epi32(
+					    x, _MM_SHUFFLE(3, 3, 3, 3));
+				}
+			}
+#endif
+			for (i = i > bpp ? i : bpp; i < n; ++i) {
+				row[i] += row[i - bpp];
+			}
+			break;
+		case 2: /* up */
+#ifdef __SSE2__
+			for (; i + 16 <= n; i += 16) {
+				__m128i x, y;
+				x = _mm_loadu_si128((__m128i *)&row[i]);
+				y = _mm_loadu_si128((__m128i *)&prior[i]);
+				_mm_storeu_si128((__m128i *)&row[i],
+						 _mm_add_epi8(x, y));
+			}
+#endif
+			for (; i < n; ++i) {
+				row[i] += prior[i];
+			}
+			break;
+		case 3: /* average */
+			for (; i < bpp && i < n; ++i) {
+				row[i] += prior[i] >> 1;
+			}
+			for (; i < n; ++i) {
+				row[i] += (row[i - bpp] + prior[i]) >> 1;
+			}
+			break;
+		case 4: /* paeth */
+			for (; i < bpp && i < n; ++i) {
+				row[i] += prior[i];
+			}
+			for (; i < n; ++i) {
+				row[i] += paeth(row[i - bpp], prior[i],
+						prior[i - bpp]);
+			}
+			break;
+		default:
+			return false;
+	}
+	return true;
+}
+
+/* rgbToRGBA expands n RGB pixels from src to opaque RGBA pixels in dst */
+static void rgbToRGBA(const uint8_t *src, uint8_t *dst, size_t n) {
+	size_t i;
+
+	i = 0;
+#ifdef __SSSE3__
+	{
+		const __m128i shuf = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6,
+						   7, 8, -1, 9, 10, 11, -1);
+		const __m128i alpha = _mm_set1_epi32((int)0xff000000);
+		/* 4 pixels per iteration; the load reads 4 bytes past them */
+		for (; i + 6 <= n; i += 4) {
+			__m128i x = _mm_loadu_si128((__m128i *)&src[i * 3]);
+			x = _mm_or_si128(_mm_shuffle_epi8(x, shuf), alpha);
+			_mm_storeu_si128((__m128i *)&dst[i * 4], x);
+		}
+	}
+#endif
+	for (; i < n; ++i) {
+		dst[i * 4 + 0] = src[i * 3 + 0];
+		dst[i * 4 + 1] = src[i * 3 + 1];
+		dst[i * 4 + 2] = src[i * 3 + 2];
+		dst[i * 4 + 3] = 0xff;
+	}
+}
+
+/* pngSample returns sample i of row as a value in [0, 2^depth) (or the high
+ * byte of 16-bit samples) */
+static uint32_t pngSample(const uint8_t *row, uint32_t i, int depth) {
+	uint32_t bit;
+
+	switch (depth) {
+		case 16:
+			return row[i * 2];
+		case 8:
+			return row[i];
+		default:
+			bit = i * depth;
+			return (row[bit / 8] >> (8 - depth - bit % 8)) &
+			       ((1 << depth) - 1);
+	}
+}
+
+/* PngInfo is what expanding a row of a PNG needs to know about it */
+typedef struct {
+	uint32_t w;
+	int depth, ctype, scale;
+	const uint8_t *palette, *trns;
+	uint32_t numPalette, numTrns;
+} PngInfo;
+
+/* pngExpand expands the unfiltered row of png to RGBA8 pixels in out */
+static void pngExpand(const PngInfo *png, const uint8_t *row, uint8_t *out) {
+	const uint8_t *trns = png->trns;
+	int depth = png->depth;
+	uint32_t x, v;
+
+	if (depth == 8 && png->ctype == PNG_RGBA) {
+		memcpy(out, row, (size_t)png->w * 4);
+		return;
+	}
+	if (depth == 8 && png->ctype == PNG_RGB && trns == NULL) {
+		rgbToRGBA(row, out, png->w);
+		return;
+	}
+	for (x = 0; x < png->w; ++x, out += 4) {
+		switch (png->ctype) {
+			case PNG_GRAY:
+				v = pngSample(row, x, depth);
+				out[0] = out[1] = out[2] = v * png->scale;
+				out[3] = 0xff;
+				if (png->numTrns >= 2 &&
+				    v == (depth == 16 ? trns[0] : trns[1])) {
+					out[3] = 0;
+				}
+				break;
+			case PNG_PALETTE:
+				v = pngSample(row, x, depth);
+				if (v >= png->numPalette) {
+					v = 0;
+				}
+				memcpy(out, &png->palette[v * 3], 3);
+				out[3] = v < png->numTrns ? trns[v] : 0xff;
+				break;
+			case PNG_GRAY_ALPHA:
+				out[0] = out[1] = out[2] =
+				    pngSample(row, x * 2, depth);
+				out[3] = pngSample(row, x * 2 + 1, depth);
+				break;
+			case PNG_RGB:
+				out[0] = pngSample(row, x * 3, depth);
+				out[1] = pngSample(row, x * 3 + 1, depth);
+				out[2] = pngSample(row, x * 3 + 2, depth);
+				out[3] = 0xff;
+				if (png->numTrns >= 6 &&
+				    out[0] == trns[depth == 16 ? 0 : 1] &&
+				    out[1] == trns[depth == 16 ? 2 : 3] &&
+				    out[2] == trns[depth == 16 ? 4 : 5]) {
+					out[3] = 0;
+				}
+				break;
+			case PNG_RGBA:
+				out[0] = pngSample(row, x * 4, depth);
+				out[1] = pngSample(row, x * 4 + 1, depth);
+				out[2] = pngSample(row, x * 4 + 2, depth);
+				out[3] = pngSample(row, x * 4 + 3, depth);
+				break;
+		}
+	}
+}
+
+/* image_DecodePNG decodes the len byte (non-interlaced) PNG file at data to
+ * img. The IDAT chunks are inflated from the mapped file one row at a time
+ * into a pair of pooled scanlines, which are unfiltered and expanded
+ * straight into the pixels of img. */
+bool image_DecodePNG(const uint8_t *data, size_t len, Image *img) {
+	uint8_t *lines, *row, *prior, *tmp, *out;
+	size_t p, stride, bpp, linesCap;
+	uint32_t h, y;
+	int channels, ret;
+	PngInfo png;
+	z_stream zs;
+	bool ended;
+
+	if (len < 8 + 25 || memcmp(data, pngSignature, 8) != 0 ||
+	    memcmp(data + 12, "IHDR", 4) != 0) {
+		return false;
+	}
+	memset(&png, 0, sizeof(png));
+	png.w = be32(data + 16);
+	h = be32(data + 20);
+	png.depth = data[24];
+	png.ctype = data[25];
+	if (data[28] != 0) {
+		puts("error: interlaced PNGs are not supported");
+		return false;
+	}
+	switch (png.ctype) {
+		case PNG_GRAY:
+		case PNG_PALETTE:
+			channels = 1;
+			break;
+		case PNG_GRAY_ALPHA:
+			channels = 2;
+			break;
+		case PNG_RGB:
+			channels = 3;
+			break;
+		case PNG_RGBA:
+			channels = 4;
+			break;
+		default:
+			return false;
+	}
+	if (png.depth != 1 && png.depth != 2 && png.depth != 4 &&
+	    png.depth != 8 && png.depth != 16) {
+		return false;
+	}
+	if (png.w == 0 || h == 0 || png.w > IMAGE_MAX_DIM ||
+	    h > IMAGE_MAX_DIM) {
+		return false;
+	}
+	png.scale = png.depth < 8 ? 255 / ((1 << png.depth) - 1) : 1;
+	stride = ((size_t)png.w * channels * png.depth + 7) / 8;
+	bpp = (channels * png.depth + 7) / 8;
+
+	/* each scanline is a filter type byte and stride bytes; the first
+	 * row is filtered against a row of 0s */
+	if ((lines = poolTake(2 * (stride + 1), &linesCap)) == NULL) {
+		return false;
+	}
+	if (!imageAlloc(img, png.w, h)) {
+		poolGive(lines, linesCap);
+		return false;
+	}
+	row = lines;
+	prior = lines + stride + 1;
+	memset(prior, 0, stride + 1);
+
+	memset(&zs, 0, sizeof(zs));
+	if (inflateInit(&zs) != Z_OK) {
+		poolGive(lines, linesCap);
+		image_Free(img);
+		return false;
+	}
+	zs.next_out = row;
+	zs.avail_out = stride + 1;
+
+	y = 0;
+	ended = false;
+	for (p = 8; p + 12 <= len && !ended && y < h;) {
+		uint32_t clen = be32(data + p);
+		const uint8_t *type = data + p + 4;
+		const uint8_t *cdata = data + p + 8;
+
+		if (clen > len - p - 12) {
+			break;
+		}
+		if (memcmp(type, "PLTE", 4) == 0) {
+			png.palette = cdata;
+			png.numPalette = clen / 3;
+		} else if (memcmp(type, "tRNS", 4) == 0) {
+			png.trns = cdata;
+			png.numTrns = clen;
+		} else if (memcmp(type, "IDAT", 4) == 0) {
+			/* PLTE and tRNS precede the image data */
+			if (png.ctype == PNG_PALETTE && png.palette == NULL) {
+				break;
+			}
+			zs.next_in = (Bytef *)cdata;
+			zs.avail_in = clen;
+			while (zs.avail_in > 0 && y < h) {
+				ret = inflate(&zs, Z_NO_FLUSH);
+				if (ret != Z_OK && ret != Z_STREAM_END) {
+					ended = true;
+					break;
+				}
+				if (zs.avail_out == 0) {
+					if (!unfilter(row + 1, prior + 1,
+						      stride, bpp, row[0])) {
+						ended = true;
+						break;
+					}
+					out = &img->pixels[(size_t)y++ *
+							   png.w * 4];
+					pngExpand(&png, row + 1, out);
+					tmp = prior;
+					prior = row;
+					row = tmp;
+					zs.next_out = row;
+					zs.avail_out = stride + 1;
+				}
+				if (ret == Z_STREAM_END) {
+					break;
+				}
+			}
+		} else if (memcmp(type, "IEND", 4) == 0) {
+			ended = true;
+		}
+		p += clen + 12;
+	}
+	inflateEnd(&zs);
+	poolGive(lines, linesCap);
+	if (y < h) {
+		puts("error: corrupt PNG");
+		image_Free(img);
+		return false;
+	}
+	return true;
+}
+
+/*****************************************************************************/
+/* BMP                                                                       */
+/*****************************************************************************/
+
+/* maskShift returns the shift of the lowest set bit of mask (0 if none) */
+static int maskShift(uint32_t mask) {
+	int s;
+
+	if (mask == 0) {
+		return 0;
+	}
+	for (s = 0; !(mask & (1u << s)); ++s)
+		;
+	return s;
+}
+
+/* maskChannel returns the field of pixel v under mask (whose lowest bit is
+ * at shift) scaled from the width of the mask to 8 bits; 0 if mask is 0 */
+static uint8_t maskChannel(uint32_t v, uint32_t mask, int shift) {
+	uint32_t max = mask >> shift;
+
+	if (mask == 0) {
+		return 0;
+	}
+	return ((uint64_t)((v & mask) >> shift) * 255 + max / 2) / max;
+}
+
+/* image_DecodeBMP decodes the len byte (uncompressed 8, 24 or 32-bit) BMP
+ * file at data to img. The channels of 32-bit bitfields are scaled from the
+ * width of their masks to 8 bits. */
+bool image_DecodeBMP(const uint8_t *data, size_t len, Image *img) {
+	uint32_t offset, hdrSz, comp, numColors, masks[4];
+	int32_t w, h;
+	uint32_t x, y, srcY;
+	int bitCount, shifts[4], i;
+	const uint8_t *palette;
+	bool topDown;
+	size_t stride;
+
+	if (len < 54 || data[0] != 'B' || data[1] != 'M') {
+		return false;
+	}
+	offset = le32(data + 10);
+	hdrSz = le32(data + 14);
+	w = (int32_t)le32(data + 18);
+	h = (int32_t)le32(data + 22);
+	bitCount = le16(data + 28);
+	comp = le32(data + 30);
+	numColors = le32(data + 46);
+
+	topDown = h < 0;
+	if (topDown) {
+		h = -h;
+	}
+	if (w <= 0 || h <= 0 || (comp != 0 && comp != 3) ||
+	    (bitCount != 8 && bitCount != 24 && bitCount != 32) ||
+	    (comp == 3 && bitCount != 32)) {
+		puts("error: unsupported BMP format");
+		return false;
+	}
+	stride = (((size_t)w * bitCount + 31) / 32) * 4;
+	if (offset > len || stride * h > len - offset) {
+		return false;
+	}
+
+	/* 32-bit pixels are BGRA unless bitfields say otherwise */
+	masks[0] = 0x00ff0000;
+	masks[1] = 0x0000ff00;
+	masks[2] = 0x000000ff;
+	masks[3] = 0;
+	if (comp == 3 && len >= 14 + 40 + 12) {
+		masks[0] = le32(data + 54);
+		masks[1] = le32(data + 58);
+		masks[2] = le32(data + 62);
+		masks[3] = hdrSz >= 56 ? le32(data + 66) : 0;
+	}
+	for (i = 0; i < 4; ++i) {
+		shifts[i] = maskShift(masks[i]);
+	}
+
+	palette = data + 14 + hdrSz;
+	if (numColors == 0 || numColors > 256) {
+		numColors = 256;
+	}
+	if (bitCount == 8 && (size_t)(palette - data) + numColors * 4 > len) {
+		return false;
+	}
+
+	if (!imageAlloc(img, w, h)) {
+		return false;
+	}
+	for (y = 0; y < (uint32_t)h; ++y) {
+		const uint8_t *row;
+		uint8_t *out;
+
+		srcY = topDown ? y : (uint32_t)h - 1 - y;
+		row = data + offset + srcY * stride;
+		out = &img->pixels[(size_t)y * w * 4];
+		for (x = 0; x < (uint32_t)w; ++x, out += 4) {
+			uint32_t v;
+			switch (bitCount) {
+				case 8:
+					v = row[x] < numColors ? row[x] : 0;
+					out[0] = palette[v * 4 + 2];
+					out[1] = palette[v * 4 + 1];
+					out[2] = palette[v * 4 + 0];
+					out[3] = 0xff;
+					break;
+				case 24:
+					out[0] = row[x * 3 + 2];
+					out[1] = row[x * 3 + 1];
+					out[2] = row[x * 3 + 0];
+					out[3] = 0xff;
+					break;
+				case 32:
+					v = le32(&row[x * 4]);
+					for (i = 0; i < 4; ++i) {
+						out[i] = maskChannel(
+						    v, masks[i], shifts[i]);
+					}
+					if (masks[3] == 0) {
+						out[3] = 0xff;
+					}
+					break;
+			}
+		}
+	}
+	return true;
+}
+
+/*****************************************************************************/
+
+/* cacheFile writes the path of the decoded-pixel cache entry for hash */
+static bool cacheFile(uint64_t hash, char *path, size_t sz) {
+	char name[32];
+
+	snprintf(name, sizeof(name), "%016llx.qoi", (unsigned long long)hash);
+	return cachePath("images", name, path, sz);
+}
+
+/* storeCache writes img to the decoded-pixel cache */
+static void storeCache(const Image *img, const char *path) {
+	char tmp[520];
+	uint8_t *qoi;
+	size_t len;
+	FILE *f;
+
+	if ((qoi = image_EncodeQOI(img, &len)) == NULL) {
+		return;
+	}
+	/* write to a temporary file first so readers never see partial
+	 * entries */
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+	if ((f = fopen(tmp, "wb")) != NULL) {
+		if (fwrite(qoi, 1, len, f) == len && fclose(f) == 0) {
+			rename(tmp, path);
+		} else {
+			remove(tmp);
+		}
+	}
+	free(qoi);
+}
+
+/* image_Load decodes file to img (with pixels from the image pool). The
+ * decoded pixels come from the cache if the file's contents were decoded
+ * before. Returns false if the file could not be decoded. */
+bool image_Load(const char *file, Image *img) {
+	const uint8_t *data, *cached;
+	size_t len, cachedLen;
+	char path[512];
+	bool ok, haveCache;
+
+	memset(img, 0, sizeof(Image));
+	if ((data = mapFile(file, &len)) == NULL) {
+		printf("error: failed to open image %s\n", file);
+		return false;
+	}
+	img->hash = contentHash(data, len);
+
+	if (len >= 4 && memcmp(data, "qoif", 4) == 0) {
+		ok = image_DecodeQOI(data, len, img);
+		unmapFile(data, len);
+		return ok;
+	}
+
+	haveCache = cacheFile(img->hash, path, sizeof(path));
+	if (haveCache && (cached = mapFile(path, &cachedLen)) != NULL) {
+		ok = image_DecodeQOI(cached, cachedLen, img);
+		unmapFile(cached, cachedLen);
+		if (ok) {
+			unmapFile(data, len);
+			return true;
+		}
+	}
+
+	if (len >= 8 && memcmp(data, pngSignature, 8) == 0) {
+		ok = image_DecodePNG(data, len, img);
+	} else if (len >= 2 && data[0] == 'B' && data[1] == 'M') {
+		ok = image_DecodeBMP(data, len, img);
+	} else {
+		printf("error: unrecognized image format %s\n", file);
+		ok = false;
+	}
+	unmapFile(data, len);
+
+	if (ok && haveCache) {
+		storeCache(img, path);
+	}
+	return ok;
+}
@@ -0,0 +1,31 @@
+/*
+ * image.h
+ * image decodes PNG, QOI and BMP files to RGBA8 pixels (rows top to bottom).
+ * Source files are memory-mapped and decoded straight into pooled buffers.
+ * Decoded pixels are cached on disk (QOI-compressed, keyed by a hash of the
+ * file's contents) so that reopening a document doesn't decode its images
+ * again.
+ */
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+	uint32_t w, h;
+	uint8_t *pixels; /* w * h RGBA8 pixels from the image pool */
+	size_t cap;      /* the capacity (in bytes) of pixels */
+	uint64_t hash;   /* the hash of the source file's contents */
+} Image;
+
+bool image_Load(const char *, Image *);
+void image_Free(Image *);
+
+bool image_DecodePNG(const uint8_t *, size_t, Image *);
+bool image_DecodeQOI(const uint8_t *, size_t, Image *);
+bool image_DecodeBMP(const uint8_t *, size_t, Image *);
+uint8_t *image_EncodeQOI(const Image *, size_t *);
+
+#endif
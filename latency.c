@@ -0,0 +1,213 @@
+#include "latency.h"
+#include <GL/glew.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "sched.h"
+
+/* how long to wait for a frame's fence (ns) */
+#define FENCE_TIMEOUT 100000000
+
+/* Trace is the time (sched_Now()) each stage was reached, 0 if not yet */
+typedef struct {
+	double t[LAT_NUM_STAGES];
+} Trace;
+
+static const char *stageNames[LAT_NUM_STAGES] = {
+    "input", "forward", "redraw", "apply", "submit", "swap", "gpu"};
+
+/* lat holds the traces in flight (oldest first) and the histograms */
+static struct {
+	bool enabled, fences;
+	Trace traces[LATENCY_MAX_TRACES];
+	uint32_t len;
+	uint32_t dropped;
+	LatencyHist hist[LAT_NUM_STAGES];
+} lat = {.enabled = true};
+
+/* latency_Enable turns tracing on or off. With fences, each frame waits for
+ * the GPU to finish it, which measures the whole pipeline but also
+ * serializes the CPU and GPU; it is meant for measurement runs only. */
+void latency_Enable(bool on, bool fences) {
+	lat.enabled = on;
+	lat.fences = on && fences;
+	lat.len = 0;
+}
+
+bool latency_Enabled() { return lat.enabled; }
+
+/* latency_Input opens a trace for an input event read at time t */
+void latency_Input(double t) {
+	Trace *tr;
+
+	if (!lat.enabled) {
+		return;
+	}
+	if (lat.len == LATENCY_MAX_TRACES) {
+		memmove(&lat.traces[0], &lat.traces[1],
+			(LATENCY_MAX_TRACES - 1) * sizeof(Trace));
+		lat.len--;
+		lat.dropped++;
+	}
+	tr = &lat.traces[lat.len++];
+	memset(tr, 0, sizeof(Trace));
+	tr->t[LAT_INPUT] = t;
+}
+
+/* waiting returns true if tr is waiting on stage */
+static bool waiting(const Trace *tr, uint32_t stage) {
+	if (tr->t[stage] != 0.0) {
+		return false;
+	}
+	switch (stage) {
+		case LAT_FORWARD:
+			return tr->t[LAT_SUBMIT] == 0.0;
+		case LAT_REDRAW:
+			return tr->t[LAT_FORWARD] != 0.0;
+		case LAT_APPLY:
+			return tr->t[LAT_REDRAW] != 0.0;
+		case LAT_SUBMIT:
+			/* forwarded input shows once the editor answered */
+			return tr->t[LAT_FORWARD] == 0.0 ||
+			       tr->t[LAT_APPLY] != 0.0;
+		default:
+			return tr->t[stage - 1] != 0.0;
+	}
+}
+
+/* add adds ms to histogram h */
+static void add(LatencyHist *h, double ms) {
+	uint32_t i = (uint32_t)(ms * 1000.0 / LATENCY_BUCKET_US);
+
+	h->counts[i < LATENCY_BUCKETS ? i : LATENCY_BUCKETS]++;
+	h->n++;
+	h->sum += ms;
+	h->max = ms > h->max ? ms : h->max;
+}
+
+/* complete records and removes every trace that reached stage last */
+static void complete(uint32_t last) {
+	uint32_t i, j, s;
+	Trace *tr;
+
+	for (i = j = 0; i < lat.len; ++i) {
+		tr = &lat.traces[i];
+		if (tr->t[last] == 0.0) {
+			lat.traces[j++] = *tr;
+			continue;
+		}
+		lat.hist[LAT_INPUT].n++;
+		for (s = LAT_INPUT + 1; s <= last; ++s) {
+			if (tr->t[s] != 0.0) {
+				add(&lat.hist[s],
+				    (tr->t[s] - tr->t[LAT_INPUT]) * 1000.0);
+			}
+		}
+	}
+	lat.len = j;
+}
+
+/* latency_Mark stamps the traces waiting on stage with the time */
+void latency_Mark(uint32_t stage) {
+	uint32_t i;
+	double now;
+
+	if (!lat.enabled || lat.len == 0 || stage >= LAT_NUM_STAGES) {
+		return;
+	}
+	now = sched_Now();
+	for (i = 0; i < lat.len; ++i) {
+		if (waiting(&lat.traces[i], stage)) {
+			lat.traces[i].t[stage] = now;
+		}
+	}
+}
+
+/* latency_Discard drops the traces waiting for a frame to be submitted,
+ * once none will be: their input changed nothing on screen */
+void latency_Discard() {
+	uint32_t i, j;
+
+	for (i = j = 0; i < lat.len; ++i) {
+		if (!waiting(&lat.traces[i], LAT_SUBMIT)) {
+			lat.traces[j++] = lat.traces[i];
+		}
+	}
+	lat.len = j;
+}
+
+/* latency_Swapped marks the frame just swapped as shown, completing the
+ * traces it carried */
+void latency_Swapped() {
+	GLsync fence;
+
+	if (!lat.enabled || lat.len == 0) {
+		return;
+	}
+	latency_Mark(LAT_SWAP);
+	if (!lat.fences) {
+		complete(LAT_SWAP);
+		return;
+	}
+	fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	if (fence != NULL) {
+		glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+				 FENCE_TIMEOUT);
+		glDeleteSync(fence);
+	}
+	latency_Mark(LAT_GPU);
+	complete(LAT_GPU);
+}
+
+/* latency_Hist returns the histogram of the time from input to stage */
+const LatencyHist *latency_Hist(uint32_t stage) {
+	return stage < LAT_NUM_STAGES ? &lat.hist[stage] : NULL;
+}
+
+/* latency_Percentile returns the p-th (0-1) percentile of the time (ms) from
+ * input to stage, to the resolution of the histogram */
+double latency_Percentile(uint32_t stage, double p) {
+	const LatencyHist *h;
+	uint32_t i, n, target;
+	double edge;
+
+	if ((h = latency_Hist(stage)) == NULL || h->n == 0) {
+		return 0.0;
+	}
+	target = (uint32_t)ceil(p * h->n);
+	target = target ? target : 1;
+	for (i = n = 0; i < LATENCY_BUCKETS; ++i) {
+		if ((n += h->counts[i]) >= target) {
+			edge = (i + 1) * LATENCY_BUCKET_US / 1000.0;
+			return edge < h->max ? edge : h->max;
+		}
+	}
+	return h->max;
+}
+
+/* latency_Reset clears the histograms and drops the traces in flight */
+void latency_Reset() {
+	memset(lat.hist, 0, sizeof(lat.hist));
+	lat.len = 0;
+	lat.dropped = 0;
+}
+
+/* latency_Report prints the percentiles of each stage reached */
+void latency_Report() {
+	const LatencyHist *h;
+	uint32_t s;
+
+	printf("latency: %u inputs shown, %u dropped\n", lat.hist[LAT_INPUT].n,
+	       lat.dropped);
+	for (s = LAT_INPUT + 1; s < LAT_NUM_STAGES; ++s) {
+		h = &lat.hist[s];
+		if (h->n == 0) {
+			continue;
+		}
+		printf("latency: %-7s mean %6.2f p50 %6.2f p90 %6.2f "
+		       "p99 %6.2f max %6.2f ms\n",
+		       stageNames[s], h->sum / h->n,
+		       latency_Percentile(s, 0.5), latency_Percentile(s, 0.9),
+		       latency_Percentile(s, 0.99), h->max);
+	}
+}
@@ -0,0 +1,54 @@
+/*
+ * latency.h
+ * latency traces input to photon. Each input event opens a trace stamped
+ * with the time it was read (sched_Now()); each stage of the pipeline the
+ * input passes through stamps the traces waiting on it. Once a trace reaches
+ * the screen (the swap returning, or the GPU finishing the frame if fences
+ * are enabled) the time from input to each stage is added to that stage's
+ * histogram.
+ * Input forwarded to the editor waits for the editor's redraw to be applied
+ * before a frame can show it; other input is shown by the next frame. Input
+ * that damages nothing is never shown, and its trace is discarded.
+ */
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* The stages of the pipeline, in order */
+enum { LAT_INPUT = 0, /* the event was read */
+       LAT_FORWARD,   /* it was sent to the editor */
+       LAT_REDRAW,    /* the editor's resulting redraw batch arrived */
+       LAT_APPLY,     /* the batch was applied to the grids */
+       LAT_SUBMIT,    /* the frame was submitted to GL */
+       LAT_SWAP,      /* the swap returned */
+       LAT_GPU,       /* the GPU finished the frame (fences only) */
+       LAT_NUM_STAGES };
+
+/* the histogram resolution and range: 0.1 ms buckets up to 100 ms */
+enum { LATENCY_BUCKET_US = 100, LATENCY_BUCKETS = 1000 };
+
+/* the most traces in flight; the oldest is dropped to open another */
+enum { LATENCY_MAX_TRACES = 64 };
+
+/* LatencyHist is a histogram of the time from input to one stage */
+typedef struct {
+	uint32_t counts[LATENCY_BUCKETS + 1]; /* the last counts overflows */
+	uint32_t n;
+	double sum, max; /* ms */
+} LatencyHist;
+
+void latency_Enable(bool, bool);
+bool latency_Enabled();
+void latency_Input(double);
+void latency_Mark(uint32_t);
+void latency_Discard();
+void latency_Swapped();
+
+const LatencyHist *latency_Hist(uint32_t);
+double latency_Percentile(uint32_t, double);
+void latency_Reset();
+void latency_Report();
+
+#endif
@@ -1,26 +1,204 @@
 #include <SDL2/SDL.h>
 #include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
 #include "gled.h"
+#include "latency.h"
+#include "mem.h"
+#include "replay.h"
+#include "rsrcdb.h"
+#include "sched.h"
 
-int main() {
-	bool run;
+/* how long a replay keeps running after its last event (ms) */
+enum { REPLAY_DRAIN_MS = 500, REPLAY_POLL_MS = 10 };
+
+/* isInput returns true for the events that open a latency trace */
+static bool isInput(const SDL_Event *evt) {
+	switch (evt->type) {
+		case SDL_KEYDOWN:
+		case SDL_KEYUP:
+		case SDL_TEXTINPUT:
+		case SDL_MOUSEBUTTONDOWN:
+		case SDL_MOUSEBUTTONUP:
+		case SDL_MOUSEWHEEL:
+			return true;
+		default:
+			return false;
+	}
+}
+
+/* usage:
+ *   gled [--record FILE] [--replay FILE] [--fences] [--rsrc FILE]
+ *        [--session FILE] [--hud] [--budget TAG.DOMAIN=MIB]...
+ *   gled --compile-rsrc SRC DST
+ * --rsrc opens the compiled resource database FILE. --session restores the
+ * window from the snapshot FILE (if there is one) and saves it there on exit.
+ * --compile-rsrc compiles the text resource database SRC to DST and exits.
+ * --record saves the input events to FILE. --replay plays FILE back, standing
+ * in for the editor by redrawing on every event, then prints the latency of
+ * each stage and exits.
+ * --fences times frames to GPU completion. --hud shows the memory used by
+ * each subsystem. --budget warns when a subsystem (window, grids, glyphs,
+ * images, meshes or post) uses more than MIB MiB of cpu or gpu memory, e.g.
+ * --budget meshes.gpu=256. Over their budgets, meshes and images also evict
+ * the resources of the blocks drawn least recently; their gpu budgets
+ * default to WINDOW_MESH_BUDGET and WINDOW_IMAGE_BUDGET.
+ */
+int main(int argc, char **argv) {
+	bool run, resized, input, got, replaying, fences, hud;
+	const char *record, *play, *rsrc, *session;
 	SDL_Event evt;
+	int32_t timeout, next, w = 0, h = 0;
+	uint32_t drainUntil = 0;
+	int i;
 
-	gled_init();
+	record = play = rsrc = session = NULL;
+	fences = hud = false;
+	mem_SetBudget(MEM_MESHES, MEM_GPU,
+		      (size_t)WINDOW_MESH_BUDGET * 1024 * 1024);
+	mem_SetBudget(MEM_IMAGES, MEM_GPU,
+		      (size_t)WINDOW_IMAGE_BUDGET * 1024 * 1024);
+	for (i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+			record = argv[++i];
+		} else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+			play = argv[++i];
+		} else if (strcmp(argv[i], "--fences") == 0) {
+			fences = true;
+		} else if (strcmp(argv[i], "--rsrc") == 0 && i + 1 < argc) {
+			rsrc = argv[++i];
+		} else if (strcmp(argv[i], "--session") == 0 && i + 1 < argc) {
+			session = argv[++i];
+		} else if (strcmp(argv[i], "--hud") == 0) {
+			hud = true;
+		} else if (strcmp(argv[i], "--budget") == 0 && i + 1 < argc &&
+			   mem_ParseBudget(argv[i + 1])) {
+			++i;
+		} else if (strcmp(argv[i], "--compile-rsrc") == 0 &&
+			   i + 2 < argc) {
+			return rsrcdb_Compile(argv[i + 1], argv[i + 2]) ? 0 : 1;
+		} else {
+			printf("usage: %s [--record FILE] [--replay FILE] "
+			       "[--fences] [--rsrc FILE] [--session FILE]\n"
+			       "       [--hud] [--budget TAG.DOMAIN=MIB]...\n"
+			       "       %s --compile-rsrc SRC DST\n",
+			       argv[0], argv[0]);
+			return 1;
+		}
+	}
+
+	if (gled_init() != 0) {
+		return 1;
+	}
+	if (rsrc != NULL && !gled_open_resources(rsrc)) {
+		return 1;
+	}
+	/* a stale or invalid snapshot is only reported: the editor redraws
+	 * the window anyway */
+	if (session != NULL && access(session, F_OK) == 0) {
+		gled_restore_snapshot(session);
+	}
+	gled_show_hud(hud);
+	latency_Enable(true, fences);
+	if (record != NULL && !replay_Record(record)) {
+		return 1;
+	}
+	replaying = play != NULL;
+	if (replaying && !replay_Load(play)) {
+		return 1;
+	}
 
 	for (run = true; run;) {
+		/* sleep until input arrives or the next frame is due */
+		timeout = gled_timeout();
+		if (replaying) {
+			next = replay_Pump();
+			if (next < 0) {
+				/* poll while the last frames drain */
+				next = REPLAY_POLL_MS;
+			}
+			if (timeout < 0 || next < timeout) {
+				timeout = next;
+			}
+		}
+		got = false;
+		if (timeout < 0) {
+			got = SDL_WaitEvent(&evt);
+		} else if (timeout > 0) {
+			got = SDL_WaitEventTimeout(&evt, timeout);
+		}
+
 		/* get input */
-		while (SDL_PollEvent(&evt)) {
+		resized = input = false;
+		while (got || SDL_PollEvent(&evt)) {
+			got = false;
+			if (isInput(&evt)) {
+				input = true;
+				latency_Input(sched_Now());
+				replay_Save(&evt);
+				if (replaying) {
+					gled_damage();
+				}
+			}
 			switch (evt.type) {
 				case SDL_QUIT:
 					run = false;
 					break;
+				case SDL_MOUSEBUTTONDOWN:
+					gled_onmousepress(evt.button.x,
+							  evt.button.y,
+							  evt.button.button);
+					break;
+				case SDL_MOUSEBUTTONUP:
+					gled_onmouserelease(evt.button.x,
+							    evt.button.y,
+							    evt.button.button);
+					break;
+				case SDL_MOUSEMOTION:
+					gled_onmousemove(evt.motion.x,
+							 evt.motion.y);
+					break;
+				case SDL_WINDOWEVENT:
+					if (evt.window.event ==
+					    SDL_WINDOWEVENT_SIZE_CHANGED) {
+						resized = true;
+						w = evt.window.data1;
+						h = evt.window.data2;
+					}
+					break;
 				default:
 					break;
 			}
 		}
 
+		/* a drag produces many size changes: only the last is drawn */
+		if (resized && w > 0 && h > 0) {
+			gled_onresize(w, h);
+		} else if (timeout == 0) {
+			gled_update();
+		} else if (input && gled_timeout() < 0) {
+			/* no frame is coming: the update closes the traces */
+			gled_update();
+		}
+
 		/* handle nvim events */
+
+		/* a replay ends once its last frames have been shown */
+		if (replaying && !replay_Playing()) {
+			if (drainUntil == 0) {
+				drainUntil = SDL_GetTicks() + REPLAY_DRAIN_MS;
+			} else if (SDL_GetTicks() >= drainUntil) {
+				run = false;
+			}
+		}
+	}
+	if (replaying) {
+		latency_Report();
+	}
+	replay_Close();
+	if (session != NULL) {
+		gled_save_snapshot(session);
 	}
 	gled_quit();
 	return 0;
@@ -0,0 +1,345 @@
+#include "material.h"
+#include <stdio.h>
+#include <string.h>
+#include "glstate.h"
+#include "util.h"
+
+static const GLchar quadVs[] =
+    "#version 150\n"
+    "in vec2 pos;\n"
+    "in vec2 texco;\n"
+    "out vec2 out_texco;\n"
+    "uniform mat4 mv, proj;\n"
+    "void main()\n"
+    "{\n"
+    "  out_texco = texco;\n"
+    "  gl_Position = proj * mv * vec4(pos, 0.0, 1.0);\n"
+    "}\n";
+
+/* quads are drawn with premultiplied alpha; textures are straight alpha
+ * unless PREMULTIPLIED */
+static const GLchar quadFs[] =
+    "#version 150\n"
+    "in vec2 out_texco;\n"
+    "out vec4 out_color;\n"
+    "uniform sampler2D tex;\n"
+    "uniform vec4 tint;\n"
+    "#ifdef SDF\n"
+    "uniform vec4 color;\n"
+    "uniform float weight;\n"
+    "#endif\n"
+    "#if defined(OUTLINE) || defined(GLOW)\n"
+    "uniform vec4 outline;\n"
+    "uniform float outlineWidth, glowWidth;\n"
+    "#endif\n"
+    "void main()\n"
+    "{\n"
+    "#ifdef SDF\n"
+    "  float d = texture(tex, out_texco).r + weight;\n"
+    "  float aa = 0.75 * fwidth(d);\n"
+    "  float a = smoothstep(0.5 - aa, 0.5 + aa, d);\n"
+    "  vec4 c = vec4(color.rgb * a, color.a * a);\n"
+    "#ifdef OUTLINE\n"
+    "  float edge = 0.5 - outlineWidth;\n"
+    "  float o = smoothstep(edge - aa, edge + aa, d);\n"
+    "  c += vec4(outline.rgb * o, outline.a * o) * (1.0 - a);\n"
+    "#endif\n"
+    "#ifdef GLOW\n"
+    "  float g = clamp((d - 0.5 + glowWidth) / max(glowWidth, 1e-4),\n"
+    "                  0.0, 1.0);\n"
+    "  c += vec4(outline.rgb * g * g, outline.a * g * g) * (1.0 - c.a);\n"
+    "#endif\n"
+    "#else\n"
+    "  vec4 c = texture(tex, out_texco);\n"
+    "#ifndef PREMULTIPLIED\n"
+    "  c.rgb *= c.a;\n"
+    "#endif\n"
+    "#endif\n"
+    "  out_color = vec4(c.rgb * tint.rgb, c.a) * tint.a;\n"
+    "}\n";
+
+static const GLchar meshVs[] =
+    "#version 150\n"
+    "in vec3 pos;\n"
+    "in vec4 normal;\n"
+    "in vec4 color;\n"
+    "in vec2 texco;\n"
+    "out vec4 out_co;\n"
+    "out vec3 out_normal;\n"
+    "out vec2 out_texco;\n"
+    "uniform mat4 mv, proj;\n"
+    "void main()\n"
+    "{\n"
+    "  out_co = color;\n"
+    "  out_normal = normal.xyz;\n"
+    "  out_texco = texco;\n"
+    "  gl_Position = proj * mv * vec4(pos, 1.0);\n"
+    "}\n";
+
+static const GLchar meshFs[] =
+    "#version 150\n"
+    "in vec4 out_co;\n"
+    "in vec3 out_normal;\n"
+    "in vec2 out_texco;\n"
+    "out vec4 out_color;\n"
+    "uniform sampler2D tex;\n"
+    "uniform vec3 light;\n"
+    "void main()\n"
+    "{\n"
+    "  vec4 c = out_co;\n"
+    "#ifdef TEXTURED\n"
+    "  c *= texture(tex, out_texco);\n"
+    "#endif\n"
+    "#ifdef LIT\n"
+    "  float l = max(dot(normalize(out_normal), normalize(light)), 0.0);\n"
+    "  c.rgb *= 0.2 + 0.8 * l;\n"
+    "#endif\n"
+    "  out_color = c;\n"
+    "}\n";
+
+/* the #define of each feature, by bit */
+static const char *featureDefines[MATERIAL_NUM_FEATURES] = {
+    "#define SDF 1\n", "#define OUTLINE 1\n", "#define GLOW 1\n",
+    "#define TEXTURED 1\n", "#define LIT 1\n", "#define PREMULTIPLIED 1\n"};
+
+static const char *quadAttrs[] = {"pos", "texco"};
+static const char *meshAttrs[] = {"pos", "normal", "color", "texco"};
+
+/* sources holds the shader source of each vertex format */
+static const struct {
+	const GLchar *vs, *fs;
+	const char **attrs;
+	int numAttrs;
+} sources[MATERIAL_NUM_FORMATS] = {{quadVs, quadFs, quadAttrs, 2},
+				   {meshVs, meshFs, meshAttrs, 4}};
+
+/* MaterialProgram is a built permutation and the uniform values it was last
+ * given, so that unchanged uniforms are never uploaded again */
+typedef struct {
+	GLuint program;
+	GLint mv, proj, tint, weight, color, outline, outlineWidth, glowWidth,
+	    light;
+
+	uint32_t matrices; /* serial of the format's matrices last uploaded */
+	uint32_t material; /* the material last uploaded */
+	float tint_[4];
+	float weight_;
+} MaterialProgram;
+
+static MaterialProgram programs[MATERIAL_NUM_KEYS];
+
+/* matrices holds the transform of each vertex format */
+static struct {
+	Mat4x4 mv, proj;
+	uint32_t serial;
+} matrices[MATERIAL_NUM_FORMATS];
+
+/* materials holds every created material; 0 is the default */
+static Material materials[MATERIAL_MAX] = {
+    {.color = {200.0f / 255.0f, 1.0f, 1.0f, 0.5f},
+     .outline = {0.0f, 0.0f, 0.0f, 1.0f},
+     .light = {0.0f, 0.0f, 1.0f}}};
+static uint32_t numMaterials = 1;
+
+/* defines returns the #define block of the features of key */
+static void defines(uint32_t key, char *buf, size_t size) {
+	uint32_t i;
+
+	buf[0] = '\0';
+	for (i = 0; i < MATERIAL_NUM_FEATURES; ++i) {
+		if (key & (1u << i)) {
+			strncat(buf, featureDefines[i], size - strlen(buf) - 1);
+		}
+	}
+}
+
+/* prefetch starts building the program of key in the background */
+static void prefetch(uint32_t key) {
+	uint32_t format = key >> MATERIAL_NUM_FEATURES;
+	char buf[128];
+
+	if (programs[key].program != 0) {
+		return;
+	}
+	defines(key, buf, sizeof(buf));
+	prefetchShader(sources[format].vs, sources[format].fs, buf,
+		       sources[format].numAttrs, sources[format].attrs);
+}
+
+/* build builds the program of key and looks up its uniforms */
+static bool build(MaterialProgram *p, uint32_t key) {
+	uint32_t format = key >> MATERIAL_NUM_FEATURES;
+	char buf[128];
+	GLuint s;
+
+	defines(key, buf, sizeof(buf));
+	s = loadShaderDefines(sources[format].vs, sources[format].fs, buf,
+			      sources[format].numAttrs, sources[format].attrs);
+	if (s == 0) {
+		printf("error: failed to build material program %x\n", key);
+		return false;
+	}
+	p->program = s;
+	p->mv = glGetUniformLocation(s, "mv");
+	p->proj = glGetUniformLocation(s, "proj");
+	p->tint = glGetUniformLocation(s, "tint");
+	p->weight = glGetUniformLocation(s, "weight");
+	p->color = glGetUniformLocation(s, "color");
+	p->outline = glGetUniformLocation(s, "outline");
+	p->outlineWidth = glGetUniformLocation(s, "outlineWidth");
+	p->glowWidth = glGetUniformLocation(s, "glowWidth");
+	p->light = glGetUniformLocation(s, "light");
+
+	glstate_UseProgram(s);
+	glUniform1i(glGetUniformLocation(s, "tex"), 0);
+	glUniform4f(p->tint, 1.0f, 1.0f, 1.0f, 1.0f);
+	glUniform1f(p->weight, 0.0f);
+	p->tint_[0] = p->tint_[1] = p->tint_[2] = p->tint_[3] = 1.0f;
+	p->weight_ = 0.0f;
+	p->matrices = 0;
+	p->material = UINT32_MAX;
+	return true;
+}
+
+/* material_New creates a material (a copy of m) and starts building the
+ * programs it uses. Returns its id or 0 on failure. */
+uint32_t material_New(const Material *m) {
+	uint32_t id;
+
+	if (numMaterials >= MATERIAL_MAX) {
+		puts("error: too many materials");
+		return 0;
+	}
+	id = numMaterials++;
+	materials[id] = *m;
+
+	if (m->features & (MATERIAL_OUTLINE | MATERIAL_GLOW)) {
+		prefetch(material_Key(MATERIAL_QUAD, MATERIAL_SDF, id));
+	}
+	if (m->features & MATERIAL_MESH_FEATURES) {
+		prefetch(material_Key(MATERIAL_MESH, 0, id));
+	}
+	return id;
+}
+
+/* material_Get returns the material id (the default if there is none) */
+const Material *material_Get(uint32_t id) {
+	return &materials[id < numMaterials ? id : 0];
+}
+
+/* material_Key returns the program key of a draw in format with the given
+ * features and material. Features that don't apply to the draw (such as an
+ * outline of a draw that is not a distance field) are dropped. */
+uint32_t material_Key(uint32_t format, uint32_t features, uint32_t id) {
+	/* only the draw decides whether it is a distance field */
+	features |= material_Get(id)->features & ~MATERIAL_SDF;
+	if (format == MATERIAL_QUAD) {
+		if (features & MATERIAL_SDF) {
+			features &= MATERIAL_QUAD_FEATURES;
+		} else {
+			features = 0;
+		}
+	} else {
+		features &= MATERIAL_MESH_FEATURES;
+	}
+	return MATERIAL_KEY(format, features);
+}
+
+/* material_Warmup starts building the default programs ahead of the first
+ * draw */
+void material_Warmup() {
+	prefetch(MATERIAL_KEY(MATERIAL_QUAD, 0));
+	prefetch(MATERIAL_KEY(MATERIAL_QUAD, MATERIAL_SDF));
+	prefetch(MATERIAL_KEY(MATERIAL_QUAD, MATERIAL_PREMULTIPLIED));
+	prefetch(MATERIAL_KEY(MATERIAL_MESH, 0));
+}
+
+/* material_Ready returns true if the program of key can be made current
+ * without waiting on the driver: it is built, or is not being built in the
+ * background. Draws may be put off to a later frame until it is. */
+bool material_Ready(uint32_t key) {
+	uint32_t format = key >> MATERIAL_NUM_FEATURES;
+	char buf[128];
+
+	if (programs[key].program != 0) {
+		return true;
+	}
+	defines(key, buf, sizeof(buf));
+	return !shaderPending(sources[format].vs, sources[format].fs, buf,
+			      sources[format].numAttrs, sources[format].attrs);
+}
+
+/* material_SetMatrices sets the transform of every program of format */
+void material_SetMatrices(uint32_t format, const Mat4x4 *proj,
+			  const Mat4x4 *mv) {
+	matrices[format].proj = *proj;
+	matrices[format].mv = *mv;
+	matrices[format].serial++;
+}
+
+/* material_Use makes the program of key current with the parameters of
+ * material id, building it if needed. Returns the program (0 on failure). */
+GLuint material_Use(uint32_t key, uint32_t id) {
+	MaterialProgram *p = &programs[key];
+	uint32_t format = key >> MATERIAL_NUM_FEATURES;
+	const Material *m;
+
+	if (p->program == 0 && !build(p, key)) {
+		return 0;
+	}
+	glstate_UseProgram(p->program);
+	if (p->matrices != matrices[format].serial) {
+		p->matrices = matrices[format].serial;
+		glUniformMatrix4fv(p->mv, 1, GL_FALSE,
+				   (GLfloat *)&matrices[format].mv);
+		glUniformMatrix4fv(p->proj, 1, GL_FALSE,
+				   (GLfloat *)&matrices[format].proj);
+	}
+	if (p->material != id) {
+		p->material = id;
+		m = material_Get(id);
+		glUniform4fv(p->color, 1, m->color);
+		glUniform4fv(p->outline, 1, m->outline);
+		glUniform1f(p->outlineWidth, m->outlineWidth);
+		glUniform1f(p->glowWidth, m->glowWidth);
+		glUniform3fv(p->light, 1, m->light);
+	}
+	return p->program;
+}
+
+/* material_SetDraw sets the per-draw tint and distance field weight of the
+ * (current) program of key */
+void material_SetDraw(uint32_t key, const float *tint, float weight) {
+	MaterialProgram *p = &programs[key];
+
+	if (memcmp(p->tint_, tint, sizeof(p->tint_)) != 0) {
+		memcpy(p->tint_, tint, sizeof(p->tint_));
+		glUniform4fv(p->tint, 1, tint);
+	}
+	if (p->weight_ != weight) {
+		p->weight_ = weight;
+		glUniform1f(p->weight, weight);
+	}
+}
+
+/* material_NumPrograms returns the number of programs built */
+uint32_t material_NumPrograms() {
+	uint32_t i, n;
+
+	for (i = n = 0; i < MATERIAL_NUM_KEYS; ++i) {
+		n += programs[i].program != 0;
+	}
+	return n;
+}
+
+/* material_Free deletes every program */
+void material_Free() {
+	uint32_t i;
+
+	for (i = 0; i < MATERIAL_NUM_KEYS; ++i) {
+		if (programs[i].program != 0) {
+			glstate_DeleteProgram(programs[i].program);
+		}
+	}
+	memset(programs, 0, sizeof(programs));
+}
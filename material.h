@@ -0,0 +1,65 @@
+/*
+ * material.h
+ * Materials describe how runes and meshes are shaded. Every program is a
+ * permutation of one shader source per vertex format, selected by the
+ * feature #defines of its key; programs are built once per key (and
+ * prefetched when a material is created) and cached. Draws are sorted by
+ * key so that each program is made current once per frame.
+ */
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include <GL/glew.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "matrix.h"
+
+/* Material features; each enables a #define of the shader source */
+enum { MATERIAL_SDF = 1,      /* quads: tex is a glyph distance field */
+       MATERIAL_OUTLINE = 2,  /* quads (SDF): outline the glyph */
+       MATERIAL_GLOW = 4,     /* quads (SDF): soft glow around the glyph */
+       MATERIAL_TEXTURED = 8, /* meshes: modulate by tex */
+       MATERIAL_LIT = 16,     /* meshes: diffuse lighting */
+       MATERIAL_PREMULTIPLIED = 32, /* quads: tex has premultiplied alpha */
+       MATERIAL_NUM_FEATURES = 6 };
+
+/* The features that apply to each vertex format */
+enum { MATERIAL_QUAD_FEATURES = MATERIAL_SDF | MATERIAL_OUTLINE |
+				MATERIAL_GLOW,
+       MATERIAL_MESH_FEATURES = MATERIAL_TEXTURED | MATERIAL_LIT };
+
+/* The vertex formats (and shader sources) of materials */
+enum { MATERIAL_QUAD = 0, MATERIAL_MESH = 1, MATERIAL_NUM_FORMATS };
+
+/* the most materials that may be created */
+enum { MATERIAL_MAX = 256 };
+
+/* MATERIAL_KEY is the program key of a set of features in format */
+#define MATERIAL_KEY(format, features) \
+	((uint32_t)(format) << MATERIAL_NUM_FEATURES | (features))
+enum { MATERIAL_NUM_KEYS = MATERIAL_NUM_FORMATS << MATERIAL_NUM_FEATURES };
+
+/* Material holds the features and parameters of a material. Material 0 is
+ * the default: no features beyond those of the draw itself. */
+typedef struct {
+	uint32_t features; /* MATERIAL_* */
+	float color[4];    /* SDF fill color */
+	float outline[4];  /* outline and glow color */
+	float outlineWidth; /* in distance field units (0 to 0.5) */
+	float glowWidth;    /* in distance field units (0 to 0.5) */
+	float light[3];     /* MATERIAL_LIT: direction towards the light */
+} Material;
+
+uint32_t material_New(const Material *);
+const Material *material_Get(uint32_t);
+uint32_t material_Key(uint32_t, uint32_t, uint32_t);
+
+void material_Warmup();
+bool material_Ready(uint32_t);
+void material_SetMatrices(uint32_t, const Mat4x4 *, const Mat4x4 *);
+GLuint material_Use(uint32_t, uint32_t);
+void material_SetDraw(uint32_t, const float *, float);
+uint32_t material_NumPrograms();
+void material_Free();
+
+#endif
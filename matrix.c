@@ -1,27 +1,45 @@
 #include "matrix.h"
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#endif
 
 const Mat4x4 Mat4x4Identity = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
 
 /*****************************************************************************/
-static Mat4x4 matrix_stack[MATRIX_STACK_SIZE * 16];
-static int matrix_sp = 0;
+/* each thread has its own stack */
+#if defined(__GNUC__)
+#define MATRIX_THREAD_LOCAL __thread
+#else
+#define MATRIX_THREAD_LOCAL
+#endif
+static MATRIX_THREAD_LOCAL Mat4x4 matrix_stack[MATRIX_STACK_SIZE];
+static MATRIX_THREAD_LOCAL int matrix_sp = 0;
 
 /******************************************************************************
  * mat4x4_push
+ * Returns false (and pushes nothing) if the stack is full.
 ******************************************************************************/
-void mat4x4_push(Mat4x4 *mat) {
-	memcpy(&matrix_stack[matrix_sp], mat, sizeof(Mat4x4));
-	++matrix_sp;
+bool mat4x4_push(Mat4x4 *mat) {
+	if (matrix_sp >= MATRIX_STACK_SIZE) {
+		puts("error: matrix stack overflow");
+		return false;
+	}
+	matrix_stack[matrix_sp++] = *mat;
+	return true;
 }
 /******************************************************************************
  * mat4x4_pop
+ * Returns false (and leaves mat unchanged) if the stack is empty.
 ******************************************************************************/
-void mat4x4_pop(Mat4x4 *mat) {
-	--matrix_sp;
-	if (matrix_sp < 0) {
-		return;
+bool mat4x4_pop(Mat4x4 *mat) {
+	if (matrix_sp <= 0) {
+		puts("error: matrix stack underflow");
+		return false;
 	}
-	memcpy(mat, &matrix_stack[matrix_sp], sizeof(Mat4x4));
+	*mat = matrix_stack[--matrix_sp];
+	return true;
 }
 /******************************************************************************
  * mat4x4_load_identity
@@ -68,12 +86,13 @@ void mat4x4_perspective(Mat4x4 *mat, float fov, float aspect, float zNear,
  * mat4x4_translate
 ******************************************************************************/
 void mat4x4_translate(Mat4x4 *mat, float x, float y, float z) {
-	Mat4x4 tmat;
+	Mat4x4 tmat, res;
 	mat4x4_load_identity(&tmat);
 	tmat.a3 = x;
 	tmat.b3 = y;
 	tmat.c3 = z;
-	*mat = mat4x4_multiply(*mat, tmat);
+	mat4x4_multiply_to(&res, mat, &tmat);
+	*mat = res;
 }
 /******************************************************************************
  * mat4x4_scale
@@ -87,7 +106,7 @@ void mat4x4_scale(Mat4x4 *mat, float x, float y, float z) {
  * mat4x4_rotate
 ******************************************************************************/
 void mat4x4_rotate(Mat4x4 *mat, float angle, float x, float y, float z) {
-	Mat4x4 r_mat;
+	Mat4x4 r_mat, res;
 	/* get the cosine and sine of the angle (convert angle to radians first)
 	 */
 	float c = cos(angle * 0.0174532925f);
@@ -111,7 +130,8 @@ void mat4x4_rotate(Mat4x4 *mat, float angle, float x, float y, float z) {
 	r_mat.d1 = 0.0f;
 	r_mat.d2 = 0.0f;
 	r_mat.d3 = 1.0f;
-	*mat = mat4x4_multiply(*mat, r_mat);
+	mat4x4_multiply_to(&res, mat, &r_mat);
+	*mat = res;
 }
 /******************************************************************************
  * mat4x4_orthographic
@@ -143,61 +163,134 @@ void mat4x4_orthographic(Mat4x4 *mat, float left, float right, float top,
 ******************************************************************************/
 Mat4x4 mat4x4_multiply(Mat4x4 mat1, Mat4x4 mat2) {
 	Mat4x4 res;
-	res.a0 = mat1.a0 * mat2.a0 + mat1.a1 * mat2.b0 + mat1.a2 * mat2.c0 +
-		 mat1.a3 * mat2.d0;
-	res.a1 = mat1.a0 * mat2.a1 + mat1.a1 * mat2.b1 + mat1.a2 * mat2.c1 +
-		 mat1.a3 * mat2.d1;
-	res.a2 = mat1.a0 * mat2.a2 + mat1.a1 * mat2.b2 + mat1.a2 * mat2.c2 +
-		 mat1.a3 * mat2.d2;
-	res.a3 = mat1.a0 * mat2.a3 + mat1.a1 * mat2.b3 + mat1.a2 * mat2.c3 +
-		 mat1.a3 * mat2.d3;
-	res.b0 = mat1.b0 * mat2.a0 + mat1.b1 * mat2.b0 + mat1.b2 * mat2.c0 +
-		 mat1.b3 * mat2.d0;
-	res.b1 = mat1.b0 * mat2.a1 + mat1.b1 * mat2.b1 + mat1.b2 * mat2.c1 +
-		 mat1.b3 * mat2.d1;
-	res.b2 = mat1.b0 * mat2.a2 + mat1.b1 * mat2.b2 + mat1.b2 * mat2.c2 +
-		 mat1.b3 * mat2.d2;
-	res.b3 = mat1.b0 * mat2.a3 + mat1.b1 * mat2.b3 + mat1.b2 * mat2.c3 +
-		 mat1.b3 * mat2.d3;
-	res.c0 = mat1.b0 * mat2.a0 + mat1.c1 * mat2.b0 + mat1.c2 * mat2.c0 +
-		 mat1.c3 * mat2.d0;
-	res.c1 = mat1.c0 * mat2.a1 + mat1.c1 * mat2.b1 + mat1.c2 * mat2.c1 +
-		 mat1.c3 * mat2.d1;
-	res.c2 = mat1.c0 * mat2.a2 + mat1.c1 * mat2.b2 + mat1.c2 * mat2.c2 +
-		 mat1.c3 * mat2.d2;
-	res.c3 = mat1.c0 * mat2.a3 + mat1.c1 * mat2.b3 + mat1.c2 * mat2.c3 +
-		 mat1.c3 * mat2.d3;
-	res.d0 = mat1.d0 * mat2.a0 + mat1.d1 * mat2.b0 + mat1.d2 * mat2.c0 +
-		 mat1.d3 * mat2.d0;
-	res.d1 = mat1.d0 * mat2.a1 + mat1.d1 * mat2.b1 + mat1.d2 * mat2.c1 +
-		 mat1.d3 * mat2.d1;
-	res.d2 = mat1.d0 * mat2.a2 + mat1.d1 * mat2.b2 + mat1.d2 * mat2.c2 +
-		 mat1.d3 * mat2.d2;
-	res.d3 = mat1.d0 * mat2.a3 + mat1.d1 * mat2.b3 + mat1.d2 * mat2.c3 +
-		 mat1.d3 * mat2.d3;
+	mat4x4_multiply_to(&res, &mat1, &mat2);
 	return res;
 }
+/******************************************************************************
+ * mat4x4_multiply_to
+ * Stores m1 * m2 in out, which must not alias m1 or m2. Each column of the
+ * result is a sum of the columns of m1 scaled by a column of m2; with AVX two
+ * columns of the result are computed at once.
+******************************************************************************/
+void mat4x4_multiply_to(Mat4x4 *restrict out, const Mat4x4 *restrict m1,
+			const Mat4x4 *restrict m2) {
+#if defined(__AVX__)
+	const float *a = (const float *)m1, *b = (const float *)m2;
+	__m256 c0, c1, c2, c3, cols, r;
+	int j;
+
+	c0 = _mm256_broadcast_ps((const __m128 *)&a[0]);
+	c1 = _mm256_broadcast_ps((const __m128 *)&a[4]);
+	c2 = _mm256_broadcast_ps((const __m128 *)&a[8]);
+	c3 = _mm256_broadcast_ps((const __m128 *)&a[12]);
+	for (j = 0; j < 16; j += 8) {
+		cols = _mm256_loadu_ps(&b[j]);
+		r = _mm256_mul_ps(c0, _mm256_permute_ps(cols, 0x00));
+		r = _mm256_add_ps(r,
+				  _mm256_mul_ps(c1, _mm256_permute_ps(cols, 0x55)));
+		r = _mm256_add_ps(r,
+				  _mm256_mul_ps(c2, _mm256_permute_ps(cols, 0xaa)));
+		r = _mm256_add_ps(r,
+				  _mm256_mul_ps(c3, _mm256_permute_ps(cols, 0xff)));
+		_mm256_storeu_ps(&((float *)out)[j], r);
+	}
+#elif defined(__SSE__)
+	const float *a = (const float *)m1, *b = (const float *)m2;
+	__m128 c0, c1, c2, c3, r;
+	int j;
+
+	c0 = _mm_loadu_ps(&a[0]);
+	c1 = _mm_loadu_ps(&a[4]);
+	c2 = _mm_loadu_ps(&a[8]);
+	c3 = _mm_loadu_ps(&a[12]);
+	for (j = 0; j < 16; j += 4) {
+		r = _mm_mul_ps(c0, _mm_set1_ps(b[j]));
+		r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_set1_ps(b[j + 1])));
+		r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_set1_ps(b[j + 2])));
+		r = _mm_add_ps(r, _mm_mul_ps(c3, _mm_set1_ps(b[j + 3])));
+		_mm_storeu_ps(&((float *)out)[j], r);
+	}
+#else
+	out->a0 = m1->a0 * m2->a0 + m1->a1 * m2->b0 + m1->a2 * m2->c0 +
+		  m1->a3 * m2->d0;
+	out->a1 = m1->a0 * m2->a1 + m1->a1 * m2->b1 + m1->a2 * m2->c1 +
+		  m1->a3 * m2->d1;
+	out->a2 = m1->a0 * m2->a2 + m1->a1 * m2->b2 + m1->a2 * m2->c2 +
+		  m1->a3 * m2->d2;
+	out->a3 = m1->a0 * m2->a3 + m1->a1 * m2->b3 + m1->a2 * m2->c3 +
+		  m1->a3 * m2->d3;
+	out->b0 = m1->b0 * m2->a0 + m1->b1 * m2->b0 + m1->b2 * m2->c0 +
+		  m1->b3 * m2->d0;
+	out->b1 = m1->b0 * m2->a1 + m1->b1 * m2->b1 + m1->b2 * m2->c1 +
+		  m1->b3 * m2->d1;
+	out->b2 = m1->b0 * m2->a2 + m1->b1 * m2->b2 + m1->b2 * m2->c2 +
+		  m1->b3 * m2->d2;
+	out->b3 = m1->b0 * m2->a3 + m1->b1 * m2->b3 + m1->b2 * m2->c3 +
+		  m1->b3 * m2->d3;
+	out->c0 = m1->c0 * m2->a0 + m1->c1 * m2->b0 + m1->c2 * m2->c0 +
+		  m1->c3 * m2->d0;
+	out->c1 = m1->c0 * m2->a1 + m1->c1 * m2->b1 + m1->c2 * m2->c1 +
+		  m1->c3 * m2->d1;
+	out->c2 = m1->c0 * m2->a2 + m1->c1 * m2->b2 + m1->c2 * m2->c2 +
+		  m1->c3 * m2->d2;
+	out->c3 = m1->c0 * m2->a3 + m1->c1 * m2->b3 + m1->c2 * m2->c3 +
+		  m1->c3 * m2->d3;
+	out->d0 = m1->d0 * m2->a0 + m1->d1 * m2->b0 + m1->d2 * m2->c0 +
+		  m1->d3 * m2->d0;
+	out->d1 = m1->d0 * m2->a1 + m1->d1 * m2->b1 + m1->d2 * m2->c1 +
+		  m1->d3 * m2->d1;
+	out->d2 = m1->d0 * m2->a2 + m1->d1 * m2->b2 + m1->d2 * m2->c2 +
+		  m1->d3 * m2->d2;
+	out->d3 = m1->d0 * m2->a3 + m1->d1 * m2->b3 + m1->d2 * m2->c3 +
+		  m1->d3 * m2->d3;
+#endif
+}
 /******************************************************************************
  * mat4x4_multiply_vec4x1
 ******************************************************************************/
 Vector4 mat4x4_multiply_vec4x1(Mat4x4 mat, Vector4 vec) {
-	Vector4 ret = {
-	    mat.a0 * vec.x + mat.a1 * vec.y + mat.a2 * vec.z + mat.a3 * vec.w,
-	    mat.b0 * vec.x + mat.b1 * vec.y + mat.b2 * vec.z + mat.b3 * vec.w,
-	    mat.c0 * vec.x + mat.c1 * vec.y + mat.c2 * vec.z + mat.c3 * vec.w,
-	    mat.d0 * vec.x + mat.d1 * vec.y + mat.d2 * vec.z + mat.d3 * vec.w};
+	Vector4 ret;
+	mat4x4_multiply_vec4_to(&ret, &mat, &vec);
 	return ret;
 }
+/******************************************************************************
+ * mat4x4_multiply_vec4_to
+ * Stores mat * vec in out, which must not alias vec.
+******************************************************************************/
+void mat4x4_multiply_vec4_to(Vector4 *restrict out,
+			     const Mat4x4 *restrict mat,
+			     const Vector4 *restrict vec) {
+#ifdef __SSE__
+	const float *m = (const float *)mat;
+	__m128 r;
+
+	r = _mm_mul_ps(_mm_loadu_ps(&m[0]), _mm_set1_ps(vec->x));
+	r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(&m[4]), _mm_set1_ps(vec->y)));
+	r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(&m[8]), _mm_set1_ps(vec->z)));
+	r = _mm_add_ps(r,
+		       _mm_mul_ps(_mm_loadu_ps(&m[12]), _mm_set1_ps(vec->w)));
+	_mm_storeu_ps((float *)out, r);
+#else
+	out->x = mat->a0 * vec->x + mat->a1 * vec->y + mat->a2 * vec->z +
+		 mat->a3 * vec->w;
+	out->y = mat->b0 * vec->x + mat->b1 * vec->y + mat->b2 * vec->z +
+		 mat->b3 * vec->w;
+	out->z = mat->c0 * vec->x + mat->c1 * vec->y + mat->c2 * vec->z +
+		 mat->c3 * vec->w;
+	out->w = mat->d0 * vec->x + mat->d1 * vec->y + mat->d2 * vec->z +
+		 mat->d3 * vec->w;
+#endif
+}
 /******************************************************************************
  * mat4x4_multiply_vec3x1
 ******************************************************************************/
 Vector3 mat4x4_multiply_vec3x1(Mat4x4 mat, Vector3 vec) {
 	Vector3 ret;
-	Vector4 v = {vec.x, vec.y, vec.z, 1.0f};
-	v = mat4x4_multiply_vec4x1(mat, v);
-	ret.x = v.x;
-	ret.y = v.y;
-	ret.z = v.z;
+	Vector4 v = {vec.x, vec.y, vec.z, 1.0f}, r;
+	mat4x4_multiply_vec4_to(&r, &mat, &v);
+	ret.x = r.x;
+	ret.y = r.y;
+	ret.z = r.z;
 	return ret;
 }
 /******************************************************************************
@@ -268,60 +361,149 @@ float mat4x4_det(Mat4x4 *mat) {
  * mat4x4_inverse
 ******************************************************************************/
 bool mat4x4_inverse(Mat4x4 mat, Mat4x4 *out) {
+	return mat4x4_inverse_to(out, &mat);
+}
+#ifdef __SSE__
+/* the 2x2 matrix products used by the block inverse. A 2x2 matrix is held in
+ * one vector as (m00, m01, m10, m11); A# is the adjugate of A. */
+#define SHUF(a, b, x, y, z, w) _mm_shuffle_ps(a, b, _MM_SHUFFLE(w, z, y, x))
+#define SWIZ(a, x, y, z, w) SHUF(a, a, x, y, z, w)
+
+/* mat2Mul returns a * b */
+static inline __m128 mat2Mul(__m128 a, __m128 b) {
+	return _mm_add_ps(_mm_mul_ps(a, SWIZ(b, 0, 3, 0, 3)),
+			  _mm_mul_ps(SWIZ(a, 1, 0, 3, 2), SWIZ(b, 2, 1, 2, 1)));
+}
+
+/* mat2AdjMul returns a# * b */
+static inline __m128 mat2AdjMul(__m128 a, __m128 b) {
+	return _mm_sub_ps(_mm_mul_ps(SWIZ(a, 3, 3, 0, 0), b),
+			  _mm_mul_ps(SWIZ(a, 1, 1, 2, 2), SWIZ(b, 2, 3, 0, 1)));
+}
+
+/* mat2MulAdj returns a * b# */
+static inline __m128 mat2MulAdj(__m128 a, __m128 b) {
+	return _mm_sub_ps(_mm_mul_ps(a, SWIZ(b, 3, 0, 3, 0)),
+			  _mm_mul_ps(SWIZ(a, 1, 0, 3, 2), SWIZ(b, 2, 1, 2, 1)));
+}
+#endif
+/******************************************************************************
+ * mat4x4_inverse_to
+ * Stores the inverse of m in out, which must not alias m. Returns false (and
+ * leaves out unchanged) if m is singular. The SSE version inverts m as a 2x2
+ * matrix of 2x2 blocks. Since it works on columns it inverts the transpose,
+ * which is stored as the inverse.
+******************************************************************************/
+bool mat4x4_inverse_to(Mat4x4 *restrict out, const Mat4x4 *restrict m) {
+#ifdef __SSE__
+	const float *f = (const float *)m;
+	__m128 r0, r1, r2, r3, a, b, c, d, det, detA, detB, detC, detD;
+	__m128 dc, ab, x, y, z, w, tr, sign;
+	float detM;
+
+	r0 = _mm_loadu_ps(&f[0]);
+	r1 = _mm_loadu_ps(&f[4]);
+	r2 = _mm_loadu_ps(&f[8]);
+	r3 = _mm_loadu_ps(&f[12]);
+	a = _mm_movelh_ps(r0, r1);
+	b = _mm_movehl_ps(r1, r0);
+	c = _mm_movelh_ps(r2, r3);
+	d = _mm_movehl_ps(r3, r2);
+
+	/* (|A|, |B|, |C|, |D|) */
+	det = _mm_sub_ps(
+	    _mm_mul_ps(SHUF(r0, r2, 0, 2, 0, 2), SHUF(r1, r3, 1, 3, 1, 3)),
+	    _mm_mul_ps(SHUF(r0, r2, 1, 3, 1, 3), SHUF(r1, r3, 0, 2, 0, 2)));
+	detA = SWIZ(det, 0, 0, 0, 0);
+	detB = SWIZ(det, 1, 1, 1, 1);
+	detC = SWIZ(det, 2, 2, 2, 2);
+	detD = SWIZ(det, 3, 3, 3, 3);
+
+	dc = mat2AdjMul(d, c);
+	ab = mat2AdjMul(a, b);
+	x = _mm_sub_ps(_mm_mul_ps(detD, a), mat2Mul(b, dc));
+	w = _mm_sub_ps(_mm_mul_ps(detA, d), mat2Mul(c, ab));
+	y = _mm_sub_ps(_mm_mul_ps(detB, c), mat2MulAdj(d, ab));
+	z = _mm_sub_ps(_mm_mul_ps(detC, b), mat2MulAdj(a, dc));
+
+	/* |M| = |A||D| + |B||C| - tr((A#B)(D#C)) */
+	tr = _mm_mul_ps(ab, SWIZ(dc, 0, 2, 1, 3));
+	tr = _mm_add_ps(tr, _mm_movehl_ps(tr, tr));
+	tr = _mm_add_ss(tr, _mm_shuffle_ps(tr, tr, 1));
+	detM = _mm_cvtss_f32(_mm_sub_ss(
+	    _mm_add_ss(_mm_mul_ss(detA, detD), _mm_mul_ss(detB, detC)), tr));
+	if (detM == 0.0f) {
+		return false;
+	}
+
+	sign = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f),
+			  _mm_set1_ps(detM));
+	x = _mm_mul_ps(x, sign);
+	y = _mm_mul_ps(y, sign);
+	z = _mm_mul_ps(z, sign);
+	w = _mm_mul_ps(w, sign);
+
+	/* apply the adjugate of each block as it is stored */
+	_mm_storeu_ps((float *)out, SHUF(x, y, 3, 1, 3, 1));
+	_mm_storeu_ps((float *)out + 4, SHUF(x, y, 2, 0, 2, 0));
+	_mm_storeu_ps((float *)out + 8, SHUF(z, w, 3, 1, 3, 1));
+	_mm_storeu_ps((float *)out + 12, SHUF(z, w, 2, 0, 2, 0));
+	return true;
+#else
 	Mat4x4 inv;
 	float det;
 
-	inv.a0 = mat.b1 * mat.c2 * mat.d3 - mat.b1 * mat.d2 * mat.c3 -
-		 mat.b2 * mat.c1 * mat.d3 + mat.b2 * mat.d1 * mat.c3 +
-		 mat.b3 * mat.c1 * mat.d2 - mat.b3 * mat.d1 * mat.c2;
-	inv.a1 = -mat.a1 * mat.c2 * mat.d3 + mat.a1 * mat.d2 * mat.c3 +
-		 mat.a2 * mat.c1 * mat.d3 - mat.a2 * mat.d1 * mat.c3 -
-		 mat.a3 * mat.c1 * mat.d2 + mat.a3 * mat.d1 * mat.c2;
-	inv.a2 = mat.a1 * mat.b2 * mat.d3 - mat.a1 * mat.d2 * mat.b3 -
-		 mat.a2 * mat.b1 * mat.d3 + mat.a2 * mat.d1 * mat.b3 +
-		 mat.a3 * mat.b1 * mat.d2 - mat.a3 * mat.d1 * mat.b2;
-	inv.a3 = -mat.a1 * mat.b2 * mat.c3 + mat.a1 * mat.c2 * mat.b3 +
-		 mat.a2 * mat.b1 * mat.c3 - mat.a2 * mat.c1 * mat.b3 -
-		 mat.a3 * mat.b1 * mat.c2 + mat.a3 * mat.c1 * mat.b2;
-	inv.b0 = -mat.b0 * mat.c2 * mat.d3 + mat.b0 * mat.d2 * mat.c3 +
-		 mat.b2 * mat.c0 * mat.d3 - mat.b2 * mat.d0 * mat.c3 -
-		 mat.b3 * mat.c0 * mat.d2 + mat.b3 * mat.d0 * mat.c2;
-	inv.b1 = mat.a0 * mat.c2 * mat.d3 - mat.a0 * mat.d2 * mat.c3 -
-		 mat.a2 * mat.c0 * mat.d3 + mat.a2 * mat.d0 * mat.c3 +
-		 mat.a3 * mat.c0 * mat.d2 - mat.a3 * mat.d0 * mat.c2;
-	inv.b2 = -mat.a0 * mat.b2 * mat.d3 + mat.a0 * mat.d2 * mat.b3 +
-		 mat.a2 * mat.b0 * mat.d3 - mat.a2 * mat.d0 * mat.b3 -
-		 mat.a3 * mat.b0 * mat.d2 + mat.a3 * mat.d0 * mat.b2;
-	inv.b3 = mat.a0 * mat.b2 * mat.c3 - mat.a0 * mat.c2 * mat.b3 -
-		 mat.a2 * mat.b0 * mat.c3 + mat.a2 * mat.c0 * mat.b3 +
-		 mat.a3 * mat.b0 * mat.c2 - mat.a3 * mat.c0 * mat.b2;
-	inv.c0 = mat.b0 * mat.c1 * mat.d3 - mat.b0 * mat.d1 * mat.c3 -
-		 mat.b1 * mat.c0 * mat.d3 + mat.b1 * mat.d0 * mat.c3 +
-		 mat.b3 * mat.c0 * mat.d1 - mat.b3 * mat.d0 * mat.c1;
-	inv.c1 = -mat.a0 * mat.c1 * mat.d3 + mat.a0 * mat.d1 * mat.c3 +
-		 mat.a1 * mat.c0 * mat.d3 - mat.a1 * mat.d0 * mat.c3 -
-		 mat.a3 * mat.c0 * mat.d1 + mat.a3 * mat.d0 * mat.c1;
-	inv.c2 = mat.a0 * mat.b1 * mat.d3 - mat.a0 * mat.d1 * mat.b3 -
-		 mat.a1 * mat.b0 * mat.d3 + mat.a1 * mat.d0 * mat.b3 +
-		 mat.a3 * mat.b0 * mat.d1 - mat.a3 * mat.d0 * mat.b1;
-	inv.c3 = -mat.a0 * mat.b1 * mat.c3 + mat.a0 * mat.c1 * mat.b3 +
-		 mat.a1 * mat.b0 * mat.c3 - mat.a1 * mat.c0 * mat.b3 -
-		 mat.a3 * mat.b0 * mat.c1 + mat.a3 * mat.c0 * mat.b1;
-	inv.d0 = -mat.b0 * mat.c1 * mat.d2 + mat.b0 * mat.d1 * mat.c2 +
-		 mat.b1 * mat.c0 * mat.d2 - mat.b1 * mat.d0 * mat.c2 -
-		 mat.b2 * mat.c0 * mat.d1 + mat.b2 * mat.d0 * mat.c1;
-	inv.d1 = mat.a0 * mat.c1 * mat.d2 - mat.a0 * mat.d1 * mat.c2 -
-		 mat.a1 * mat.c0 * mat.d2 + mat.a1 * mat.d0 * mat.c2 +
-		 mat.a2 * mat.c0 * mat.d1 - mat.a2 * mat.d0 * mat.c1;
-	inv.d2 = -mat.a0 * mat.b1 * mat.d2 + mat.a0 * mat.d1 * mat.b2 +
-		 mat.a1 * mat.b0 * mat.d2 - mat.a1 * mat.d0 * mat.b2 -
-		 mat.a2 * mat.b0 * mat.d1 + mat.a2 * mat.d0 * mat.b1;
-	inv.d3 = mat.a0 * mat.b1 * mat.c2 - mat.a0 * mat.c1 * mat.b2 -
-		 mat.a1 * mat.b0 * mat.c2 + mat.a1 * mat.c0 * mat.b2 +
-		 mat.a2 * mat.b0 * mat.c1 - mat.a2 * mat.c0 * mat.b1;
-
-	det = (mat.a0 * inv.a0) + (mat.b0 * inv.a1) + (mat.c0 * inv.a2) +
-	      (mat.d0 * inv.a3);
+	inv.a0 = m->b1 * m->c2 * m->d3 - m->b1 * m->d2 * m->c3 -
+		 m->b2 * m->c1 * m->d3 + m->b2 * m->d1 * m->c3 +
+		 m->b3 * m->c1 * m->d2 - m->b3 * m->d1 * m->c2;
+	inv.a1 = -m->a1 * m->c2 * m->d3 + m->a1 * m->d2 * m->c3 +
+		 m->a2 * m->c1 * m->d3 - m->a2 * m->d1 * m->c3 -
+		 m->a3 * m->c1 * m->d2 + m->a3 * m->d1 * m->c2;
+	inv.a2 = m->a1 * m->b2 * m->d3 - m->a1 * m->d2 * m->b3 -
+		 m->a2 * m->b1 * m->d3 + m->a2 * m->d1 * m->b3 +
+		 m->a3 * m->b1 * m->d2 - m->a3 * m->d1 * m->b2;
+	inv.a3 = -m->a1 * m->b2 * m->c3 + m->a1 * m->c2 * m->b3 +
+		 m->a2 * m->b1 * m->c3 - m->a2 * m->c1 * m->b3 -
+		 m->a3 * m->b1 * m->c2 + m->a3 * m->c1 * m->b2;
+	inv.b0 = -m->b0 * m->c2 * m->d3 + m->b0 * m->d2 * m->c3 +
+		 m->b2 * m->c0 * m->d3 - m->b2 * m->d0 * m->c3 -
+		 m->b3 * m->c0 * m->d2 + m->b3 * m->d0 * m->c2;
+	inv.b1 = m->a0 * m->c2 * m->d3 - m->a0 * m->d2 * m->c3 -
+		 m->a2 * m->c0 * m->d3 + m->a2 * m->d0 * m->c3 +
+		 m->a3 * m->c0 * m->d2 - m->a3 * m->d0 * m->c2;
+	inv.b2 = -m->a0 * m->b2 * m->d3 + m->a0 * m->d2 * m->b3 +
+		 m->a2 * m->b0 * m->d3 - m->a2 * m->d0 * m->b3 -
+		 m->a3 * m->b0 * m->d2 + m->a3 * m->d0 * m->b2;
+	inv.b3 = m->a0 * m->b2 * m->c3 - m->a0 * m->c2 * m->b3 -
+		 m->a2 * m->b0 * m->c3 + m->a2 * m->c0 * m->b3 +
+		 m->a3 * m->b0 * m->c2 - m->a3 * m->c0 * m->b2;
+	inv.c0 = m->b0 * m->c1 * m->d3 - m->b0 * m->d1 * m->c3 -
+		 m->b1 * m->c0 * m->d3 + m->b1 * m->d0 * m->c3 +
+		 m->b3 * m->c0 * m->d1 - m->b3 * m->d0 * m->c1;
+	inv.c1 = -m->a0 * m->c1 * m->d3 + m->a0 * m->d1 * m->c3 +
+		 m->a1 * m->c0 * m->d3 - m->a1 * m->d0 * m->c3 -
+		 m->a3 * m->c0 * m->d1 + m->a3 * m->d0 * m->c1;
+	inv.c2 = m->a0 * m->b1 * m->d3 - m->a0 * m->d1 * m->b3 -
+		 m->a1 * m->b0 * m->d3 + m->a1 * m->d0 * m->b3 +
+		 m->a3 * m->b0 * m->d1 - m->a3 * m->d0 * m->b1;
+	inv.c3 = -m->a0 * m->b1 * m->c3 + m->a0 * m->c1 * m->b3 +
+		 m->a1 * m->b0 * m->c3 - m->a1 * m->c0 * m->b3 -
+		 m->a3 * m->b0 * m->c1 + m->a3 * m->c0 * m->b1;
+	inv.d0 = -m->b0 * m->c1 * m->d2 + m->b0 * m->d1 * m->c2 +
+		 m->b1 * m->c0 * m->d2 - m->b1 * m->d0 * m->c2 -
+		 m->b2 * m->c0 * m->d1 + m->b2 * m->d0 * m->c1;
+	inv.d1 = m->a0 * m->c1 * m->d2 - m->a0 * m->d1 * m->c2 -
+		 m->a1 * m->c0 * m->d2 + m->a1 * m->d0 * m->c2 +
+		 m->a2 * m->c0 * m->d1 - m->a2 * m->d0 * m->c1;
+	inv.d2 = -m->a0 * m->b1 * m->d2 + m->a0 * m->d1 * m->b2 +
+		 m->a1 * m->b0 * m->d2 - m->a1 * m->d0 * m->b2 -
+		 m->a2 * m->b0 * m->d1 + m->a2 * m->d0 * m->b1;
+	inv.d3 = m->a0 * m->b1 * m->c2 - m->a0 * m->c1 * m->b2 -
+		 m->a1 * m->b0 * m->c2 + m->a1 * m->c0 * m->b2 +
+		 m->a2 * m->b0 * m->c1 - m->a2 * m->c0 * m->b1;
+
+	det = (m->a0 * inv.a0) + (m->b0 * inv.a1) + (m->c0 * inv.a2) +
+	      (m->d0 * inv.a3);
 	if (det == 0.0f) {
 		return false;
 	}
@@ -346,4 +528,84 @@ bool mat4x4_inverse(Mat4x4 mat, Mat4x4 *out) {
 	out->d2 = inv.d2 * det;
 	out->d3 = inv.d3 * det;
 	return true;
+#endif
+}
+/******************************************************************************
+ * mat4x4_affine_inverse
+ * Stores the inverse of the affine transform m (its last row is 0 0 0 1) in
+ * out, which must not alias m. The rows of the inverse of the upper 3x3 are
+ * the cross products of its columns over the determinant; the translation is
+ * moved back through them. Returns false if m is singular.
+******************************************************************************/
+bool mat4x4_affine_inverse(Mat4x4 *restrict out, const Mat4x4 *restrict m) {
+#ifdef __SSE__
+	const float *f = (const float *)m;
+	__m128 c0, c1, c2, t, i0, i1, i2, i3, det;
+	float d;
+
+	c0 = _mm_loadu_ps(&f[0]);
+	c1 = _mm_loadu_ps(&f[4]);
+	c2 = _mm_loadu_ps(&f[8]);
+	t = _mm_loadu_ps(&f[12]);
+
+	/* the cross products (row i of the adjugate) */
+	i0 = _mm_sub_ps(_mm_mul_ps(SWIZ(c1, 1, 2, 0, 3), SWIZ(c2, 2, 0, 1, 3)),
+			_mm_mul_ps(SWIZ(c1, 2, 0, 1, 3), SWIZ(c2, 1, 2, 0, 3)));
+	i1 = _mm_sub_ps(_mm_mul_ps(SWIZ(c2, 1, 2, 0, 3), SWIZ(c0, 2, 0, 1, 3)),
+			_mm_mul_ps(SWIZ(c2, 2, 0, 1, 3), SWIZ(c0, 1, 2, 0, 3)));
+	i2 = _mm_sub_ps(_mm_mul_ps(SWIZ(c0, 1, 2, 0, 3), SWIZ(c1, 2, 0, 1, 3)),
+			_mm_mul_ps(SWIZ(c0, 2, 0, 1, 3), SWIZ(c1, 1, 2, 0, 3)));
+
+	/* det = c0 . (c1 x c2) */
+	det = _mm_mul_ps(c0, i0);
+	d = _mm_cvtss_f32(det) + _mm_cvtss_f32(SWIZ(det, 1, 1, 1, 1)) +
+	    _mm_cvtss_f32(SWIZ(det, 2, 2, 2, 2));
+	if (d == 0.0f) {
+		return false;
+	}
+	det = _mm_set1_ps(1.0f / d);
+	i0 = _mm_mul_ps(i0, det);
+	i1 = _mm_mul_ps(i1, det);
+	i2 = _mm_mul_ps(i2, det);
+	i3 = _mm_setzero_ps();
+	_MM_TRANSPOSE4_PS(i0, i1, i2, i3);
+
+	/* -(R^-1 t), with w = 1 */
+	t = _mm_add_ps(
+	    _mm_add_ps(_mm_mul_ps(i0, SWIZ(t, 0, 0, 0, 0)),
+		       _mm_mul_ps(i1, SWIZ(t, 1, 1, 1, 1))),
+	    _mm_mul_ps(i2, SWIZ(t, 2, 2, 2, 2)));
+	t = _mm_sub_ps(_mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f), t);
+
+	_mm_storeu_ps((float *)out, i0);
+	_mm_storeu_ps((float *)out + 4, i1);
+	_mm_storeu_ps((float *)out + 8, i2);
+	_mm_storeu_ps((float *)out + 12, t);
+	return true;
+#else
+	float det;
+
+	det = m->a0 * (m->b1 * m->c2 - m->c1 * m->b2) -
+	      m->a1 * (m->b0 * m->c2 - m->c0 * m->b2) +
+	      m->a2 * (m->b0 * m->c1 - m->c0 * m->b1);
+	if (det == 0.0f) {
+		return false;
+	}
+	det = 1.0f / det;
+	out->a0 = (m->b1 * m->c2 - m->b2 * m->c1) * det;
+	out->a1 = (m->a2 * m->c1 - m->a1 * m->c2) * det;
+	out->a2 = (m->a1 * m->b2 - m->a2 * m->b1) * det;
+	out->b0 = (m->b2 * m->c0 - m->b0 * m->c2) * det;
+	out->b1 = (m->a0 * m->c2 - m->a2 * m->c0) * det;
+	out->b2 = (m->a2 * m->b0 - m->a0 * m->b2) * det;
+	out->c0 = (m->b0 * m->c1 - m->b1 * m->c0) * det;
+	out->c1 = (m->a1 * m->c0 - m->a0 * m->c1) * det;
+	out->c2 = (m->a0 * m->b1 - m->a1 * m->b0) * det;
+	out->a3 = -(out->a0 * m->a3 + out->a1 * m->b3 + out->a2 * m->c3);
+	out->b3 = -(out->b0 * m->a3 + out->b1 * m->b3 + out->b2 * m->c3);
+	out->c3 = -(out->c0 * m->a3 + out->c1 * m->b3 + out->c2 * m->c3);
+	out->d0 = out->d1 = out->d2 = 0.0f;
+	out->d3 = 1.0f;
+	return true;
+#endif
 }
@@ -32,8 +32,8 @@ typedef struct Mat4x4 {
 	float a3, b3, c3, d3;
 } Mat4x4;
 
-void mat4x4_push(Mat4x4* mat);
-void mat4x4_pop(Mat4x4* mat);
+bool mat4x4_push(Mat4x4* mat);
+bool mat4x4_pop(Mat4x4* mat);
 
 void mat4x4_load_identity(Mat4x4* mat);
 void mat4x4_scale(Mat4x4* mat, float x, float y, float z);
@@ -45,6 +45,16 @@ bool mat4x4_inverse(Mat4x4 mat, Mat4x4* out);
 
 Mat4x4 mat4x4_multiply(Mat4x4 mat1, Mat4x4 mat2);
 Vector4 mat4x4_multiply_vec4x1(Mat4x4 mat, Vector4 vec);
+
+/* pointer variants: out must not alias the inputs */
+void mat4x4_multiply_to(Mat4x4* restrict out, const Mat4x4* restrict m1,
+			const Mat4x4* restrict m2);
+void mat4x4_multiply_vec4_to(Vector4* restrict out,
+			     const Mat4x4* restrict mat,
+			     const Vector4* restrict vec);
+bool mat4x4_inverse_to(Mat4x4* restrict out, const Mat4x4* restrict m);
+bool mat4x4_affine_inverse(Mat4x4* restrict out, const Mat4x4* restrict m);
+
 Vector3 mat4x4_multiply_vec3x1(Mat4x4 mat, Vector3 vec);
 void mat4x4_perspective(Mat4x4* mat, float fov, float aspect, float zNear,
 			float zFar);
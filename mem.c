@@ -0,0 +1,316 @@
+#include "mem.h"
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* the initial capacity of the table of tracked objects (a power of two) */
+enum { MEM_MIN_OBJECTS = 256 };
+
+static const char *tagNames[MEM_NUM_TAGS] = {"window", "grids",  "glyphs",
+					     "images", "meshes", "post"};
+static const char *domainNames[MEM_NUM_DOMAINS] = {"cpu", "gpu"};
+
+/* MemObject is a tracked GL object */
+typedef struct {
+	uint64_t key; /* kind << 32 | name, 0 if the slot is free */
+	size_t bytes;
+	uint32_t tag;
+} MemObject;
+
+/* mem is shared with the asset thread, which imports meshes; the lock
+ * guards all of it */
+static struct {
+	SDL_SpinLock lock;
+	MemStats stats[MEM_NUM_TAGS][MEM_NUM_DOMAINS];
+	size_t budgets[MEM_NUM_TAGS][MEM_NUM_DOMAINS]; /* 0 for none */
+	bool over[MEM_NUM_TAGS][MEM_NUM_DOMAINS]; /* warned, still over */
+
+	/* objects is an open-addressing table of the tracked GL objects */
+	MemObject *objects;
+	uint32_t numObjects, capObjects;
+} mem;
+
+/* add counts n bytes more (or, if sub, fewer) against tag in domain. The
+ * lock must be held. Returns true if the budget was just exceeded. */
+static bool add(uint32_t tag, uint32_t domain, size_t n, bool sub) {
+	MemStats *s = &mem.stats[tag][domain];
+	size_t budget = mem.budgets[tag][domain];
+
+	if (sub) {
+		s->live = s->live > n ? s->live - n : 0;
+		s->count -= s->count > 0;
+	} else {
+		s->live += n;
+		s->count++;
+		s->peak = s->live > s->peak ? s->live : s->peak;
+	}
+	if (budget == 0 || s->live <= budget) {
+		mem.over[tag][domain] = false;
+		return false;
+	}
+	if (mem.over[tag][domain]) {
+		return false;
+	}
+	mem.over[tag][domain] = true;
+	return true;
+}
+
+/* warn reports that tag exceeded its budget in domain */
+static void warn(uint32_t tag, uint32_t domain) {
+	MemStats s = mem_Stats(tag, domain);
+
+	printf("warning: %s %s memory (%zu KiB) is over its budget "
+	       "(%zu KiB)\n",
+	       tagNames[tag], domainNames[domain], s.live / 1024,
+	       mem_Budget(tag, domain) / 1024);
+}
+
+/* mem_Add counts an allocation of n bytes against tag in domain. Empty
+ * allocations are not counted. */
+void mem_Add(uint32_t tag, uint32_t domain, size_t n) {
+	bool over;
+
+	if (n == 0 || tag >= MEM_NUM_TAGS || domain >= MEM_NUM_DOMAINS) {
+		return;
+	}
+	SDL_AtomicLock(&mem.lock);
+	over = add(tag, domain, n, false);
+	SDL_AtomicUnlock(&mem.lock);
+	if (over) {
+		warn(tag, domain);
+	}
+}
+
+/* mem_Sub counts the release of an allocation of n bytes against tag in
+ * domain */
+void mem_Sub(uint32_t tag, uint32_t domain, size_t n) {
+	if (n == 0 || tag >= MEM_NUM_TAGS || domain >= MEM_NUM_DOMAINS) {
+		return;
+	}
+	SDL_AtomicLock(&mem.lock);
+	add(tag, domain, n, true);
+	SDL_AtomicUnlock(&mem.lock);
+}
+
+/* home returns the slot key hashes to in the object table */
+static uint32_t home(uint64_t key) {
+	return (uint32_t)((key * 0x9e3779b97f4a7c15ull) >> 32) &
+	       (mem.capObjects - 1);
+}
+
+/* slot returns the slot of key in the object table: its own, or the free
+ * slot it would go in. The table must not be full. */
+static uint32_t slot(uint64_t key) {
+	uint32_t i, mask = mem.capObjects - 1;
+
+	i = home(key);
+	while (mem.objects[i].key != 0 && mem.objects[i].key != key) {
+		i = (i + 1) & mask;
+	}
+	return i;
+}
+
+/* grow doubles the object table. The lock must be held. */
+static bool grow() {
+	MemObject *old = mem.objects;
+	uint32_t i, cap = mem.capObjects;
+
+	mem.capObjects = cap ? cap * 2 : MEM_MIN_OBJECTS;
+	if ((mem.objects = calloc(mem.capObjects, sizeof(MemObject))) ==
+	    NULL) {
+		mem.objects = old;
+		mem.capObjects = cap;
+		return false;
+	}
+	for (i = 0; i < cap; ++i) {
+		if (old[i].key != 0) {
+			mem.objects[slot(old[i].key)] = old[i];
+		}
+	}
+	free(old);
+	return true;
+}
+
+/* mem_Track counts the GL object name of kind (MEM_TEXTURE etc.) as
+ * holding n bytes of GPU memory for tag. Tracking an object again replaces
+ * its size, as when a texture's storage is respecified. */
+void mem_Track(uint32_t kind, GLuint name, uint32_t tag, size_t n) {
+	uint64_t key = (uint64_t)kind << 32 | name;
+	MemObject *o;
+	bool over;
+
+	if (name == 0 || tag >= MEM_NUM_TAGS) {
+		return;
+	}
+	SDL_AtomicLock(&mem.lock);
+	if ((mem.numObjects + 1) * 2 > mem.capObjects && !grow()) {
+		SDL_AtomicUnlock(&mem.lock);
+		puts("error: out of memory tracking GL objects");
+		return;
+	}
+	o = &mem.objects[slot(key)];
+	if (o->key == key) {
+		add(o->tag, MEM_GPU, o->bytes, true);
+	} else {
+		o->key = key;
+		mem.numObjects++;
+	}
+	o->bytes = n;
+	o->tag = tag;
+	over = add(tag, MEM_GPU, n, false);
+	SDL_AtomicUnlock(&mem.lock);
+	if (over) {
+		warn(tag, MEM_GPU);
+	}
+}
+
+/* mem_Untrack stops counting the GL object name of kind, which is being
+ * deleted */
+void mem_Untrack(uint32_t kind, GLuint name) {
+	uint64_t key = (uint64_t)kind << 32 | name;
+	uint32_t i, j, mask;
+
+	if (name == 0) {
+		return;
+	}
+	SDL_AtomicLock(&mem.lock);
+	if (mem.capObjects == 0 || mem.objects[slot(key)].key != key) {
+		SDL_AtomicUnlock(&mem.lock);
+		return;
+	}
+	i = slot(key);
+	add(mem.objects[i].tag, MEM_GPU, mem.objects[i].bytes, true);
+	mem.numObjects--;
+
+	/* shift the following entries back over the hole, so that every
+	 * entry stays reachable from its home slot */
+	mask = mem.capObjects - 1;
+	for (j = (i + 1) & mask; mem.objects[j].key != 0; j = (j + 1) & mask) {
+		if (((j - home(mem.objects[j].key)) & mask) >=
+		    ((j - i) & mask)) {
+			mem.objects[i] = mem.objects[j];
+			i = j;
+		}
+	}
+	mem.objects[i].key = 0;
+	SDL_AtomicUnlock(&mem.lock);
+}
+
+/* mem_Stats returns the usage of tag in domain */
+MemStats mem_Stats(uint32_t tag, uint32_t domain) {
+	MemStats s;
+
+	memset(&s, 0, sizeof(s));
+	if (tag < MEM_NUM_TAGS && domain < MEM_NUM_DOMAINS) {
+		SDL_AtomicLock(&mem.lock);
+		s = mem.stats[tag][domain];
+		SDL_AtomicUnlock(&mem.lock);
+	}
+	return s;
+}
+
+/* mem_Total returns the usage of every subsystem in domain. Its peak is the
+ * sum of theirs, which may never have been reached at once. */
+MemStats mem_Total(uint32_t domain) {
+	MemStats s, t;
+	uint32_t i;
+
+	memset(&t, 0, sizeof(t));
+	for (i = 0; i < MEM_NUM_TAGS; ++i) {
+		s = mem_Stats(i, domain);
+		t.live += s.live;
+		t.peak += s.peak;
+		t.count += s.count;
+	}
+	return t;
+}
+
+/* mem_TagName returns the name of tag */
+const char *mem_TagName(uint32_t tag) {
+	return tag < MEM_NUM_TAGS ? tagNames[tag] : "?";
+}
+
+/* mem_SetBudget sets the budget of tag in domain to n bytes (0 for none) */
+void mem_SetBudget(uint32_t tag, uint32_t domain, size_t n) {
+	if (tag < MEM_NUM_TAGS && domain < MEM_NUM_DOMAINS) {
+		SDL_AtomicLock(&mem.lock);
+		mem.budgets[tag][domain] = n;
+		mem.over[tag][domain] = false;
+		SDL_AtomicUnlock(&mem.lock);
+	}
+}
+
+/* mem_Budget returns the budget of tag in domain (0 if it has none) */
+size_t mem_Budget(uint32_t tag, uint32_t domain) {
+	size_t n = 0;
+
+	if (tag < MEM_NUM_TAGS && domain < MEM_NUM_DOMAINS) {
+		SDL_AtomicLock(&mem.lock);
+		n = mem.budgets[tag][domain];
+		SDL_AtomicUnlock(&mem.lock);
+	}
+	return n;
+}
+
+/* mem_OverBudget returns true if tag uses more than its budget in domain */
+bool mem_OverBudget(uint32_t tag, uint32_t domain) {
+	size_t budget = mem_Budget(tag, domain);
+
+	return budget != 0 && mem_Stats(tag, domain).live > budget;
+}
+
+/* mem_ParseBudget sets a budget given as "<tag>.<cpu|gpu>=<MiB>", e.g.
+ * "meshes.gpu=256". Returns false if s is malformed. */
+bool mem_ParseBudget(const char *s) {
+	const char *dot, *eq;
+	uint32_t tag, domain;
+	unsigned long mib;
+	char *end;
+
+	if ((dot = strchr(s, '.')) == NULL || (eq = strchr(dot, '=')) == NULL) {
+		return false;
+	}
+	for (tag = 0; tag < MEM_NUM_TAGS; ++tag) {
+		if (strlen(tagNames[tag]) == (size_t)(dot - s) &&
+		    strncmp(s, tagNames[tag], dot - s) == 0) {
+			break;
+		}
+	}
+	for (domain = 0; domain < MEM_NUM_DOMAINS; ++domain) {
+		if (strlen(domainNames[domain]) == (size_t)(eq - dot - 1) &&
+		    strncmp(dot + 1, domainNames[domain], eq - dot - 1) == 0) {
+			break;
+		}
+	}
+	mib = strtoul(eq + 1, &end, 10);
+	if (tag == MEM_NUM_TAGS || domain == MEM_NUM_DOMAINS ||
+	    end == eq + 1 || *end != '\0') {
+		return false;
+	}
+	mem_SetBudget(tag, domain, (size_t)mib * 1024 * 1024);
+	return true;
+}
+
+/* mem_Report prints the usage of each subsystem */
+void mem_Report() {
+	uint32_t i, d;
+	MemStats s;
+
+	for (i = 0; i < MEM_NUM_TAGS; ++i) {
+		for (d = 0; d < MEM_NUM_DOMAINS; ++d) {
+			s = mem_Stats(i, d);
+			if (s.peak == 0) {
+				continue;
+			}
+			printf("mem: %-6s %s %8zu KiB live (%u), %8zu KiB peak",
+			       tagNames[i], domainNames[d], s.live / 1024,
+			       s.count, s.peak / 1024);
+			if (mem_Budget(i, d) != 0) {
+				printf(", budget %zu KiB",
+				       mem_Budget(i, d) / 1024);
+			}
+			putchar('\n');
+		}
+	}
+}
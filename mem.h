@@ -0,0 +1,58 @@
+/*
+ * mem.h
+ * mem accounts gled's memory to the subsystems that use it, separately for
+ * CPU memory and GPU memory. CPU allocations are counted with mem_Add() and
+ * mem_Sub() where they are made. GL objects are registered with their size
+ * by mem_Track() when their storage is (re)specified; glstate_Delete*()
+ * untracks them, so an object is never counted after it is deleted.
+ * Each subsystem and domain has a live byte count, a high-water mark and an
+ * optional budget. Exceeding a budget prints a warning (once, until usage
+ * falls back under it) and makes mem_OverBudget() true.
+ */
+#ifndef MEM_H
+#define MEM_H
+
+#include <GL/glew.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* The subsystems memory is accounted to */
+enum { MEM_WINDOW = 0, /* the window's cell buffer and quad */
+       MEM_GRIDS = 1,  /* grid cells, and the targets of grids and buffer */
+       MEM_GLYPHS = 2, /* the glyph atlas and rasterized glyphs */
+       MEM_IMAGES = 3, /* image textures */
+       MEM_MESHES = 4, /* mesh data, buffers and render targets */
+       MEM_POST = 5,   /* post-processing targets */
+       MEM_NUM_TAGS = 6 };
+
+/* Where memory lives */
+enum { MEM_CPU = 0, MEM_GPU = 1, MEM_NUM_DOMAINS = 2 };
+
+/* The kinds of GL objects tracked */
+enum { MEM_TEXTURE = 1, MEM_RENDERBUFFER = 2, MEM_BUFFER = 3 };
+
+/* MemStats is the usage of one subsystem in one domain */
+typedef struct {
+	size_t live;    /* bytes in use */
+	size_t peak;    /* the most bytes ever in use */
+	uint32_t count; /* allocations or objects in use */
+} MemStats;
+
+void mem_Add(uint32_t, uint32_t, size_t);
+void mem_Sub(uint32_t, uint32_t, size_t);
+void mem_Track(uint32_t, GLuint, uint32_t, size_t);
+void mem_Untrack(uint32_t, GLuint);
+
+MemStats mem_Stats(uint32_t, uint32_t);
+MemStats mem_Total(uint32_t);
+const char *mem_TagName(uint32_t);
+
+void mem_SetBudget(uint32_t, uint32_t, size_t);
+size_t mem_Budget(uint32_t, uint32_t);
+bool mem_OverBudget(uint32_t, uint32_t);
+bool mem_ParseBudget(const char *);
+
+void mem_Report();
+
+#endif
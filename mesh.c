@@ -5,52 +5,55 @@
 #include <assimp/scene.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include "alloc.h"
+#include "glstate.h"
+#include "material.h"
 #include "matrix.h"
-#include "util.h"
-
-static const GLchar *vs =
-    "#version 150\n"
-    "in vec3 pos;\n"
-    "in vec4 normal;\n"
-    "in vec4 color;\n"
-    "in vec2 texco;\n"
-    "out vec4 out_co;\n"
-    "uniform sampler2D tex;\n"
-    "uniform mat4 mv, proj;\n"
-    "void main()\n"
-    "{\n"
-    "  out_co = color;\n"
-    "  gl_Position = proj * mv * vec4(pos, 1.0);\n"
-    "}\n";
-
-static const GLchar *fs =
-    "#version 150\n"
-    "in vec4 out_co;\n"
-    "out vec4 out_color;\n"
-    "void main()\n"
-    "{\n"
-    "  out_color = out_co;\n"
-    "}\n";
+#include "mem.h"
+
+/* meshBytes returns the size of the vertices and faces m keeps on the CPU */
+static size_t meshBytes(const Mesh *m) {
+	return sizeof(MeshVertex) * m->numVertices +
+	       sizeof(Face) * m->numFaces;
+}
+
+/* dataBytes returns the size of the arrays of d */
+static size_t dataBytes(const MeshData *d) {
+	return sizeof(MeshVertex) * d->numVertices +
+	       sizeof(Face) * d->numFaces +
+	       (sizeof(Mat4x4) + sizeof(uint32_t)) * d->numNodes;
+}
 
 void init_Mesh(Mesh *m) {
+	GLuint fbo;
+
 	m->vertices = NULL;
+	m->faces = NULL;
+	m->numVertices = m->numFaces = 0;
+	m->vao = m->vbo = m->ibo = 0;
+	m->material = 0;
+	m->texture = 0;
+	init_XformTree(&m->nodes);
+	m->node = XFORM_NONE;
 
 	/* RGBA8 2D texture, 24 bit depth texture, 256x256 */
 	glGenTextures(1, &m->color);
-	glBindTexture(GL_TEXTURE_2D, m->color);
+	glstate_BindTexture(0, GL_TEXTURE_2D, m->color);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 256, 256, 0, GL_RGBA,
 		     GL_UNSIGNED_BYTE, NULL);
-	glBindTexture(GL_TEXTURE_2D, 0);
 
 	glGenRenderbuffers(1, &m->depth);
-	glBindRenderbuffer(GL_RENDERBUFFER, m->depth);
+	glstate_BindRenderbuffer(m->depth);
 	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, 256, 256);
-	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	mem_Track(MEM_TEXTURE, m->color, MEM_MESHES, 256 * 256 * 4);
+	mem_Track(MEM_RENDERBUFFER, m->depth, MEM_MESHES, 256 * 256 * 4);
 
 	glGenFramebuffers(1, &m->fbo);
-	glBindFramebuffer(GL_FRAMEBUFFER, m->fbo);
+	fbo = glstate_GetFramebuffer();
+	glstate_BindFramebuffer(m->fbo);
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
 			       GL_TEXTURE_2D, m->color, 0);
 	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
@@ -61,28 +64,83 @@ void init_Mesh(Mesh *m) {
 		printf("FBO setup failed\n");
 	}
 
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glstate_BindFramebuffer(fbo);
 }
 
+/* meshes holds the meshes made by new_Mesh */
+static Pool meshes;
+
 Mesh *new_Mesh() {
 	Mesh *m;
-	m = malloc(sizeof(Mesh));
+
+	if (meshes.size == 0) {
+		init_Pool(&meshes, sizeof(Mesh), MESH_POOL_CHUNK);
+	}
+	if ((m = pool_Alloc(&meshes)) == NULL) {
+		return NULL;
+	}
 	init_Mesh(m);
 	return m;
 }
 
+/* deinit_Mesh frees the copies and GL objects of m, leaving it zeroed (so
+ * that its color is 0) until init_Mesh() is called again */
+void deinit_Mesh(Mesh *m) {
+	mem_Sub(MEM_MESHES, MEM_CPU, meshBytes(m));
+	free(m->vertices);
+	free(m->faces);
+
+	glstate_DeleteTexture(m->color);
+	glstate_DeleteRenderbuffer(m->depth);
+	glstate_DeleteFramebuffer(m->fbo);
+	glstate_DeleteVertexArray(m->vao);
+	glstate_DeleteBuffer(m->vbo);
+	glstate_DeleteBuffer(m->ibo);
+	deinit_XformTree(&m->nodes);
+	memset(m, 0, sizeof(Mesh));
+	m->node = XFORM_NONE;
+}
+
 void del_Mesh(Mesh *m) {
-	if (m->vertices != NULL) {
-		free(m->vertices);
+	deinit_Mesh(m);
+	pool_Free(&meshes, m);
+}
+
+/* countNodes returns the number of nodes in the tree under node */
+static uint32_t countNodes(const struct aiNode *node) {
+	uint32_t i, n;
+
+	for (i = 0, n = 1; i < node->mNumChildren; ++i) {
+		n += countNodes(node->mChildren[i]);
 	}
+	return n;
+}
 
-	glDeleteTextures(1, &m->depth);
-	glDeleteFramebuffers(1, &m->fbo);
-	free(m);
+/* flattenNodes adds node and its children to d under parent (parents
+ * first), recording the first node that places mesh 0 */
+static void flattenNodes(MeshData *d, const struct aiNode *node,
+			 uint32_t parent) {
+	const struct aiMatrix4x4 *t = &node->mTransformation;
+	uint32_t i, n;
+	Mat4x4 local = {t->a1, t->b1, t->c1, t->d1, t->a2, t->b2, t->c2, t->d2,
+			t->a3, t->b3, t->c3, t->d3, t->a4, t->b4, t->c4, t->d4};
+
+	n = d->numNodes++;
+	d->nodes[n] = local;
+	d->parents[n] = parent;
+	for (i = 0; i < node->mNumMeshes && d->node == XFORM_NONE; ++i) {
+		if (node->mMeshes[i] == 0) {
+			d->node = n;
+		}
+	}
+	for (i = 0; i < node->mNumChildren; ++i) {
+		flattenNodes(d, node->mChildren[i], n);
+	}
 }
 
-/* mesh_Load loads m with the mesh described by filename */
-void mesh_Load(Mesh *m, const char *filename) {
+/* mesh_Import reads the first mesh of filename, and the node hierarchy of
+ * its model, into d. It makes no GL calls, so it may run on any thread. */
+bool mesh_Import(const char *filename, MeshData *d) {
 	unsigned int i;
 	struct aiMesh *iMesh;
 	const struct aiScene *scene = aiImportFile(
@@ -90,144 +148,283 @@ void mesh_Load(Mesh *m, const char *filename) {
 			  aiProcess_JoinIdenticalVertices |
 			  aiProcess_SortByPType);
 	bool hasColors, hasTexcos, hasNormals;
+	uint32_t numNodes;
 
+	memset(d, 0, sizeof(MeshData));
+	d->node = XFORM_NONE;
 	if (scene == NULL) {
-		return;
+		printf("error: failed to import %s\n", filename);
+		return false;
 	}
 	if (scene->mNumMeshes == 0) {
-		return;
+		aiReleaseImport(scene);
+		return false;
 	}
 
 	iMesh = scene->mMeshes[0];
-	m->numVertices = iMesh->mNumVertices;
-	m->vertices = malloc(sizeof(MeshVertex) * m->numVertices);
+	numNodes = scene->mRootNode != NULL ? countNodes(scene->mRootNode) : 0;
+	d->vertices = malloc(sizeof(MeshVertex) * iMesh->mNumVertices);
+	d->faces = malloc(sizeof(Face) * iMesh->mNumFaces);
+	d->nodes = malloc(sizeof(Mat4x4) * numNodes);
+	d->parents = malloc(sizeof(uint32_t) * numNodes);
+	if (d->vertices == NULL || d->faces == NULL ||
+	    (numNodes > 0 && (d->nodes == NULL || d->parents == NULL))) {
+		printf("error: out of memory importing %s\n", filename);
+		aiReleaseImport(scene);
+		mesh_FreeData(d);
+		return false;
+	}
+	d->numVertices = iMesh->mNumVertices;
 
 	hasNormals = iMesh->mNormals != NULL;
 	hasColors = iMesh->mColors[0] != NULL;
 	hasTexcos = iMesh->mTextureCoords[0] != NULL;
 
 	/* get the vertices */
-	for (i = 0; i < m->numVertices; ++i) {
-		m->vertices[i].pos[0] = iMesh->mVertices[i].x;
-		m->vertices[i].pos[1] = iMesh->mVertices[i].y;
-		m->vertices[i].pos[2] = iMesh->mVertices[i].z;
+	for (i = 0; i < d->numVertices; ++i) {
+		d->vertices[i].pos[0] = iMesh->mVertices[i].x;
+		d->vertices[i].pos[1] = iMesh->mVertices[i].y;
+		d->vertices[i].pos[2] = iMesh->mVertices[i].z;
 
 		if (hasNormals) {
-			m->vertices[i].normal[0] = iMesh->mNormals[i].x;
-			m->vertices[i].normal[1] = iMesh->mNormals[i].y;
-			m->vertices[i].normal[2] = iMesh->mNormals[i].z;
+			d->vertices[i].normal[0] = iMesh->mNormals[i].x;
+			d->vertices[i].normal[1] = iMesh->mNormals[i].y;
+			d->vertices[i].normal[2] = iMesh->mNormals[i].z;
 		} else {
-			m->vertices[i].normal[0] = m->vertices[i].normal[1] =
-			    m->vertices[i].normal[2] = 0.0f;
+			d->vertices[i].normal[0] = d->vertices[i].normal[1] =
+			    d->vertices[i].normal[2] = 0.0f;
 		}
 
 		if (hasTexcos) {
-			m->vertices[i].texco[0] = iMesh->mTextureCoords[i][0].x;
-			m->vertices[i].texco[1] = iMesh->mTextureCoords[i][0].y;
+			d->vertices[i].texco[0] = iMesh->mTextureCoords[0][i].x;
+			d->vertices[i].texco[1] = iMesh->mTextureCoords[0][i].y;
 		} else {
-			m->vertices[i].texco[0] = m->vertices[i].texco[1] =
+			d->vertices[i].texco[0] = d->vertices[i].texco[1] =
 			    0.0f;
 		}
 
 		if (hasColors) {
-			m->vertices[i].color[0] = iMesh->mColors[i][0].r;
-			m->vertices[i].color[1] = iMesh->mColors[i][0].g;
-			m->vertices[i].color[2] = iMesh->mColors[i][0].b;
-			m->vertices[i].color[3] = iMesh->mColors[i][0].a;
+			d->vertices[i].color[0] = iMesh->mColors[0][i].r;
+			d->vertices[i].color[1] = iMesh->mColors[0][i].g;
+			d->vertices[i].color[2] = iMesh->mColors[0][i].b;
+			d->vertices[i].color[3] = iMesh->mColors[0][i].a;
 		} else {
-			m->vertices[i].color[0] = m->vertices[i].color[1] =
-			    m->vertices[i].color[2] = 0.0f;
-			m->vertices[i].color[3] = 1.0f;
+			d->vertices[i].color[0] = d->vertices[i].color[1] =
+			    d->vertices[i].color[2] = 0.0f;
+			d->vertices[i].color[3] = 1.0f;
 		}
 	}
 
+	/* ai_real is float unless assimp was built for double precision */
+	d->bounds = batch_Bounds((const Vector3 *)iMesh->mVertices,
+				 iMesh->mNumVertices);
+
 	/* get the indices for the faces */
-	m->faces = malloc(sizeof(Face) * m->numFaces);
 	for (i = 0; i < iMesh->mNumFaces; ++i) {
-		m->faces[i][0] = iMesh->mFaces[i].mIndices[0];
-		m->faces[i][1] = iMesh->mFaces[i].mIndices[1];
-		m->faces[i][2] = iMesh->mFaces[i].mIndices[2];
-	}
-	m->numFaces = iMesh->mNumFaces;
-
-	glGenVertexArrays(1, &m->vao);
-	glGenBuffers(1, &m->vbo);
-	glGenBuffers(1, &m->ibo);
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m->ibo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(Face) * m->numFaces,
-		     m->faces, GL_STATIC_DRAW);
-
-	glBindVertexArray(m->vao);
-	glEnableVertexAttribArray(0);
-	glBindBuffer(GL_ARRAY_BUFFER, m->vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(MeshVertex) * m->numVertices,
-		     m->vertices, GL_STATIC_DRAW);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex),
-			      (GLvoid *)offsetof(MeshVertex, pos));
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex),
-			      (GLvoid *)offsetof(MeshVertex, normal));
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(MeshVertex),
-			      (GLvoid *)offsetof(MeshVertex, color));
-	glEnableVertexAttribArray(3);
-	glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(MeshVertex),
-			      (GLvoid *)offsetof(MeshVertex, texco));
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+		d->faces[i][0] = iMesh->mFaces[i].mIndices[0];
+		d->faces[i][1] = iMesh->mFaces[i].mIndices[1];
+		d->faces[i][2] = iMesh->mFaces[i].mIndices[2];
+	}
+	d->numFaces = iMesh->mNumFaces;
 
+	if (scene->mRootNode != NULL) {
+		flattenNodes(d, scene->mRootNode, XFORM_NONE);
+	}
 	aiReleaseImport(scene);
+	mem_Add(MEM_MESHES, MEM_CPU, dataBytes(d));
+	return true;
+}
+
+/* mesh_FreeData frees the arrays of d */
+void mesh_FreeData(MeshData *d) {
+	mem_Sub(MEM_MESHES, MEM_CPU, dataBytes(d));
+	free(d->vertices);
+	free(d->faces);
+	free(d->nodes);
+	free(d->parents);
+	memset(d, 0, sizeof(MeshData));
+	d->node = XFORM_NONE;
+}
+
+/* mesh_Apply copies d to m and uploads it. m keeps its buffers; when the
+ * vertex and face counts are unchanged their storage is reused as well. */
+void mesh_Apply(Mesh *m, const MeshData *d) {
+	bool sameVertices, sameFaces, setup;
+	uint32_t i, *handles;
+
+	sameVertices = m->vertices != NULL && m->numVertices == d->numVertices;
+	sameFaces = m->faces != NULL && m->numFaces == d->numFaces;
+	/* the copies are counted again once they are made */
+	mem_Sub(MEM_MESHES, MEM_CPU, meshBytes(m));
+	if (!sameVertices) {
+		free(m->vertices);
+		m->vertices = malloc(sizeof(MeshVertex) * d->numVertices);
+	}
+	if (!sameFaces) {
+		free(m->faces);
+		m->faces = malloc(sizeof(Face) * d->numFaces);
+	}
+	if (m->vertices == NULL || m->faces == NULL) {
+		puts("error: out of memory loading mesh");
+		m->numVertices = m->numFaces = 0;
+		return;
+	}
+	memcpy(m->vertices, d->vertices, sizeof(MeshVertex) * d->numVertices);
+	memcpy(m->faces, d->faces, sizeof(Face) * d->numFaces);
+	m->numVertices = d->numVertices;
+	m->numFaces = d->numFaces;
+	m->bounds = d->bounds;
+	mem_Add(MEM_MESHES, MEM_CPU, meshBytes(m));
+
+	setup = m->vao == 0;
+	if (setup) {
+		glGenVertexArrays(1, &m->vao);
+		glGenBuffers(1, &m->vbo);
+		glGenBuffers(1, &m->ibo);
+	}
+
+	/* bind the VAO first so that it records the index buffer */
+	glstate_BindVertexArray(m->vao);
+	glstate_BindBuffer(GL_ELEMENT_ARRAY_BUFFER, m->ibo);
+	if (sameFaces) {
+		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0,
+				sizeof(Face) * m->numFaces, m->faces);
+	} else {
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+			     sizeof(Face) * m->numFaces, m->faces,
+			     GL_STATIC_DRAW);
+		mem_Track(MEM_BUFFER, m->ibo, MEM_MESHES,
+			  sizeof(Face) * m->numFaces);
+	}
+	glstate_BindBuffer(GL_ARRAY_BUFFER, m->vbo);
+	if (sameVertices) {
+		glBufferSubData(GL_ARRAY_BUFFER, 0,
+				sizeof(MeshVertex) * m->numVertices,
+				m->vertices);
+	} else {
+		glBufferData(GL_ARRAY_BUFFER,
+			     sizeof(MeshVertex) * m->numVertices, m->vertices,
+			     GL_STATIC_DRAW);
+		mem_Track(MEM_BUFFER, m->vbo, MEM_MESHES,
+			  sizeof(MeshVertex) * m->numVertices);
+	}
+	if (setup) {
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE,
+				      sizeof(MeshVertex),
+				      (GLvoid *)offsetof(MeshVertex, pos));
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE,
+				      sizeof(MeshVertex),
+				      (GLvoid *)offsetof(MeshVertex, normal));
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE,
+				      sizeof(MeshVertex),
+				      (GLvoid *)offsetof(MeshVertex, color));
+		glEnableVertexAttribArray(3);
+		glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE,
+				      sizeof(MeshVertex),
+				      (GLvoid *)offsetof(MeshVertex, texco));
+	}
+
+	/* rebuild the hierarchy; parents come first, so their handles are
+	 * known when their children are added */
+	deinit_XformTree(&m->nodes);
+	m->node = XFORM_NONE;
+	if (d->numNodes == 0 ||
+	    (handles = malloc(sizeof(uint32_t) * d->numNodes)) == NULL) {
+		return;
+	}
+	for (i = 0; i < d->numNodes; ++i) {
+		handles[i] = xform_Add(&m->nodes,
+				       d->parents[i] == XFORM_NONE
+					   ? XFORM_NONE
+					   : handles[d->parents[i]],
+				       &d->nodes[i]);
+		if (i == d->node) {
+			m->node = handles[i];
+		}
+	}
+	free(handles);
+}
+
+/* mesh_Load loads m with the mesh described by filename */
+void mesh_Load(Mesh *m, const char *filename) {
+	MeshData d;
+
+	if (mesh_Import(filename, &d)) {
+		mesh_Apply(m, &d);
+		mesh_FreeData(&d);
+	}
 }
 
 /* mesh_Draw renders mesh m. */
 void mesh_Draw(Mesh *m) {
-	static Mat4x4 mv, proj;
-	static GLuint mvUniform, projUniform;
-	static GLuint shader;
+	static bool matrices;
+	static Mat4x4 proj, view;
+	const Mat4x4 *world;
+	Mat4x4 mv;
 	GLint vp[4];
+	GLuint fbo;
+	uint32_t key;
 
 	if (m->color == 0 || m->fbo == 0) {
 		return;
 	}
 
-	/* create shader program */
-	if (shader == 0) {
-		const char *attrs[31] = {"pos", "normal", "color", "texco"};
-		shader = loadShader(vs, fs, 4, attrs);
-
-		/* get the uniforms */
-		mvUniform = glGetUniformLocation(shader, "mv");
-		projUniform = glGetUniformLocation(shader, "proj");
+	if (!matrices) {
 		mat4x4_perspective(&proj, 45.0f, 640.0f / 480.0f, 0.01f,
 				   1000.0f);
-		mat4x4_load_identity(&mv);
-		mat4x4_translate(&mv, 0.0f, 0.0f, -3.0f);
+		mat4x4_load_identity(&view);
+		mat4x4_translate(&view, 0.0f, 0.0f, -3.0f);
+		matrices = true;
+	}
+
+	/* place the mesh by its node in the model's hierarchy; only the nodes
+	 * that changed since the last draw are recomputed */
+	xform_Update(&m->nodes);
+	if ((world = xform_World(&m->nodes, m->node)) != NULL) {
+		mat4x4_multiply_to(&mv, &view, world);
+	} else {
+		mv = view;
+	}
+	material_SetMatrices(MATERIAL_MESH, &proj, &mv);
+	key = material_Key(MATERIAL_MESH, 0, m->material);
+	if (m->texture == 0) {
+		key &= ~MATERIAL_TEXTURED;
 	}
 
-	glBindFramebuffer(GL_FRAMEBUFFER, m->fbo);
-	glGetIntegerv(GL_VIEWPORT, vp);
-	glViewport(0, 0, 256, 256);
+	/* render to the mesh's target, then restore the caller's (which may be
+	 * the post-processing scene target) */
+	fbo = glstate_GetFramebuffer();
+	glstate_BindFramebuffer(m->fbo);
+	glstate_GetViewport(vp);
+	glstate_Viewport(0, 0, 256, 256);
 
-	glUseProgram(shader);
-	glUniformMatrix4fv(mvUniform, 1, GL_FALSE, ((GLfloat *)&mv));
-	glUniformMatrix4fv(projUniform, 1, GL_FALSE, ((GLfloat *)&proj));
+	if (material_Use(key, m->material) == 0) {
+		glstate_BindFramebuffer(fbo);
+		glstate_Viewport(vp[0], vp[1], vp[2], vp[3]);
+		return;
+	}
+	if (m->texture != 0) {
+		glstate_BindTexture(0, GL_TEXTURE_2D, m->texture);
+	}
 
 	glClearColor(1.0, 1.0, 1.0, 1.0);
 	glClearDepth(1.0f);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	glDisable(GL_BLEND);
-	glEnable(GL_DEPTH_TEST);
-	glDepthFunc(GL_LEQUAL);
+	glstate_Enable(GL_BLEND, false);
+	glstate_Enable(GL_DEPTH_TEST, true);
+	glstate_DepthFunc(GL_LEQUAL);
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m->ibo);
-	glBindVertexArray(m->vao);
+	glstate_BindVertexArray(m->vao);
 	glDrawElements(GL_TRIANGLES, m->numFaces * 3, GL_UNSIGNED_SHORT,
 		       (void *)0);
 
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	glViewport(vp[0], vp[1], vp[2], vp[3]);
-	glDisable(GL_DEPTH_TEST);
+	glstate_BindFramebuffer(fbo);
+	glstate_Viewport(vp[0], vp[1], vp[2], vp[3]);
+	glstate_Enable(GL_DEPTH_TEST, false);
 
 	return;
 }
@@ -2,8 +2,13 @@
 #define MESH_H
 
 #include <GL/glew.h>
+#include "batch.h"
+#include "xform.h"
 #include "render.h"
 
+/* the number of meshes new_Mesh() allocates at a time */
+enum { MESH_POOL_CHUNK = 16 };
+
 /* if >0, the offset of the attribute in the vertex memory layout */
 typedef struct {
 	int pos;
@@ -27,6 +32,11 @@ typedef struct {
 	Face *faces;
 	uint32_t numFaces;
 
+	Aabb bounds; /* the bounds of the vertex positions */
+
+	XformTree nodes; /* the node hierarchy of the model */
+	uint32_t node;   /* the node that places the mesh (or XFORM_NONE) */
+
 	GLuint vao; /* vertex attribute object */
 	GLuint vbo;
 	GLuint ibo;
@@ -34,12 +44,36 @@ typedef struct {
 
 	GLuint color; /* color texture */
 	GLuint depth; /* depth texture */
+
+	uint32_t material; /* material id (0 for the default) */
+	GLuint texture;    /* MATERIAL_TEXTURED: the texture to apply */
 } Mesh;
 
+/* MeshData is an imported mesh, not yet uploaded to a Mesh */
+typedef struct {
+	MeshVertex *vertices;
+	uint32_t numVertices;
+
+	Face *faces;
+	uint32_t numFaces;
+
+	Aabb bounds;
+
+	Mat4x4 *nodes;     /* the local transform of each node, parents first */
+	uint32_t *parents; /* the index of each node's parent or XFORM_NONE */
+	uint32_t numNodes;
+	uint32_t node; /* the index of the node that places the mesh */
+} MeshData;
+
 void init_Mesh();
+void deinit_Mesh(Mesh *);
 Mesh *new_Mesh();
 void del_Mesh(Mesh *);
 
+bool mesh_Import(const char *, MeshData *);
+void mesh_Apply(Mesh *, const MeshData *);
+void mesh_FreeData(MeshData *);
+
 void mesh_Load(Mesh *, const char *);
 void mesh_Draw(Mesh *);
 
@@ -0,0 +1,464 @@
+#include "post.h"
+#include <stdio.h>
+#include <string.h>
+#include "glstate.h"
+#include "mem.h"
+#include "util.h"
+
+/* the number of frames a timer query may take to come back */
+#define QUERY_FRAMES 3
+
+/* the range of bloom resolutions (the extract pass runs at 1 / 2^shift) */
+#define MIN_BLOOM_SHIFT 1
+#define MAX_BLOOM_SHIFT 3
+
+/* a full-screen triangle generated from gl_VertexID (no vertex buffers) */
+static const GLchar *vs =
+    "#version 150\n"
+    "out vec2 uv;\n"
+    "void main()\n"
+    "{\n"
+    "  uv = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);\n"
+    "  gl_Position = vec4(uv * 2.0 - 1.0, 0.0, 1.0);\n"
+    "}\n";
+
+/* every pass is a permutation of this source */
+static const GLchar *fs =
+    "#version 150\n"
+    "in vec2 uv;\n"
+    "out vec4 out_color;\n"
+    "uniform sampler2D src;\n"
+    "uniform sampler2D bloom;\n"
+    "uniform vec2 texel;\n"
+    "uniform vec2 dir;\n"
+    "uniform vec2 resolution;\n"
+    "uniform float threshold, intensity, scanlines, aberration;\n"
+    "uniform float contrast, saturation;\n"
+    "const vec3 luma = vec3(0.2126, 0.7152, 0.0722);\n"
+    "void main()\n"
+    "{\n"
+    "#if defined(PASS_EXTRACT)\n"
+    "  vec3 c = texture(src, uv).rgb;\n"
+    "  float l = dot(c, luma);\n"
+    "  out_color = vec4(c * max(l - threshold, 0.0) / max(l, 1e-4), 1.0);\n"
+    "#elif defined(PASS_BLUR)\n"
+    /* 9-tap gaussian from 5 bilinear fetches */
+    "  vec2 o1 = dir * texel * 1.3846153846;\n"
+    "  vec2 o2 = dir * texel * 3.2307692308;\n"
+    "  vec3 c = texture(src, uv).rgb * 0.2270270270;\n"
+    "  c += (texture(src, uv + o1).rgb + texture(src, uv - o1).rgb) *\n"
+    "       0.3162162162;\n"
+    "  c += (texture(src, uv + o2).rgb + texture(src, uv - o2).rgb) *\n"
+    "       0.0702702703;\n"
+    "  out_color = vec4(c, 1.0);\n"
+    "#else\n"
+    "#ifdef CHROMA\n"
+    "  vec2 d = (uv - 0.5) * aberration;\n"
+    "  vec3 c = vec3(texture(src, uv + d).r, texture(src, uv).g,\n"
+    "                texture(src, uv - d).b);\n"
+    "#else\n"
+    "  vec3 c = texture(src, uv).rgb;\n"
+    "#endif\n"
+    "#ifdef BLOOM\n"
+    "  c += texture(bloom, uv).rgb * intensity;\n"
+    "#endif\n"
+    "#ifdef CRT\n"
+    "  float line = 0.5 + 0.5 * sin(uv.y * resolution.y * 3.14159265);\n"
+    "  c *= mix(1.0, line, scanlines);\n"
+    "  vec2 v = uv * (1.0 - uv.yx);\n"
+    "  c *= pow(v.x * v.y * 16.0, 0.15);\n"
+    "#endif\n"
+    "#ifdef GRADE\n"
+    "  c = mix(vec3(dot(c, luma)), c, saturation);\n"
+    "  c = (c - 0.5) * contrast + 0.5;\n"
+    "#endif\n"
+    "  out_color = vec4(c, 1.0);\n"
+    "#endif\n"
+    "}\n";
+
+/* PostTarget is a pooled color render target */
+typedef struct {
+	GLuint fbo, tex;
+	uint32_t w, h;
+	bool used;
+} PostTarget;
+
+/* PostTimer measures a stage with GL_TIME_ELAPSED queries. Results are read
+ * QUERY_FRAMES frames later so the CPU never waits on the GPU. */
+typedef struct {
+	GLuint queries[QUERY_FRAMES];
+	bool pending[QUERY_FRAMES];
+	bool running;
+	float ms; /* smoothed GPU time */
+} PostTimer;
+
+/* the passes post_End runs */
+enum { STAGE_BLOOM = 0, STAGE_COMPOSITE, NUM_STAGES };
+
+/* PostProgram is a pass program and its uniforms */
+typedef struct {
+	GLuint program;
+	GLint texel, dir, resolution, threshold, intensity, scanlines,
+	    aberration, contrast, saturation;
+} PostProgram;
+
+static struct {
+	uint32_t effects; /* enabled effects */
+	uint32_t dropped; /* effects dropped for running over budget */
+	PostParams params;
+	uint32_t bloomShift;
+
+	PostTarget pool[POST_MAX_TARGETS];
+	PostTarget *scene;
+	uint32_t w, h;
+
+	PostProgram extract, blur, composite[POST_ALL + 1];
+	GLuint vao;
+
+	PostTimer timers[NUM_STAGES];
+	uint32_t frame;
+	bool initialized;
+} post = {.params = {.bloomThreshold = 0.6f,
+		     .bloomIntensity = 0.8f,
+		     .scanlines = 0.35f,
+		     .aberration = 0.004f,
+		     .contrast = 1.1f,
+		     .saturation = 1.15f,
+		     .bloomBudget = 1.5f,
+		     .compositeBudget = 2.0f},
+	  .bloomShift = MIN_BLOOM_SHIFT};
+
+/* post_Enable sets the enabled POST_* effects (0 renders straight to the
+ * window). Effects dropped for running over budget are restored. */
+void post_Enable(uint32_t effects) {
+	post.effects = effects & POST_ALL;
+	post.dropped = 0;
+	post.bloomShift = MIN_BLOOM_SHIFT;
+}
+
+/* post_Effects returns the effects that are currently applied */
+uint32_t post_Effects() { return post.effects & ~post.dropped; }
+
+void post_SetParams(const PostParams *p) { post.params = *p; }
+
+PostParams post_Params() { return post.params; }
+
+/* acquire returns an unused w x h target from the pool. Targets of the right
+ * size are preferred so that steady-state frames never reallocate. */
+static PostTarget *acquire(uint32_t w, uint32_t h) {
+	PostTarget *t, *empty, *other;
+	int i;
+
+	empty = other = NULL;
+	for (i = 0; i < POST_MAX_TARGETS; ++i) {
+		t = &post.pool[i];
+		if (t->used) {
+			continue;
+		}
+		if (t->fbo != 0 && t->w == w && t->h == h) {
+			t->used = true;
+			return t;
+		}
+		if (t->fbo == 0 && empty == NULL) {
+			empty = t;
+		} else if (t->fbo != 0 && other == NULL) {
+			other = t;
+		}
+	}
+	if ((t = empty != NULL ? empty : other) == NULL) {
+		puts("error: post-processing target pool exhausted");
+		return NULL;
+	}
+
+	if (t->fbo == 0) {
+		glGenTextures(1, &t->tex);
+		glGenFramebuffers(1, &t->fbo);
+	}
+	glstate_BindTexture(0, GL_TEXTURE_2D, t->tex);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0, GL_RGBA,
+		     GL_UNSIGNED_BYTE, NULL);
+	mem_Track(MEM_TEXTURE, t->tex, MEM_POST, (size_t)w * h * 4);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glstate_BindFramebuffer(t->fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+			       GL_TEXTURE_2D, t->tex, 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) !=
+	    GL_FRAMEBUFFER_COMPLETE) {
+		puts("error: incomplete post-processing target");
+	}
+	t->w = w;
+	t->h = h;
+	t->used = true;
+	return t;
+}
+
+static void release(PostTarget *t) {
+	if (t != NULL) {
+		t->used = false;
+	}
+}
+
+/* loadProgram builds the permutation of fs for defines */
+static void loadProgram(PostProgram *p, const char *defines) {
+	GLuint s;
+
+	s = p->program = loadShaderDefines(vs, fs, defines, 0, NULL);
+	glstate_UseProgram(s);
+	glUniform1i(glGetUniformLocation(s, "src"), 0);
+	glUniform1i(glGetUniformLocation(s, "bloom"), 1);
+	p->texel = glGetUniformLocation(s, "texel");
+	p->dir = glGetUniformLocation(s, "dir");
+	p->resolution = glGetUniformLocation(s, "resolution");
+	p->threshold = glGetUniformLocation(s, "threshold");
+	p->intensity = glGetUniformLocation(s, "intensity");
+	p->scanlines = glGetUniformLocation(s, "scanlines");
+	p->aberration = glGetUniformLocation(s, "aberration");
+	p->contrast = glGetUniformLocation(s, "contrast");
+	p->saturation = glGetUniformLocation(s, "saturation");
+}
+
+/* compositeProgram returns the composite pass for effects, building it on
+ * first use */
+static PostProgram *compositeProgram(uint32_t effects) {
+	PostProgram *p = &post.composite[effects];
+	char defines[128];
+
+	if (p->program == 0) {
+		snprintf(defines, sizeof(defines), "%s%s%s%s",
+			 effects & POST_BLOOM ? "#define BLOOM 1\n" : "",
+			 effects & POST_CRT ? "#define CRT 1\n" : "",
+			 effects & POST_CHROMA ? "#define CHROMA 1\n" : "",
+			 effects & POST_GRADE ? "#define GRADE 1\n" : "");
+		loadProgram(p, defines);
+	}
+	return p;
+}
+
+/* init creates the objects shared by every frame */
+static void init() {
+	int i;
+
+	loadProgram(&post.extract, "#define PASS_EXTRACT 1\n");
+	loadProgram(&post.blur, "#define PASS_BLUR 1\n");
+	glGenVertexArrays(1, &post.vao);
+	if (GLEW_ARB_timer_query) {
+		for (i = 0; i < NUM_STAGES; ++i) {
+			glGenQueries(QUERY_FRAMES, post.timers[i].queries);
+		}
+	}
+	post.initialized = true;
+}
+
+/* timerBegin starts timing a stage unless its query slot is still in flight.
+ * A finished result in the slot is folded into the stage's average. */
+static void timerBegin(PostTimer *t) {
+	uint32_t slot = post.frame % QUERY_FRAMES;
+	GLuint64 ns;
+	GLint done;
+
+	if (!GLEW_ARB_timer_query) {
+		return;
+	}
+	if (t->pending[slot]) {
+		glGetQueryObjectiv(t->queries[slot], GL_QUERY_RESULT_AVAILABLE,
+				   &done);
+		if (!done) {
+			return;
+		}
+		glGetQueryObjectui64v(t->queries[slot], GL_QUERY_RESULT, &ns);
+		t->ms = t->ms == 0.0f ? ns / 1e6f : t->ms * 0.9f + ns / 1e7f;
+		t->pending[slot] = false;
+	}
+	glBeginQuery(GL_TIME_ELAPSED, t->queries[slot]);
+	t->running = true;
+}
+
+static void timerEnd(PostTimer *t) {
+	if (t->running) {
+		glEndQuery(GL_TIME_ELAPSED);
+		t->pending[post.frame % QUERY_FRAMES] = true;
+		t->running = false;
+	}
+}
+
+/* post_Begin redirects rendering of a w x h pixel frame to the scene target
+ * if any effect is enabled. Returns false (and changes nothing) otherwise. */
+bool post_Begin(uint32_t w, uint32_t h) {
+	if (post_Effects() == 0 || w == 0 || h == 0) {
+		return false;
+	}
+	if (!post.initialized) {
+		init();
+	}
+	if ((post.scene = acquire(w, h)) == NULL) {
+		return false;
+	}
+	post.w = w;
+	post.h = h;
+	glstate_BindFramebuffer(post.scene->fbo);
+	glstate_Viewport(0, 0, w, h);
+	return true;
+}
+
+/* pass draws src through program p into dst (the window if NULL) */
+static void pass(PostProgram *p, PostTarget *src, PostTarget *dst) {
+	if (dst != NULL) {
+		glstate_BindFramebuffer(dst->fbo);
+		glstate_Viewport(0, 0, dst->w, dst->h);
+	} else {
+		glstate_BindFramebuffer(0);
+		glstate_Viewport(0, 0, post.w, post.h);
+	}
+	glstate_UseProgram(p->program);
+	glUniform2f(p->texel, 1.0f / src->w, 1.0f / src->h);
+	glstate_BindTexture(0, GL_TEXTURE_2D, src->tex);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+/* bloom blurs the bright parts of the scene, returning the result */
+static PostTarget *bloom() {
+	const PostParams *pp = &post.params;
+	PostTarget *bright, *half, *full;
+	uint32_t s = post.bloomShift;
+
+	bright = acquire(post.w >> s ? post.w >> s : 1,
+			 post.h >> s ? post.h >> s : 1);
+	half = acquire(post.w >> (s + 1) ? post.w >> (s + 1) : 1,
+		       post.h >> (s + 1) ? post.h >> (s + 1) : 1);
+	full = NULL;
+	if (bright == NULL || half == NULL) {
+		release(bright);
+		release(half);
+		return NULL;
+	}
+
+	glstate_UseProgram(post.extract.program);
+	glUniform1f(post.extract.threshold, pp->bloomThreshold);
+	pass(&post.extract, post.scene, bright);
+
+	/* separable blur, downsampling on the first axis */
+	glstate_UseProgram(post.blur.program);
+	glUniform2f(post.blur.dir, 1.0f, 0.0f);
+	pass(&post.blur, bright, half);
+	release(bright);
+	if ((full = acquire(half->w, half->h)) != NULL) {
+		glUniform2f(post.blur.dir, 0.0f, 1.0f);
+		pass(&post.blur, half, full);
+	}
+	release(half);
+	return full;
+}
+
+/* adapt degrades stages that ran over budget */
+static void adapt() {
+	const PostParams *pp = &post.params;
+	PostTimer *b = &post.timers[STAGE_BLOOM];
+	PostTimer *c = &post.timers[STAGE_COMPOSITE];
+
+	if (b->ms > pp->bloomBudget) {
+		if (post.bloomShift < MAX_BLOOM_SHIFT) {
+			post.bloomShift++;
+		} else {
+			post.dropped |= POST_BLOOM;
+		}
+		b->ms = 0.0f;
+	}
+	if (c->ms > pp->compositeBudget) {
+		if (post_Effects() & POST_CHROMA) {
+			post.dropped |= POST_CHROMA;
+		} else if (post_Effects() & POST_CRT) {
+			post.dropped |= POST_CRT;
+		}
+		c->ms = 0.0f;
+	}
+}
+
+/* post_End applies the enabled effects to the scene and draws the result to
+ * the window */
+void post_End() {
+	const PostParams *pp = &post.params;
+	PostTarget *blurred;
+	PostProgram *p;
+	uint32_t effects;
+
+	if (post.scene == NULL) {
+		return;
+	}
+	effects = post_Effects();
+	glstate_BindVertexArray(post.vao);
+	glstate_Enable(GL_BLEND, false);
+
+	blurred = NULL;
+	if (effects & POST_BLOOM) {
+		timerBegin(&post.timers[STAGE_BLOOM]);
+		blurred = bloom();
+		timerEnd(&post.timers[STAGE_BLOOM]);
+		if (blurred == NULL) {
+			effects &= ~POST_BLOOM;
+		}
+	}
+
+	timerBegin(&post.timers[STAGE_COMPOSITE]);
+	p = compositeProgram(effects);
+	glstate_UseProgram(p->program);
+	glUniform2f(p->resolution, post.w, post.h);
+	glUniform1f(p->intensity, pp->bloomIntensity);
+	glUniform1f(p->scanlines, pp->scanlines);
+	glUniform1f(p->aberration, pp->aberration);
+	glUniform1f(p->contrast, pp->contrast);
+	glUniform1f(p->saturation, pp->saturation);
+	if (blurred != NULL) {
+		glstate_BindTexture(1, GL_TEXTURE_2D, blurred->tex);
+	}
+	pass(p, post.scene, NULL);
+	timerEnd(&post.timers[STAGE_COMPOSITE]);
+
+	release(blurred);
+	release(post.scene);
+	post.scene = NULL;
+	post.frame++;
+	adapt();
+}
+
+/* post_Report prints the GPU time of each stage */
+void post_Report() {
+	printf("post: effects %x (dropped %x), bloom 1/%u: %.2f ms, "
+	       "composite: %.2f ms\n",
+	       post.effects, post.dropped, 1u << post.bloomShift,
+	       post.timers[STAGE_BLOOM].ms, post.timers[STAGE_COMPOSITE].ms);
+}
+
+/* post_Free deletes every GL object owned by post */
+void post_Free() {
+	int i;
+
+	for (i = 0; i < POST_MAX_TARGETS; ++i) {
+		if (post.pool[i].fbo != 0) {
+			glstate_DeleteFramebuffer(post.pool[i].fbo);
+			glstate_DeleteTexture(post.pool[i].tex);
+		}
+	}
+	memset(post.pool, 0, sizeof(post.pool));
+	if (post.initialized) {
+		glstate_DeleteProgram(post.extract.program);
+		glstate_DeleteProgram(post.blur.program);
+		for (i = 0; i <= POST_ALL; ++i) {
+			if (post.composite[i].program != 0) {
+				glstate_DeleteProgram(post.composite[i].program);
+			}
+		}
+		memset(post.composite, 0, sizeof(post.composite));
+		glstate_DeleteVertexArray(post.vao);
+		if (GLEW_ARB_timer_query) {
+			for (i = 0; i < NUM_STAGES; ++i) {
+				glDeleteQueries(QUERY_FRAMES,
+						post.timers[i].queries);
+			}
+		}
+		memset(post.timers, 0, sizeof(post.timers));
+		post.initialized = false;
+	}
+}
@@ -0,0 +1,54 @@
+/*
+ * post.h
+ * post applies full-screen effects to the rendered grid. While any effect is
+ * enabled the grid is drawn into an offscreen scene target; post_End() then
+ * runs the bloom passes at reduced resolution and a single full-resolution
+ * composite pass (bloom, CRT scanlines, chromatic aberration and color
+ * grading) into the default framebuffer. Targets are pooled and reused every
+ * frame. Each stage is timed on the GPU and degraded when it runs over its
+ * budget.
+ */
+#ifndef POST_H
+#define POST_H
+
+#include <GL/glew.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Post-processing effects */
+enum { POST_BLOOM = 1,
+       POST_CRT = 2,
+       POST_CHROMA = 4, /* chromatic aberration */
+       POST_GRADE = 8,  /* color grading */
+       POST_ALL = 15 };
+
+/* the most targets kept in the pool */
+enum { POST_MAX_TARGETS = 8 };
+
+/* PostParams tunes the effects */
+typedef struct {
+	float bloomThreshold; /* luminance above which pixels bloom */
+	float bloomIntensity;
+	float scanlines;  /* 0 (none) to 1 (black between lines) */
+	float aberration; /* channel offset at the screen edge (in UV) */
+	float contrast;
+	float saturation;
+
+	/* GPU time budgets (ms). Bloom drops resolution when over budget; the
+	 * composite pass drops aberration, then scanlines. */
+	float bloomBudget;
+	float compositeBudget;
+} PostParams;
+
+void post_Enable(uint32_t);
+uint32_t post_Effects();
+void post_SetParams(const PostParams *);
+PostParams post_Params();
+
+bool post_Begin(uint32_t, uint32_t);
+void post_End();
+
+void post_Report();
+void post_Free();
+
+#endif
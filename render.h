@@ -34,6 +34,7 @@ typedef struct {
 typedef struct {
 	uint32_t font_size;
 	uint32_t color;
+	uint32_t material; /* material id (0 for the default) */
 } RenderProperties;
 
 #endif
@@ -0,0 +1,149 @@
+#include "replay.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sched.h"
+
+/* ReplayEvent is a recorded event and its time from the start */
+typedef struct {
+	double t;
+	SDL_Event evt;
+} ReplayEvent;
+
+static struct {
+	FILE *out;    /* the recording, if any */
+	double start; /* sched_Now() at the start of recording or playback */
+
+	ReplayEvent *events;
+	uint32_t numEvents, next;
+} replay;
+
+/* replay_Record starts recording input events to path */
+bool replay_Record(const char *path) {
+	if ((replay.out = fopen(path, "w")) == NULL) {
+		printf("error: failed to open %s for recording\n", path);
+		return false;
+	}
+	replay.start = sched_Now();
+	return true;
+}
+
+/* replay_Save records evt if it is an input event and recording is on */
+void replay_Save(const SDL_Event *evt) {
+	double t;
+
+	if (replay.out == NULL) {
+		return;
+	}
+	t = sched_Now() - replay.start;
+	switch (evt->type) {
+		case SDL_KEYDOWN:
+		case SDL_KEYUP:
+			fprintf(replay.out, "%.6f key %d %d %d %d\n", t,
+				evt->type == SDL_KEYDOWN,
+				(int)evt->key.keysym.scancode,
+				(int)evt->key.keysym.sym,
+				(int)evt->key.keysym.mod);
+			break;
+		case SDL_TEXTINPUT:
+			fprintf(replay.out, "%.6f text %s\n", t,
+				evt->text.text);
+			break;
+		default:
+			break;
+	}
+}
+
+/* parse decodes the recorded event in line into e. Returns false if the
+ * line holds no event. */
+static bool parse(const char *line, ReplayEvent *e) {
+	int down, scancode, sym, mod, n;
+	char kind[8];
+
+	memset(e, 0, sizeof(ReplayEvent));
+	if (sscanf(line, "%lf %7s %n", &e->t, kind, &n) != 2) {
+		return false;
+	}
+	if (strcmp(kind, "key") == 0) {
+		if (sscanf(line + n, "%d %d %d %d", &down, &scancode, &sym,
+			   &mod) != 4) {
+			return false;
+		}
+		e->evt.type = down ? SDL_KEYDOWN : SDL_KEYUP;
+		e->evt.key.state = down ? SDL_PRESSED : SDL_RELEASED;
+		e->evt.key.keysym.scancode = scancode;
+		e->evt.key.keysym.sym = sym;
+		e->evt.key.keysym.mod = mod;
+		return true;
+	}
+	if (strcmp(kind, "text") == 0) {
+		e->evt.type = SDL_TEXTINPUT;
+		strncpy(e->evt.text.text, line + n,
+			sizeof(e->evt.text.text) - 1);
+		e->evt.text.text[strcspn(e->evt.text.text, "\n")] = '\0';
+		return true;
+	}
+	return false;
+}
+
+/* replay_Load loads the recording at path and starts playing it back */
+bool replay_Load(const char *path) {
+	char line[128];
+	FILE *in;
+
+	if ((in = fopen(path, "r")) == NULL) {
+		printf("error: failed to open replay %s\n", path);
+		return false;
+	}
+	free(replay.events);
+	replay.events = malloc(REPLAY_MAX_EVENTS * sizeof(ReplayEvent));
+	replay.numEvents = replay.next = 0;
+	if (replay.events == NULL) {
+		puts("error: failed to allocate replay");
+		fclose(in);
+		return false;
+	}
+	while (fgets(line, sizeof(line), in) != NULL &&
+	       replay.numEvents < REPLAY_MAX_EVENTS) {
+		if (parse(line, &replay.events[replay.numEvents])) {
+			replay.numEvents++;
+		}
+	}
+	fclose(in);
+	replay.start = sched_Now();
+	return true;
+}
+
+/* replay_Playing returns true while recorded events remain to be played */
+bool replay_Playing() {
+	return replay.events != NULL && replay.next < replay.numEvents;
+}
+
+/* replay_Pump pushes the recorded events that are due onto the SDL event
+ * queue. Returns the milliseconds until the next one (-1 if none remain). */
+int32_t replay_Pump() {
+	double now;
+	ReplayEvent *e;
+
+	if (!replay_Playing()) {
+		return -1;
+	}
+	now = sched_Now() - replay.start;
+	for (; replay.next < replay.numEvents; ++replay.next) {
+		e = &replay.events[replay.next];
+		if (e->t > now) {
+			return (int32_t)((e->t - now) * 1000.0);
+		}
+		SDL_PushEvent(&e->evt);
+	}
+	return -1;
+}
+
+/* replay_Close ends recording and playback */
+void replay_Close() {
+	if (replay.out != NULL) {
+		fclose(replay.out);
+	}
+	free(replay.events);
+	memset(&replay, 0, sizeof(replay));
+}
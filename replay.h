@@ -0,0 +1,28 @@
+/*
+ * replay.h
+ * replay records input events to a file and plays them back at the times
+ * they were recorded, so that latency can be measured over the same input
+ * on every run. Events are stored one per line with their time from the
+ * start of the recording:
+ *   <seconds> key <down> <scancode> <keycode> <mod>
+ *   <seconds> text <utf-8 text>
+ * Without a display, run it under SDL_VIDEODRIVER=offscreen.
+ */
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* the most events held by a replay */
+enum { REPLAY_MAX_EVENTS = 65536 };
+
+bool replay_Record(const char *);
+void replay_Save(const SDL_Event *);
+bool replay_Load(const char *);
+bool replay_Playing();
+int32_t replay_Pump();
+void replay_Close();
+
+#endif
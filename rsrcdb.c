@@ -0,0 +1,325 @@
+#define _DEFAULT_SOURCE
+#include "rsrcdb.h"
+#include <ctype.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+enum { RSRCDB_MAGIC = 0x44524c47, /* "GLRD" */
+       RSRCDB_VERSION = 1 };
+
+/* the longest line of a text database */
+enum { RSRCDB_MAX_LINE = 1024 };
+
+/* RsrcDbHeader begins each binary database */
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t count;      /* the number of entries */
+	uint32_t stringsLen; /* the length of the string table */
+} RsrcDbHeader;
+
+/* the offset of the entries (the header and slot table) */
+#define RSRCDB_ENTRIES (sizeof(RsrcDbHeader) + RSRC_CODES * sizeof(uint16_t))
+
+/* init_RsrcDb maps the compiled database at path */
+bool init_RsrcDb(RsrcDb *db, const char *path) {
+	const RsrcDbHeader *hdr;
+	struct stat st;
+	size_t len;
+	void *p;
+	int fd;
+
+	memset(db, 0, sizeof(RsrcDb));
+	if ((fd = open(path, O_RDONLY)) < 0) {
+		printf("error: failed to open resources %s\n", path);
+		return false;
+	}
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < RSRCDB_ENTRIES) {
+		printf("error: invalid resources %s\n", path);
+		close(fd);
+		return false;
+	}
+	len = st.st_size;
+	p = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED) {
+		printf("error: failed to map resources %s\n", path);
+		return false;
+	}
+
+	hdr = p;
+	if (hdr->magic != RSRCDB_MAGIC || hdr->version != RSRCDB_VERSION ||
+	    hdr->count > RSRC_CODES || hdr->stringsLen == 0 ||
+	    len != RSRCDB_ENTRIES + hdr->count * sizeof(RsrcEntry) +
+		       hdr->stringsLen ||
+	    ((const char *)p)[len - 1] != '\0') {
+		printf("error: invalid resources %s\n", path);
+		munmap(p, len);
+		return false;
+	}
+	db->map = p;
+	db->len = len;
+	db->slots = (const uint16_t *)(db->map + sizeof(RsrcDbHeader));
+	db->entries = (const RsrcEntry *)(db->map + RSRCDB_ENTRIES);
+	db->strings = (const char *)(db->entries + hdr->count);
+	db->count = hdr->count;
+	db->stringsLen = hdr->stringsLen;
+	return true;
+}
+
+/* deinit_RsrcDb unmaps db. The paths it returned are no longer valid. */
+void deinit_RsrcDb(RsrcDb *db) {
+	if (db->map != NULL) {
+		munmap((void *)db->map, db->len);
+	}
+	memset(db, 0, sizeof(RsrcDb));
+}
+
+/* rsrcdb_Find returns the entry of code, or NULL if it has none or its
+ * entry is invalid */
+const RsrcEntry *rsrcdb_Find(const RsrcDb *db, uint32_t code) {
+	const RsrcEntry *e;
+	uint32_t slot;
+
+	if (db->map == NULL || code < CODEPAGE_RSRC || code > CODEPAGE_END) {
+		return NULL;
+	}
+	slot = db->slots[code - CODEPAGE_RSRC];
+	if (slot == 0 || slot > db->count) {
+		return NULL;
+	}
+	/* opening only checked the layout of the file, so that it reads none
+	 * of the entries; the fields of an entry are checked on each lookup,
+	 * as parseLine() checks them when compiling */
+	e = &db->entries[slot - 1];
+	if (e->code != code || e->path >= db->stringsLen ||
+	    (e->kind != RSRC_MESH && e->kind != RSRC_IMAGE) || e->w == 0 ||
+	    e->h == 0 || e->w > RUNE_MAX_W || e->h > RUNE_MAX_H) {
+		return NULL;
+	}
+	return e;
+}
+
+/* rsrcdb_Path returns the path of the resource of e */
+const char *rsrcdb_Path(const RsrcDb *db, const RsrcEntry *e) {
+	return db->strings + e->path;
+}
+
+/* rsrcdb_Rune sets r to a rune showing the resource of code. Its filename
+ * points into db, which must stay open while r is in use. Returns false if
+ * code has no resource. */
+bool rsrcdb_Rune(const RsrcDb *db, uint32_t code, Rune_ *r) {
+	const RsrcEntry *e;
+
+	if ((e = rsrcdb_Find(db, code)) == NULL) {
+		return false;
+	}
+	switch (e->kind) {
+		case RSRC_MESH:
+			r->mesh = rune_blankMesh;
+			r->mesh.filename = rsrcdb_Path(db, e);
+			break;
+		case RSRC_IMAGE:
+			r->img = rune_blankImg;
+			r->img.filename = rsrcdb_Path(db, e);
+			break;
+		default:
+			return false;
+	}
+	r->r.code = code;
+	r->r.w = e->w;
+	r->r.h = e->h;
+	return true;
+}
+
+/*****************************************************************************/
+/* Compiler                                                                  */
+/*****************************************************************************/
+
+/* RsrcText is a text database being compiled */
+typedef struct {
+	RsrcEntry *byCode; /* the entry of each codepoint */
+	bool *present;     /* the codepoints defined */
+	char *strings;
+	size_t stringsLen, stringsCap;
+} RsrcText;
+
+/* addString appends s to the string table of t, returning its offset */
+static bool addString(RsrcText *t, const char *s, uint32_t *off) {
+	size_t n = strlen(s) + 1;
+	char *p;
+
+	if (t->stringsLen + n > UINT32_MAX) {
+		return false;
+	}
+	if (t->stringsLen + n > t->stringsCap) {
+		t->stringsCap = (t->stringsLen + n) * 2;
+		if ((p = realloc(t->strings, t->stringsCap)) == NULL) {
+			return false;
+		}
+		t->strings = p;
+	}
+	memcpy(t->strings + t->stringsLen, s, n);
+	*off = t->stringsLen;
+	t->stringsLen += n;
+	return true;
+}
+
+/* parseLine decodes the resource on line into e. Returns its path, or NULL
+ * if the line is malformed. */
+static char *parseLine(char *line, RsrcEntry *e) {
+	unsigned long code;
+	unsigned w, h;
+	char kind[8], *end, *path;
+	int n;
+
+	if ((line[0] == 'U' || line[0] == 'u') && line[1] == '+') {
+		line += 2;
+	}
+	code = strtoul(line, &end, 16);
+	if (end == line ||
+	    sscanf(end, " %7s %u %u %n", kind, &w, &h, &n) != 3) {
+		return NULL;
+	}
+	if (code < CODEPAGE_RSRC || code > CODEPAGE_END || w == 0 || h == 0 ||
+	    w > RUNE_MAX_W || h > RUNE_MAX_H) {
+		return NULL;
+	}
+	memset(e, 0, sizeof(RsrcEntry));
+	if (strcmp(kind, "mesh") == 0) {
+		e->kind = RSRC_MESH;
+	} else if (strcmp(kind, "image") == 0) {
+		e->kind = RSRC_IMAGE;
+	} else {
+		return NULL;
+	}
+	e->code = code;
+	e->w = w;
+	e->h = h;
+
+	path = end + n;
+	for (n = strlen(path); n > 0 && isspace((unsigned char)path[n - 1]);) {
+		path[--n] = '\0';
+	}
+	return *path != '\0' ? path : NULL;
+}
+
+/* parseText reads the text database src into t */
+static bool parseText(const char *src, RsrcText *t) {
+	char line[RSRCDB_MAX_LINE], *s, *path;
+	uint32_t lineNo, slot;
+	RsrcEntry e;
+	FILE *in;
+
+	if ((in = fopen(src, "r")) == NULL) {
+		printf("error: failed to open %s\n", src);
+		return false;
+	}
+	for (lineNo = 1; fgets(line, sizeof(line), in) != NULL; ++lineNo) {
+		for (s = line; isspace((unsigned char)*s); ++s) {
+		}
+		if (*s == '\0' || *s == '#') {
+			continue;
+		}
+		if ((path = parseLine(s, &e)) == NULL) {
+			printf("error: %s:%u: malformed resource\n", src,
+			       lineNo);
+			goto fail;
+		}
+		slot = e.code - CODEPAGE_RSRC;
+		if (t->present[slot]) {
+			printf("error: %s:%u: U+%04X is already defined\n",
+			       src, lineNo, e.code);
+			goto fail;
+		}
+		if (!addString(t, path, &e.path)) {
+			puts("error: out of memory compiling resources");
+			goto fail;
+		}
+		t->byCode[slot] = e;
+		t->present[slot] = true;
+	}
+	fclose(in);
+	return true;
+
+fail:
+	fclose(in);
+	return false;
+}
+
+/* writeDb writes the compiled database of t to dst */
+static bool writeDb(const RsrcText *t, const char *dst) {
+	RsrcDbHeader hdr;
+	uint16_t *slots;
+	char tmp[520];
+	uint32_t i;
+	FILE *f;
+	bool ok;
+
+	if ((slots = calloc(RSRC_CODES, sizeof(uint16_t))) == NULL) {
+		puts("error: out of memory compiling resources");
+		return false;
+	}
+	hdr.magic = RSRCDB_MAGIC;
+	hdr.version = RSRCDB_VERSION;
+	hdr.count = 0;
+	hdr.stringsLen = t->stringsLen;
+	for (i = 0; i < RSRC_CODES; ++i) {
+		if (t->present[i]) {
+			slots[i] = ++hdr.count;
+		}
+	}
+
+	/* write to a temporary file first so that the database is replaced
+	 * whole, even while it is mapped */
+	snprintf(tmp, sizeof(tmp), "%s.tmp", dst);
+	if ((f = fopen(tmp, "wb")) == NULL) {
+		printf("error: failed to open %s\n", tmp);
+		free(slots);
+		return false;
+	}
+	ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1 &&
+	     fwrite(slots, sizeof(uint16_t), RSRC_CODES, f) == RSRC_CODES;
+	for (i = 0; i < RSRC_CODES && ok; ++i) {
+		if (t->present[i]) {
+			ok = fwrite(&t->byCode[i], sizeof(RsrcEntry), 1,
+				    f) == 1;
+		}
+	}
+	ok = ok && fwrite(t->strings, 1, t->stringsLen, f) == t->stringsLen;
+	ok = fclose(f) == 0 && ok;
+	free(slots);
+	if (!ok || rename(tmp, dst) != 0) {
+		printf("error: failed to write %s\n", dst);
+		remove(tmp);
+		return false;
+	}
+	return true;
+}
+
+/* rsrcdb_Compile compiles the text database src to the binary database
+ * dst */
+bool rsrcdb_Compile(const char *src, const char *dst) {
+	RsrcText t;
+	uint32_t empty;
+	bool ok;
+
+	memset(&t, 0, sizeof(t));
+	t.byCode = calloc(RSRC_CODES, sizeof(RsrcEntry));
+	t.present = calloc(RSRC_CODES, sizeof(bool));
+	/* offset 0 holds the empty string, so the table is never empty */
+	ok = t.byCode != NULL && t.present != NULL && addString(&t, "", &empty);
+	if (!ok) {
+		puts("error: out of memory compiling resources");
+	}
+	ok = ok && parseText(src, &t) && writeDb(&t, dst);
+	free(t.byCode);
+	free(t.present);
+	free(t.strings);
+	return ok;
+}
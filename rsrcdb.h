@@ -0,0 +1,58 @@
+/*
+ * rsrcdb.h
+ * The resource database maps a file's resource codepoints (U+E008..U+F8FF)
+ * to the resources they stand for. It is written as text, one resource per
+ * line (lines starting with '#' are comments):
+ *   <codepoint> <mesh|image> <w> <h> <path>
+ * e.g. "U+E008 mesh 3 3 models/cube.obj", and compiled by rsrcdb_Compile()
+ * (gled --compile-rsrc) to a binary file that is memory-mapped read-only:
+ *   RsrcDbHeader
+ *   uint16_t slots[RSRC_CODES]  the entry + 1 of each codepoint, 0 if none
+ *   RsrcEntry entries[count]    sorted by codepoint
+ *   char strings[]              the NUL-terminated paths
+ * Opening a database maps the file without reading it. A lookup indexes the
+ * slot table directly, so it is O(1), allocates nothing and, the mapping
+ * being read-only, needs no locking.
+ */
+#ifndef RSRCDB_H
+#define RSRCDB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "rune.h"
+
+/* the number of resource codepoints */
+enum { RSRC_CODES = CODEPAGE_END - CODEPAGE_RSRC + 1 };
+
+/* The kinds of resources */
+enum { RSRC_MESH = 1, RSRC_IMAGE = 2 };
+
+/* RsrcEntry describes the resource of one codepoint */
+typedef struct {
+	uint32_t code; /* the codepoint */
+	uint32_t path; /* the offset of the path in the string table */
+	uint16_t kind; /* RSRC_* */
+	uint16_t w, h; /* the cells the resource covers */
+	uint16_t pad;
+} RsrcEntry;
+
+/* RsrcDb is an open resource database */
+typedef struct {
+	const uint8_t *map;
+	size_t len;
+	const uint16_t *slots;
+	const RsrcEntry *entries;
+	const char *strings;
+	uint32_t count, stringsLen;
+} RsrcDb;
+
+bool init_RsrcDb(RsrcDb *, const char *);
+void deinit_RsrcDb(RsrcDb *);
+const RsrcEntry *rsrcdb_Find(const RsrcDb *, uint32_t);
+const char *rsrcdb_Path(const RsrcDb *, const RsrcEntry *);
+bool rsrcdb_Rune(const RsrcDb *, uint32_t, Rune_ *);
+
+bool rsrcdb_Compile(const char *, const char *);
+
+#endif
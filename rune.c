@@ -1,8 +1,16 @@
 #include "rune.h"
 #include <SDL2/SDL_ttf.h>
 #include <stdlib.h>
+#include <string.h>
+#include "alloc.h"
+#include "asset.h"
+#include "glstate.h"
+#include "glyphcache.h"
+#include "image.h"
+#include "mem.h"
 #include "matrix.h"
-#include "uthash.h"
+#include "sdf.h"
+#include "texcomp.h"
 #include "util.h"
 
 #define MAX_RUNE_PAGES 512
@@ -24,91 +32,133 @@ static SDL_PixelFormat pixelFmt = {.palette = 0,
 				   .Ashift = 24,
 				   .Amask = 0xff000000};
 
-/* LoadedTex is the type stored in the texture -> name hash table */
-typedef struct {
-	GLuint tex;
-	char name[32];
-	UT_hash_handle hh;
-} LoadedTex;
-static LoadedTex *loadedTextures = NULL;
-
-/* renders the given character to a texture and returns its GL handle */
-static GLuint latin1_to_texture(char c) {
-	static TTF_Font *font = NULL;
+/* the size glyphs without a size of their own are rasterized at */
+#define RUNE_FONT_PX 32
+
+/* the number of font sizes kept open for rasterizing glyphs */
+#define MAX_FONT_SIZES 8
+
+/* glyphs caches every glyph drawn so far (a zeroed GlyphCache is empty) */
+static GlyphCache glyphs;
+
+/* open_font returns the rune font at size px, opening it on first use */
+static TTF_Font *open_font(uint32_t px) {
+	static struct {
+		uint32_t px;
+		TTF_Font *font;
+	} fonts[MAX_FONT_SIZES];
+	static uint32_t numFonts = 0, oldest = 0;
+	TTF_Font *font;
+	uint32_t i;
+
+	for (i = 0; i < numFonts; ++i) {
+		if (fonts[i].px == px) {
+			return fonts[i].font;
+		}
+	}
+	if ((font = TTF_OpenFont(SDF_FONT, px)) == NULL) {
+		printf("failed to load font: %s\n", TTF_GetError());
+		return NULL;
+	}
+	/* once every slot is taken, close the font opened longest ago; the
+	 * fonts returned are only used until the next call */
+	if (numFonts < MAX_FONT_SIZES) {
+		i = numFonts++;
+	} else {
+		i = oldest;
+		oldest = (oldest + 1) % MAX_FONT_SIZES;
+		TTF_CloseFont(fonts[i].font);
+	}
+	fonts[i].px = px;
+	fonts[i].font = font;
+	return font;
+}
+
+/* glyph_to_texture rasterizes the glyph for code (in the given GLYPH_STYLE_*
+ * style and size in pixels) to a texture and returns its GL handle */
+static GLuint glyph_to_texture(uint32_t code, uint32_t style, uint32_t px) {
 	static SDL_Color color = {.r = 200, .g = 255, .b = 255, .a = 128};
-	char str[2];
-	SDL_Surface *surf;
-	LoadedTex *lup;
+	SDL_Surface *surf, *optSurf;
+	TTF_Font *font;
 	GLuint tex;
 
-	str[0] = c;
-	str[1] = '\0';
-
-	HASH_FIND_STR(loadedTextures, str, lup);
-	if (lup != NULL) {
-		return lup->tex;
+	if (code > 0xffff || (font = open_font(px)) == NULL) {
+		return 0;
 	}
+	TTF_SetFontStyle(font,
+			 (style & GLYPH_STYLE_BOLD ? TTF_STYLE_BOLD : 0) |
+			     (style & GLYPH_STYLE_ITALIC ? TTF_STYLE_ITALIC : 0));
 
-	if (font == NULL) {
-		font = TTF_OpenFont("C64.ttf", 32);
-	}
-	if (font == NULL) {
-		printf("failed to load font: %s\n", TTF_GetError());
+	if ((surf = TTF_RenderGlyph_Solid(font, code, color)) == NULL) {
+		printf("error: failed to render char U+%04X to texture: %s\n",
+		       code, TTF_GetError());
 		return 0;
 	}
-
-	tex = -1;
-	if ((surf = TTF_RenderText_Solid(font, str, color))) {
-		int colors;
-		SDL_Surface *optSurf;
-
-		optSurf = SDL_ConvertSurface(surf, &pixelFmt, SDL_SWSURFACE);
-		colors = surf->format->BytesPerPixel;
-		glGenTextures(1, &tex);
-		glBindTexture(GL_TEXTURE_2D, tex);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, optSurf->w, optSurf->h,
-			     0, GL_RGBA, GL_UNSIGNED_BYTE, optSurf->pixels);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
-				GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER,
-				GL_NEAREST);
-		SDL_FreeSurface(surf);
-	} else {
-		printf("error: failed to render char %c to texture: %s\n", c,
-		       TTF_GetError());
-		tex = 0;
+	optSurf = SDL_ConvertSurface(surf, &pixelFmt, SDL_SWSURFACE);
+	SDL_FreeSurface(surf);
+	if (optSurf == NULL) {
+		return 0;
 	}
+	glGenTextures(1, &tex);
+	glstate_BindTexture(0, GL_TEXTURE_2D, tex);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, optSurf->w, optSurf->h, 0,
+		     GL_RGBA, GL_UNSIGNED_BYTE, optSurf->pixels);
+	mem_Track(MEM_TEXTURE, tex, MEM_GLYPHS,
+		  (size_t)optSurf->w * optSurf->h * 4);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	SDL_FreeSurface(optSurf);
 
-	lup = malloc(sizeof(LoadedTex));
+	return tex;
+}
 
-	lup->name[0] = c;
-	lup->name[1] = '\0';
-	lup->tex = tex;
-	HASH_ADD_STR(loadedTextures, name, lup);
+/* rune_glyph returns the glyph for code in the given style and size (0 for
+ * the default), loading it on first use. Glyphs in the distance field atlas
+ * are shared by every size and style; others are rasterized. */
+static const Glyph *rune_glyph(uint32_t code, uint32_t style, uint32_t px) {
+	uint64_t key;
+	Glyph *g;
 
-	return tex;
+	key = GLYPH_KEY(0, style, px, code);
+	if ((g = glyphcache_Find(&glyphs, key)) != NULL) {
+		return g;
+	}
+	if ((g = glyphcache_Insert(&glyphs, key)) == NULL) {
+		return NULL;
+	}
+	if (sdf_Clip(code, &g->clip)) {
+		g->tex = sdf_Texture();
+		g->mode = RUNE_DRAW_SDF;
+		return g;
+	}
+	g->tex = glyph_to_texture(code, style, px ? px : RUNE_FONT_PX);
+	g->mode = RUNE_DRAW_TEXTURE;
+	g->clip.x = 0.0f;
+	g->clip.y = 0.0f;
+	g->clip.w = 1.0f;
+	g->clip.h = 1.0f;
+	return g;
 }
 
-/* bitmap to texture loads file and returns a handle an OpenGL texture of it */
-static GLuint bitmap_to_texture(const char *file) {
+/* image_to_texture loads file and returns a handle to an OpenGL texture of
+ * it. The image is block-compressed (with mipmaps) and the encoding is cached
+ * on disk, so later loads of an unchanged file skip decoding and encoding. */
+static GLuint image_to_texture(const char *file) {
 	GLuint tex;
-	SDL_Surface *surf;
-
-	surf = NULL;
-	tex = 0;
-	if ((surf = SDL_LoadBMP(file))) {
-		glGenTextures(1, &tex);
-		glBindTexture(GL_TEXTURE_2D, tex);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, surf->w, surf->h, 0,
-			     GL_RGB, GL_UNSIGNED_BYTE, surf->pixels);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
-				GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER,
-				GL_NEAREST);
-		SDL_FreeSurface(surf);
-	} else {
+	Image img;
+	uint64_t key;
+
+	key = texcomp_FileKey(file);
+	if ((tex = texcomp_LoadCached(key)) != 0) {
+		return tex;
+	}
+
+	if (!image_Load(file, &img)) {
 		printf("error: failed to load texture %s\n", file);
+		return 0;
 	}
+	tex = texcomp_Upload(key, img.pixels, img.w, img.h);
+	image_Free(&img);
 
 	return tex;
 }
@@ -118,47 +168,43 @@ uint32_t new_Runeset(const char *file) {
 	static uint32_t pages[MAX_RUNE_PAGES];
 	static uint32_t numPages = 0;
 
-	pages[numPages] = bitmap_to_texture(file);
+	pages[numPages] = image_to_texture(file);
 	return pages[numPages++];
 }
 
+/* runes holds the runes made by new_Rune (each large enough for any type) */
+static Pool runes;
+
 /* ctor */
 Rune *new_Rune() {
-	Rune *r = malloc(sizeof(Rune));
+	Rune *r;
 
-	r->draw = NULL;
-	r->update = NULL;
+	if (runes.size == 0) {
+		init_Pool(&runes, sizeof(Rune_), RUNE_POOL_CHUNK);
+	}
+	if ((r = pool_Alloc(&runes)) == NULL) {
+		return NULL;
+	}
+	memset(r, 0, sizeof(Rune_));
 	return r;
 }
 
 /* dtor */
-void del_Rune(Rune *r) { free(r); }
+void del_Rune(Rune *r) { pool_Free(&runes, r); }
 
 /* rune_Draw executes r's draw method */
 void rune_Draw(Rune *r, uint32_t x, uint32_t y) { r->draw(r, x, y); }
 
-/* rune_DrawChar renders the given rune at char position (x, y) */
-RuneDrawResult rune_DrawChar(Rune *rune, uint32_t x, uint32_t y) {
+/* rune_result returns the draw result of rune's full extent with nothing
+ * applied to it */
+static RuneDrawResult rune_result(Rune *rune) {
 	RuneDrawResult res;
-	CharRune *r;
-	GLfloat u, v;
-	GLuint sampler;
-
-	r = (CharRune *)rune;
-
-	/* load texture */
-	if (r->texture == 0) {
-		r->texture = latin1_to_texture('a');  // r->id);
-		glGenSamplers(1, &sampler);
-		glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER,
-				    GL_NEAREST_MIPMAP_NEAREST);
-		glSamplerParameterf(sampler, GL_TEXTURE_MAX_ANISOTROPY_EXT,
-				    16.0f);
-	}
-	res.tex = r->texture;
+
+	res.tex = 0;
+	res.mode = RUNE_DRAW_TEXTURE;
+	res.weight = 0.0f;
+	res.rotation = 0.0f;
+	res.tint[0] = res.tint[1] = res.tint[2] = res.tint[3] = 1.0f;
 
 	res.pos.x = 0.0f;
 	res.pos.y = 0.0f;
@@ -173,6 +219,35 @@ RuneDrawResult rune_DrawChar(Rune *rune, uint32_t x, uint32_t y) {
 	return res;
 }
 
+/* rune_DrawChar renders the given rune at char position (x, y). Glyphs come
+ * from the distance field atlas where possible, so they can be drawn at any
+ * scale. */
+RuneDrawResult rune_DrawChar(Rune *rune, uint32_t x, uint32_t y) {
+	RuneDrawResult res;
+	const Glyph *g;
+	uint32_t style;
+
+	res = rune_result(rune);
+	res.weight = rune->flags.bold ? RUNE_BOLD_WEIGHT : 0.0f;
+
+	/* control characters (including blank cells) have no glyph */
+	if (rune->code < SDF_FIRST) {
+		return res;
+	}
+
+	style = (rune->flags.bold ? GLYPH_STYLE_BOLD : 0) |
+		(rune->flags.italicize ? GLYPH_STYLE_ITALIC : 0);
+	if ((g = rune_glyph(rune->code, style, rune->props.font_size)) ==
+	    NULL) {
+		return res;
+	}
+	res.tex = g->tex;
+	res.clip = g->clip;
+	res.mode = g->mode;
+
+	return res;
+}
+
 /* rune_DrawImg renders the given image rune */
 RuneDrawResult rune_DrawImg(Rune *rune, uint32_t x, uint32_t y) {
 	RuneDrawResult res;
@@ -180,50 +255,50 @@ RuneDrawResult rune_DrawImg(Rune *rune, uint32_t x, uint32_t y) {
 
 	r = (ImgRune *)rune;
 
-	/* load image as texture */
-	if (r->texture == 0) {
-		r->texture = bitmap_to_texture(r->filename);
+	/* load image as texture; the asset's texture is updated in place
+	 * when the file is reloaded, and may be evicted between frames, so
+	 * it is asked for on every draw */
+	if (r->asset == 0 && r->texture == 0) {
+		r->asset = asset_Open(r->filename, ASSET_IMAGE);
+		if (r->asset == 0) {
+			r->texture = image_to_texture(r->filename);
+		}
 	}
+	if (r->asset != 0) {
+		r->texture = asset_Texture(r->asset);
+	}
+	res = rune_result(rune);
 	res.tex = r->texture;
 
-	res.pos.x = 0.0f;
-	res.pos.y = 0.0f;
-	res.pos.w = rune->w;
-	res.pos.h = rune->h;
-
-	res.clip.x = 0.0f;
-	res.clip.y = 0.0f;
-	res.clip.w = 1.0f;
-	res.clip.h = 1.0f;
-
 	return res;
 }
 
 /* rune_DrawMesh renders a mesh at char position (x, y) */
 RuneDrawResult rune_DrawMesh(Rune *r, uint32_t x, uint32_t y) {
+	const MeshData *d;
 	MeshRune *mr;
-	RuneDrawResult res = {};
+	RuneDrawResult res;
 	mr = (MeshRune *)r;
 
 	if (mr->mesh.color == 0) {
-		printf("LOADING %s\n", mr->filename);
 		init_Mesh(&mr->mesh);
-		mesh_Load(&mr->mesh, mr->filename);
+		if ((mr->asset = asset_Open(mr->filename, ASSET_MESH)) == 0) {
+			mesh_Load(&mr->mesh, mr->filename);
+		}
+	}
+	/* upload the mesh again whenever its file was reloaded */
+	if (mr->asset != 0 && mr->gen != asset_Generation(mr->asset)) {
+		if ((d = asset_Mesh(mr->asset)) != NULL) {
+			mesh_Apply(&mr->mesh, d);
+		}
+		mr->gen = asset_Generation(mr->asset);
 	}
+	mr->mesh.material = r->props.material;
 	mesh_Draw(&mr->mesh);
 
+	res = rune_result(r);
 	res.tex = mr->mesh.color;
 
-	res.pos.x = 0.0f;
-	res.pos.y = 0.0f;
-	res.pos.w = r->w;
-	res.pos.h = r->h;
-
-	res.clip.x = 0.0f;
-	res.clip.y = 0.0f;
-	res.clip.w = 1.0f;
-	res.clip.h = 1.0f;
-
 	return res;
 }
 
@@ -233,3 +308,35 @@ void rune_Update(Rune *r) {
 		r->update(r);
 	}
 }
+
+/* rune_IsResource returns true if code is in the resource codepage */
+bool rune_IsResource(uint32_t code) {
+	return code >= CODEPAGE_RSRC && code <= CODEPAGE_END;
+}
+
+/* rune_Asset returns the asset r shows (0 for none) */
+uint32_t rune_Asset(const Rune *r) {
+	if (r->draw == rune_DrawImg) {
+		return ((const ImgRune *)r)->asset;
+	}
+	if (r->draw == rune_DrawMesh) {
+		return ((const MeshRune *)r)->asset;
+	}
+	return 0;
+}
+
+/* rune_Evict frees the GPU resources of r, which are made again (from the
+ * asset cache) the next time it is drawn. Image runes share their asset's
+ * texture, which is evicted with asset_Evict() instead. */
+void rune_Evict(Rune *r) {
+	MeshRune *mr;
+
+	if (r->draw != rune_DrawMesh) {
+		return;
+	}
+	mr = (MeshRune *)r;
+	if (mr->mesh.color != 0) {
+		deinit_Mesh(&mr->mesh);
+		mr->gen = 0;
+	}
+}
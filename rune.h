@@ -13,6 +13,9 @@
 #include "render.h"
 #include "vector.h"
 
+/* the number of runes new_Rune() allocates at a time */
+enum { RUNE_POOL_CHUNK = 256 };
+
 /* Dimensional limitations of each rune */
 enum { RUNE_MAX_W = 80, RUNE_MAX_H = 80 };
 
@@ -23,11 +26,38 @@ enum { CODEPAGE_CHAR = 0x00,   /* 0x00-0xe000: UTF-8 characters */
        CODEPAGE_END = 0xf8ff   /* end of supported range */
 };
 
+/* How a RuneDrawResult's texture is applied */
+enum { RUNE_DRAW_TEXTURE = 0, /* tex is copied as-is */
+       RUNE_DRAW_SDF = 1      /* tex is a glyph distance field */
+};
+
+/* the distance field offset used to embolden glyphs */
+#define RUNE_BOLD_WEIGHT 0.08f
+
+/* The pointer events delivered to runes */
+enum { RUNE_POINTER_MOVE = 0,
+       RUNE_POINTER_PRESS = 1,
+       RUNE_POINTER_RELEASE = 2 };
+
+/* RunePointer is a pointer event relative to the rune (or block) it hit.
+ * While a button is held, events go to the rune it was pressed on, so x, y
+ * and u, v may lie outside of it. */
+typedef struct {
+	uint32_t type;   /* RUNE_POINTER_* */
+	uint32_t button; /* the SDL button pressed or released */
+	int32_t x, y;    /* the cell within the block */
+	float u, v;      /* the point within the block (0-1 inside it) */
+} RunePointer;
+
 /* RuneDrawTarget contains the information used to apply a rune's render */
 typedef struct {
 	GLuint tex;
 	Rect pos;
 	Rect clip;
+	uint32_t mode;  /* RUNE_DRAW_* */
+	float weight;   /* RUNE_DRAW_SDF only: added to the distance field */
+	float rotation; /* radians, about the center of pos */
+	float tint[4];  /* multiplies the rendered color */
 } RuneDrawResult;
 
 /* Rune_ is the basic struct (and first member) of all rune types */
@@ -36,10 +66,14 @@ typedef struct Rune {
 	RenderProperties props;
 
 	uint32_t type;
+	uint32_t code; /* the codepoint this rune represents in the buffer */
 	uint32_t w, h; /* the dimensions (in cells) that this rune renders to */
+	uint32_t anim; /* the rune's animation instance (0 for none) */
+	uint32_t frame; /* a block anchor: the frame it was last drawn in */
 
 	RuneDrawResult (*draw)(struct Rune *r, uint32_t x, uint32_t y);
 	void (*update)(struct Rune *);
+	void (*pointer)(struct Rune *, const RunePointer *); /* may be NULL */
 } Rune;
 
 /* CharRune is a rune representing 1 1x1 cell symbol */
@@ -47,7 +81,6 @@ typedef struct {
 	Rune r;
 	uint32_t f, v;    /* f (fragment), v (vertex) shader handles */
 	uint32_t id;      /* id is a texture ID */
-	uint32_t texture; /* texture handle for the character's spritesheet */
 } CharRune;
 
 /* MeshRune represents 1 cell of an arbitrary dimension 3D-mesh */
@@ -62,6 +95,8 @@ typedef struct {
 
 	Mesh mesh;	    /* mesh to render */
 	const char *filename; /* the filename of the mesh*/
+	uint32_t asset;       /* the asset of filename (0 until drawn) */
+	uint32_t gen;         /* the generation of the asset in mesh */
 } MeshRune;
 
 /* ImgRune is a multi-cell static image */
@@ -69,6 +104,7 @@ typedef struct {
 	Rune r;
 	GLuint texture;
 	const char *filename; /* the filename of the image */
+	uint32_t asset;       /* the asset of filename (0 until drawn) */
 } ImgRune;
 
 /* Rune is a container large enough to hold any Rune type */
@@ -79,7 +115,7 @@ typedef union {
 	ImgRune img;
 } Rune_;
 
-Rune *new_CharRune();
+Rune *new_Rune();
 void del_Rune(Rune *);
 
 void rune_Draw(Rune *, uint32_t, uint32_t);
@@ -89,6 +125,10 @@ RuneDrawResult rune_DrawMesh(Rune *, uint32_t, uint32_t);
 
 void rune_Update(Rune *);
 
+bool rune_IsResource(uint32_t);
+uint32_t rune_Asset(const Rune *);
+void rune_Evict(Rune *);
+
 extern CharRune rune_blankChar;
 extern MeshRune rune_blankMesh;
 extern ImgRune rune_blankImg;
@@ -0,0 +1,62 @@
+#include "sched.h"
+#include <SDL2/SDL.h>
+#include <math.h>
+
+/* init_FrameSched initializes s for a display refreshing hz times a second
+ * (60 if unknown) */
+void init_FrameSched(FrameSched *s, uint32_t hz) {
+	s->period = 1.0 / (hz ? hz : 60);
+	s->vblank = sched_Now();
+	s->cost = s->period / 4;
+}
+
+/* sched_Now returns the time in seconds */
+double sched_Now() {
+	static double freq;
+
+	if (freq == 0.0) {
+		freq = (double)SDL_GetPerformanceFrequency();
+	}
+	return SDL_GetPerformanceCounter() / freq;
+}
+
+/* sched_Timeout returns the milliseconds until the next frame should start,
+ * 0 if it is due now or -1 if nothing needs drawing (busy is false) */
+int32_t sched_Timeout(const FrameSched *s, bool busy) {
+	double now, vblank, start;
+
+	if (!busy) {
+		return -1;
+	}
+	now = sched_Now();
+	vblank = s->vblank + ceil((now - s->vblank) / s->period) * s->period;
+	if (vblank <= now) {
+		vblank += s->period;
+	}
+	start = vblank - s->cost - SCHED_MARGIN;
+	if (start <= now) {
+		/* late for the start, but the frame may still make the vblank */
+		if (now + s->cost <= vblank) {
+			return 0;
+		}
+		start += s->period;
+	}
+	return (int32_t)((start - now) * 1000.0);
+}
+
+/* sched_Presented records a frame started at start and submitted at submit
+ * whose swap has just returned */
+void sched_Presented(FrameSched *s, double start, double submit) {
+	double cost = submit - start;
+
+	/* rise with slow frames at once; fall back slowly */
+	if (cost > s->cost) {
+		s->cost = cost;
+	} else {
+		s->cost = s->cost * 0.95 + cost * 0.05;
+	}
+	if (s->cost > s->period) {
+		s->cost = s->period;
+	}
+	s->vblank = sched_Now();
+}
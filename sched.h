@@ -0,0 +1,29 @@
+/*
+ * sched.h
+ * sched paces frames to the display. A frame is started as late as the
+ * estimated cost of rendering it allows before the next vblank, so that it
+ * shows the newest input; a frame that becomes due after that point is
+ * started at once if it can still make the vblank. Nothing is scheduled
+ * while there is nothing to draw.
+ */
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* the slack (s) left between a frame's submission and the vblank */
+#define SCHED_MARGIN 0.001
+
+typedef struct {
+	double period; /* between vblanks (s) */
+	double vblank; /* the estimated time of a recent vblank */
+	double cost;   /* the estimated time to render and submit a frame */
+} FrameSched;
+
+void init_FrameSched(FrameSched *, uint32_t);
+double sched_Now();
+int32_t sched_Timeout(const FrameSched *, bool);
+void sched_Presented(FrameSched *, double, double);
+
+#endif
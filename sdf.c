@@ -0,0 +1,304 @@
+#include "sdf.h"
+#include <SDL2/SDL.h>
+#include <ft2build.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include FT_FREETYPE_H
+#include FT_MODULE_H
+#include "glstate.h"
+#include "mem.h"
+
+/* FreeType renders SDFs itself from 2.11 on */
+#if FREETYPE_MAJOR > 2 || (FREETYPE_MAJOR == 2 && FREETYPE_MINOR >= 11)
+#define HAVE_FT_SDF 1
+#endif
+
+#define ATLAS_W (SDF_COLS * SDF_CELL)
+#define ATLAS_H (SDF_ROWS * SDF_CELL)
+#define INF 1e20f
+
+/* SDFJob is the work shared by the threads building the atlas */
+typedef struct {
+	uint8_t *atlas;
+	SDL_atomic_t next; /* the next codepoint to render */
+} SDFJob;
+
+static GLuint atlasTex = 0;
+static bool atlasFailed = false;
+static bool present[SDF_LAST + 1]; /* glyphs the font defines */
+
+/* edt1d computes the squared distance transform of the n samples in f into d
+ * (Felzenszwalb & Huttenlocher). v and z are scratch space for n and n + 1
+ * values. */
+static void edt1d(const float *f, float *d, int *v, float *z, int n) {
+	int k, q;
+	float s;
+
+	k = 0;
+	v[0] = 0;
+	z[0] = -INF;
+	z[1] = INF;
+	for (q = 1; q < n; ++q) {
+		s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) /
+		    (2 * q - 2 * v[k]);
+		while (s <= z[k]) {
+			--k;
+			s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) /
+			    (2 * q - 2 * v[k]);
+		}
+		++k;
+		v[k] = q;
+		z[k] = s;
+		z[k + 1] = INF;
+	}
+	k = 0;
+	for (q = 0; q < n; ++q) {
+		while (z[k + 1] < q) {
+			++k;
+		}
+		d[q] = (q - v[k]) * (q - v[k]) + f[v[k]];
+	}
+}
+
+/* edt2d replaces the w x h grid g with its squared distance transform */
+static void edt2d(float *g, int w, int h) {
+	float *f, *d, *z;
+	int *v, x, y, n;
+
+	n = w > h ? w : h;
+	f = malloc(sizeof(float) * n);
+	d = malloc(sizeof(float) * n);
+	z = malloc(sizeof(float) * (n + 1));
+	v = malloc(sizeof(int) * n);
+	if (f && d && z && v) {
+		for (x = 0; x < w; ++x) {
+			for (y = 0; y < h; ++y) {
+				f[y] = g[y * w + x];
+			}
+			edt1d(f, d, v, z, h);
+			for (y = 0; y < h; ++y) {
+				g[y * w + x] = d[y];
+			}
+		}
+		for (y = 0; y < h; ++y) {
+			edt1d(&g[y * w], d, v, z, w);
+			memcpy(&g[y * w], d, sizeof(float) * w);
+		}
+	}
+	free(f);
+	free(d);
+	free(z);
+	free(v);
+}
+
+/* distanceField converts the w x h coverage bitmap src (with the given pitch)
+ * to a signed distance field padded by SDF_SPREAD on each side, in the same
+ * encoding as FreeType's SDF renderer (128 on the edge, larger inside). */
+static uint8_t *distanceField(const uint8_t *src, int w, int h, int pitch) {
+	float *in, *out;
+	uint8_t *sdf;
+	int pw, ph, x, y, i;
+
+	pw = w + 2 * SDF_SPREAD;
+	ph = h + 2 * SDF_SPREAD;
+	in = malloc(sizeof(float) * pw * ph);
+	out = malloc(sizeof(float) * pw * ph);
+	sdf = malloc(pw * ph);
+	if (in == NULL || out == NULL || sdf == NULL) {
+		free(in);
+		free(out);
+		free(sdf);
+		return NULL;
+	}
+
+	/* in: distance to the glyph; out: distance to the background */
+	for (y = 0; y < ph; ++y) {
+		for (x = 0; x < pw; ++x) {
+			int sx = x - SDF_SPREAD, sy = y - SDF_SPREAD;
+			bool inside = sx >= 0 && sy >= 0 && sx < w && sy < h &&
+				      src[sy * pitch + sx] >= 128;
+			in[y * pw + x] = inside ? 0.0f : INF;
+			out[y * pw + x] = inside ? INF : 0.0f;
+		}
+	}
+	edt2d(in, pw, ph);
+	edt2d(out, pw, ph);
+
+	for (i = 0; i < pw * ph; ++i) {
+		float dist = sqrtf(out[i]) - sqrtf(in[i]);
+		float val = 128.0f + dist * 128.0f / SDF_SPREAD;
+		sdf[i] = val < 0.0f ? 0 : val > 255.0f ? 255 : (uint8_t)val;
+	}
+	free(in);
+	free(out);
+	return sdf;
+}
+
+/* blit copies the glyph field src into code's atlas cell, placing its origin
+ * (left, top relative to the pen on the baseline) as FreeType reports it. */
+static void blit(uint8_t *atlas, uint32_t code, const uint8_t *src, int w,
+		 int h, int pitch, int left, int top, int ascender) {
+	int cx, cy, x, y, ax, ay;
+
+	cx = ((code - SDF_FIRST) % SDF_COLS) * SDF_CELL;
+	cy = ((code - SDF_FIRST) / SDF_COLS) * SDF_CELL;
+	for (y = 0; y < h; ++y) {
+		ay = SDF_SPREAD + ascender - top + y;
+		if (ay < 0 || ay >= SDF_CELL) {
+			continue;
+		}
+		for (x = 0; x < w; ++x) {
+			ax = SDF_SPREAD + left + x;
+			if (ax >= 0 && ax < SDF_CELL) {
+				atlas[(cy + ay) * ATLAS_W + cx + ax] =
+				    src[y * pitch + x];
+			}
+		}
+	}
+}
+
+/* renderGlyph renders code with face into its atlas cell */
+static void renderGlyph(FT_Face face, uint32_t code, uint8_t *atlas) {
+	FT_GlyphSlot slot = face->glyph;
+	int ascender = face->size->metrics.ascender >> 6;
+	uint8_t *sdf;
+
+	if (FT_Get_Char_Index(face, code) == 0 ||
+	    FT_Load_Char(face, code, FT_LOAD_DEFAULT) != 0) {
+		return;
+	}
+	present[code] = true;
+
+#ifdef HAVE_FT_SDF
+	if (FT_Render_Glyph(slot, FT_RENDER_MODE_SDF) == 0) {
+		blit(atlas, code, slot->bitmap.buffer, slot->bitmap.width,
+		     slot->bitmap.rows, slot->bitmap.pitch, slot->bitmap_left,
+		     slot->bitmap_top, ascender);
+		return;
+	}
+#endif
+	/* rasterize and compute the field ourselves */
+	if (FT_Render_Glyph(slot, FT_RENDER_MODE_NORMAL) != 0) {
+		return;
+	}
+	sdf = distanceField(slot->bitmap.buffer, slot->bitmap.width,
+			    slot->bitmap.rows, slot->bitmap.pitch);
+	if (sdf != NULL) {
+		blit(atlas, code, sdf, slot->bitmap.width + 2 * SDF_SPREAD,
+		     slot->bitmap.rows + 2 * SDF_SPREAD,
+		     slot->bitmap.width + 2 * SDF_SPREAD,
+		     slot->bitmap_left - SDF_SPREAD,
+		     slot->bitmap_top + SDF_SPREAD, ascender);
+		free(sdf);
+	}
+}
+
+/* worker renders glyphs until the job runs out. FreeType objects may not be
+ * shared between threads, so each worker opens its own copy of the font. */
+static int worker(void *data) {
+	SDFJob *job = data;
+	FT_Library lib;
+	FT_Face face;
+	int code;
+
+	if (FT_Init_FreeType(&lib) != 0) {
+		return -1;
+	}
+#ifdef HAVE_FT_SDF
+	{
+		FT_Int spread = SDF_SPREAD;
+		FT_Property_Set(lib, "sdf", "spread", &spread);
+	}
+#endif
+	if (FT_New_Face(lib, SDF_FONT, 0, &face) != 0 ||
+	    FT_Set_Pixel_Sizes(face, 0, SDF_GLYPH_PX) != 0) {
+		FT_Done_FreeType(lib);
+		return -1;
+	}
+	while ((code = SDL_AtomicAdd(&job->next, 1)) <= SDF_LAST) {
+		renderGlyph(face, code, job->atlas);
+	}
+	FT_Done_Face(face);
+	FT_Done_FreeType(lib);
+	return 0;
+}
+
+/* buildAtlas renders every glyph of SDF_FONT in parallel and uploads the
+ * atlas. Returns 0 on failure. */
+static GLuint buildAtlas() {
+	SDL_Thread *threads[SDF_MAX_THREADS];
+	int i, n, ret;
+	SDFJob job;
+	GLuint tex;
+
+	if ((job.atlas = calloc(ATLAS_W, ATLAS_H)) == NULL) {
+		return 0;
+	}
+	SDL_AtomicSet(&job.next, SDF_FIRST);
+
+	n = SDL_GetCPUCount();
+	n = n < 1 ? 1 : n > SDF_MAX_THREADS ? SDF_MAX_THREADS : n;
+	for (i = 0; i < n - 1; ++i) {
+		threads[i] = SDL_CreateThread(worker, "sdf", &job);
+	}
+	ret = worker(&job);
+	for (i = 0; i < n - 1; ++i) {
+		if (threads[i] != NULL) {
+			SDL_WaitThread(threads[i], NULL);
+		}
+	}
+	if (ret != 0) {
+		printf("error: failed to load font %s\n", SDF_FONT);
+		free(job.atlas);
+		return 0;
+	}
+
+	glGenTextures(1, &tex);
+	glstate_BindTexture(0, GL_TEXTURE_2D, tex);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, ATLAS_W, ATLAS_H, 0, GL_RED,
+		     GL_UNSIGNED_BYTE, job.atlas);
+	mem_Track(MEM_TEXTURE, tex, MEM_GLYPHS, (size_t)ATLAS_W * ATLAS_H);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	free(job.atlas);
+	return tex;
+}
+
+/* sdf_Texture returns the glyph atlas (a single-channel distance field),
+ * building it on first use. Returns 0 if the atlas could not be built. */
+GLuint sdf_Texture() {
+	if (atlasTex == 0 && !atlasFailed) {
+		atlasTex = buildAtlas();
+		atlasFailed = atlasTex == 0;
+	}
+	return atlasTex;
+}
+
+/* sdf_Clip writes the texture coordinates of code's glyph (one em square) in
+ * the atlas to clip. Returns false if the atlas doesn't contain code. */
+bool sdf_Clip(uint32_t code, Rect *clip) {
+	uint32_t i;
+
+	if (code < SDF_FIRST || code > SDF_LAST || sdf_Texture() == 0 ||
+	    !present[code]) {
+		return false;
+	}
+	i = code - SDF_FIRST;
+	clip->x = (float)((i % SDF_COLS) * SDF_CELL + SDF_SPREAD) / ATLAS_W;
+	clip->y = (float)((i / SDF_COLS) * SDF_CELL + SDF_SPREAD) / ATLAS_H;
+	clip->w = (float)SDF_GLYPH_PX / ATLAS_W;
+	clip->h = (float)SDF_GLYPH_PX / ATLAS_H;
+	return true;
+}
+
+/* sdf_Free deletes the atlas */
+void sdf_Free() {
+	if (atlasTex != 0) {
+		glstate_DeleteTexture(atlasTex);
+		atlasTex = 0;
+	}
+	atlasFailed = false;
+}
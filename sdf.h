@@ -0,0 +1,35 @@
+/*
+ * sdf.h
+ * sdf renders a font's Latin-1 glyphs to a signed-distance-field atlas so
+ * that characters can be drawn at any scale, rotation or weight by a single
+ * shader without rasterizing them again. The atlas is generated from the
+ * font's outlines (on several threads) the first time it is needed.
+ */
+#ifndef SDF_H
+#define SDF_H
+
+#include <GL/glew.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "vector.h"
+
+/* the font the atlas is built from */
+#define SDF_FONT "C64.ttf"
+
+/* Atlas layout. Each glyph is rendered at SDF_GLYPH_PX pixels per em into a
+ * cell padded by SDF_SPREAD pixels, the distance (in atlas pixels) at which
+ * the field saturates. */
+enum { SDF_FIRST = 0x20,
+       SDF_LAST = 0xff,
+       SDF_GLYPH_PX = 48,
+       SDF_SPREAD = 8,
+       SDF_CELL = SDF_GLYPH_PX + 2 * SDF_SPREAD,
+       SDF_COLS = 16,
+       SDF_ROWS = (SDF_LAST - SDF_FIRST + SDF_COLS) / SDF_COLS,
+       SDF_MAX_THREADS = 8 };
+
+GLuint sdf_Texture();
+bool sdf_Clip(uint32_t, Rect *);
+void sdf_Free();
+
+#endif
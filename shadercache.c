@@ -0,0 +1,167 @@
+#include "shadercache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include "util.h"
+
+enum { SHADERCACHE_MAGIC = 0x42534c47, /* "GLSB" */
+       SHADERCACHE_VERSION = 1 };
+
+/* ShaderCacheHeader precedes the program binary in each cache file */
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t key;
+	uint32_t format; /* the binary format reported by the driver */
+	uint32_t length; /* the length of the binary that follows */
+} ShaderCacheHeader;
+
+/* driverHash returns a hash of the strings identifying the GL driver */
+static uint64_t driverHash() {
+	static uint64_t hash = 0;
+	const char *strs[3];
+	int i;
+
+	if (hash != 0) {
+		return hash;
+	}
+	strs[0] = (const char *)glGetString(GL_VENDOR);
+	strs[1] = (const char *)glGetString(GL_RENDERER);
+	strs[2] = (const char *)glGetString(GL_VERSION);
+	hash = 1;
+	for (i = 0; i < 3; ++i) {
+		hash = hashStr(strs[i], hash);
+	}
+	return hash;
+}
+
+/* keyPath writes the filename of the cache entry for key to path */
+static bool keyPath(uint64_t key, char *path, size_t sz) {
+	char name[32];
+
+	snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+	return cachePath("shaders", name, path, sz);
+}
+
+/* shadercache_Supported returns true if the driver can return binaries */
+bool shadercache_Supported() {
+	static int supported = -1;
+	GLint numFormats;
+
+	if (supported < 0) {
+		numFormats = 0;
+		if (GLEW_ARB_get_program_binary) {
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS,
+				      &numFormats);
+		}
+		supported = numFormats > 0;
+	}
+	return supported;
+}
+
+/* shadercache_Key returns the key for the program built from the given
+ * sources, defines, and attributes by the current driver. */
+uint64_t shadercache_Key(const GLchar *vs, const GLchar *fs,
+			 const char *defines, int numAttrs,
+			 const char **attrs) {
+	uint64_t key;
+	int i;
+
+	key = driverHash();
+	key = hashStr(vs, key);
+	key = hashStr(fs, key);
+	key = hashStr(defines, key);
+	for (i = 0; i < numAttrs; ++i) {
+		key = hashStr(attrs[i], key);
+	}
+	return key;
+}
+
+/* shadercache_Load returns a program restored from the cache entry for key
+ * or 0 if there is no usable entry. */
+GLuint shadercache_Load(uint64_t key) {
+	ShaderCacheHeader hdr;
+	char path[512];
+	void *binary;
+	GLuint program;
+	GLint linked;
+	FILE *f;
+
+	if (!shadercache_Supported() || !keyPath(key, path, sizeof(path))) {
+		return 0;
+	}
+	if ((f = fopen(path, "rb")) == NULL) {
+		return 0;
+	}
+	if (fread(&hdr, sizeof(hdr), 1, f) != 1 ||
+	    hdr.magic != SHADERCACHE_MAGIC ||
+	    hdr.version != SHADERCACHE_VERSION || hdr.key != key) {
+		fclose(f);
+		return 0;
+	}
+	if ((binary = malloc(hdr.length)) == NULL) {
+		fclose(f);
+		return 0;
+	}
+	if (fread(binary, 1, hdr.length, f) != hdr.length) {
+		free(binary);
+		fclose(f);
+		return 0;
+	}
+	fclose(f);
+
+	program = glCreateProgram();
+	glProgramBinary(program, hdr.format, binary, hdr.length);
+	free(binary);
+
+	/* the driver rejects binaries it did not produce (e.g. after an
+	 * update); the caller recompiles and replaces the entry */
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (linked == GL_FALSE) {
+		glDeleteProgram(program);
+		return 0;
+	}
+	return program;
+}
+
+/* shadercache_Store writes the binary of the linked program to the cache
+ * entry for key. */
+void shadercache_Store(uint64_t key, GLuint program) {
+	ShaderCacheHeader hdr;
+	char path[512], tmp[520];
+	void *binary;
+	GLint len;
+	GLenum format;
+	bool ok;
+	FILE *f;
+
+	if (!shadercache_Supported() || !keyPath(key, path, sizeof(path))) {
+		return;
+	}
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &len);
+	if (len <= 0 || (binary = malloc(len)) == NULL) {
+		return;
+	}
+	glGetProgramBinary(program, len, &len, &format, binary);
+
+	hdr.magic = SHADERCACHE_MAGIC;
+	hdr.version = SHADERCACHE_VERSION;
+	hdr.key = key;
+	hdr.format = format;
+	hdr.length = len;
+	/* write to a temporary file first so readers never see partial
+	 * entries */
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+	if ((f = fopen(tmp, "wb")) == NULL) {
+		printf("error: failed to write shader cache %s\n", tmp);
+		free(binary);
+		return;
+	}
+	ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1 &&
+	     fwrite(binary, 1, len, f) == (size_t)len;
+	ok = fclose(f) == 0 && ok;
+	if (!ok || rename(tmp, path) != 0) {
+		printf("error: failed to write shader cache %s\n", path);
+		remove(tmp);
+	}
+	free(binary);
+}
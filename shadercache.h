@@ -0,0 +1,21 @@
+/*
+ * shadercache.h
+ * The shader cache stores linked program binaries on disk so that programs
+ * can be restored with glProgramBinary() instead of compiling them again.
+ * Binaries are keyed by a hash of the program's sources, its defines and the
+ * GL driver that produced them; any mismatch falls back to compiling.
+ */
+#ifndef SHADERCACHE_H
+#define SHADERCACHE_H
+
+#include <GL/glew.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+bool shadercache_Supported();
+uint64_t shadercache_Key(const GLchar *, const GLchar *, const char *, int,
+			 const char **);
+GLuint shadercache_Load(uint64_t);
+void shadercache_Store(uint64_t, GLuint);
+
+#endif
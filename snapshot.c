@@ -0,0 +1,509 @@
+#define _DEFAULT_SOURCE
+#include "snapshot.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "anim.h"
+#include "asset.h"
+#include "sched.h"
+
+enum { SNAP_MAGIC = 0x4e534c47, /* "GLSN" */
+       SNAP_VERSION = 1 };
+
+/* SnapHeader begins each snapshot */
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t cellW, cellH; /* the size of a cell in pixels */
+	uint32_t initW, initH; /* the extent of the saved buffer */
+	uint32_t numAssets;    /* the entries of the asset table */
+	uint32_t numGrids;
+} SnapHeader;
+
+/* SnapGrid begins the cells of each saved grid */
+typedef struct {
+	uint32_t id;
+	int32_t x, y, z;
+	uint32_t w, h;
+	uint32_t flags; /* SNAP_GRID_* */
+} SnapGrid;
+
+/* flags of a saved grid */
+enum { SNAP_GRID_HIDDEN = 1 << 0, SNAP_GRID_OPAQUE = 1 << 1 };
+
+/* SnapWriter collects the cells of a snapshot in memory, and the table of
+ * the assets they show */
+typedef struct {
+	uint8_t *data;
+	size_t len, cap;
+	bool failed;
+
+	uint16_t index[ASSET_MAX + 1]; /* the entry + 1 of each asset id */
+	uint32_t assets[ASSET_MAX];    /* the asset id of each entry */
+	uint32_t kinds[ASSET_MAX];     /* the ASSET_* kind of each entry */
+	uint32_t numAssets;
+} SnapWriter;
+
+/* SnapReader reads a mapped snapshot */
+typedef struct {
+	const uint8_t *p, *end;
+	const uint8_t *cells; /* where the cells begin, past the asset table */
+
+	const char *files[ASSET_MAX]; /* the path of each entry */
+	uint32_t ids[ASSET_MAX];      /* the asset of each entry, 0 if lost */
+	uint32_t kinds[ASSET_MAX];    /* the ASSET_* kind of each entry */
+	uint32_t numAssets;
+} SnapReader;
+
+/*****************************************************************************/
+/* Saving                                                                    */
+/*****************************************************************************/
+
+/* put appends the n bytes at p to s */
+static void put(SnapWriter *s, const void *p, size_t n) {
+	uint8_t *data;
+	size_t cap;
+
+	if (s->failed) {
+		return;
+	}
+	if (s->len + n > s->cap) {
+		cap = (s->len + n) * 2;
+		if ((data = realloc(s->data, cap)) == NULL) {
+			s->failed = true;
+			return;
+		}
+		s->data = data;
+		s->cap = cap;
+	}
+	memcpy(s->data + s->len, p, n);
+	s->len += n;
+}
+
+/* cellAsset returns the entry + 1 of the asset of kind shown by r, adding
+ * it to the table of s (0 if it has none) */
+static uint16_t cellAsset(SnapWriter *s, const Rune_ *r, uint32_t kind) {
+	const char *file;
+	uint32_t id;
+
+	file = kind == ASSET_IMAGE ? r->img.filename : r->mesh.filename;
+	if ((id = rune_Asset(&r->r)) == 0 && file != NULL) {
+		id = asset_Open(file, kind);
+	}
+	if (id == 0) {
+		return 0;
+	}
+	if (s->index[id] == 0) {
+		s->assets[s->numAssets] = id;
+		s->kinds[s->numAssets] = kind;
+		s->index[id] = ++s->numAssets;
+	}
+	return s->index[id];
+}
+
+/* encodeCell saves the rune r to c */
+static void encodeCell(SnapWriter *s, const Rune_ *r, SnapCell *c) {
+	const Rune *rune = &r->r;
+
+	memset(c, 0, sizeof(SnapCell));
+	if (rune->draw == rune_DrawImg) {
+		c->kind = SNAP_IMAGE;
+		c->asset = cellAsset(s, r, ASSET_IMAGE);
+	} else if (rune->draw == rune_DrawMesh) {
+		c->kind = SNAP_MESH;
+		c->asset = cellAsset(s, r, ASSET_MESH);
+	}
+	/* a resource without a file is saved blank */
+	if (c->kind != SNAP_CHAR && c->asset == 0) {
+		c->kind = SNAP_CHAR;
+		c->w = c->h = 1;
+		return;
+	}
+	c->code = rune->code;
+	c->type = rune->type;
+	c->fontSize = rune->props.font_size;
+	c->color = rune->props.color;
+	c->material = rune->props.material;
+	c->w = rune->w;
+	c->h = rune->h;
+	c->flags = (rune->flags.invert ? SNAP_INVERT : 0) |
+		   (rune->flags.bold ? SNAP_BOLD : 0) |
+		   (rune->flags.italicize ? SNAP_ITALIC : 0) |
+		   (rune->flags.underline ? SNAP_UNDERLINE : 0);
+}
+
+/* putRow run-length encodes the n runes at r into s */
+static void putRow(SnapWriter *s, const Rune_ *r, uint32_t n) {
+	SnapCell cell, next;
+	uint32_t i, count;
+
+	for (i = 0; i < n; i += count) {
+		encodeCell(s, &r[i], &cell);
+		for (count = 1; i + count < n; ++count) {
+			encodeCell(s, &r[i + count], &next);
+			if (memcmp(&next, &cell, sizeof(SnapCell)) != 0) {
+				break;
+			}
+		}
+		put(s, &count, sizeof(count));
+		put(s, &cell, sizeof(cell));
+	}
+}
+
+/* writeFile writes the header, asset table and cells of s to path */
+static bool writeFile(const SnapWriter *s, const SnapHeader *hdr,
+		      const char *path) {
+	const char *file;
+	uint32_t i, len;
+	char tmp[520];
+	FILE *f;
+	bool ok;
+
+	/* write to a temporary file first so that a crash never leaves a
+	 * partial snapshot behind */
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+	if ((f = fopen(tmp, "wb")) == NULL) {
+		printf("error: failed to open %s\n", tmp);
+		return false;
+	}
+	ok = fwrite(hdr, sizeof(SnapHeader), 1, f) == 1;
+	for (i = 0; i < s->numAssets && ok; ++i) {
+		file = asset_Path(s->assets[i]);
+		len = strlen(file) + 1;
+		ok = fwrite(&s->kinds[i], sizeof(uint32_t), 1, f) == 1 &&
+		     fwrite(&len, sizeof(len), 1, f) == 1 &&
+		     fwrite(file, 1, len, f) == len;
+	}
+	ok = ok && fwrite(s->data, 1, s->len, f) == s->len;
+	ok = fclose(f) == 0 && ok;
+	if (!ok || rename(tmp, path) != 0) {
+		printf("error: failed to write %s\n", path);
+		remove(tmp);
+		return false;
+	}
+	return true;
+}
+
+/* snapshot_Save saves the state of w to path */
+bool snapshot_Save(Window *w, const char *path) {
+	SnapHeader hdr;
+	SnapWriter s;
+	SnapGrid sg;
+	const Grid *g;
+	uint32_t i, y;
+	bool ok;
+
+	memset(&s, 0, sizeof(s));
+	for (y = 0; y < w->initH; ++y) {
+		putRow(&s, &w->buff[(size_t)y * WINDOW_STRIDE], w->initW);
+	}
+	for (i = 0; i < w->numGrids; ++i) {
+		g = w->grids[i];
+		sg.id = g->id;
+		sg.x = g->x;
+		sg.y = g->y;
+		sg.z = g->z;
+		sg.w = g->w;
+		sg.h = g->h;
+		sg.flags = (g->hidden ? SNAP_GRID_HIDDEN : 0) |
+			   (g->opaque ? SNAP_GRID_OPAQUE : 0);
+		put(&s, &sg, sizeof(sg));
+		for (y = 0; y < g->h; ++y) {
+			putRow(&s, &g->cells[(size_t)y * g->w], g->w);
+		}
+	}
+	if (s.failed) {
+		puts("error: out of memory saving the snapshot");
+		free(s.data);
+		return false;
+	}
+
+	hdr.magic = SNAP_MAGIC;
+	hdr.version = SNAP_VERSION;
+	hdr.cellW = w->cellW;
+	hdr.cellH = w->cellH;
+	hdr.initW = w->initW;
+	hdr.initH = w->initH;
+	hdr.numAssets = s.numAssets;
+	hdr.numGrids = w->numGrids;
+	ok = writeFile(&s, &hdr, path);
+	free(s.data);
+	return ok;
+}
+
+/*****************************************************************************/
+/* Restoring                                                                 */
+/*****************************************************************************/
+
+/* get copies the next n bytes of r to dst. Returns false if it has fewer
+ * left. */
+static bool get(SnapReader *r, void *dst, size_t n) {
+	if ((size_t)(r->end - r->p) < n) {
+		return false;
+	}
+	memcpy(dst, r->p, n);
+	r->p += n;
+	return true;
+}
+
+/* readAssets reads the n entries of the asset table of r. The assets are
+ * not opened until the snapshot is restored. */
+static bool readAssets(SnapReader *r, uint32_t n) {
+	uint32_t i, kind, len;
+
+	for (i = 0; i < n; ++i) {
+		if (!get(r, &kind, sizeof(kind)) ||
+		    !get(r, &len, sizeof(len)) || len == 0 ||
+		    (size_t)(r->end - r->p) < len ||
+		    r->p[len - 1] != '\0' ||
+		    (kind != ASSET_IMAGE && kind != ASSET_MESH)) {
+			return false;
+		}
+		r->files[i] = (const char *)r->p;
+		r->kinds[i] = kind;
+		r->p += len;
+	}
+	r->numAssets = n;
+	return true;
+}
+
+/* checkRows returns true if r holds rows rows of width cells, skipping
+ * them */
+static bool checkRows(SnapReader *r, uint32_t width, uint32_t rows) {
+	uint32_t y, x, count;
+	SnapCell cell;
+
+	for (y = 0; y < rows; ++y) {
+		for (x = 0; x < width; x += count) {
+			if (!get(r, &count, sizeof(count)) || count == 0 ||
+			    count > width - x || !get(r, &cell, sizeof(cell))) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+/* decodeCell sets rune to the cell c of r */
+static void decodeCell(const SnapReader *r, const SnapCell *c, Rune_ *rune) {
+	uint32_t id, kind;
+
+	id = kind = 0;
+	if (c->asset != 0 && c->asset <= r->numAssets) {
+		id = r->ids[c->asset - 1];
+		kind = r->kinds[c->asset - 1];
+	}
+	if (c->kind == SNAP_IMAGE && id != 0 && kind == ASSET_IMAGE) {
+		rune->img = rune_blankImg;
+		rune->img.filename = asset_Path(id);
+		rune->img.asset = id;
+	} else if (c->kind == SNAP_MESH && id != 0 && kind == ASSET_MESH) {
+		rune->mesh = rune_blankMesh;
+		rune->mesh.filename = asset_Path(id);
+		rune->mesh.asset = id;
+	} else {
+		rune->ch = rune_blankChar;
+		if (c->kind != SNAP_CHAR) {
+			/* the resource's file is lost */
+			return;
+		}
+	}
+	rune->r.code = c->code;
+	rune->r.type = c->type;
+	rune->r.props.font_size = c->fontSize;
+	rune->r.props.color = c->color;
+	rune->r.props.material = c->material;
+	rune->r.w = c->w > 0 && c->w <= RUNE_MAX_W ? c->w : 1;
+	rune->r.h = c->h > 0 && c->h <= RUNE_MAX_H ? c->h : 1;
+	rune->r.flags.invert = c->flags & SNAP_INVERT;
+	rune->r.flags.bold = c->flags & SNAP_BOLD;
+	rune->r.flags.italicize = c->flags & SNAP_ITALIC;
+	rune->r.flags.underline = c->flags & SNAP_UNDERLINE;
+	rune->r.flags.dirty = true;
+}
+
+/* readRow decodes a row of width cells of r into cells. Returns false if
+ * the row is cut short or overlong, which check() has ruled out. */
+static bool readRow(SnapReader *r, Rune_ *cells, uint32_t width) {
+	uint32_t x, i, count;
+	SnapCell cell;
+
+	for (x = 0; x < width; x += count) {
+		if (!get(r, &count, sizeof(count)) || count == 0 ||
+		    count > width - x || !get(r, &cell, sizeof(cell))) {
+			return false;
+		}
+		decodeCell(r, &cell, &cells[x]);
+		for (i = 1; i < count; ++i) {
+			cells[x + i] = cells[x];
+		}
+	}
+	return true;
+}
+
+/* check returns true if the header and cells of r make a valid snapshot */
+static bool check(SnapReader *r, const SnapHeader *hdr) {
+	uint32_t i, j, ids[WINDOW_MAX_GRIDS];
+	SnapGrid sg;
+
+	if (hdr->magic != SNAP_MAGIC || hdr->version != SNAP_VERSION ||
+	    hdr->cellW == 0 || hdr->cellH == 0 ||
+	    hdr->initW <= WINDOW_MARGIN_W || hdr->initW > WINDOW_STRIDE ||
+	    hdr->initH <= WINDOW_MARGIN_H ||
+	    hdr->initH > WINDOW_MARGIN_H + WINDOW_MAX_H ||
+	    hdr->numAssets > ASSET_MAX || hdr->numGrids > WINDOW_MAX_GRIDS) {
+		return false;
+	}
+	if (!readAssets(r, hdr->numAssets)) {
+		return false;
+	}
+	r->cells = r->p;
+	if (!checkRows(r, hdr->initW, hdr->initH)) {
+		return false;
+	}
+	for (i = 0; i < hdr->numGrids; ++i) {
+		if (!get(r, &sg, sizeof(sg)) || sg.w == 0 || sg.h == 0 ||
+		    sg.w > WINDOW_MAX_W || sg.h > WINDOW_MAX_H ||
+		    !checkRows(r, sg.w, sg.h)) {
+			return false;
+		}
+		for (j = 0; j < i; ++j) {
+			if (ids[j] == sg.id) {
+				return false;
+			}
+		}
+		ids[i] = sg.id;
+	}
+	return r->p == r->end;
+}
+
+/* clear stops the animations of the cells of w (once each: anim_Stop
+ * ignores the copies of a freed instance), frees their resources, blanks
+ * them and closes its grids */
+static void clear(Window *w) {
+	uint32_t x, y;
+	Rune_ *r;
+
+	while (w->numGrids > 0) {
+		window_closeGrid(w, w->grids[0]->id);
+	}
+	for (y = 0; y < w->initH; ++y) {
+		for (x = 0; x < w->initW; ++x) {
+			r = &w->buff[(size_t)y * WINDOW_STRIDE + x];
+			if (r->r.anim != 0) {
+				anim_Stop(r->r.anim);
+			}
+			rune_Evict(&r->r);
+			r->ch = rune_blankChar;
+			blockindex_Set(&w->blocks, x, y, r->r.code);
+		}
+	}
+	w->capturing = false;
+}
+
+/* restore replaces the state of w with the checked snapshot of r */
+static bool restore(Window *w, SnapReader *r, const SnapHeader *hdr) {
+	uint32_t i, x, y;
+	SnapGrid sg;
+	Rune_ *row;
+	Grid *g;
+
+	/* the rows are committed before anything is changed, so that w is
+	 * left as it was if they cannot be */
+	if (!window_commit(w, hdr->initH)) {
+		return false;
+	}
+	for (i = 0; i < r->numAssets; ++i) {
+		r->ids[i] = asset_Open(r->files[i], r->kinds[i]);
+	}
+	r->p = r->cells;
+	clear(w);
+	window_resize(w, hdr->initW - WINDOW_MARGIN_W,
+		      hdr->initH - WINDOW_MARGIN_H);
+	for (y = 0; y < hdr->initH; ++y) {
+		row = &w->buff[(size_t)y * WINDOW_STRIDE];
+		if (!readRow(r, row, hdr->initW)) {
+			return false;
+		}
+		/* the block index is rebuilt from the cells rather than
+		 * saved, since it is derived from them */
+		for (x = 0; x < hdr->initW; ++x) {
+			blockindex_Set(&w->blocks, x, y, row[x].r.code);
+		}
+	}
+	for (i = 0; i < hdr->numGrids; ++i) {
+		if (!get(r, &sg, sizeof(sg)) ||
+		    (g = window_newGrid(w, sg.id, sg.w, sg.h)) == NULL) {
+			return false;
+		}
+		for (y = 0; y < sg.h; ++y) {
+			if (!readRow(r, &g->cells[(size_t)y * sg.w], sg.w)) {
+				return false;
+			}
+		}
+		window_placeGrid(w, sg.id, sg.x, sg.y, sg.z);
+		window_showGrid(w, sg.id, !(sg.flags & SNAP_GRID_HIDDEN));
+		window_opaqueGrid(w, sg.id, sg.flags & SNAP_GRID_OPAQUE);
+	}
+
+	/* refit to the window as it is now, which may differ from when the
+	 * snapshot was saved */
+	window_setCellSize(w, hdr->cellW, hdr->cellH);
+	for (i = 0; i < r->numAssets; ++i) {
+		asset_Prefetch(r->ids[i]);
+	}
+	return true;
+}
+
+/* snapshot_Restore replaces the state of w with the snapshot at path. The
+ * snapshot is checked whole first, so w is unchanged if it is invalid. */
+bool snapshot_Restore(Window *w, const char *path) {
+	SnapHeader hdr;
+	SnapReader r;
+	struct stat st;
+	bool ok;
+	void *p;
+	int fd;
+#ifdef DEBUG
+	double start = sched_Now();
+#endif
+
+	if ((fd = open(path, O_RDONLY)) < 0) {
+		printf("error: failed to open snapshot %s\n", path);
+		return false;
+	}
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(SnapHeader)) {
+		printf("error: invalid snapshot %s\n", path);
+		close(fd);
+		return false;
+	}
+	p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED) {
+		printf("error: failed to map snapshot %s\n", path);
+		return false;
+	}
+
+	memset(&r, 0, sizeof(r));
+	r.p = p;
+	r.end = r.p + st.st_size;
+	get(&r, &hdr, sizeof(hdr));
+	if (!check(&r, &hdr)) {
+		printf("error: invalid snapshot %s\n", path);
+		ok = false;
+	} else if (!(ok = restore(w, &r, &hdr))) {
+		printf("error: failed to restore snapshot %s\n", path);
+	}
+#ifdef DEBUG
+	if (ok) {
+		printf("snapshot: restored %s in %.2f ms\n", path,
+		       (sched_Now() - start) * 1000.0);
+	}
+#endif
+	munmap(p, st.st_size);
+	return ok;
+}
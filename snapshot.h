@@ -0,0 +1,47 @@
+/*
+ * snapshot.h
+ * A snapshot saves the state of a Window (its cell size, the cells of its
+ * buffer and grids, and the assets they show) to a binary file, so that a
+ * session can be restored at launch without rebuilding it rune by rune:
+ *   SnapHeader
+ *   the asset table             numAssets x (uint32_t kind, len, char[len])
+ *   the buffer                  initH rows of initW cells
+ *   the grids                   numGrids x (SnapGrid, h rows of w cells)
+ * Cells are saved as SnapCells rather than as runes, which hold pointers and
+ * GL objects. Each row is run-length encoded (a uint32_t count, then the
+ * SnapCell repeated), which shrinks blank rows and the cells of a resource
+ * block to a single run.
+ * Restoring rebuilds the block index from the cells, and starts importing
+ * the assets on the asset thread so that the first frame does not wait for
+ * them. Animations and the update and pointer hooks of runes are not saved.
+ */
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "window.h"
+
+/* The kinds of saved cells */
+enum { SNAP_CHAR = 0, SNAP_IMAGE = 1, SNAP_MESH = 2 };
+
+/* The render flags of a saved cell */
+enum { SNAP_INVERT = 1 << 0,
+       SNAP_BOLD = 1 << 1,
+       SNAP_ITALIC = 1 << 2,
+       SNAP_UNDERLINE = 1 << 3 };
+
+/* SnapCell is a saved cell */
+typedef struct {
+	uint32_t code, type;
+	uint32_t fontSize, color, material;
+	uint16_t w, h;
+	uint8_t kind;   /* SNAP_* */
+	uint8_t flags;  /* SNAP_INVERT etc. */
+	uint16_t asset; /* the entry + 1 in the asset table, 0 for none */
+} SnapCell;
+
+bool snapshot_Save(Window *, const char *);
+bool snapshot_Restore(Window *, const char *);
+
+#endif
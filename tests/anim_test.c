@@ -0,0 +1,72 @@
+/*
+ * anim_test.c
+ * Checks that stopping the shared instance of several rune copies frees it
+ * once, and that tracks advance to their end values.
+ */
+#include <math.h>
+#include <stdio.h>
+#include "anim.h"
+
+static uint32_t failures;
+
+/* check reports a failed check */
+static void check(bool ok, const char *what) {
+	if (!ok) {
+		printf("FAIL: %s\n", what);
+		failures++;
+	}
+}
+
+/* testRepeatedStop stops one instance as often as a stamped rune has
+ * copies; it must be handed out again only once */
+static void testRepeatedStop() {
+	uint32_t a, b, c, d, i;
+
+	a = anim_Add(0, ANIM_SCALE, 1.0f, 2.0f, 1.0f, ANIM_LOOP);
+	b = anim_Add(0, ANIM_OPACITY, 0.0f, 1.0f, 1.0f, ANIM_ONCE);
+	check(a != 0 && b != 0 && a != b, "new instances");
+	for (i = 0; i < 6; ++i) {
+		anim_Stop(a);
+	}
+	check(anim_Instance(a) == NULL, "stopped instance still readable");
+	check(anim_NumTracks() == 1, "stopped tracks left behind");
+	check(anim_Add(a, ANIM_SCALE, 1.0f, 2.0f, 1.0f, 0) == 0,
+	      "track added to a stopped instance");
+
+	c = anim_Add(0, ANIM_RED, 0.0f, 1.0f, 1.0f, ANIM_ONCE);
+	d = anim_Add(0, ANIM_RED, 0.0f, 1.0f, 1.0f, ANIM_ONCE);
+	check(c == a, "freed instance not reused");
+	check(d != a && d != b && d != 0, "freed instance reused twice");
+	anim_Stop(b);
+	anim_Stop(c);
+	anim_Stop(d);
+	anim_Stop(d);
+	check(anim_NumTracks() == 0, "tracks left after stopping all");
+}
+
+/* testTick runs a track past its end */
+static void testTick() {
+	const AnimInstance *v;
+	uint32_t a, i;
+
+	a = anim_Add(0, ANIM_OFFSET_X, 0.0f, 4.0f, 0.5f, ANIM_ONCE);
+	for (i = 0; i < 10; ++i) {
+		anim_Tick(0.1f);
+	}
+	v = anim_Instance(a);
+	check(v != NULL && fabsf(v->v[ANIM_OFFSET_X] - 4.0f) < 1e-5f,
+	      "track did not end at its end value");
+	check(v != NULL && v->v[ANIM_SCALE] == 1.0f, "untouched property");
+	anim_Stop(a);
+}
+
+int main() {
+	testRepeatedStop();
+	testTick();
+	if (failures != 0) {
+		printf("anim_test: %u failures\n", failures);
+		return 1;
+	}
+	puts("anim_test: ok");
+	return 0;
+}
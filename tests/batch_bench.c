@@ -0,0 +1,133 @@
+/*
+ * batch_bench.c
+ * Times each batch kernel at each level batch_SetLevel() accepts and reports
+ * the points (elements) processed per second. The points fit in L2, so the
+ * figures are those of the kernels rather than of memory.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "batch.h"
+#include "sched.h"
+
+enum { N = 4096, MIN_PASSES = 64 };
+
+/* the time each kernel is run for at each level (s) */
+static const double runTime = 0.2;
+
+static Mat4x4 mat;
+static Vector3 points[N], points3[N];
+static Vector4 vecs[N], vecs4[N];
+static float a[3][N], b[3][N], t[N], out[N];
+static volatile float sink;
+
+static void runTransformPoints() {
+	batch_TransformPoints(&mat, points, points3, N);
+	sink += points3[N - 1].x;
+}
+
+static void runTransformVec4() {
+	batch_TransformVec4(&mat, vecs, vecs4, N);
+	sink += vecs4[N - 1].x;
+}
+
+static void runLerp() {
+	batch_Lerp(a[0], b[0], t, out, N);
+	sink += out[N - 1];
+}
+
+/* runNormalize3 normalizes b in place; once normalized it stays so, which
+ * costs the same */
+static void runNormalize3() {
+	batch_Normalize3(b[0], b[1], b[2], N);
+	sink += b[0][N - 1];
+}
+
+static void runDot3() {
+	batch_Dot3(a[0], a[1], a[2], b[0], b[1], b[2], out, N);
+	sink += out[N - 1];
+}
+
+static void runBounds() {
+	sink += batch_Bounds(points, N).max.x;
+}
+
+static const struct {
+	const char *name;
+	void (*run)();
+} kernels[] = {
+    {"TransformPoints", runTransformPoints},
+    {"TransformVec4", runTransformVec4},
+    {"Lerp", runLerp},
+    {"Normalize3", runNormalize3},
+    {"Dot3", runDot3},
+    {"Bounds", runBounds},
+};
+#define NUM_KERNELS (sizeof(kernels) / sizeof(kernels[0]))
+
+static const char *levelNames[] = {"scalar", "sse2", "avx"};
+
+/* bench runs kernel k for runTime and returns its points per second */
+static double bench(uint32_t k) {
+	uint32_t i, passes = 0;
+	double start, elapsed;
+
+	kernels[k].run();
+	start = sched_Now();
+	do {
+		for (i = 0; i < MIN_PASSES; ++i) {
+			kernels[k].run();
+		}
+		passes += MIN_PASSES;
+	} while ((elapsed = sched_Now() - start) < runTime);
+	return (double)passes * N / elapsed;
+}
+
+int main() {
+	double rate[NUM_KERNELS][3];
+	uint32_t i, k, l;
+
+	srand(1);
+	mat = Mat4x4Identity;
+	mat4x4_rotate(&mat, 30.0f, 0.0f, 0.6f, 0.8f);
+	mat4x4_translate(&mat, 1.0f, 2.0f, 3.0f);
+	for (i = 0; i < N; ++i) {
+		points[i].x = vecs[i].x = 2.0f * rand() / RAND_MAX - 1.0f;
+		points[i].y = vecs[i].y = 2.0f * rand() / RAND_MAX - 1.0f;
+		points[i].z = vecs[i].z = 2.0f * rand() / RAND_MAX - 1.0f;
+		vecs[i].w = 1.0f;
+		for (k = 0; k < 3; ++k) {
+			a[k][i] = 2.0f * rand() / RAND_MAX - 1.0f;
+			b[k][i] = 2.0f * rand() / RAND_MAX - 1.0f;
+		}
+		t[i] = 1.0f * rand() / RAND_MAX;
+	}
+
+	printf("%-16s", "M points/s");
+	for (l = BATCH_SCALAR; l <= BATCH_AVX; ++l) {
+		printf(" %8s", levelNames[l]);
+	}
+	putchar('\n');
+	for (l = BATCH_SCALAR; l <= BATCH_AVX; ++l) {
+		if (batch_SetLevel(l) != l) {
+			for (k = 0; k < NUM_KERNELS; ++k) {
+				rate[k][l] = 0.0;
+			}
+			continue;
+		}
+		for (k = 0; k < NUM_KERNELS; ++k) {
+			rate[k][l] = bench(k);
+		}
+	}
+	for (k = 0; k < NUM_KERNELS; ++k) {
+		printf("%-16s", kernels[k].name);
+		for (l = BATCH_SCALAR; l <= BATCH_AVX; ++l) {
+			if (rate[k][l] == 0.0) {
+				printf(" %8s", "-");
+			} else {
+				printf(" %8.1f", rate[k][l] / 1e6);
+			}
+		}
+		putchar('\n');
+	}
+	return 0;
+}
@@ -0,0 +1,265 @@
+/*
+ * block_test.c
+ * Checks the block index against the runs and blocks recomputed from the
+ * cells by brute force, and its lookups against a scan of the blocks, after
+ * directed and random edits.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "block.h"
+#include "rune.h"
+
+enum { COLS = 40, ROWS = 24, EDITS = 20000 };
+
+static uint32_t cells[ROWS][COLS];
+static uint32_t failures;
+
+/* fail reports a failed check */
+static void fail(const char *what, uint32_t x, uint32_t y) {
+	printf("FAIL: %s at (%u, %u)\n", what, x, y);
+	failures++;
+}
+
+/* set changes cell (x, y) of both idx and the reference */
+static void set(BlockIndex *idx, uint32_t x, uint32_t y, uint32_t code) {
+	cells[y][x] = code;
+	blockindex_Set(idx, x, y, code);
+}
+
+/* checkRuns compares the runs of every row to the maximal runs of
+ * matching resource cells */
+static void checkRuns(const BlockIndex *idx) {
+	const BlockRow *row;
+	uint32_t x, y, i, x1;
+
+	for (y = 0; y < ROWS; ++y) {
+		row = &idx->rows[y];
+		i = 0;
+		for (x = 0; x < COLS; x = x1) {
+			for (x1 = x + 1;
+			     x1 < COLS && cells[y][x1] == cells[y][x]; ++x1)
+				;
+			if (!rune_IsResource(cells[y][x])) {
+				continue;
+			}
+			if (i == row->numRuns || row->runs[i].x0 != x ||
+			    row->runs[i].x1 != x1 ||
+			    row->runs[i].code != cells[y][x]) {
+				fail("run", x, y);
+				return;
+			}
+			++i;
+		}
+		if (i != row->numRuns) {
+			fail("extra run", 0, y);
+		}
+	}
+}
+
+/* runEnd returns the end of the run of matching cells of row y that begins
+ * at x */
+static uint32_t runEnd(uint32_t y, uint32_t x) {
+	uint32_t x1;
+
+	for (x1 = x + 1; x1 < COLS && cells[y][x1] == cells[y][x]; ++x1)
+		;
+	return x1;
+}
+
+/* sameRun returns true if [x0, x1) is a whole run of code in row y */
+static bool sameRun(uint32_t y, uint32_t x0, uint32_t x1, uint32_t code) {
+	uint32_t x;
+
+	for (x = x0; x < x1; ++x) {
+		if (cells[y][x] != code) {
+			return false;
+		}
+	}
+	return (x0 == 0 || cells[y][x0 - 1] != code) &&
+	       (x1 == COLS || cells[y][x1] != code);
+}
+
+/* checkBlocks compares the blocks of idx to the rectangles of matching
+ * resource cells: each run that is not a copy of the run above it, stacked
+ * with the copies of it below */
+static void checkBlocks(BlockIndex *idx) {
+	static Block rects[ROWS * COLS];
+	uint32_t x, y, x1, i, j, n;
+	Block *r;
+
+	n = 0;
+	for (y = 0; y < ROWS; ++y) {
+		for (x = 0; x < COLS; x = x1) {
+			x1 = runEnd(y, x);
+			if (!rune_IsResource(cells[y][x]) ||
+			    (y > 0 && sameRun(y - 1, x, x1, cells[y][x]))) {
+				continue;
+			}
+			r = &rects[n++];
+			r->x = x;
+			r->y = y;
+			r->w = x1 - x;
+			r->code = cells[y][x];
+			for (r->h = 1; y + r->h < ROWS &&
+				       sameRun(y + r->h, x, x1, r->code);
+			     ++r->h)
+				;
+		}
+	}
+
+	blockindex_Update(idx);
+	if (idx->numBlocks != n) {
+		printf("FAIL: %u blocks, expected %u\n", idx->numBlocks, n);
+		failures++;
+		return;
+	}
+	for (i = 0; i < n; ++i) {
+		for (j = 0; j < idx->numBlocks; ++j) {
+			if (memcmp(&rects[i], &idx->blocks[j], sizeof(Block)) ==
+			    0) {
+				break;
+			}
+		}
+		if (j == idx->numBlocks) {
+			fail("missing block", rects[i].x, rects[i].y);
+		}
+	}
+}
+
+/* checkFind compares blockindex_Find() at every cell to a scan of the
+ * blocks of idx for the one covering it */
+static void checkFind(BlockIndex *idx) {
+	uint32_t x, y, i;
+	Block *b, *want;
+
+	for (y = 0; y < ROWS; ++y) {
+		for (x = 0; x < COLS; ++x) {
+			want = NULL;
+			for (i = 0; i < idx->numBlocks; ++i) {
+				b = &idx->blocks[i];
+				if (x >= b->x && x < b->x + b->w && y >= b->y &&
+				    y < b->y + b->h) {
+					want = b;
+					break;
+				}
+			}
+			if (want != NULL && want->code != cells[y][x]) {
+				fail("block covers another code", x, y);
+			}
+			if (blockindex_Find(idx, x, y) != want) {
+				fail("find", x, y);
+			}
+		}
+	}
+}
+
+/* testTrimLeft trims the left edge of a run, then extends a new run into
+ * the gap, which must merge into a single 2x1 block */
+static void testTrimLeft() {
+	BlockIndex idx;
+	Block *b;
+
+	memset(cells, 0, sizeof(cells));
+	init_BlockIndex(&idx, COLS, ROWS);
+	set(&idx, 2, 0, 0xe008);
+	set(&idx, 3, 0, 0xe008);
+	set(&idx, 1, 0, 0xe009);
+	set(&idx, 0, 0, 0xe009);
+	checkRuns(&idx);
+	blockindex_Update(&idx);
+	b = blockindex_Find(&idx, 0, 0);
+	if (idx.numBlocks != 2 || b == NULL || b->code != 0xe009 ||
+	    b->x != 0 || b->w != 2 || b->h != 1) {
+		fail("left-trimmed run did not merge", 0, 0);
+	}
+	deinit_BlockIndex(&idx);
+}
+
+/* testCutCorner types a character into the corner of a square of one
+ * resource: the rest is split into two rectangles, neither of which may
+ * cover the character */
+static void testCutCorner() {
+	static const Block want[] = {{1, 0, 2, 1, 0xe008},
+				     {0, 1, 3, 2, 0xe008}};
+	BlockIndex idx;
+	uint32_t x, y, i;
+
+	memset(cells, 0, sizeof(cells));
+	init_BlockIndex(&idx, COLS, ROWS);
+	for (y = 0; y < 3; ++y) {
+		for (x = 0; x < 3; ++x) {
+			set(&idx, x, y, 0xe008);
+		}
+	}
+	set(&idx, 0, 0, 'a');
+	blockindex_Update(&idx);
+	if (blockindex_Find(&idx, 0, 0) != NULL) {
+		fail("cut-out corner found in a block", 0, 0);
+	}
+	if (idx.numBlocks != 2) {
+		fail("cut square is not two blocks", 0, 0);
+	}
+	for (i = 0; i < 2 && idx.numBlocks == 2; ++i) {
+		if (memcmp(&idx.blocks[i], &want[i], sizeof(Block)) != 0) {
+			fail("wrong block", want[i].x, want[i].y);
+		}
+	}
+	deinit_BlockIndex(&idx);
+}
+
+/* testTrimRight trims the right edge of a run, then extends a new run out
+ * of the gap, which must merge into a single 2x1 block */
+static void testTrimRight() {
+	BlockIndex idx;
+	Block *b;
+
+	memset(cells, 0, sizeof(cells));
+	init_BlockIndex(&idx, COLS, ROWS);
+	set(&idx, 0, 0, 0xe008);
+	set(&idx, 1, 0, 0xe008);
+	set(&idx, 1, 0, 0xe009);
+	set(&idx, 2, 0, 0xe009);
+	checkRuns(&idx);
+	blockindex_Update(&idx);
+	b = blockindex_Find(&idx, 2, 0);
+	if (idx.numBlocks != 2 || b == NULL || b->code != 0xe009 ||
+	    b->x != 1 || b->w != 2 || b->h != 1) {
+		fail("right-trimmed run did not merge", 1, 0);
+	}
+	deinit_BlockIndex(&idx);
+}
+
+/* testRandom makes random edits with few distinct codes, so that runs are
+ * often split, trimmed and merged */
+static void testRandom() {
+	static const uint32_t codes[] = {' ', 'a', 0xe008, 0xe009, 0xe00a};
+	BlockIndex idx;
+	uint32_t i;
+
+	memset(cells, 0, sizeof(cells));
+	init_BlockIndex(&idx, COLS, ROWS);
+	srand(1);
+	for (i = 0; i < EDITS && failures == 0; ++i) {
+		set(&idx, rand() % COLS, rand() % ROWS, codes[rand() % 5]);
+		checkRuns(&idx);
+		if (i % 97 == 0) {
+			checkBlocks(&idx);
+			checkFind(&idx);
+		}
+	}
+	deinit_BlockIndex(&idx);
+}
+
+int main() {
+	testTrimLeft();
+	testTrimRight();
+	testCutCorner();
+	testRandom();
+	if (failures != 0) {
+		printf("block_test: %u failures\n", failures);
+		return 1;
+	}
+	puts("block_test: ok");
+	return 0;
+}
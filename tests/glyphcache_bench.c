@@ -0,0 +1,101 @@
+/*
+ * glyphcache_bench.c
+ * Times glyph lookups for a screen of mixed ASCII text: the uthash table of
+ * one-character strings the glyph cache replaced, the cache's direct ASCII
+ * path, and its hashed path (glyphs of a non-default size).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "glyphcache.h"
+#include "sched.h"
+#include "uthash.h"
+
+enum { CELLS = 200 * 60, PASSES = 1000 };
+
+/* LoadedTex is the node of the former texture -> name table */
+typedef struct {
+	GLuint tex;
+	char name[32];
+	UT_hash_handle hh;
+} LoadedTex;
+
+static LoadedTex *loadedTextures = NULL;
+static uint8_t text[CELLS];
+
+/* report prints the time per lookup of n lookups that took t seconds */
+static void report(const char *name, double t, double n, GLuint sum) {
+	printf("%-10s %6.2f ns/lookup %8.1f M lookups/s (%u)\n", name,
+	       t / n * 1e9, n / t / 1e6, sum);
+}
+
+/* benchUthash looks up every cell as the former latin1_to_texture did */
+static void benchUthash() {
+	LoadedTex *lup;
+	GLuint sum = 0;
+	uint32_t i, j;
+	char str[2];
+	double t;
+
+	for (i = 1; i < 256; ++i) {
+		lup = calloc(1, sizeof(LoadedTex));
+		lup->tex = i;
+		lup->name[0] = (char)i;
+		HASH_ADD_STR(loadedTextures, name, lup);
+	}
+	t = sched_Now();
+	for (j = 0; j < PASSES; ++j) {
+		for (i = 0; i < CELLS; ++i) {
+			str[0] = (char)text[i];
+			str[1] = '\0';
+			HASH_FIND_STR(loadedTextures, str, lup);
+			sum += lup->tex;
+		}
+	}
+	report("uthash", sched_Now() - t, (double)CELLS * PASSES, sum);
+}
+
+/* benchCache looks up every cell in gc under keys of the given size */
+static void benchCache(GlyphCache *gc, const char *name, uint32_t size) {
+	GLuint sum = 0;
+	Glyph *g;
+	uint32_t i, j;
+	double t;
+
+	t = sched_Now();
+	for (j = 0; j < PASSES; ++j) {
+		for (i = 0; i < CELLS; ++i) {
+			g = glyphcache_Find(gc, GLYPH_KEY(0, 0, size, text[i]));
+			sum += g->tex;
+		}
+	}
+	report(name, sched_Now() - t, (double)CELLS * PASSES, sum);
+}
+
+int main() {
+	GlyphCache gc;
+	uint32_t i;
+
+	/* mostly lowercase prose with spaces, capitals and punctuation */
+	srand(1);
+	for (i = 0; i < CELLS; ++i) {
+		if (rand() % 6 == 0) {
+			text[i] = ' ';
+		} else if (rand() % 10 == 0) {
+			text[i] = 33 + rand() % 94;
+		} else {
+			text[i] = 'a' + rand() % 26;
+		}
+	}
+	init_GlyphCache(&gc, 256);
+	for (i = 1; i < 256; ++i) {
+		glyphcache_Insert(&gc, GLYPH_KEY(0, 0, 0, i))->tex = i;
+		glyphcache_Insert(&gc, GLYPH_KEY(0, 0, 24, i))->tex = i;
+	}
+
+	benchUthash();
+	benchCache(&gc, "ascii", 0);
+	benchCache(&gc, "hashed", 24);
+	deinit_GlyphCache(&gc);
+	return 0;
+}
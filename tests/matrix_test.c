@@ -0,0 +1,222 @@
+/*
+ * matrix_test.c
+ * Checks the matrix multiply, inverse and affine inverse against reference
+ * math in double precision on random matrices. matrix.c picks its SSE, AVX
+ * or scalar code at compile time, so `make check` links this test against
+ * each build of it; the name of the build is passed as the first argument.
+ */
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "matrix.h"
+
+enum { TRIALS = 10000 };
+
+static uint32_t failures;
+
+/* at returns element (row r, column c) of the column-major m */
+static float at(const Mat4x4 *m, int r, int c) {
+	return ((const float *)m)[c * 4 + r];
+}
+
+/* randomMat returns a matrix with entries in [-1, 1] and a heavy diagonal,
+ * so that it is well conditioned */
+static Mat4x4 randomMat() {
+	Mat4x4 m;
+	float *f = (float *)&m;
+	int i;
+
+	for (i = 0; i < 16; ++i) {
+		f[i] = 2.0f * rand() / RAND_MAX - 1.0f;
+	}
+	for (i = 0; i < 4; ++i) {
+		f[i * 5] += f[i * 5] < 0.0f ? -4.0f : 4.0f;
+	}
+	return m;
+}
+
+/* randomAffine returns a random rotation, scale and translation */
+static Mat4x4 randomAffine() {
+	Mat4x4 m = Mat4x4Identity;
+	float x, y, z, n;
+
+	x = 1.0f * rand() / RAND_MAX;
+	y = 1.0f * rand() / RAND_MAX;
+	z = 1.0f + rand() / RAND_MAX;
+	n = sqrtf(x * x + y * y + z * z);
+	mat4x4_translate(&m, 20.0f * rand() / RAND_MAX - 10.0f,
+			 20.0f * rand() / RAND_MAX - 10.0f,
+			 20.0f * rand() / RAND_MAX - 10.0f);
+	mat4x4_rotate(&m, 360.0f * rand() / RAND_MAX, x / n, y / n, z / n);
+	mat4x4_scale(&m, 0.5f + 2.0f * rand() / RAND_MAX,
+		     0.5f + 2.0f * rand() / RAND_MAX,
+		     0.5f + 2.0f * rand() / RAND_MAX);
+	return m;
+}
+
+/* refMultiply stores a * b in out */
+static void refMultiply(double out[4][4], const Mat4x4 *a, const Mat4x4 *b) {
+	int r, c, k;
+
+	for (r = 0; r < 4; ++r) {
+		for (c = 0; c < 4; ++c) {
+			out[r][c] = 0.0;
+			for (k = 0; k < 4; ++k) {
+				out[r][c] += (double)at(a, r, k) * at(b, k, c);
+			}
+		}
+	}
+}
+
+/* refInverse stores the inverse of m in out by Gauss-Jordan elimination
+ * with partial pivoting. Returns false if m is singular. */
+static bool refInverse(double out[4][4], const Mat4x4 *m) {
+	double a[4][8], t;
+	int r, c, p;
+
+	for (r = 0; r < 4; ++r) {
+		for (c = 0; c < 4; ++c) {
+			a[r][c] = at(m, r, c);
+			a[r][c + 4] = r == c;
+		}
+	}
+	for (c = 0; c < 4; ++c) {
+		for (p = c, r = c + 1; r < 4; ++r) {
+			if (fabs(a[r][c]) > fabs(a[p][c])) {
+				p = r;
+			}
+		}
+		if (a[p][c] == 0.0) {
+			return false;
+		}
+		for (r = 0; r < 8; ++r) {
+			t = a[c][r];
+			a[c][r] = a[p][r];
+			a[p][r] = t;
+		}
+		for (t = a[c][c], r = 0; r < 8; ++r) {
+			a[c][r] /= t;
+		}
+		for (r = 0; r < 4; ++r) {
+			for (t = a[r][c], p = 0; r != c && p < 8; ++p) {
+				a[r][p] -= t * a[c][p];
+			}
+		}
+	}
+	for (r = 0; r < 4; ++r) {
+		for (c = 0; c < 4; ++c) {
+			out[r][c] = a[r][c + 4];
+		}
+	}
+	return true;
+}
+
+/* compare reports the elements of got more than tol (relative to their
+ * magnitude) from ref */
+static void compare(const char *what, const Mat4x4 *got, double ref[4][4],
+		    double tol) {
+	int r, c;
+
+	for (r = 0; r < 4; ++r) {
+		for (c = 0; c < 4; ++c) {
+			if (fabs(at(got, r, c) - ref[r][c]) >
+			    tol * (1.0 + fabs(ref[r][c]))) {
+				printf("FAIL: %s (%d, %d) is %g, expected %g\n",
+				       what, r, c, at(got, r, c), ref[r][c]);
+				failures++;
+				return;
+			}
+		}
+	}
+}
+
+/* testMultiply checks the matrix and vector products */
+static void testMultiply() {
+	Mat4x4 a, b, m;
+	Vector4 v, u;
+	double ref[4][4], e[4];
+	int i, r;
+
+	for (i = 0; i < TRIALS && failures == 0; ++i) {
+		a = randomMat();
+		b = randomMat();
+		refMultiply(ref, &a, &b);
+		mat4x4_multiply_to(&m, &a, &b);
+		compare("multiply_to", &m, ref, 1e-5);
+		m = mat4x4_multiply(a, b);
+		compare("multiply", &m, ref, 1e-5);
+
+		memcpy(&v, &b, sizeof(v));
+		for (r = 0; r < 4; ++r) {
+			e[r] = (double)at(&a, r, 0) * v.x +
+			       (double)at(&a, r, 1) * v.y +
+			       (double)at(&a, r, 2) * v.z +
+			       (double)at(&a, r, 3) * v.w;
+		}
+		u = mat4x4_multiply_vec4x1(a, v);
+		if (fabs(u.x - e[0]) > 1e-5 * (1.0 + fabs(e[0])) ||
+		    fabs(u.y - e[1]) > 1e-5 * (1.0 + fabs(e[1])) ||
+		    fabs(u.z - e[2]) > 1e-5 * (1.0 + fabs(e[2])) ||
+		    fabs(u.w - e[3]) > 1e-5 * (1.0 + fabs(e[3]))) {
+			puts("FAIL: multiply_vec4x1");
+			failures++;
+		}
+	}
+}
+
+/* testInverse checks the general and affine inverses, and that singular
+ * matrices are refused */
+static void testInverse() {
+	static const Mat4x4 singular = {1, 2, 3, 4, 5, 6, 7, 8,
+					1, 2, 3, 4, 0, 1, 0, 1};
+	Mat4x4 m, inv;
+	double ref[4][4];
+	int i;
+
+	for (i = 0; i < TRIALS && failures == 0; ++i) {
+		m = randomMat();
+		refInverse(ref, &m);
+		if (!mat4x4_inverse_to(&inv, &m)) {
+			puts("FAIL: inverse_to refused a regular matrix");
+			failures++;
+		}
+		compare("inverse_to", &inv, ref, 1e-5);
+
+		m = randomAffine();
+		refInverse(ref, &m);
+		if (!mat4x4_affine_inverse(&inv, &m)) {
+			puts("FAIL: affine_inverse refused a regular matrix");
+			failures++;
+		}
+		compare("affine_inverse", &inv, ref, 1e-5);
+	}
+	inv = Mat4x4Identity;
+	if (mat4x4_inverse_to(&inv, &singular) ||
+	    mat4x4_affine_inverse(&inv, &singular) ||
+	    memcmp(&inv, &Mat4x4Identity, sizeof(inv)) != 0) {
+		puts("FAIL: singular matrix inverted");
+		failures++;
+	}
+}
+
+int main(int argc, char **argv) {
+	const char *name = argc > 1 ? argv[1] : "default";
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	if (strcmp(name, "avx") == 0 && !__builtin_cpu_supports("avx")) {
+		printf("matrix_test (%s): skipped, no AVX\n", name);
+		return 0;
+	}
+#endif
+	srand(1);
+	testMultiply();
+	testInverse();
+	if (failures != 0) {
+		printf("matrix_test (%s): %u failures\n", name, failures);
+		return 1;
+	}
+	printf("matrix_test (%s): ok\n", name);
+	return 0;
+}
@@ -0,0 +1,248 @@
+/*
+ * xform_test.c
+ * Checks the transform tree against a reference hierarchy kept by handle,
+ * after random adds, removals (which remap the positions of the nodes
+ * after the one removed), reparenting (which may leave the nodes to be
+ * sorted lazily) and cycles that must be refused. Local transforms are
+ * whole-cell translations, so world transforms are exact sums.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "xform.h"
+
+enum { MAX_HANDLES = 256, MAX_NODES = 96, OPS = 20000 };
+
+/* the reference: the parent handle and offset of each live handle */
+static struct {
+	bool live;
+	uint32_t parent;
+	int32_t x, y, z;
+} ref[MAX_HANDLES];
+
+static uint32_t failures;
+
+/* fail reports a failed check */
+static void fail(const char *what, uint32_t h) {
+	printf("FAIL: %s (handle %u)\n", what, h);
+	failures++;
+}
+
+/* translation returns a translation by (x, y, z) */
+static Mat4x4 translation(int32_t x, int32_t y, int32_t z) {
+	Mat4x4 m = Mat4x4Identity;
+
+	mat4x4_translate(&m, x, y, z);
+	return m;
+}
+
+/* randomLive returns a random live handle, or XFORM_NONE if there is none
+ * (or, if root is true, at times) */
+static uint32_t randomLive(bool root) {
+	uint32_t h, n;
+
+	if (root && rand() % 8 == 0) {
+		return XFORM_NONE;
+	}
+	for (n = 0; n < MAX_HANDLES; ++n) {
+		h = rand() % MAX_HANDLES;
+		if (ref[h].live) {
+			return h;
+		}
+	}
+	for (h = 0; h < MAX_HANDLES; ++h) {
+		if (ref[h].live) {
+			return h;
+		}
+	}
+	return XFORM_NONE;
+}
+
+/* below returns true if handle a is h or one of its descendants */
+static bool below(uint32_t a, uint32_t h) {
+	for (; a != XFORM_NONE; a = ref[a].parent) {
+		if (a == h) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/* numLive returns the number of live handles */
+static uint32_t numLive() {
+	uint32_t h, n;
+
+	for (h = n = 0; h < MAX_HANDLES; ++h) {
+		n += ref[h].live;
+	}
+	return n;
+}
+
+/* add adds a node under a random node (or as a root) to both trees */
+static void add(XformTree *t) {
+	Mat4x4 m;
+	uint32_t h, p;
+	int32_t x, y, z;
+
+	p = randomLive(true);
+	x = rand() % 17 - 8;
+	y = rand() % 17 - 8;
+	z = rand() % 17 - 8;
+	m = translation(x, y, z);
+	if ((h = xform_Add(t, p, &m)) == XFORM_NONE || h >= MAX_HANDLES ||
+	    ref[h].live) {
+		fail("add returned a bad handle", h);
+		return;
+	}
+	ref[h].live = true;
+	ref[h].parent = p;
+	ref[h].x = x;
+	ref[h].y = y;
+	ref[h].z = z;
+}
+
+/* removeRandom removes a random node and its descendants from both trees */
+static void removeRandom(XformTree *t) {
+	uint32_t h, r;
+	bool gone[MAX_HANDLES];
+
+	if ((r = randomLive(false)) == XFORM_NONE) {
+		return;
+	}
+	xform_Remove(t, r);
+	for (h = 0; h < MAX_HANDLES; ++h) {
+		gone[h] = ref[h].live && below(h, r);
+	}
+	for (h = 0; h < MAX_HANDLES; ++h) {
+		ref[h].live &= !gone[h];
+	}
+}
+
+/* reparent moves a random node under another (or makes it a root); moves
+ * that would make a cycle must be refused */
+static void reparent(XformTree *t) {
+	uint32_t h, p;
+	bool cycle;
+
+	if ((h = randomLive(false)) == XFORM_NONE) {
+		return;
+	}
+	/* most random moves in a deep tree are cycles: only try one in a few
+	 * (each is reported by xform_SetParent) */
+	p = randomLive(true);
+	cycle = p != XFORM_NONE && below(p, h);
+	if (cycle && rand() % 8 != 0) {
+		return;
+	}
+	if (xform_SetParent(t, h, p) == cycle) {
+		fail(cycle ? "cycle accepted" : "move refused", h);
+		return;
+	}
+	if (!cycle) {
+		ref[h].parent = p;
+	}
+}
+
+/* setLocal gives a random node a new offset in both trees */
+static void setLocal(XformTree *t) {
+	Mat4x4 m;
+	uint32_t h;
+
+	if ((h = randomLive(false)) == XFORM_NONE) {
+		return;
+	}
+	ref[h].x = rand() % 17 - 8;
+	ref[h].y = rand() % 17 - 8;
+	ref[h].z = rand() % 17 - 8;
+	m = translation(ref[h].x, ref[h].y, ref[h].z);
+	xform_SetLocal(t, h, &m);
+}
+
+/* check updates t and compares it with the reference: the world transform
+ * of every handle, the order of the nodes and the handle index */
+static void check(XformTree *t) {
+	const Mat4x4 *w;
+	uint32_t h, i, a;
+	int32_t x, y, z;
+
+	xform_Update(t);
+	if (t->len != numLive()) {
+		fail("node count", t->len);
+	}
+	for (i = 0; i < t->len; ++i) {
+		if (t->parent[i] != XFORM_NONE && t->parent[i] >= i) {
+			fail("parent after child", t->handle[i]);
+		}
+		if (t->index[t->handle[i]] != i) {
+			fail("index", t->handle[i]);
+		}
+	}
+	for (h = 0; h < MAX_HANDLES; ++h) {
+		w = xform_World(t, h);
+		if (!ref[h].live) {
+			if (w != NULL) {
+				fail("removed node still found", h);
+			}
+			continue;
+		}
+		if (w == NULL) {
+			fail("node not found", h);
+			continue;
+		}
+		i = t->index[h];
+		a = ref[h].parent;
+		if (t->parent[i] !=
+		    (a == XFORM_NONE ? XFORM_NONE : t->index[a])) {
+			fail("parent", h);
+		}
+		x = y = z = 0;
+		for (a = h; a != XFORM_NONE; a = ref[a].parent) {
+			x += ref[a].x;
+			y += ref[a].y;
+			z += ref[a].z;
+		}
+		if (w->a3 != x || w->b3 != y || w->c3 != z) {
+			fail("world transform", h);
+		}
+	}
+}
+
+int main() {
+	XformTree t;
+	uint32_t i, n;
+
+	srand(1);
+	init_XformTree(&t);
+	for (i = 0; i < OPS && failures == 0; ++i) {
+		n = numLive();
+		switch (rand() % 8) {
+			case 0:
+			case 1:
+			case 2:
+				if (n < MAX_NODES) {
+					add(&t);
+				}
+				break;
+			case 3:
+				removeRandom(&t);
+				break;
+			case 4:
+			case 5:
+				reparent(&t);
+				break;
+			case 6:
+				setLocal(&t);
+				break;
+			default:
+				check(&t);
+				break;
+		}
+	}
+	check(&t);
+	deinit_XformTree(&t);
+	if (failures != 0) {
+		printf("xform_test: %u failures\n", failures);
+		return 1;
+	}
+	puts("xform_test: ok");
+	return 0;
+}
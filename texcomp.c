@@ -0,0 +1,634 @@
+#include "texcomp.h"
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "glstate.h"
+#include "mem.h"
+#include "util.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+enum { TEXCOMP_MAGIC = 0x43544c47, /* "GLTC" */
+       TEXCOMP_VERSION = 1 };
+
+/* TexCompHeader precedes the mip levels in each cache file. Each level is
+ * stored as its size (uint32_t) followed by its blocks */
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t key;
+	uint32_t format; /* the GL compressed internal format */
+	uint32_t w, h;
+	uint32_t levels;
+} TexCompHeader;
+
+static TexCompStats stats;
+
+/* fetchBlock copies the 4x4 block at block coords (bx, by) of the w x h
+ * RGBA8 image rgba to blk, repeating edge pixels for partial blocks. */
+static void fetchBlock(const uint8_t *rgba, uint32_t w, uint32_t h,
+		       uint32_t bx, uint32_t by, uint8_t *blk) {
+	uint32_t x, y, sx, sy;
+
+	for (y = 0; y < 4; ++y) {
+		sy = by * 4 + y < h ? by * 4 + y : h - 1;
+		if (bx * 4 + 3 < w) {
+			memcpy(&blk[y * 16], &rgba[(sy * w + bx * 4) * 4], 16);
+			continue;
+		}
+		for (x = 0; x < 4; ++x) {
+			sx = bx * 4 + x < w ? bx * 4 + x : w - 1;
+			memcpy(&blk[y * 16 + x * 4], &rgba[(sy * w + sx) * 4],
+			       4);
+		}
+	}
+}
+
+/* blockBounds writes the per-channel minimum and maximum of blk */
+static void blockBounds(const uint8_t *blk, uint8_t *mn, uint8_t *mx) {
+#ifdef __SSE2__
+	__m128i r0, r1, r2, r3, lo, hi;
+	uint32_t l, h;
+
+	r0 = _mm_loadu_si128((const __m128i *)&blk[0]);
+	r1 = _mm_loadu_si128((const __m128i *)&blk[16]);
+	r2 = _mm_loadu_si128((const __m128i *)&blk[32]);
+	r3 = _mm_loadu_si128((const __m128i *)&blk[48]);
+	lo = _mm_min_epu8(_mm_min_epu8(r0, r1), _mm_min_epu8(r2, r3));
+	hi = _mm_max_epu8(_mm_max_epu8(r0, r1), _mm_max_epu8(r2, r3));
+	lo = _mm_min_epu8(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(1, 0, 3, 2)));
+	hi = _mm_max_epu8(hi, _mm_shuffle_epi32(hi, _MM_SHUFFLE(1, 0, 3, 2)));
+	lo = _mm_min_epu8(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(2, 3, 0, 1)));
+	hi = _mm_max_epu8(hi, _mm_shuffle_epi32(hi, _MM_SHUFFLE(2, 3, 0, 1)));
+	l = (uint32_t)_mm_cvtsi128_si32(lo);
+	h = (uint32_t)_mm_cvtsi128_si32(hi);
+	memcpy(mn, &l, 4);
+	memcpy(mx, &h, 4);
+#else
+	int i, c;
+
+	memcpy(mn, blk, 4);
+	memcpy(mx, blk, 4);
+	for (i = 1; i < 16; ++i) {
+		for (c = 0; c < 4; ++c) {
+			uint8_t v = blk[i * 4 + c];
+			mn[c] = v < mn[c] ? v : mn[c];
+			mx[c] = v > mx[c] ? v : mx[c];
+		}
+	}
+#endif
+}
+
+/* to565 packs the RGB color c into 5:6:5 bits */
+static uint16_t to565(const uint8_t *c) {
+	return ((c[0] >> 3) << 11) | ((c[1] >> 2) << 5) | (c[2] >> 3);
+}
+
+/* from565 unpacks the 5:6:5 color p to 8-bit RGB */
+static void from565(uint16_t p, int *c) {
+	c[0] = (p >> 11) & 31;
+	c[1] = (p >> 5) & 63;
+	c[2] = p & 31;
+	c[0] = (c[0] << 3) | (c[0] >> 2);
+	c[1] = (c[1] << 2) | (c[1] >> 4);
+	c[2] = (c[2] << 3) | (c[2] >> 2);
+}
+
+/* flipDiagonal picks the diagonal of the bounding box that follows the
+ * block's colors: any channel that falls while the widest channel rises has
+ * its endpoints swapped */
+static void flipDiagonal(const uint8_t *blk, const uint8_t *mn,
+			 const uint8_t *mx, uint8_t *e0, uint8_t *e1) {
+	int cov[3], mid[3];
+	int i, c, ref;
+	uint8_t tmp;
+
+	ref = 0;
+	for (c = 0; c < 3; ++c) {
+		mid[c] = (mn[c] + mx[c] + 1) / 2;
+		cov[c] = 0;
+		if (mx[c] - mn[c] > mx[ref] - mn[ref]) {
+			ref = c;
+		}
+	}
+	for (i = 0; i < 16; ++i) {
+		int d = blk[i * 4 + ref] - mid[ref];
+		for (c = 0; c < 3; ++c) {
+			cov[c] += d * (blk[i * 4 + c] - mid[c]);
+		}
+	}
+	for (c = 0; c < 3; ++c) {
+		if (cov[c] < 0) {
+			tmp = e0[c];
+			e0[c] = e1[c];
+			e1[c] = tmp;
+		}
+	}
+}
+
+/* encodeColor writes the 8-byte BC1 color block for blk. The endpoints are
+ * the (slightly inset) corners of the block's bounding box. */
+static void encodeColor(const uint8_t *blk, const uint8_t *mn,
+			const uint8_t *mx, uint8_t *out) {
+	uint8_t e0[3], e1[3];
+	uint16_t c0, c1, tmp;
+	uint32_t indices;
+	int pal[4][3];
+	int i, j, c;
+
+	for (c = 0; c < 3; ++c) {
+		int inset = (mx[c] - mn[c]) >> 4;
+		e0[c] = mx[c] - inset;
+		e1[c] = mn[c] + inset;
+	}
+	flipDiagonal(blk, mn, mx, e0, e1);
+	c0 = to565(e0);
+	c1 = to565(e1);
+	if (c0 < c1) {
+		tmp = c0;
+		c0 = c1;
+		c1 = tmp;
+	}
+
+	indices = 0;
+	if (c0 != c1) {
+		from565(c0, pal[0]);
+		from565(c1, pal[1]);
+		for (c = 0; c < 3; ++c) {
+			pal[2][c] = (2 * pal[0][c] + pal[1][c]) / 3;
+			pal[3][c] = (pal[0][c] + 2 * pal[1][c]) / 3;
+		}
+		for (i = 0; i < 16; ++i) {
+			const uint8_t *p = &blk[i * 4];
+			int best, bestDist;
+
+			best = 0;
+			bestDist = 0x7fffffff;
+			for (j = 0; j < 4; ++j) {
+				int dr = p[0] - pal[j][0];
+				int dg = p[1] - pal[j][1];
+				int db = p[2] - pal[j][2];
+				int d = dr * dr + dg * dg + db * db;
+				if (d < bestDist) {
+					bestDist = d;
+					best = j;
+				}
+			}
+			indices |= (uint32_t)best << (i * 2);
+		}
+	}
+	out[0] = c0 & 0xff;
+	out[1] = c0 >> 8;
+	out[2] = c1 & 0xff;
+	out[3] = c1 >> 8;
+	out[4] = indices & 0xff;
+	out[5] = (indices >> 8) & 0xff;
+	out[6] = (indices >> 16) & 0xff;
+	out[7] = indices >> 24;
+}
+
+/* encodeAlpha writes the 8-byte BC3 alpha block for blk, using the
+ * 8-value interpolation mode between the block's minimum and maximum */
+static void encodeAlpha(const uint8_t *blk, uint8_t amin, uint8_t amax,
+			uint8_t *out) {
+	uint64_t indices;
+	int i;
+
+	out[0] = amax;
+	out[1] = amin;
+	indices = 0;
+	if (amax != amin) {
+		int range = amax - amin;
+		for (i = 0; i < 16; ++i) {
+			/* rank 0 is amin, rank 7 is amax */
+			int rank = ((blk[i * 4 + 3] - amin) * 7 + range / 2) /
+				   range;
+			uint64_t code;
+			if (rank == 7) {
+				code = 0;
+			} else if (rank == 0) {
+				code = 1;
+			} else {
+				code = 8 - rank;
+			}
+			indices |= code << (i * 3);
+		}
+	}
+	for (i = 0; i < 6; ++i) {
+		out[2 + i] = (indices >> (i * 8)) & 0xff;
+	}
+}
+
+/* texcomp_EncodeBC1 encodes the w x h RGBA8 image rgba (ignoring alpha) to
+ * out, which must hold ceil(w/4) * ceil(h/4) * 8 bytes. */
+void texcomp_EncodeBC1(const uint8_t *rgba, uint32_t w, uint32_t h,
+		       uint8_t *out) {
+	uint8_t blk[64], mn[4], mx[4];
+	uint32_t bx, by;
+
+	for (by = 0; by < (h + 3) / 4; ++by) {
+		for (bx = 0; bx < (w + 3) / 4; ++bx) {
+			fetchBlock(rgba, w, h, bx, by, blk);
+			blockBounds(blk, mn, mx);
+			encodeColor(blk, mn, mx, out);
+			out += 8;
+		}
+	}
+}
+
+/* texcomp_EncodeBC3 encodes the w x h RGBA8 image rgba to out, which must
+ * hold ceil(w/4) * ceil(h/4) * 16 bytes. */
+void texcomp_EncodeBC3(const uint8_t *rgba, uint32_t w, uint32_t h,
+		       uint8_t *out) {
+	uint8_t blk[64], mn[4], mx[4];
+	uint32_t bx, by;
+
+	for (by = 0; by < (h + 3) / 4; ++by) {
+		for (bx = 0; bx < (w + 3) / 4; ++bx) {
+			fetchBlock(rgba, w, h, bx, by, blk);
+			blockBounds(blk, mn, mx);
+			encodeAlpha(blk, mn[3], mx[3], out);
+			encodeColor(blk, mn, mx, out + 8);
+			out += 16;
+		}
+	}
+}
+
+/* downsample writes the half-size (box filtered) version of the w x h RGBA8
+ * image src to dst. */
+static void downsample(const uint8_t *src, uint32_t w, uint32_t h,
+		       uint8_t *dst) {
+	uint32_t dw, dh, x, y, c, x0, x1, y0, y1;
+
+	dw = w > 1 ? w / 2 : 1;
+	dh = h > 1 ? h / 2 : 1;
+	for (y = 0; y < dh; ++y) {
+		y0 = y * 2 < h ? y * 2 : h - 1;
+		y1 = y * 2 + 1 < h ? y * 2 + 1 : h - 1;
+		for (x = 0; x < dw; ++x) {
+			x0 = x * 2 < w ? x * 2 : w - 1;
+			x1 = x * 2 + 1 < w ? x * 2 + 1 : w - 1;
+			for (c = 0; c < 4; ++c) {
+				uint32_t sum = src[(y0 * w + x0) * 4 + c] +
+					       src[(y0 * w + x1) * 4 + c] +
+					       src[(y1 * w + x0) * 4 + c] +
+					       src[(y1 * w + x1) * 4 + c];
+				dst[(y * dw + x) * 4 + c] = (sum + 2) / 4;
+			}
+		}
+	}
+}
+
+/* mipBytes returns the size of the RGBA8 mip chain of a w x h image */
+static uint64_t mipBytes(uint32_t w, uint32_t h) {
+	uint64_t sz = 0;
+
+	for (;;) {
+		sz += (uint64_t)w * h * 4;
+		if (w == 1 && h == 1) {
+			return sz;
+		}
+		w = w > 1 ? w / 2 : 1;
+		h = h > 1 ? h / 2 : 1;
+	}
+}
+
+/* keyPath writes the filename of the cache entry for key to path */
+static bool keyPath(uint64_t key, char *path, size_t sz) {
+	char name[32];
+
+	snprintf(name, sizeof(name), "%016llx.tc", (unsigned long long)key);
+	return cachePath("textures", name, path, sz);
+}
+
+/* newTexture creates a texture with the given number of mip levels */
+static GLuint newTexture(uint32_t levels) {
+	GLuint tex;
+
+	glGenTextures(1, &tex);
+	glstate_BindTexture(0, GL_TEXTURE_2D, tex);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+			GL_NEAREST_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+	return tex;
+}
+
+/* texcomp_FileKey returns a key identifying the current version of file */
+uint64_t texcomp_FileKey(const char *file) {
+	struct stat st;
+	uint64_t key;
+	int64_t mtime, size;
+
+	key = hashStr(file, 0);
+	if (stat(file, &st) == 0) {
+		mtime = st.st_mtime;
+		size = st.st_size;
+		key = hash64(&mtime, sizeof(mtime), key);
+		key = hash64(&size, sizeof(size), key);
+	}
+	return key;
+}
+
+/* texcomp_ReadCached reads the cached encoding for key into img. Returns
+ * false if there is no usable cache entry. It makes no GL calls. */
+bool texcomp_ReadCached(uint64_t key, TexCompImage *img) {
+	TexCompHeader hdr;
+	char path[512];
+	uint32_t i, sz;
+	size_t len;
+	uint8_t *p;
+	FILE *f;
+
+	memset(img, 0, sizeof(TexCompImage));
+	if (!GLEW_EXT_texture_compression_s3tc ||
+	    !keyPath(key, path, sizeof(path))) {
+		return false;
+	}
+	if ((f = fopen(path, "rb")) == NULL) {
+		return false;
+	}
+	if (fread(&hdr, sizeof(hdr), 1, f) != 1 || hdr.magic != TEXCOMP_MAGIC ||
+	    hdr.version != TEXCOMP_VERSION || hdr.key != key ||
+	    hdr.levels == 0 || hdr.levels > TEXCOMP_MAX_LEVELS) {
+		fclose(f);
+		return false;
+	}
+
+	img->format = hdr.format;
+	img->w = hdr.w;
+	img->h = hdr.h;
+	img->levels = hdr.levels;
+	img->cached = true;
+	for (i = len = 0; i < hdr.levels; ++i) {
+		if (fread(&sz, sizeof(sz), 1, f) != 1 ||
+		    (p = realloc(img->data, len + sz)) == NULL) {
+			break;
+		}
+		img->data = p;
+		if (fread(img->data + len, 1, sz, f) != sz) {
+			break;
+		}
+		img->sizes[i] = sz;
+		len += sz;
+	}
+	fclose(f);
+	if (i != hdr.levels) {
+		puts("error: truncated texture cache entry");
+		texcomp_FreeImage(img);
+		return false;
+	}
+	return true;
+}
+
+/* texcomp_LoadCached uploads the cached encoding for key, returning the new
+ * texture or 0 if there is no usable cache entry. */
+GLuint texcomp_LoadCached(uint64_t key) {
+	TexCompImage img;
+	GLuint tex;
+
+	if (!texcomp_ReadCached(key, &img)) {
+		return 0;
+	}
+	tex = texcomp_Apply(0, &img);
+	texcomp_FreeImage(&img);
+	return tex;
+}
+
+/* store writes img, after hdr, to the cache entry at path. The entry is
+ * written to a temporary file of the calling thread and renamed into place,
+ * so that neither readers nor the main and asset threads storing the same
+ * entry ever see a partial one. */
+static void store(const char *path, const TexCompHeader *hdr,
+		  const TexCompImage *img) {
+	char tmp[560];
+	size_t len;
+	uint32_t i;
+	bool ok;
+	FILE *f;
+
+	snprintf(tmp, sizeof(tmp), "%s.%lx.tmp", path,
+		 (unsigned long)SDL_ThreadID());
+	if ((f = fopen(tmp, "wb")) == NULL) {
+		printf("error: failed to write texture cache %s\n", tmp);
+		return;
+	}
+	ok = fwrite(hdr, sizeof(TexCompHeader), 1, f) == 1;
+	for (i = len = 0; ok && i < img->levels; ++i) {
+		ok = fwrite(&img->sizes[i], sizeof(uint32_t), 1, f) == 1 &&
+		     fwrite(img->data + len, 1, img->sizes[i], f) ==
+			 img->sizes[i];
+		len += img->sizes[i];
+	}
+	ok = fclose(f) == 0 && ok;
+	if (!ok || rename(tmp, path) != 0) {
+		printf("error: failed to write texture cache %s\n", path);
+		remove(tmp);
+	}
+}
+
+/* texcomp_Encode encodes the w x h RGBA8 image rgba with its mip chain to
+ * img and stores the result in the cache under key. If the driver cannot
+ * sample S3TC textures the image is kept uncompressed. It makes no GL calls,
+ * so it may run on any thread. */
+bool texcomp_Encode(uint64_t key, const uint8_t *rgba, uint32_t w, uint32_t h,
+		    TexCompImage *img) {
+	TexCompHeader hdr;
+	uint8_t *level, *next;
+	uint32_t i, lw, lh, blockSz;
+	char path[512];
+	size_t len;
+	bool alpha;
+
+	memset(img, 0, sizeof(TexCompImage));
+	img->w = w;
+	img->h = h;
+	if (!GLEW_EXT_texture_compression_s3tc) {
+		img->format = GL_RGBA8;
+		img->levels = 1;
+		img->sizes[0] = w * h * 4;
+		if ((img->data = malloc(img->sizes[0])) == NULL) {
+			puts("error: out of memory encoding texture");
+			return false;
+		}
+		memcpy(img->data, rgba, img->sizes[0]);
+		return true;
+	}
+
+	alpha = false;
+	for (i = 0; i < w * h && !alpha; ++i) {
+		alpha = rgba[i * 4 + 3] != 0xff;
+	}
+	blockSz = alpha ? 16 : 8;
+
+	img->format = alpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+			    : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	for (img->levels = 1, lw = w, lh = h; lw > 1 || lh > 1;
+	     ++img->levels) {
+		lw = lw > 1 ? lw / 2 : 1;
+		lh = lh > 1 ? lh / 2 : 1;
+	}
+	if (img->levels > TEXCOMP_MAX_LEVELS) {
+		img->levels = TEXCOMP_MAX_LEVELS;
+	}
+	for (i = len = 0, lw = w, lh = h; i < img->levels; ++i) {
+		img->sizes[i] = ((lw + 3) / 4) * ((lh + 3) / 4) * blockSz;
+		len += img->sizes[i];
+		lw = lw > 1 ? lw / 2 : 1;
+		lh = lh > 1 ? lh / 2 : 1;
+	}
+
+	level = malloc((size_t)w * h * 4);
+	next = malloc((size_t)(w / 2 + 1) * (h / 2 + 1) * 4);
+	img->data = malloc(len);
+	if (level == NULL || next == NULL || img->data == NULL) {
+		puts("error: out of memory encoding texture");
+		free(level);
+		free(next);
+		texcomp_FreeImage(img);
+		return false;
+	}
+	memcpy(level, rgba, (size_t)w * h * 4);
+
+	for (i = len = 0, lw = w, lh = h; i < img->levels; ++i) {
+		uint8_t *tmp;
+
+		if (alpha) {
+			texcomp_EncodeBC3(level, lw, lh, img->data + len);
+		} else {
+			texcomp_EncodeBC1(level, lw, lh, img->data + len);
+		}
+		len += img->sizes[i];
+
+		downsample(level, lw, lh, next);
+		tmp = level;
+		level = next;
+		next = tmp;
+		lw = lw > 1 ? lw / 2 : 1;
+		lh = lh > 1 ? lh / 2 : 1;
+	}
+	free(level);
+	free(next);
+
+	hdr.magic = TEXCOMP_MAGIC;
+	hdr.version = TEXCOMP_VERSION;
+	hdr.key = key;
+	hdr.format = img->format;
+	hdr.w = w;
+	hdr.h = h;
+	hdr.levels = img->levels;
+	if (keyPath(key, path, sizeof(path))) {
+		store(path, &hdr, img);
+	}
+	return true;
+}
+
+/* texcomp_Apply uploads img to tex, or to a new texture if tex is 0, and
+ * returns the texture. If tex already holds an image of the same size and
+ * format, its storage is reused. */
+GLuint texcomp_Apply(GLuint tex, const TexCompImage *img) {
+	GLint w = 0, h = 0, format = 0;
+	uint32_t i, lw, lh;
+	size_t len;
+	bool reuse;
+
+	reuse = false;
+	if (tex != 0) {
+		glstate_BindTexture(0, GL_TEXTURE_2D, tex);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH,
+					 &w);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT,
+					 &h);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0,
+					 GL_TEXTURE_INTERNAL_FORMAT, &format);
+		reuse = (uint32_t)w == img->w && (uint32_t)h == img->h &&
+			(GLenum)format == img->format;
+	} else {
+		tex = newTexture(img->format == GL_RGBA8 ? 1000 : img->levels);
+		stats.textures++;
+		stats.cacheHits += img->cached;
+		stats.rawBytes += mipBytes(img->w, img->h);
+	}
+	if (!reuse) {
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,
+				img->format == GL_RGBA8 ? 1000
+							: img->levels - 1);
+	}
+
+	if (img->format == GL_RGBA8) {
+		if (reuse) {
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, img->w, img->h,
+					GL_RGBA, GL_UNSIGNED_BYTE, img->data);
+		} else {
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, img->w, img->h,
+				     0, GL_RGBA, GL_UNSIGNED_BYTE, img->data);
+			stats.compressedBytes += mipBytes(img->w, img->h);
+			mem_Track(MEM_TEXTURE, tex, MEM_IMAGES,
+				  mipBytes(img->w, img->h));
+		}
+		glGenerateMipmap(GL_TEXTURE_2D);
+		return tex;
+	}
+	for (i = len = 0, lw = img->w, lh = img->h; i < img->levels; ++i) {
+		if (reuse) {
+			glCompressedTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, lw,
+						  lh, img->format,
+						  img->sizes[i],
+						  img->data + len);
+		} else {
+			glCompressedTexImage2D(GL_TEXTURE_2D, i, img->format,
+					       lw, lh, 0, img->sizes[i],
+					       img->data + len);
+			stats.compressedBytes += img->sizes[i];
+		}
+		len += img->sizes[i];
+		lw = lw > 1 ? lw / 2 : 1;
+		lh = lh > 1 ? lh / 2 : 1;
+	}
+	if (!reuse) {
+		mem_Track(MEM_TEXTURE, tex, MEM_IMAGES, len);
+	}
+	return tex;
+}
+
+/* texcomp_FreeImage frees the levels of img */
+void texcomp_FreeImage(TexCompImage *img) {
+	free(img->data);
+	img->data = NULL;
+}
+
+/* texcomp_Upload encodes the w x h RGBA8 image rgba with its mip chain,
+ * stores the result in the cache under key, and uploads it. */
+GLuint texcomp_Upload(uint64_t key, const uint8_t *rgba, uint32_t w,
+		      uint32_t h) {
+	TexCompImage img;
+	GLuint tex;
+
+	if (!texcomp_Encode(key, rgba, w, h, &img)) {
+		return 0;
+	}
+	tex = texcomp_Apply(0, &img);
+	texcomp_FreeImage(&img);
+	return tex;
+}
+
+/* texcomp_Stats returns the memory used by textures uploaded by texcomp */
+TexCompStats texcomp_Stats() { return stats; }
+
+/* texcomp_Report prints the memory used by compressed textures compared to
+ * what the same textures would use uncompressed. */
+void texcomp_Report() {
+	printf("textures: %u (%u from cache)\n", stats.textures,
+	       stats.cacheHits);
+	printf("  raw RGBA8:  %llu KiB\n",
+	       (unsigned long long)(stats.rawBytes / 1024));
+	printf("  compressed: %llu KiB (%.1f%%)\n",
+	       (unsigned long long)(stats.compressedBytes / 1024),
+	       stats.rawBytes ? 100.0 * stats.compressedBytes / stats.rawBytes
+			      : 0.0);
+}
@@ -0,0 +1,55 @@
+/*
+ * texcomp.h
+ * texcomp encodes RGBA8 images to block-compressed textures (BC1 for opaque
+ * images, BC3 for images with alpha) on the CPU, including a full mip chain.
+ * Encoded images are cached on disk so that each image is encoded once, and
+ * are uploaded with glCompressedTexImage2D().
+ * Reading and encoding (texcomp_ReadCached(), texcomp_Encode()) make no GL
+ * calls, so that images can be prepared on another thread and then uploaded
+ * with texcomp_Apply().
+ */
+#ifndef TEXCOMP_H
+#define TEXCOMP_H
+
+#include <GL/glew.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* the most mip levels stored for an image */
+enum { TEXCOMP_MAX_LEVELS = 16 };
+
+/* TexCompStats compares the memory used by compressed and raw textures */
+typedef struct {
+	uint32_t textures;	  /* textures uploaded through texcomp */
+	uint32_t cacheHits;	 /* textures restored from the disk cache */
+	uint64_t rawBytes;	  /* bytes the same mip chains use as RGBA8 */
+	uint64_t compressedBytes; /* bytes actually uploaded */
+} TexCompStats;
+
+/* TexCompImage is an encoded mip chain, ready to upload */
+typedef struct {
+	GLenum format; /* the compressed format, or GL_RGBA8 if uncompressed */
+	uint32_t w, h;
+	uint32_t levels;
+	uint8_t *data; /* the levels, one after another */
+	uint32_t sizes[TEXCOMP_MAX_LEVELS];
+	bool cached; /* read from the disk cache */
+} TexCompImage;
+
+uint64_t texcomp_FileKey(const char *);
+GLuint texcomp_LoadCached(uint64_t);
+GLuint texcomp_Upload(uint64_t, const uint8_t *, uint32_t, uint32_t);
+
+bool texcomp_ReadCached(uint64_t, TexCompImage *);
+bool texcomp_Encode(uint64_t, const uint8_t *, uint32_t, uint32_t,
+		    TexCompImage *);
+GLuint texcomp_Apply(GLuint, const TexCompImage *);
+void texcomp_FreeImage(TexCompImage *);
+
+void texcomp_EncodeBC1(const uint8_t *, uint32_t, uint32_t, uint8_t *);
+void texcomp_EncodeBC3(const uint8_t *, uint32_t, uint32_t, uint8_t *);
+
+TexCompStats texcomp_Stats();
+void texcomp_Report();
+
+#endif
@@ -1,49 +1,140 @@
 #include "util.h"
+#include <errno.h>
+#include <sys/stat.h>
+#include "alloc.h"
+#include "shadercache.h"
 
-GLuint loadShader(const GLchar *vs, const GLchar *fs, int numAttrs,
-		  const char **attrs) {
-	GLint compiled, linked;
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+enum { MAX_PENDING_SHADERS = 32 };
+
+/* PendingShader is a program whose compilation was started ahead of use */
+typedef struct {
+	uint64_t key;
+	GLuint program;
+	GLuint vert, frag; /* 0 if the program was restored from the cache */
+} PendingShader;
+
+static PendingShader pending[MAX_PENDING_SHADERS];
+static int numPending;
+
+/* hash64 returns the 64-bit FNV-1a hash of the sz bytes at data, continuing
+ * from seed (which may be the hash of the preceding data). */
+uint64_t hash64(const void *data, size_t sz, uint64_t seed) {
+	const uint8_t *p = data;
+	uint64_t h;
+	size_t i;
+
+	h = seed ^ 0xcbf29ce484222325ULL;
+	for (i = 0; i < sz; ++i) {
+		h ^= p[i];
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+/* hashStr returns the hash of str (including its terminator) from seed */
+uint64_t hashStr(const char *str, uint64_t seed) {
+	if (str == NULL) {
+		return hash64("", 1, seed);
+	}
+	return hash64(str, strlen(str) + 1, seed);
+}
+
+/* cachePath writes the path of name within the cache subdirectory dir to
+ * path, creating the directory if needed. Returns false on failure. */
+bool cachePath(const char *dir, const char *name, char *path, size_t sz) {
+	const char *base, *home;
+	char root[384];
+	int n;
+
+	if ((base = getenv("XDG_CACHE_HOME")) != NULL && base[0] != '\0') {
+		n = snprintf(root, sizeof(root), "%s/gled", base);
+	} else if ((home = getenv("HOME")) != NULL) {
+		n = snprintf(root, sizeof(root), "%s/.cache", home);
+		if (n > 0 && (size_t)n < sizeof(root)) {
+			mkdir(root, 0755);
+		}
+		n = snprintf(root, sizeof(root), "%s/.cache/gled", home);
+	} else {
+		return false;
+	}
+	if (n < 0 || (size_t)n >= sizeof(root)) {
+		return false;
+	}
+	if (mkdir(root, 0755) != 0 && errno != EEXIST) {
+		return false;
+	}
+	n = snprintf(path, sz, "%s/%s", root, dir);
+	if (n < 0 || (size_t)n >= sz) {
+		return false;
+	}
+	if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+		return false;
+	}
+	n = snprintf(path, sz, "%s/%s/%s", root, dir, name);
+	return n > 0 && (size_t)n < sz;
+}
+
+/* compileShader begins compiling src as a shader of the given type. If
+ * defines is given, it is inserted after the source's #version line.
+ * The compile status is not queried here so that the driver may compile in
+ * the background. */
+static GLuint compileShader(GLenum type, const GLchar *src,
+			    const char *defines) {
+	const GLchar *strs[3];
+	GLint lens[3];
 	GLuint shader;
-	GLuint frag, vert;
-	GLint len;
-	int i;
+	const char *nl;
+	int n;
 
-	/* vertex shader */
-	vert = glCreateShader(GL_VERTEX_SHADER);
-	len = strlen(vs);
-	glShaderSource(vert, 1, &vs, &len);
-	glCompileShader(vert);
-	glGetShaderiv(vert, GL_COMPILE_STATUS, &compiled);
-	if (compiled == GL_FALSE) {
-		GLint logSz;
-		GLchar *log;
+	n = 0;
+	if (defines != NULL && strncmp(src, "#version", 8) == 0 &&
+	    (nl = strchr(src, '\n')) != NULL) {
+		strs[n] = src;
+		lens[n++] = nl - src + 1;
+		src = nl + 1;
+	}
+	if (defines != NULL) {
+		strs[n] = defines;
+		lens[n++] = strlen(defines);
+	}
+	strs[n] = src;
+	lens[n++] = strlen(src);
+
+	shader = glCreateShader(type);
+	glShaderSource(shader, n, strs, lens);
+	glCompileShader(shader);
+	return shader;
+}
+
+/* checkShader prints the log of shader if it failed to compile */
+static void checkShader(GLuint shader, const char *stage) {
+	GLint compiled;
 
-		glGetShaderiv(vert, GL_INFO_LOG_LENGTH, &logSz);
-		log = malloc(logSz * sizeof(GLchar));
-		glGetShaderInfoLog(vert, logSz, &logSz, log);
-		puts("error: vertex shader compilation failed");
-		puts(log);
-		free(log);
-	}
-	/* fragment shader */
-	frag = glCreateShader(GL_FRAGMENT_SHADER);
-	len = strlen(fs);
-	glShaderSource(frag, 1, &fs, &len);
-	glCompileShader(frag);
-	glGetShaderiv(frag, GL_COMPILE_STATUS, &compiled);
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
 	if (compiled == GL_FALSE) {
 		GLint logSz;
 		GLchar *log;
 
-		glGetShaderiv(vert, GL_INFO_LOG_LENGTH, &logSz);
-		log = malloc(logSz * sizeof(GLchar));
-		glGetShaderInfoLog(vert, logSz, &logSz, log);
-		puts("error: fragment shader compilation failed");
-		puts(log);
-		free(log);
+		printf("error: %s shader compilation failed\n", stage);
+		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logSz);
+		if (logSz > 0 &&
+		    (log = frame_Alloc(logSz * sizeof(GLchar))) != NULL) {
+			glGetShaderInfoLog(shader, logSz, &logSz, log);
+			puts(log);
+		}
 	}
+}
+
+/* linkProgram begins linking vert and frag into a new program */
+static GLuint linkProgram(GLuint vert, GLuint frag, int numAttrs,
+			  const char **attrs) {
+	GLuint shader;
+	int i;
 
-	/* link shaders */
 	shader = glCreateProgram();
 	glAttachShader(shader, vert);
 	glAttachShader(shader, frag);
@@ -53,19 +144,156 @@ GLuint loadShader(const GLchar *vs, const GLchar *fs, int numAttrs,
 	}
 	glBindAttribLocation(shader, 1, "texco");
 
+	if (shadercache_Supported()) {
+		glProgramParameteri(shader, GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+				    GL_TRUE);
+	}
 	glLinkProgram(shader);
+	return shader;
+}
+
+/* finishProgram waits for shader to link, reporting any errors. If it
+ * succeeded, its binary is stored in the shader cache under key */
+static GLuint finishProgram(uint64_t key, GLuint shader, GLuint vert,
+			    GLuint frag) {
+	GLint linked;
+
 	glGetProgramiv(shader, GL_LINK_STATUS, &linked);
 	if (linked == GL_FALSE) {
 		GLint logSz;
 		GLchar *log;
 
+		checkShader(vert, "vertex");
+		checkShader(frag, "fragment");
+		puts("error: shader program failed to link");
 		glGetProgramiv(shader, GL_INFO_LOG_LENGTH, &logSz);
-		log = malloc(logSz * sizeof(GLchar));
-		glGetProgramInfoLog(shader, logSz, &logSz, log);
-		puts(fs);
-		puts(log);
-		free(log);
+		if (logSz > 0 &&
+		    (log = frame_Alloc(logSz * sizeof(GLchar))) != NULL) {
+			glGetProgramInfoLog(shader, logSz, &logSz, log);
+			puts(log);
+		}
+	} else {
+		shadercache_Store(key, shader);
 	}
-
+	glDetachShader(shader, vert);
+	glDetachShader(shader, frag);
+	glDeleteShader(vert);
+	glDeleteShader(frag);
 	return shader;
 }
+
+/* enableParallelCompile lets the driver compile on its own threads */
+static void enableParallelCompile() {
+#ifdef GL_KHR_parallel_shader_compile
+	static bool enabled = false;
+
+	if (!enabled && GLEW_KHR_parallel_shader_compile) {
+		glMaxShaderCompilerThreadsKHR(0xffffffff);
+	}
+	enabled = true;
+#endif
+}
+
+/* prefetchShader starts building the program for the given sources so that
+ * a later loadShaderDefines() with the same arguments does not stall.
+ * Programs found in the shader cache are restored immediately. */
+void prefetchShader(const GLchar *vs, const GLchar *fs, const char *defines,
+		    int numAttrs, const char **attrs) {
+	PendingShader *p;
+	uint64_t key;
+	int i;
+
+	key = shadercache_Key(vs, fs, defines, numAttrs, attrs);
+	for (i = 0; i < numPending; ++i) {
+		if (pending[i].key == key) {
+			return;
+		}
+	}
+	if (numPending >= MAX_PENDING_SHADERS) {
+		return;
+	}
+
+	p = &pending[numPending++];
+	p->key = key;
+	p->vert = p->frag = 0;
+	if ((p->program = shadercache_Load(key)) != 0) {
+		return;
+	}
+	enableParallelCompile();
+	p->vert = compileShader(GL_VERTEX_SHADER, vs, defines);
+	p->frag = compileShader(GL_FRAGMENT_SHADER, fs, defines);
+	p->program = linkProgram(p->vert, p->frag, numAttrs, attrs);
+}
+
+/* shaderReady returns true if the prefetched program is done linking */
+static bool shaderReady(PendingShader *p) {
+	GLint done;
+
+	if (p->vert == 0) {
+		return true;
+	}
+#ifdef GL_KHR_parallel_shader_compile
+	if (GLEW_KHR_parallel_shader_compile) {
+		glGetProgramiv(p->program, GL_COMPLETION_STATUS_KHR, &done);
+		return done == GL_TRUE;
+	}
+#endif
+	(void)done;
+	return true;
+}
+
+/* shaderPending returns true if the program for the given sources was
+ * prefetched and is still being built, so that loadShaderDefines() would
+ * wait for it. Without KHR_parallel_shader_compile this is never known. */
+bool shaderPending(const GLchar *vs, const GLchar *fs, const char *defines,
+		   int numAttrs, const char **attrs) {
+	uint64_t key;
+	int i;
+
+	key = shadercache_Key(vs, fs, defines, numAttrs, attrs);
+	for (i = 0; i < numPending; ++i) {
+		if (pending[i].key == key) {
+			return !shaderReady(&pending[i]);
+		}
+	}
+	return false;
+}
+
+/* loadShaderDefines returns a program built from the vertex shader vs and
+ * fragment shader fs with the given defines prepended to each (after the
+ * #version line). Prefetched and cached programs are used when available. */
+GLuint loadShaderDefines(const GLchar *vs, const GLchar *fs,
+			 const char *defines, int numAttrs,
+			 const char **attrs) {
+	GLuint shader, vert, frag;
+	uint64_t key;
+	int i;
+
+	key = shadercache_Key(vs, fs, defines, numAttrs, attrs);
+	for (i = 0; i < numPending; ++i) {
+		PendingShader p = pending[i];
+		if (p.key != key) {
+			continue;
+		}
+		pending[i] = pending[--numPending];
+		if (p.vert == 0) {
+			return p.program;
+		}
+		return finishProgram(key, p.program, p.vert, p.frag);
+	}
+
+	if ((shader = shadercache_Load(key)) != 0) {
+		return shader;
+	}
+	vert = compileShader(GL_VERTEX_SHADER, vs, defines);
+	frag = compileShader(GL_FRAGMENT_SHADER, fs, defines);
+	shader = linkProgram(vert, frag, numAttrs, attrs);
+	return finishProgram(key, shader, vert, frag);
+}
+
+/* loadShader returns a program built from the vertex shader vs and fragment
+ * shader fs, binding attrs to the attribute locations 0..numAttrs-1. */
+GLuint loadShader(const GLchar *vs, const GLchar *fs, int numAttrs,
+		  const char **attrs) {
+	return loadShaderDefines(vs, fs, NULL, numAttrs, attrs);
+}
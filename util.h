@@ -3,6 +3,8 @@
 
 #include <GL/glew.h>
 #include <SDL2/SDL.h>
+#include <stdbool.h>
+#include <stdint.h>
 
 #define GL_CHECK()                                                             \
 	{                                                                      \
@@ -13,6 +15,16 @@
 		}                                                              \
 	}
 
-#endif
+uint64_t hash64(const void *, size_t, uint64_t);
+uint64_t hashStr(const char *, uint64_t);
+bool cachePath(const char *, const char *, char *, size_t);
 
 GLuint loadShader(const GLchar *, const GLchar *, int, const char **);
+GLuint loadShaderDefines(const GLchar *, const GLchar *, const char *, int,
+			 const char **);
+void prefetchShader(const GLchar *, const GLchar *, const char *, int,
+		    const char **);
+bool shaderPending(const GLchar *, const GLchar *, const char *, int,
+		   const char **);
+
+#endif
@@ -1,16 +1,158 @@
+/* for MAP_ANONYMOUS and sysconf() */
+#define _DEFAULT_SOURCE
 #include "window.h"
 #include <SDL2/SDL.h>
+#include <math.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "alloc.h"
+#include "anim.h"
+#include "asset.h"
+#include "glstate.h"
+#include "latency.h"
+#include "material.h"
 #include "matrix.h"
+#include "mem.h"
+#include "post.h"
 #include "rune.h"
+#include "sched.h"
 #include "util.h"
 #include "vector.h"
 
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif
+
+/* DrawItem is a queued rune draw. Draws are sorted by key: layer, then
+ * program, material and texture. */
+typedef struct {
+	uint64_t key;
+	uint32_t index; /* into draws.results */
+} DrawItem;
+
+enum { DRAW_LAYER_SHIFT = 63,
+       DRAW_PROGRAM_SHIFT = 56,
+       DRAW_MATERIAL_SHIFT = 48 };
+
+/* draws is the draw list of the frame being rendered (in the frame arena) */
+static struct {
+	RuneDrawResult *results;
+	DrawItem *items;
+	uint32_t len, cap;
+} draws;
+
+/* Evictable is a resource window_evict() may free: the mesh of a block, or
+ * the texture of an image asset shared by blocks */
+typedef struct {
+	uint32_t frame; /* the frame it was last drawn in */
+	uint32_t asset; /* the image asset, or 0 for the mesh of block */
+	uint32_t block;
+} Evictable;
+
+/* window_buff returns the rune at (x, y) in buffer coordinates */
+static Rune_ *window_buff(Window *w, uint32_t x, uint32_t y) {
+	return &w->buff[(size_t)y * WINDOW_STRIDE + x];
+}
+
+/* window_peek returns the rune at viewport cell (x, y) without marking the
+ * buffer for redraw */
+static Rune_ *window_peek(Window *w, int32_t x, int32_t y) {
+	return window_buff(w, x + WINDOW_MARGIN_W, y + WINDOW_MARGIN_H);
+}
+
+/* window_reserve reserves address space for the largest grid. Nothing is
+ * committed until window_commit(). */
+static bool window_reserve(Window *w) {
+	size_t sz;
+	void *p;
+
+	sz = (size_t)(WINDOW_MARGIN_H + WINDOW_MAX_H) * WINDOW_STRIDE *
+	     sizeof(Rune_);
+	p = mmap(NULL, sz, PROT_NONE,
+		 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (p == MAP_FAILED) {
+		puts("error: failed to reserve the window buffer");
+		return false;
+	}
+	w->buff = p;
+	w->committed = 0;
+	w->initW = w->initH = 0;
+	return true;
+}
+
+/* window_commit makes the first rows rows of the buffer usable */
+bool window_commit(Window *w, uint32_t rows) {
+	size_t page, from, to;
+
+	if (rows <= w->committed) {
+		return true;
+	}
+	page = (size_t)sysconf(_SC_PAGESIZE);
+	from = (size_t)w->committed * WINDOW_STRIDE * sizeof(Rune_) / page *
+	       page;
+	to = ((size_t)rows * WINDOW_STRIDE * sizeof(Rune_) + page - 1) / page *
+	     page;
+	if (mprotect((uint8_t *)w->buff + from, to - from,
+		     PROT_READ | PROT_WRITE) != 0) {
+		puts("error: failed to grow the window buffer");
+		return false;
+	}
+	/* the committed rows are counted as a single allocation */
+	mem_Sub(MEM_WINDOW, MEM_CPU,
+		(size_t)w->committed * WINDOW_STRIDE * sizeof(Rune_));
+	mem_Add(MEM_WINDOW, MEM_CPU,
+		(size_t)rows * WINDOW_STRIDE * sizeof(Rune_));
+	w->committed = rows;
+	return true;
+}
+
+/* window_blank fills the cells of the first cols x rows of the buffer that
+ * have never been used with blanks. The rest keep their contents. */
+static void window_blank(Window *w, uint32_t cols, uint32_t rows) {
+	uint32_t x, y, initW;
+
+	initW = cols > w->initW ? cols : w->initW;
+	for (y = 0; y < w->initH && cols > w->initW; ++y) {
+		for (x = w->initW; x < cols; ++x) {
+			window_buff(w, x, y)->ch = rune_blankChar;
+		}
+	}
+	for (y = w->initH; y < rows; ++y) {
+		for (x = 0; x < initW; ++x) {
+			window_buff(w, x, y)->ch = rune_blankChar;
+		}
+	}
+	w->initW = initW;
+	w->initH = rows > w->initH ? rows : w->initH;
+}
+
+/* window_project maps the cells onto a dw x dh pixel drawable */
+static void window_project(Window *w, int32_t dw, int32_t dh) {
+	uint32_t i;
+
+	mat4x4_orthographic(&w->proj, 0.0f, (float)dw / w->cellW, 0.0f,
+			    (float)dh / w->cellH, -1.0f, 1.0f);
+	material_SetMatrices(MATERIAL_QUAD, &w->proj, &Mat4x4Identity);
+	w->pixelW = dw;
+	w->pixelH = dh;
+
+	/* every cached rendering depends on the cell size */
+	w->dirty = true;
+	for (i = 0; i < w->numGrids; ++i) {
+		w->grids[i]->dirty = true;
+	}
+}
+
 Window *new_Window(uint32_t width, uint32_t height) {
-	uint32_t i, j;
 	Window *w;
 
 	w = malloc(sizeof(Window));
+	if (w == NULL || !window_reserve(w)) {
+		free(w);
+		return NULL;
+	}
 	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK,
 			    SDL_GL_CONTEXT_PROFILE_CORE);
 	SDL_GL_SetAttribute(SDL_GL_RED_SIZE, 8);
@@ -24,8 +166,9 @@ Window *new_Window(uint32_t width, uint32_t height) {
 	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
 	SDL_GL_SetAttribute(SDL_GL_ACCELERATED_VISUAL, 1);
 	w->win = SDL_CreateWindow(
-	    "gled", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, width * 32,
-	    height * 32, SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN);
+	    "gled", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
+	    width * WINDOW_CELL_W, height * WINDOW_CELL_H,
+	    SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE);
 	if (w->win == NULL) {
 		puts("error: failed to create window.");
 		return NULL;
@@ -40,21 +183,42 @@ Window *new_Window(uint32_t width, uint32_t height) {
 		puts("error: failed to initialize GLEW");
 		return NULL;
 	}
-	w->w = width;
-	w->h = height;
 
-	for (i = 0; i < height; ++i) {
-		for (j = 0; j < width; ++j) {
-			w->buff[i][j].ch = rune_blankChar;
-		}
+	glstate_Reset();
+
+	/* adaptive vsync lets a late frame tear instead of waiting a whole
+	 * period; not every driver has it */
+	if (SDL_GL_SetSwapInterval(-1) != 0) {
+		SDL_GL_SetSwapInterval(1);
 	}
 
+	/* start building shaders now so the first frame doesn't wait on them */
+	material_Warmup();
+	w->cellW = WINDOW_CELL_W;
+	w->cellH = WINDOW_CELL_H;
+	w->pixelW = w->pixelH = 0;
+	w->w = w->h = 0;
+	w->numOccluders = 0;
+	w->numGrids = w->gridSerial = 0;
+	memset(&w->target, 0, sizeof(GridTarget));
+	w->dirty = true;
+	w->relayout = w->updating = false;
+	w->capturing = false;
+	w->submitted = 0.0;
+	w->lastTick = SDL_GetTicks();
+	init_BlockIndex(&w->blocks, WINDOW_STRIDE,
+			WINDOW_MARGIN_H + WINDOW_MAX_H);
+	window_resize(w, width, height);
+
 	/* TODO: test */
-	w->buff[2][3].img = rune_blankImg;
-	w->buff[2][3].img.filename = "fonts/ascii.bmp";
+	ImgRune img = rune_blankImg;
+	img.filename = "fonts/ascii.bmp";
+	img.r.code = CODEPAGE_RSRC + 1;
+	window_setImg(w, 3, 2, &img);
 
 	MeshRune m = rune_blankMesh;
 	m.filename = "cube.obj";
+	m.r.code = CODEPAGE_RSRC;
 	m.r.w = 3;
 	m.r.h = 3;
 	window_setMesh(w, 0, 0, &m);
@@ -66,38 +230,29 @@ void del_Window(Window *w) {
 	if (w == NULL) {
 		return;
 	}
+	while (w->numGrids > 0) {
+		window_closeGrid(w, w->grids[0]->id);
+	}
 	if (w->ctx != NULL) {
+		gridtarget_Free(&w->target);
+		post_Free();
+		material_Free();
 		SDL_GL_DeleteContext(w->ctx);
 	}
 	if (w->win) {
 		SDL_DestroyWindow(w->win);
 	}
+	deinit_BlockIndex(&w->blocks);
+	mem_Sub(MEM_WINDOW, MEM_CPU,
+		(size_t)w->committed * WINDOW_STRIDE * sizeof(Rune_));
+	munmap(w->buff, (size_t)(WINDOW_MARGIN_H + WINDOW_MAX_H) *
+			    WINDOW_STRIDE * sizeof(Rune_));
 	free(w);
 }
 
-/* window_DrawRune applies the target render in tex from the rect (u,v,w,h) */
-void window_DrawRune(GLuint tex, Rect pos, Rect clip) {
-	const GLchar *vs =
-	    "#version 150\n"
-	    "in vec2 pos;\n"
-	    "in vec2 texco;\n"
-	    "out vec2 out_texco;\n"
-	    "uniform sampler2D tex;\n"
-	    "uniform mat4 mvp;\n"
-	    "void main()\n"
-	    "{\n"
-	    "  out_texco = texco;\n"
-	    "  gl_Position = mvp * vec4(pos, 0.0, 1.0);\n"
-	    "}\n";
-	const GLchar *fs =
-	    "#version 150\n"
-	    "in vec2 out_texco;\n"
-	    "out vec4 out_color;\n"
-	    "uniform sampler2D tex;\n"
-	    "void main()\n"
-	    "{\n"
-	    "  out_color = texture(tex, out_texco);\n"
-	    "}\n";
+/* window_DrawRune applies the render res (with pos in cells) with the
+ * current material program */
+static void window_DrawRune(const RuneDrawResult *res) {
 	static GLuint vao = 0;
 	static GLuint vbo = 0;
 	static GLuint ibo = 0;
@@ -108,22 +263,8 @@ void window_DrawRune(GLuint tex, Rect pos, Rect clip) {
 	};
 	static GLshort indices[3 * 2] = {/* 2 triangles */
 					 0, 1, 2, 0, 3, 2};
-	static Mat4x4 mvp;
-	static GLuint mvpUniform;
-	static GLuint texUniform;
-	static GLuint shader;
-
-	/* create shader program */
-	if (shader == 0) {
-		const char *attrs[31] = {"pos", "texco"};
-		shader = loadShader(vs, fs, 2, attrs);
-
-		/* get the uniforms */
-		mvpUniform = glGetUniformLocation(shader, "mvp");
-		mat4x4_orthographic(&mvp, 0.0f, 80.0f, 0.0f, 40.0f, -1.0f,
-				    1.0f);
-		texUniform = glGetUniformLocation(shader, "tex");
-	}
+	Rect pos, clip;
+	int i;
 
 	/* create vertex attribute object */
 	if (vao == 0) {
@@ -132,20 +273,30 @@ void window_DrawRune(GLuint tex, Rect pos, Rect clip) {
 		glGenBuffers(1, &ibo);
 
 		/* vertices */
-		glBindVertexArray(vao);
-		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+		glstate_BindVertexArray(vao);
+		glstate_BindBuffer(GL_ARRAY_BUFFER, vbo);
 		glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 4 * 4, vertices,
-			     GL_STATIC_DRAW);
+			     GL_DYNAMIC_DRAW);
+		mem_Track(MEM_BUFFER, vbo, MEM_WINDOW, sizeof(GLfloat) * 4 * 4);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE,
+				      sizeof(GLfloat) * 4, (void *)0);
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE,
+				      sizeof(GLfloat) * 4, (void *)8);
 
 		/* indices */
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+		glstate_BindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLshort) * 6,
 			     indices, GL_STATIC_DRAW);
+		mem_Track(MEM_BUFFER, ibo, MEM_WINDOW, sizeof(GLshort) * 6);
 	}
 
-	if (tex == 0) {
+	if (res->tex == 0) {
 		return;
 	}
+	pos = res->pos;
+	clip = res->clip;
 
 	/* set VBO attributes */
 	vertices[0] = pos.x;
@@ -168,118 +319,863 @@ void window_DrawRune(GLuint tex, Rect pos, Rect clip) {
 	vertices[2 + 12] = clip.x;
 	vertices[3 + 12] = clip.y + clip.h;
 
-	glBindVertexArray(vao);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 4 * 4, vertices,
-		     GL_STATIC_DRAW);
+	/* rotate the corners about the center of the quad */
+	if (res->rotation != 0.0f) {
+		float c = cosf(res->rotation), s = sinf(res->rotation);
+		float cx = pos.x + pos.w / 2.0f, cy = pos.y + pos.h / 2.0f;
+
+		for (i = 0; i < 4; ++i) {
+			float dx = vertices[i * 4] - cx;
+			float dy = vertices[i * 4 + 1] - cy;
+			vertices[i * 4] = cx + dx * c - dy * s;
+			vertices[i * 4 + 1] = cy + dx * s + dy * c;
+		}
+	}
+
+	/* the attribute layout and index buffer are recorded in the VAO */
+	glstate_BindVertexArray(vao);
+	glstate_BindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(GLfloat) * 4 * 4, vertices);
 
 	/* draw */
-	glUseProgram(shader);
-	glUniformMatrix4fv(mvpUniform, 1, 0, ((GLfloat *)&mvp));
-
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, tex);
-	glUniform1i(texUniform, 0);
-	glBindVertexArray(vao);
-
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 4,
-			      (void *)0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 4,
-			      (void *)8);
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+	glstate_BindTexture(0, GL_TEXTURE_2D, res->tex);
 	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, (void *)0);
 }
 
-/* window_redraw renders the window by drawing all runes in the render area. */
-void window_redraw(Window *w) {
-	unsigned int i, j, k, l;
+/* window_visible returns true if the (cw x ch) block anchored at (x, y)
+ * intersects the viewport and is not entirely hidden by an occluder. */
+static bool window_visible(Window *w, int32_t x, int32_t y, uint32_t cw,
+			   uint32_t ch) {
+	int32_t x1, y1;
+	uint32_t i;
 
-	/* mark all runes as 'dirty' so that they will be drawn */
-	for (i = 0; i < w->h; ++i) {
-		for (j = 0; j < w->w; ++j) {
-			w->buff[i][j].r.flags.dirty = true;
+	x1 = x + (int32_t)cw;
+	y1 = y + (int32_t)ch;
+	if (x1 <= 0 || y1 <= 0 || x >= (int32_t)w->w || y >= (int32_t)w->h) {
+		return false;
+	}
+	for (i = 0; i < w->numOccluders; ++i) {
+		Rect *o = &w->occluders[i];
+		if (o->x <= x && o->y <= y && o->x + o->w >= x1 &&
+		    o->y + o->h >= y1) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/* window_occlude takes the rects of the visible opaque grids as the
+ * occluders of the buffer, which is redrawn if they changed (the runes they
+ * uncover were not drawn) */
+static void window_occlude(Window *w) {
+	Rect occluders[WINDOW_MAX_OCCLUDERS];
+	uint32_t i, n;
+	Grid *g;
+
+	for (i = n = 0; i < w->numGrids && n < WINDOW_MAX_OCCLUDERS; ++i) {
+		g = w->grids[i];
+		if (g->hidden || !g->opaque) {
+			continue;
+		}
+		occluders[n].x = g->x;
+		occluders[n].y = g->y;
+		occluders[n].w = g->w;
+		occluders[n].h = g->h;
+		n++;
+	}
+	if (n != w->numOccluders ||
+	    memcmp(occluders, w->occluders, n * sizeof(Rect)) != 0) {
+		memcpy(w->occluders, occluders, n * sizeof(Rect));
+		w->numOccluders = n;
+		w->dirty = true;
+	}
+}
+
+/* window_updateBlocks brings the block index up to date and sizes each
+ * block's anchor rune to the extent of its block. A cell that no longer
+ * anchors a block drops its mesh, which window_evict() would not see. */
+static void window_updateBlocks(Window *w) {
+	Block *old = NULL, *b;
+	uint32_t i, numOld = 0;
+	Rune *r;
+
+	if (w->blocks.dirty && w->blocks.numBlocks != 0 &&
+	    (old = frame_Alloc(w->blocks.numBlocks * sizeof(Block))) != NULL) {
+		numOld = w->blocks.numBlocks;
+		memcpy(old, w->blocks.blocks, numOld * sizeof(Block));
+	}
+	if (!blockindex_Update(&w->blocks)) {
+		return;
+	}
+	for (i = 0; i < w->blocks.numBlocks; ++i) {
+		b = &w->blocks.blocks[i];
+		r = &window_buff(w, b->x, b->y)->r;
+		r->w = b->w;
+		r->h = b->h;
+	}
+	for (i = 0; i < numOld; ++i) {
+		b = blockindex_Find(&w->blocks, old[i].x, old[i].y);
+		if (b != NULL && b->x == old[i].x && b->y == old[i].y) {
+			continue;
 		}
+		rune_Evict(&window_buff(w, old[i].x, old[i].y)->r);
 	}
+}
+
+/* window_queue adds the draw res of rune r to the draw list */
+static void window_queue(const Rune *r, const RuneDrawResult *res,
+			 uint32_t layer) {
+	uint32_t key, material;
 
+	if (res->tex == 0 || draws.len == draws.cap) {
+		return;
+	}
+
+	material = r->props.material < MATERIAL_MAX ? r->props.material : 0;
+	key = material_Key(MATERIAL_QUAD,
+			   res->mode == RUNE_DRAW_SDF ? MATERIAL_SDF : 0,
+			   material);
+	draws.results[draws.len] = *res;
+	draws.items[draws.len].key = (uint64_t)layer << DRAW_LAYER_SHIFT |
+				     (uint64_t)key << DRAW_PROGRAM_SHIFT |
+				     (uint64_t)material << DRAW_MATERIAL_SHIFT |
+				     res->tex;
+	draws.items[draws.len].index = draws.len;
+	draws.len++;
+}
+
+/* compareDraws orders draws by key, then by the order they were queued */
+static int compareDraws(const void *a, const void *b) {
+	const DrawItem *x = a, *y = b;
+
+	if (x->key != y->key) {
+		return x->key < y->key ? -1 : 1;
+	}
+	return x->index < y->index ? -1 : x->index > y->index;
+}
+
+/* window_beginDraws allocates a draw list for n draws from the frame arena */
+static void window_beginDraws(uint32_t n) {
+	draws.results = frame_Alloc(n * sizeof(RuneDrawResult));
+	draws.items = frame_Alloc(n * sizeof(DrawItem));
+	draws.len = 0;
+	draws.cap = draws.results && draws.items ? n : 0;
+}
+
+/* window_flush draws and empties the draw list. Each program and material
+ * is made current once per run of draws that share it. Draws whose program
+ * is still being built are skipped; returns true if any were, so that the
+ * target is drawn again. */
+static bool window_flush() {
+	uint32_t i, key, material, lastKey, lastMaterial;
+	const RuneDrawResult *res;
+	bool deferred = false;
+
+	qsort(draws.items, draws.len, sizeof(DrawItem), compareDraws);
+	lastKey = lastMaterial = UINT32_MAX;
+	for (i = 0; i < draws.len; ++i) {
+		key = (draws.items[i].key >> DRAW_PROGRAM_SHIFT) & 0x7f;
+		material = (draws.items[i].key >> DRAW_MATERIAL_SHIFT) & 0xff;
+		res = &draws.results[draws.items[i].index];
+		if (key != lastKey || material != lastMaterial) {
+			if (!material_Ready(key)) {
+				deferred = true;
+				continue;
+			}
+			if (material_Use(key, material) == 0) {
+				continue;
+			}
+			lastKey = key;
+			lastMaterial = material;
+		}
+		material_SetDraw(key, res->tint, res->weight);
+		window_DrawRune(res);
+	}
+	draws.len = 0;
+	return deferred;
+}
+
+/* window_overBudget returns true if the resource runes use more memory than
+ * the budgets of meshes and images (see mem.h) */
+static bool window_overBudget() {
+	return mem_OverBudget(MEM_MESHES, MEM_GPU) ||
+	       mem_OverBudget(MEM_MESHES, MEM_CPU) ||
+	       mem_OverBudget(MEM_IMAGES, MEM_GPU);
+}
+
+/* compareEvictables orders resources from the least recently drawn */
+static int compareEvictables(const void *a, const void *b) {
+	const Evictable *x = a, *y = b;
+
+	return x->frame < y->frame ? -1 : x->frame > y->frame;
+}
+
+/* window_evict frees the resources of the blocks drawn least recently
+ * until meshes and images are within their budgets again. Meshes are freed
+ * per block, image textures per asset, as of the last block showing them.
+ * Blocks drawn in the current frame keep theirs; the others make them
+ * again, from the asset cache, when they are next drawn. */
+static void window_evict(Window *w) {
+	uint32_t i, n, asset, seen[ASSET_MAX];
+	Evictable *e;
+	Rune *r;
+
+	if (!window_overBudget() ||
+	    (e = frame_Alloc((w->blocks.numBlocks + ASSET_MAX) *
+			     sizeof(Evictable))) == NULL) {
+		return;
+	}
+	memset(seen, 0, sizeof(seen));
+	for (i = n = 0; i < w->blocks.numBlocks; ++i) {
+		Block *b = &w->blocks.blocks[i];
+
+		r = &window_buff(w, b->x, b->y)->r;
+		if (r->draw == rune_DrawMesh &&
+		    ((MeshRune *)r)->mesh.color != 0) {
+			e[n].frame = r->frame;
+			e[n].asset = 0;
+			e[n++].block = i;
+		} else if ((asset = rune_Asset(r)) != 0 &&
+			   r->frame > seen[asset - 1]) {
+			seen[asset - 1] = r->frame;
+		}
+	}
+	for (i = 0; i < ASSET_MAX; ++i) {
+		if (asset_Resident(i + 1)) {
+			e[n].frame = seen[i];
+			e[n++].asset = i + 1;
+		}
+	}
+
+	qsort(e, n, sizeof(Evictable), compareEvictables);
+	for (i = 0; i < n && e[i].frame != w->frame && window_overBudget();
+	     ++i) {
+		if (e[i].asset != 0) {
+			asset_Evict(e[i].asset);
+		} else {
+			Block *b = &w->blocks.blocks[e[i].block];
+			rune_Evict(&window_buff(w, b->x, b->y)->r);
+		}
+	}
+}
+
+/* window_renderBuffer renders the buffer into the bound target. Character
+ * cells are drawn from the viewport; resource blocks are drawn once from
+ * their anchor (which may lie in the virtual margin) if any part of the
+ * block is visible. Draws are queued, then sorted by material before they
+ * are issued. Blocks over the memory budgets are evicted afterwards.
+ * Returns true if an animated rune was drawn or a draw was put off. */
+static bool window_renderBuffer(Window *w) {
+	int32_t x, y;
+	uint32_t i;
+	bool live;
+
+	w->frame++;
+
+	/* every visible cell and block queues at most one draw */
+	window_beginDraws(w->w * w->h + w->blocks.numBlocks);
+	/* clear to transparent: mesh runes leave their own clear color set */
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
 	glClear(GL_COLOR_BUFFER_BIT);
+	live = false;
 
-	for (i = 0; i < w->h; ++i) {
-		for (j = 0; j < w->w; ++j) {
-			/* draw the rune @ (j, i) if it is dirty */
-			Rune *r = &w->buff[i][j].r;
-			if (r->flags.dirty && r->draw != NULL) {
-				RuneDrawResult res;
-				res = r->draw(r, j, i);
-				res.pos.x += i;
-				res.pos.y += j;
-				window_DrawRune(res.tex, res.pos, res.clip);
+	for (y = 0; y < (int32_t)w->h; ++y) {
+		for (x = 0; x < (int32_t)w->w; ++x) {
+			Rune *r = &window_peek(w, x, y)->r;
+			RuneDrawResult res;
+
+			if (r->draw == NULL || rune_IsResource(r->code) ||
+			    !window_visible(w, x, y, 1, 1)) {
+				continue;
 			}
-			/* mark the area that this rune renders to as 'clean' */
-			for (k = 0; (k < r->h) && (k < w->h); ++k) {
-				for (l = 0; (l < r->w) && (l < w->w); ++l) {
-					Rune *clean;
-					clean = &w->buff[i + k][j + l].r;
-					clean->flags.dirty = false;
-				}
+			res = r->draw(r, x, y);
+			res.pos.x += x;
+			res.pos.y += y;
+			if (r->anim != 0) {
+				anim_Apply(r->anim, &res);
+				live = true;
+			}
+			window_queue(r, &res, 0);
+		}
+	}
+
+	for (i = 0; i < w->blocks.numBlocks; ++i) {
+		Block *b = &w->blocks.blocks[i];
+		Rune *r = &window_buff(w, b->x, b->y)->r;
+		RuneDrawResult res;
+
+		x = (int32_t)b->x - WINDOW_MARGIN_W;
+		y = (int32_t)b->y - WINDOW_MARGIN_H;
+		if (r->draw == NULL || !window_visible(w, x, y, b->w, b->h)) {
+			continue;
+		}
+		r->frame = w->frame;
+		res = r->draw(r, x, y);
+		res.pos.x += x;
+		res.pos.y += y;
+		if (r->anim != 0) {
+			anim_Apply(r->anim, &res);
+			live = true;
+		}
+		window_queue(r, &res, 1);
+	}
+
+	/* resource blocks (layer 1) stay on top of the characters */
+	live |= window_flush();
+	window_evict(w);
+	return live;
+}
+
+/* window_renderGrid renders the cells of g into its target */
+static void window_renderGrid(Window *w, Grid *g) {
+	RuneDrawResult res;
+	Mat4x4 proj;
+	uint32_t x, y;
+	bool live;
+
+	if (!gridtarget_Fit(&g->target, g->w * w->cellW, g->h * w->cellH)) {
+		return;
+	}
+	mat4x4_orthographic(&proj, 0.0f, g->w, 0.0f, g->h, -1.0f, 1.0f);
+	material_SetMatrices(MATERIAL_QUAD, &proj, &Mat4x4Identity);
+	window_beginDraws(g->w * g->h);
+	glClearColor(0.0f, 0.0f, 0.0f, g->opaque ? 1.0f : 0.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+	live = false;
+
+	for (y = 0; y < g->h; ++y) {
+		for (x = 0; x < g->w; ++x) {
+			Rune *r = &g->cells[y * g->w + x].r;
+
+			if (r->draw == NULL || rune_IsResource(r->code)) {
+				continue;
+			}
+			res = r->draw(r, x, y);
+			res.pos.x += x;
+			res.pos.y += y;
+			if (r->anim != 0) {
+				anim_Apply(r->anim, &res);
+				live = true;
 			}
+			window_queue(r, &res, 0);
+		}
+	}
+	live |= window_flush();
+	g->dirty = live;
+}
+
+/* window_composite draws the rendering cached in t (which has premultiplied
+ * alpha, as every rune draw does) over the cells of pos */
+static void window_composite(const GridTarget *t, Rect pos) {
+	static const float opaque[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+	uint32_t key = MATERIAL_KEY(MATERIAL_QUAD, MATERIAL_PREMULTIPLIED);
+	RuneDrawResult res;
+
+	if (t->fbo == 0 || material_Use(key, 0) == 0) {
+		return;
+	}
+	memset(&res, 0, sizeof(res));
+	res.tex = t->tex;
+	res.pos = pos;
+	res.clip = gridtarget_Clip(t);
+	memcpy(res.tint, opaque, sizeof(opaque));
+	material_SetDraw(key, res.tint, 0.0f);
+	window_DrawRune(&res);
+}
+
+/* window_damaged returns true if the next redraw would change the frame */
+bool window_damaged(Window *w) {
+	int32_t dw, dh;
+	uint32_t i;
+
+	if (w->dirty || w->relayout || w->updating) {
+		return true;
+	}
+	for (i = 0; i < w->numGrids; ++i) {
+		if (!w->grids[i]->hidden && w->grids[i]->dirty) {
+			return true;
 		}
 	}
+	SDL_GL_GetDrawableSize(w->win, &dw, &dh);
+	return dw != w->pixelW || dh != w->pixelH;
+}
+
+/* window_damage makes the next redraw recomposite the frame */
+void window_damage(Window *w) { w->relayout = true; }
+
+/* window_redraw renders the window. The buffer and each grid are cached in
+ * their own targets, which are only redrawn when their cells change (or
+ * hold animations); the frame itself composites the targets, grids in
+ * increasing z over the buffer. Returns false (without presenting) if
+ * nothing changed, or if the shaders are still being built. */
+bool window_redraw(Window *w) {
+	int32_t dw, dh;
+	uint32_t i;
+	Rect pos;
+
+	window_updateBlocks(w);
+	if (w->relayout) {
+		window_occlude(w);
+	}
+	if (!window_damaged(w)) {
+		return false;
+	}
+	/* every frame composites the targets: until that program is built,
+	 * frames are put off and the damage is kept */
+	if (!material_Ready(
+		MATERIAL_KEY(MATERIAL_QUAD, MATERIAL_PREMULTIPLIED))) {
+		return false;
+	}
+	SDL_GL_GetDrawableSize(w->win, &dw, &dh);
+	if (dw != w->pixelW || dh != w->pixelH) {
+		window_project(w, dw, dh);
+	}
+
+	if (w->dirty && gridtarget_Fit(&w->target, dw, dh)) {
+		w->dirty = window_renderBuffer(w);
+	}
+	for (i = 0; i < w->numGrids; ++i) {
+		if (!w->grids[i]->hidden && w->grids[i]->dirty) {
+			window_renderGrid(w, w->grids[i]);
+		}
+	}
+	material_SetMatrices(MATERIAL_QUAD, &w->proj, &Mat4x4Identity);
+
+	if (!post_Begin(dw, dh)) {
+		glstate_BindFramebuffer(0);
+		glstate_Viewport(0, 0, dw, dh);
+	}
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+	pos.x = pos.y = 0.0f;
+	pos.w = (float)dw / w->cellW;
+	pos.h = (float)dh / w->cellH;
+	window_composite(&w->target, pos);
+
+	/* grid renderings have premultiplied alpha */
+	glstate_Enable(GL_BLEND, true);
+	glstate_BlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+	for (i = 0; i < w->numGrids; ++i) {
+		Grid *g = w->grids[i];
+
+		if (g->hidden) {
+			continue;
+		}
+		pos.x = g->x;
+		pos.y = g->y;
+		pos.w = g->w;
+		pos.h = g->h;
+		window_composite(&g->target, pos);
+	}
+	glstate_Enable(GL_BLEND, false);
+
+	post_End();
+	w->relayout = false;
+	w->submitted = sched_Now();
+	latency_Mark(LAT_SUBMIT);
 	SDL_GL_SwapWindow(w->win);
+	latency_Swapped();
+	frame_Reset();
+	return true;
 }
 
-/* window_update updates all runes within the window's render area. */
+/* window_update advances animations and updates all runes within the
+ * window's render area. */
 void window_update(Window *w) {
 	unsigned int i, j, k, l;
+	uint32_t now;
+
+	now = SDL_GetTicks();
+	anim_Tick((now - w->lastTick) / 1000.0f);
+	w->lastTick = now;
+
+	w->updating = false;
 
 	/* mark all runes as 'dirty' so that they will be updated */
 	for (i = 0; i < w->h; ++i) {
 		for (j = 0; j < w->w; ++j) {
-			w->buff[i][j].r.flags.dirty = true;
+			window_peek(w, j, i)->r.flags.dirty = true;
 		}
 	}
 
 	for (i = 0; i < w->h; ++i) {
 		for (j = 0; j < w->w; ++j) {
 			/* update the rune @ (j, i) if it is dirty */
-			Rune *r;
-			r = &(w->buff[i][j].r);
-			if (r->flags.dirty && r->update != NULL) {
-				r->update(r);
+			Rune *r, *c;
+			r = &window_peek(w, j, i)->r;
+			if (!r->flags.dirty || r->update == NULL) {
+				continue;
 			}
+			r->update(r);
+			w->dirty = w->updating = true;
 			/* mark the area that this rune updated as 'clean' */
-			for (k = i; k < (r->h + w->h) && (k < w->h); ++k) {
-				for (l = j; l < (r->w + w->w) && (l < w->w);
-				     ++l) {
-					r->flags.dirty = false;
+			for (k = i; k < i + r->h && k < w->h; ++k) {
+				for (l = j; l < j + r->w && l < w->w; ++l) {
+					c = &window_peek(w, l, k)->r;
+					c->flags.dirty = false;
 				}
 			}
 		}
 	}
 }
 
-/* window_resize resizes win to cols x rows tiles */
+/* window_resize resizes win to cols x rows tiles. Cells (and the resource
+ * blocks they form) stay where they are; cells that scroll out of view are
+ * kept for when the window grows again. */
 void window_resize(Window *win, uint32_t cols, uint32_t rows) {
+	cols = cols < WINDOW_MAX_W ? cols : WINDOW_MAX_W;
+	rows = rows < WINDOW_MAX_H ? rows : WINDOW_MAX_H;
+	if (!window_commit(win, WINDOW_MARGIN_H + rows)) {
+		return;
+	}
+	window_blank(win, WINDOW_MARGIN_W + cols, WINDOW_MARGIN_H + rows);
 	win->w = cols;
 	win->h = rows;
+	win->dirty = true;
+}
+
+/* window_fit resizes win to the cells that fit in a pw x ph pixel drawable */
+void window_fit(Window *win, uint32_t pw, uint32_t ph) {
+	window_resize(win, pw / win->cellW ? pw / win->cellW : 1,
+		      ph / win->cellH ? ph / win->cellH : 1);
 }
 
-/* window_at returns a reference to the rune at (x, y). */
+/* window_setCellSize sets the size of a cell in pixels, refitting win to
+ * its drawable */
+void window_setCellSize(Window *win, uint32_t cw, uint32_t ch) {
+	int32_t dw, dh;
+
+	if (cw == 0 || ch == 0) {
+		return;
+	}
+	win->cellW = cw;
+	win->cellH = ch;
+	SDL_GL_GetDrawableSize(win->win, &dw, &dh);
+	window_project(win, dw, dh);
+	window_fit(win, dw, dh);
+}
+
+/* window_at returns a reference to the rune at viewport cell (x, y). */
 Rune_ *window_at(Window *win, uint32_t x, uint32_t y) {
-	return &win->buff[x][y];
+	return window_cell(win, (int32_t)x, (int32_t)y);
+}
+
+/* window_cell returns a reference to the rune at (x, y) in the virtual buffer.
+ * (0, 0) is the upper-left corner of the viewport; x and y may be as small as
+ * -WINDOW_MARGIN_W and -WINDOW_MARGIN_H respectively. Since the rune may be
+ * changed through it, the buffer is redrawn on the next frame. */
+Rune_ *window_cell(Window *win, int32_t x, int32_t y) {
+	win->dirty = true;
+	return window_buff(win, x + WINDOW_MARGIN_W, y + WINDOW_MARGIN_H);
+}
+
+/* window_blockAt returns the anchor rune of the resource block covering
+ * (x, y) or NULL if there is none. If blk is not NULL, the block is copied
+ * into it (in buffer coordinates). */
+Rune_ *window_blockAt(Window *w, int32_t x, int32_t y, Block *blk) {
+	Block *b;
+
+	window_updateBlocks(w);
+	b = blockindex_Find(&w->blocks, x + WINDOW_MARGIN_W,
+			    y + WINDOW_MARGIN_H);
+	if (b == NULL) {
+		return NULL;
+	}
+	if (blk != NULL) {
+		*blk = *b;
+	}
+	w->dirty = true;
+	return window_buff(w, b->x, b->y);
+}
+
+/* window_stamp copies the sz byte rune r into every cell of the r->w x r->h
+ * area anchored at (x, y) and records the change in the block index. The
+ * animations of the runes stamped over are stopped (once each, as anim_Stop
+ * ignores the copies of an instance already freed). */
+static void window_stamp(Window *w, uint32_t x, uint32_t y, Rune *r,
+			 size_t sz) {
+	uint32_t i, j;
+	Rune *old;
+
+	for (i = 0; i < r->h && y + i < w->h; ++i) {
+		for (j = 0; j < r->w && x + j < w->w; ++j) {
+			old = &window_at(w, x + j, y + i)->r;
+			if (old->anim != 0 && old->anim != r->anim) {
+				anim_Stop(old->anim);
+			}
+			rune_Evict(old);
+			memcpy(window_at(w, x + j, y + i), r, sz);
+			blockindex_Set(&w->blocks, x + j + WINDOW_MARGIN_W,
+				       y + i + WINDOW_MARGIN_H, r->code);
+		}
+	}
 }
 
 void window_setChar(Window *w, uint32_t x, uint32_t y, CharRune *r) {
+	Rune *old = &window_at(w, x, y)->r;
+
+	/* the replaced rune's animation and resources go with it */
+	if (old->anim != 0 && old->anim != r->r.anim) {
+		anim_Stop(old->anim);
+	}
+	rune_Evict(old);
 	memcpy(&(window_at(w, x, y)->ch), r, sizeof(CharRune));
+	blockindex_Set(&w->blocks, x + WINDOW_MARGIN_W, y + WINDOW_MARGIN_H,
+		       r->r.code);
 }
 
+/* window_setMesh fills the area covered by r with it */
 void window_setMesh(Window *w, uint32_t x, uint32_t y, MeshRune *r) {
-	memcpy(&(window_at(w, x, y)->mesh), r, sizeof(MeshRune));
+	window_stamp(w, x, y, &r->r, sizeof(MeshRune));
 }
 
+/* window_setImg fills the area covered by r with it */
 void window_setImg(Window *w, uint32_t x, uint32_t y, ImgRune *r) {
-	memcpy(&(window_at(w, x, y)->img), r, sizeof(ImgRune));
+	window_stamp(w, x, y, &r->r, sizeof(ImgRune));
+}
+
+/* window_stack restores the compositing order of the grids of w: increasing
+ * z, then the order they were placed in */
+static void window_stack(Window *w) {
+	uint32_t i, j;
+	Grid *g;
+
+	for (i = 1; i < w->numGrids; ++i) {
+		g = w->grids[i];
+		for (j = i; j > 0 && (w->grids[j - 1]->z > g->z ||
+				      (w->grids[j - 1]->z == g->z &&
+				       w->grids[j - 1]->serial > g->serial));
+		     --j) {
+			w->grids[j] = w->grids[j - 1];
+		}
+		w->grids[j] = g;
+	}
+}
+
+/* window_newGrid adds grid id of cols x rows blank cells at the origin,
+ * above the other grids. Returns it (NULL on failure). */
+Grid *window_newGrid(Window *w, uint32_t id, uint32_t cols, uint32_t rows) {
+	Grid *g;
+
+	if (window_grid(w, id) != NULL || w->numGrids >= WINDOW_MAX_GRIDS) {
+		puts("error: failed to add grid");
+		return NULL;
+	}
+	if ((g = malloc(sizeof(Grid))) == NULL) {
+		puts("error: failed to add grid");
+		return NULL;
+	}
+	if (!init_Grid(g, id, cols, rows)) {
+		free(g);
+		return NULL;
+	}
+	g->z = w->numGrids > 0 ? w->grids[w->numGrids - 1]->z : 0;
+	g->serial = w->gridSerial++;
+	w->grids[w->numGrids++] = g;
+	window_stack(w);
+	w->relayout = true;
+	return g;
+}
+
+/* window_grid returns grid id (NULL if there is none) */
+Grid *window_grid(Window *w, uint32_t id) {
+	uint32_t i;
+
+	for (i = 0; i < w->numGrids; ++i) {
+		if (w->grids[i]->id == id) {
+			return w->grids[i];
+		}
+	}
+	return NULL;
+}
+
+/* window_placeGrid moves grid id to cell (x, y) at depth z. Its cells are
+ * not redrawn; the next frame only recomposites. */
+void window_placeGrid(Window *w, uint32_t id, int32_t x, int32_t y,
+		      int32_t z) {
+	Grid *g;
+
+	if ((g = window_grid(w, id)) == NULL) {
+		return;
+	}
+	g->x = x;
+	g->y = y;
+	w->relayout = true;
+	if (g->z != z) {
+		g->z = z;
+		g->serial = w->gridSerial++;
+		window_stack(w);
+	}
+}
+
+/* window_closeGrid removes grid id */
+void window_closeGrid(Window *w, uint32_t id) {
+	uint32_t i;
+
+	for (i = 0; i < w->numGrids && w->grids[i]->id != id; ++i)
+		;
+	if (i == w->numGrids) {
+		return;
+	}
+	deinit_Grid(w->grids[i]);
+	free(w->grids[i]);
+	memmove(&w->grids[i], &w->grids[i + 1],
+		(w->numGrids - i - 1) * sizeof(Grid *));
+	w->numGrids--;
+	w->relayout = true;
+}
+
+/* window_showGrid shows or hides grid id */
+void window_showGrid(Window *w, uint32_t id, bool shown) {
+	Grid *g;
+
+	if ((g = window_grid(w, id)) != NULL && g->hidden == shown) {
+		g->hidden = !shown;
+		w->relayout = true;
+	}
+}
+
+/* window_opaqueGrid sets whether grid id hides what is under it. An opaque
+ * grid is drawn over a background, and the runes of the buffer it covers
+ * are not drawn. */
+void window_opaqueGrid(Window *w, uint32_t id, bool opaque) {
+	Grid *g;
+
+	if ((g = window_grid(w, id)) != NULL && g->opaque != opaque) {
+		g->opaque = opaque;
+		g->dirty = true;
+		w->relayout = true;
+	}
+}
+
+/* window_locate sets the rune and rect of hit from its grid and cell.
+ * Returns false if they are gone. */
+static bool window_locate(Window *w, WindowHit *hit) {
+	Grid *g;
+
+	if (hit->grid == 0) {
+		hit->rune = window_peek(w, hit->x, hit->y);
+		return true;
+	}
+	if ((g = window_grid(w, hit->grid)) == NULL || hit->x < 0 ||
+	    hit->y < 0 || hit->x >= (int32_t)g->w || hit->y >= (int32_t)g->h) {
+		return false;
+	}
+	hit->rune = &g->cells[hit->y * g->w + hit->x];
+	hit->rect.x = g->x + hit->x;
+	hit->rect.y = g->y + hit->y;
+	return true;
+}
+
+/* window_pick resolves the point (x, y) (in window cells) to the rune
+ * drawn there: the topmost grid's cell, else the resource block covering
+ * it, else the buffer's cell. Returns false if there is none. */
+bool window_pick(Window *w, float x, float y, WindowHit *hit) {
+	int32_t cx, cy;
+	uint32_t i;
+	Block *b;
+
+	cx = (int32_t)floorf(x);
+	cy = (int32_t)floorf(y);
+	hit->rect.w = hit->rect.h = 1.0f;
+	for (i = w->numGrids; i-- > 0;) {
+		Grid *g = w->grids[i];
+
+		if (g->hidden || cx < g->x || cy < g->y ||
+		    cx >= g->x + (int32_t)g->w || cy >= g->y + (int32_t)g->h) {
+			continue;
+		}
+		hit->grid = g->id;
+		hit->x = cx - g->x;
+		hit->y = cy - g->y;
+		return window_locate(w, hit);
+	}
+	if (cx < 0 || cy < 0 || cx >= (int32_t)w->w || cy >= (int32_t)w->h) {
+		return false;
+	}
+
+	hit->grid = 0;
+	hit->x = cx;
+	hit->y = cy;
+	window_updateBlocks(w);
+	b = blockindex_Find(&w->blocks, cx + WINDOW_MARGIN_W,
+			    cy + WINDOW_MARGIN_H);
+	if (b != NULL) {
+		hit->x = (int32_t)b->x - WINDOW_MARGIN_W;
+		hit->y = (int32_t)b->y - WINDOW_MARGIN_H;
+		hit->rect.w = b->w;
+		hit->rect.h = b->h;
+	}
+	hit->rect.x = hit->x;
+	hit->rect.y = hit->y;
+	return window_locate(w, hit);
+}
+
+/* window_pointer delivers a RUNE_POINTER_* event at (x, y) (in window
+ * cells) to the rune under it, or to the rune the pointer was pressed on */
+void window_pointer(Window *w, uint32_t type, float x, float y,
+		    uint32_t button) {
+	RunePointer p;
+	WindowHit hit;
+	Rune *r;
+	Grid *g;
+
+	if (w->capturing) {
+		hit = w->captured;
+		if (!window_locate(w, &hit)) {
+			w->capturing = false;
+			return;
+		}
+	} else if (!window_pick(w, x, y, &hit)) {
+		return;
+	}
+	if (type == RUNE_POINTER_PRESS) {
+		w->captured = hit;
+		w->capturing = true;
+	} else if (type == RUNE_POINTER_RELEASE) {
+		w->capturing = false;
+	}
+
+	r = &hit.rune->r;
+	if (r->pointer == NULL) {
+		return;
+	}
+	p.type = type;
+	p.button = button;
+	p.x = (int32_t)floorf(x - hit.rect.x);
+	p.y = (int32_t)floorf(y - hit.rect.y);
+	p.u = (x - hit.rect.x) / hit.rect.w;
+	p.v = (y - hit.rect.y) / hit.rect.h;
+	r->pointer(r, &p);
+
+	/* the handler may have changed how the rune looks */
+	if (hit.grid == 0) {
+		w->dirty = true;
+	} else if ((g = window_grid(w, hit.grid)) != NULL) {
+		g->dirty = true;
+	}
+}
+
+/* window_reloaded redraws the buffer and the grids that show asset, which
+ * was just reloaded */
+void window_reloaded(Window *w, uint32_t asset) {
+	uint32_t i, j;
+	Block *b;
+	Grid *g;
+
+	window_updateBlocks(w);
+	for (i = 0; i < w->blocks.numBlocks && !w->dirty; ++i) {
+		b = &w->blocks.blocks[i];
+		if (rune_Asset(&window_buff(w, b->x, b->y)->r) == asset) {
+			w->dirty = true;
+		}
+	}
+	for (i = 0; i < w->numGrids; ++i) {
+		g = w->grids[i];
+		for (j = 0; j < g->w * g->h && !g->dirty; ++j) {
+			if (rune_Asset(&g->cells[j].r) == asset) {
+				g->dirty = true;
+			}
+		}
+	}
 }
@@ -2,16 +2,85 @@
 #define WINDOW_H
 
 #include <SDL2/SDL.h>
+#include "block.h"
+#include "grid.h"
+#include "matrix.h"
 #include "rune.h"
 
-enum { WINDOW_MAX_W = 480, WINDOW_MAX_H = 300 };
+/* The largest grid (in cells); enough for an 8K display with small fonts.
+ * Its storage is reserved up front and committed as the grid grows. */
+enum { WINDOW_MAX_W = 2048, WINDOW_MAX_H = 1024 };
+
+/* the default size of a cell in pixels */
+enum { WINDOW_CELL_W = 32, WINDOW_CELL_H = 32 };
+
+/* The virtual buffer extends this many cells above and to the left of the
+ * viewport so that resource blocks anchored off-screen can still render */
+enum { WINDOW_MARGIN_W = RUNE_MAX_W - 1, WINDOW_MARGIN_H = RUNE_MAX_H - 1 };
+
+/* the cells between the starts of consecutive rows of the buffer */
+enum { WINDOW_STRIDE = WINDOW_MARGIN_W + WINDOW_MAX_W };
+
+/* the most grids composited over the buffer */
+enum { WINDOW_MAX_GRIDS = 64 };
+
+/* maximum number of opaque floating rects tracked for occlusion culling */
+enum { WINDOW_MAX_OCCLUDERS = 16 };
+
+/* the default budgets (in MiB) of the GPU memory of meshes and images;
+ * past them, the blocks drawn least recently give up their resources */
+enum { WINDOW_MESH_BUDGET = 256, WINDOW_IMAGE_BUDGET = 256 };
+
+/* WindowHit is the rune a point of the window resolves to */
+typedef struct {
+	Rune_ *rune;   /* the rune hit (for a block, its anchor) */
+	uint32_t grid; /* the id of the grid hit, 0 for the buffer */
+	int32_t x, y;  /* the rune's cell in the grid or viewport */
+	Rect rect;     /* the cells the rune covers, in window cells */
+} WindowHit;
 
 typedef struct {
 	uint32_t w, h;
 	SDL_Window *win;
 	SDL_GLContext ctx;
 
-	Rune_ buff[WINDOW_MAX_W][WINDOW_MAX_H];
+	uint32_t cellW, cellH; /* the size of a cell in pixels */
+	int32_t pixelW, pixelH; /* the drawable size of the projection */
+
+	/* buff holds WINDOW_STRIDE cells per row and includes the virtual
+	 * margin. Rows are committed as the grid grows; cells outside the
+	 * viewport keep their contents, so resizing never moves a cell. */
+	Rune_ *buff;
+	uint32_t committed;    /* rows of buff that are committed */
+	uint32_t initW, initH; /* the extent of the initialized cells */
+
+	/* target caches the rendering of buff, which is redrawn when dirty */
+	GridTarget target;
+	bool dirty;
+	Mat4x4 proj; /* maps the window's cells onto its drawable */
+
+	bool relayout; /* the grids moved since the last frame */
+	bool updating; /* a rune updated in the last window_update() */
+	double submitted; /* sched_Now() when the last frame was submitted */
+
+	/* grids are composited over buff in increasing z */
+	Grid *grids[WINDOW_MAX_GRIDS];
+	uint32_t numGrids, gridSerial;
+
+	/* blocks indexes the resource blocks of buff (in buffer coordinates) */
+	BlockIndex blocks;
+	uint32_t frame; /* the number of times buff was rendered */
+
+	/* occluders are the rects (in cells) of the visible opaque grids */
+	Rect occluders[WINDOW_MAX_OCCLUDERS];
+	uint32_t numOccluders;
+
+	uint32_t lastTick; /* SDL_GetTicks() at the last update */
+
+	/* the rune a pointer button was pressed on receives the pointer
+	 * events until the button is released */
+	WindowHit captured;
+	bool capturing;
 
 	const char name[32];
 } Window;
@@ -19,13 +88,31 @@ typedef struct {
 Window *new_Window(uint32_t, uint32_t);
 void del_Window(Window *);
 
-void window_redraw(Window *);
+bool window_redraw(Window *);
+bool window_damaged(Window *);
+void window_damage(Window *);
 void window_update(Window *);
 void window_resize(Window *, uint32_t, uint32_t);
+bool window_commit(Window *, uint32_t);
+void window_fit(Window *, uint32_t, uint32_t);
+void window_setCellSize(Window *, uint32_t, uint32_t);
 Rune_ *window_at(Window *, uint32_t, uint32_t);
+Rune_ *window_cell(Window *, int32_t, int32_t);
+Rune_ *window_blockAt(Window *, int32_t, int32_t, Block *);
 
 void window_setChar(Window *, uint32_t, uint32_t, CharRune *);
 void window_setMesh(Window *, uint32_t, uint32_t, MeshRune *);
 void window_setImg(Window *, uint32_t, uint32_t, ImgRune *);
 
+bool window_pick(Window *, float, float, WindowHit *);
+void window_reloaded(Window *, uint32_t);
+void window_pointer(Window *, uint32_t, float, float, uint32_t);
+
+Grid *window_newGrid(Window *, uint32_t, uint32_t, uint32_t);
+Grid *window_grid(Window *, uint32_t);
+void window_placeGrid(Window *, uint32_t, int32_t, int32_t, int32_t);
+void window_closeGrid(Window *, uint32_t);
+void window_showGrid(Window *, uint32_t, bool);
+void window_opaqueGrid(Window *, uint32_t, bool);
+
 #endif
@@ -0,0 +1,330 @@
+#include "xform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "alloc.h"
+
+void init_XformTree(XformTree *t) { memset(t, 0, sizeof(XformTree)); }
+
+void deinit_XformTree(XformTree *t) {
+	free(t->local);
+	free(t->world);
+	free(t->parent);
+	free(t->handle);
+	free(t->dirty);
+	free(t->index);
+	free(t->freeHandles);
+	init_XformTree(t);
+}
+
+/* growNodes makes room for one more node */
+static bool growNodes(XformTree *t) {
+	uint32_t cap;
+	void *p;
+
+	if (t->len < t->cap) {
+		return true;
+	}
+	cap = t->cap ? t->cap * 2 : 64;
+	if ((p = alloc_Realloc(t->local, cap * sizeof(Mat4x4))) == NULL) {
+		goto fail;
+	}
+	t->local = p;
+	if ((p = alloc_Realloc(t->world, cap * sizeof(Mat4x4))) == NULL) {
+		goto fail;
+	}
+	t->world = p;
+	if ((p = alloc_Realloc(t->parent, cap * sizeof(uint32_t))) == NULL) {
+		goto fail;
+	}
+	t->parent = p;
+	if ((p = alloc_Realloc(t->handle, cap * sizeof(uint32_t))) == NULL) {
+		goto fail;
+	}
+	t->handle = p;
+	if ((p = alloc_Realloc(t->dirty, cap)) == NULL) {
+		goto fail;
+	}
+	t->dirty = p;
+	t->cap = cap;
+	return true;
+fail:
+	puts("error: failed to grow transform tree");
+	return false;
+}
+
+/* newHandle returns an unused handle (XFORM_NONE on failure) */
+static uint32_t newHandle(XformTree *t) {
+	uint32_t cap;
+	void *p;
+
+	if (t->numFree > 0) {
+		return t->freeHandles[--t->numFree];
+	}
+	if (t->numHandles == t->capHandles) {
+		cap = t->capHandles ? t->capHandles * 2 : 64;
+		p = alloc_Realloc(t->index, cap * sizeof(uint32_t));
+		if (p == NULL) {
+			goto fail;
+		}
+		t->index = p;
+		p = alloc_Realloc(t->freeHandles, cap * sizeof(uint32_t));
+		if (p == NULL) {
+			goto fail;
+		}
+		t->freeHandles = p;
+		t->capHandles = cap;
+	}
+	return t->numHandles++;
+fail:
+	puts("error: failed to grow transform tree");
+	return XFORM_NONE;
+}
+
+static bool sort(XformTree *);
+
+/* position returns the position of the node of handle h (or XFORM_NONE) */
+static uint32_t position(const XformTree *t, uint32_t h) {
+	return h < t->numHandles ? t->index[h] : XFORM_NONE;
+}
+
+/* xform_Add adds a node with the given local transform under the node of
+ * handle parent (or as a root if XFORM_NONE). Returns its handle or
+ * XFORM_NONE on failure. */
+uint32_t xform_Add(XformTree *t, uint32_t parent, const Mat4x4 *local) {
+	uint32_t h, i, p;
+
+	p = XFORM_NONE;
+	if (parent != XFORM_NONE &&
+	    (p = position(t, parent)) == XFORM_NONE) {
+		return XFORM_NONE;
+	}
+	if (!growNodes(t) || (h = newHandle(t)) == XFORM_NONE) {
+		return XFORM_NONE;
+	}
+
+	/* appending keeps every parent before its children */
+	i = t->len++;
+	t->local[i] = *local;
+	t->parent[i] = p;
+	t->handle[i] = h;
+	t->dirty[i] = 1;
+	t->index[h] = i;
+	t->anyDirty = true;
+	return h;
+}
+
+/* xform_Remove removes the node of handle h and all of its descendants.
+ * Since descendants come after their ancestors, one pass from the node
+ * finds and compacts them. */
+void xform_Remove(XformTree *t, uint32_t h) {
+	uint32_t r, i, w, *remap;
+
+	if (t->unsorted && !sort(t)) {
+		return;
+	}
+	if ((r = position(t, h)) == XFORM_NONE) {
+		return;
+	}
+	if ((remap = alloc_Heap((t->len - r) * sizeof(uint32_t))) == NULL) {
+		puts("error: failed to remove transform");
+		return;
+	}
+
+	/* remap holds the new position of each node from r on */
+	for (i = r, w = r; i < t->len; ++i) {
+		uint32_t p = t->parent[i];
+
+		if (i == r ||
+		    (p != XFORM_NONE && p >= r && remap[p - r] == XFORM_NONE)) {
+			t->index[t->handle[i]] = XFORM_NONE;
+			t->freeHandles[t->numFree++] = t->handle[i];
+			remap[i - r] = XFORM_NONE;
+			continue;
+		}
+		remap[i - r] = w;
+		if (p != XFORM_NONE && p >= r) {
+			p = remap[p - r];
+		}
+		t->local[w] = t->local[i];
+		t->world[w] = t->world[i];
+		t->parent[w] = p;
+		t->handle[w] = t->handle[i];
+		t->dirty[w] = t->dirty[i];
+		t->index[t->handle[w]] = w;
+		w++;
+	}
+	t->len = w;
+	free(remap);
+}
+
+/* xform_SetParent moves the node of handle h under the node of handle
+ * parent (or makes it a root). Fails if parent is h or a descendant of h. */
+bool xform_SetParent(XformTree *t, uint32_t h, uint32_t parent) {
+	uint32_t i, p, q;
+
+	if ((i = position(t, h)) == XFORM_NONE) {
+		return false;
+	}
+	p = XFORM_NONE;
+	if (parent != XFORM_NONE) {
+		if ((p = position(t, parent)) == XFORM_NONE) {
+			return false;
+		}
+		for (q = p; q != XFORM_NONE; q = t->parent[q]) {
+			if (q == i) {
+				puts("error: transform parent cycle");
+				return false;
+			}
+		}
+	}
+	t->parent[i] = p;
+	t->dirty[i] = 1;
+	t->anyDirty = true;
+	if (p != XFORM_NONE && p > i) {
+		t->unsorted = true;
+	}
+	return true;
+}
+
+/* xform_SetLocal sets the local transform of the node of handle h */
+void xform_SetLocal(XformTree *t, uint32_t h, const Mat4x4 *local) {
+	uint32_t i;
+
+	if ((i = position(t, h)) == XFORM_NONE) {
+		return;
+	}
+	t->local[i] = *local;
+	t->dirty[i] = 1;
+	t->anyDirty = true;
+}
+
+/* xform_World returns the world transform of the node of handle h as of the
+ * last update (NULL if there is no such node) */
+const Mat4x4 *xform_World(const XformTree *t, uint32_t h) {
+	uint32_t i;
+
+	if ((i = position(t, h)) == XFORM_NONE) {
+		return NULL;
+	}
+	return &t->world[i];
+}
+
+/* sort restores parent-before-child order with a stable counting sort of the
+ * nodes by depth */
+static bool sort(XformTree *t) {
+	uint32_t *depth, *start, *order, i, j, d, maxDepth;
+	XformTree s;
+
+	depth = alloc_Heap(t->len * sizeof(uint32_t));
+	order = alloc_Heap(t->len * sizeof(uint32_t));
+	start = NULL;
+	if (depth == NULL || order == NULL) {
+		goto fail;
+	}
+
+	maxDepth = 0;
+	for (i = 0; i < t->len; ++i) {
+		for (d = 0, j = t->parent[i]; j != XFORM_NONE; j = t->parent[j]) {
+			d++;
+		}
+		depth[i] = d;
+		maxDepth = d > maxDepth ? d : maxDepth;
+	}
+	if ((start = alloc_Heap((maxDepth + 2) * sizeof(uint32_t))) ==
+	    NULL) {
+		goto fail;
+	}
+	memset(start, 0, (maxDepth + 2) * sizeof(uint32_t));
+	for (i = 0; i < t->len; ++i) {
+		start[depth[i] + 1]++;
+	}
+	for (d = 1; d <= maxDepth + 1; ++d) {
+		start[d] += start[d - 1];
+	}
+	/* order[new position] = old position; depth becomes old -> new */
+	for (i = 0; i < t->len; ++i) {
+		j = start[depth[i]]++;
+		order[j] = i;
+		depth[i] = j;
+	}
+
+	/* permute into a copy of the node arrays */
+	s = *t;
+	s.local = s.world = NULL;
+	s.parent = s.handle = NULL;
+	s.dirty = NULL;
+	s.len = s.cap = 0;
+	for (i = 0; i < t->len; ++i) {
+		if (!growNodes(&s)) {
+			goto failCopy;
+		}
+		j = order[i];
+		s.local[i] = t->local[j];
+		s.world[i] = t->world[j];
+		s.parent[i] = t->parent[j] == XFORM_NONE ? XFORM_NONE
+							 : depth[t->parent[j]];
+		s.handle[i] = t->handle[j];
+		s.dirty[i] = t->dirty[j];
+		s.len++;
+	}
+	for (i = 0; i < s.len; ++i) {
+		s.index[s.handle[i]] = i;
+	}
+	free(t->local);
+	free(t->world);
+	free(t->parent);
+	free(t->handle);
+	free(t->dirty);
+	*t = s;
+	t->unsorted = false;
+	free(depth);
+	free(order);
+	free(start);
+	return true;
+failCopy:
+	free(s.local);
+	free(s.world);
+	free(s.parent);
+	free(s.handle);
+	free(s.dirty);
+fail:
+	puts("error: failed to sort transform tree");
+	free(depth);
+	free(order);
+	free(start);
+	return false;
+}
+
+/* xform_Update recomputes the world transform of every node that changed
+ * (or whose ancestor changed) since the last update. Returns the number of
+ * nodes recomputed. */
+uint32_t xform_Update(XformTree *t) {
+	uint32_t i, p, n;
+
+	if (t->unsorted && !sort(t)) {
+		return 0;
+	}
+	if (!t->anyDirty) {
+		return 0;
+	}
+	for (i = n = 0; i < t->len; ++i) {
+		p = t->parent[i];
+		if (p != XFORM_NONE) {
+			t->dirty[i] |= t->dirty[p];
+		}
+		if (!t->dirty[i]) {
+			continue;
+		}
+		if (p == XFORM_NONE) {
+			t->world[i] = t->local[i];
+		} else {
+			mat4x4_multiply_to(&t->world[i], &t->world[p],
+					   &t->local[i]);
+		}
+		n++;
+	}
+	memset(t->dirty, 0, t->len);
+	t->anyDirty = false;
+	return n;
+}
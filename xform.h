@@ -0,0 +1,49 @@
+/*
+ * xform.h
+ * The XformTree composes the transforms of a hierarchy (mesh nodes, groups
+ * of runes). Nodes are stored in flat arrays with every parent before its
+ * children, so xform_Update() recomputes the world transforms in a single
+ * linear pass; only nodes whose local transform (or an ancestor's) changed
+ * since the last update are recomputed.
+ * Nodes are referred to by handles, which stay valid while nodes are
+ * reordered.
+ */
+#ifndef XFORM_H
+#define XFORM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "matrix.h"
+
+/* no node (the parent of a root) */
+enum { XFORM_NONE = 0xffffffff };
+
+typedef struct {
+	/* the nodes, indexed by position (parents before children) */
+	Mat4x4 *local;
+	Mat4x4 *world;
+	uint32_t *parent; /* the position of the parent or XFORM_NONE */
+	uint32_t *handle; /* the handle of the node at each position */
+	uint8_t *dirty;
+	uint32_t len, cap;
+
+	/* index maps a handle to its node's position (XFORM_NONE if unused) */
+	uint32_t *index;
+	uint32_t *freeHandles;
+	uint32_t numHandles, numFree, capHandles;
+
+	bool unsorted; /* a node was moved under a parent placed after it */
+	bool anyDirty;
+} XformTree;
+
+void init_XformTree(XformTree *);
+void deinit_XformTree(XformTree *);
+
+uint32_t xform_Add(XformTree *, uint32_t, const Mat4x4 *);
+void xform_Remove(XformTree *, uint32_t);
+bool xform_SetParent(XformTree *, uint32_t, uint32_t);
+void xform_SetLocal(XformTree *, uint32_t, const Mat4x4 *);
+const Mat4x4 *xform_World(const XformTree *, uint32_t);
+uint32_t xform_Update(XformTree *);
+
+#endif